@@ -16,6 +16,8 @@
  * --------------
  * 04/20/09: File creation (AMH)
  * 03/10/14: #ifdef out CEL qc fields to save memory (EAW)
+ * 10/16/26: read cells through affy_cel_value() and friends (EAW)
+ * 10/16/26: masks/outliers are sorted cell lists now (EAW)
  *
  **************************************************************************/
 
@@ -25,7 +27,9 @@
 
 #define JSON_BOOLEAN(x) ((x) ? "true" : "false")
 
-static void print_cell_json(AFFY_CELL *cell, 
+static void print_cell_json(AFFY_CELFILE *cf,
+                            int x,
+                            int y,
                             int ismasked, 
                             int isoutlier,
                             FILE *fp)
@@ -39,14 +43,15 @@ static void print_cell_json(AFFY_CELL *cell,
                      "\"masked\":%s,\"outlier\":%s}";
 #endif
 
-  assert(cell != NULL);
-  assert(fp   != NULL);
+  assert(cf != NULL);
+  assert(fp != NULL);
 
 #ifdef STORE_CEL_QC
-  fprintf(fp, tmpl, cell->value, cell->stddev, cell->numpixels,
+  fprintf(fp, tmpl, affy_cel_value(cf, x, y), affy_cel_stddev(cf, x, y),
+          affy_cel_numpixels(cf, x, y),
           JSON_BOOLEAN(ismasked), JSON_BOOLEAN(isoutlier));
 #else
-  fprintf(fp, tmpl, cell->value,
+  fprintf(fp, tmpl, affy_cel_value(cf, x, y),
           JSON_BOOLEAN(ismasked), JSON_BOOLEAN(isoutlier));
 #endif
 }
@@ -77,9 +82,9 @@ void cel_to_json(void *vp, const char *output_name)
       else
         fprintf(fp, "    ");
         
-      print_cell_json(&(cf->data[j][i]), 
-                      bit_test(cf->mask[j], i),
-                      bit_test(cf->outlier[j], i),
+      print_cell_json(cf, j, i,
+                      affy_cel_ismasked_at(cf, (size_t)j * cf->numrows + i),
+                      affy_cel_isoutlier_at(cf, (size_t)j * cf->numrows + i),
                       fp);
     }
   
@@ -91,39 +96,34 @@ void cel_to_sexpr(void *vp, const char *output_name)
 }
 
 #if defined(AFFY_HAVE_NETCDF)
-static void write_netcdf_bitmap(bitstr_t **bitmap, 
-                                int ncid, 
-                                int varid,
-                                int rows,
-                                int cols)
+static void write_netcdf_cell_list(affy_uint32 *cells,
+                                   affy_uint32 num_cells,
+                                   int ncid, 
+                                   int varid,
+                                   int rows)
 {
-  unsigned int rec_count = 0, i, j;
-  int          status;
-
-  assert(bitmap != NULL);
-
-  for (i = 0; i < rows; i++)
-    for (j = 0; j < cols; j++)
-    {
-      if (bit_test(bitmap[j], i))
-      {
-        int count[] = { 1, 2 };
-        int val[2], start[2];
-        
-        val[0] = j;
-        val[1] = i;
-        
-        start[0] = rec_count++;
-        start[1] = 0;
-        
-        if ((status = nc_put_vara_int(ncid, 
-                                      varid, 
-                                      start, 
-                                      count, 
-                                      val)) != NC_NOERR)
-          die("Couldn't write NetCDF data (%s)", nc_strerror(status));
-      }
-    }
+  affy_uint32 k;
+  int         status;
+
+  /* cells are sorted in x-major order */
+  for (k = 0; k < num_cells; k++)
+  {
+    int count[] = { 1, 2 };
+    int val[2], start[2];
+
+    val[0] = cells[k] / rows;
+    val[1] = cells[k] % rows;
+
+    start[0] = k;
+    start[1] = 0;
+
+    if ((status = nc_put_vara_int(ncid, 
+                                  varid, 
+                                  start, 
+                                  count, 
+                                  val)) != NC_NOERR)
+      die("Couldn't write NetCDF data (%s)", nc_strerror(status));
+  }
 }
 
 void cel_to_netcdf(void *vp, const char *output_name)
@@ -226,18 +226,18 @@ void cel_to_netcdf(void *vp, const char *output_name)
     die("Couldn't leave NetCDF define mode (%s)", nc_strerror(status));
 
   /* Masks */
-  write_netcdf_bitmap(cf->mask, 
-                      ncid, 
-                      mask_var, 
-                      cf->numrows, 
-                      cf->numcols);
+  write_netcdf_cell_list(cf->mask, 
+                         cf->mask ? cf->nummasks : 0,
+                         ncid, 
+                         mask_var, 
+                         cf->numrows);
 
   /* Outliers */
-  write_netcdf_bitmap(cf->outlier, 
-                      ncid, 
-                      outlier_var, 
-                      cf->numrows, 
-                      cf->numcols);
+  write_netcdf_cell_list(cf->outlier, 
+                         cf->outlier ? cf->numoutliers : 0,
+                         ncid, 
+                         outlier_var, 
+                         cf->numrows);
 
   /* Intensity, standard deviation, number of pixels */
   for (i = 0; i < cf->numrows; i++)
@@ -247,9 +247,9 @@ void cel_to_netcdf(void *vp, const char *output_name)
       double     intensity, stddev;
       affy_int16 numpixels;
 
-      intensity = cf->data[j][i].value;
-      stddev    = cf->data[j][i].stddev;
-      numpixels = cf->data[j][i].numpixels;
+      intensity = affy_cel_value(cf, j, i);
+      stddev    = affy_cel_stddev(cf, j, i);
+      numpixels = affy_cel_numpixels(cf, j, i);
 
       idx[0] = i;
       idx[1] = j;
@@ -1,5 +1,6 @@
 
 /* 2020/08/12:  modified to (hopefully) compile with f->cdf_filename stuff
+ * 2026/10/16:  look probesets up with affy_cdf_find_probeset()
  */
 
 #include "affy.h"
@@ -59,11 +60,12 @@ int main(int argc, char **argv)
   /* Identify a probeset */
   for (i = 0; probeset_list[i] != NULL; i++)
   {
-    /* Try and find the probeset in the chip */
-    for (j = 0; j < cp->cdf->numprobesets; j++)
+    /* Try and find the probeset (and any namesakes) in the chip */
+    for (j = affy_cdf_find_probeset(cp->cdf, probeset_list[i]);
+         j >= 0;
+         j = cp->cdf->name_next[j])
     {
-      if (!strcmp(probeset_list[i], cp->cdf->probeset[j].name))
-        write_probeset(cp, &(cp->cdf->probeset[j]), err);
+      write_probeset(cp, &(cp->cdf->probeset[j]), err);
     }
   }
 
@@ -56,6 +56,8 @@
  * 08/12/20: pass flags to affy_create_chipset() (EAW)
  * 03/24/21: corrected --ignore-weak description (ignore <= 0, not <= 1)
  * 03/24/21: add progress indicator for missing data pre-scan
+ * 10/16/26: read --spreadsheet input with LINE_READER (EAW)
+ * 10/16/26: skip control/excluded/spikein probes by cdf->ps_flags[] (EAW)
  *
  **************************************************************************/
 
@@ -194,7 +196,7 @@ affy_uint32 fill_all_points(char *filename, float **all_points,
                             AFFY_ERROR *err)
 {
   FILE *data_file;
-  int max_string_len = 0;
+  LINE_READER *lr;
   char *string       = NULL;
   char **fields      = NULL;
   char *sptr;
@@ -214,9 +216,16 @@ affy_uint32 fill_all_points(char *filename, float **all_points,
   data_file = fopen(filename, "rb");
   if (!data_file)
     AFFY_HANDLE_ERROR("can not open data file", AFFY_ERROR_NOTFOUND, err, 0);
+
+  lr = line_reader_init(data_file);
+  if (lr == NULL)
+  {
+    fclose(data_file);
+    AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, 0);
+  }
   
   /* read header line */
-  fgets_strip_realloc(&string, &max_string_len, data_file);
+  string = line_reader_next(lr, NULL);
   num_fields = split_tabs(string, &fields, &max_field);
   
   /* first field is probe, the rest are samples, skip empty columns */
@@ -251,7 +260,7 @@ affy_uint32 fill_all_points(char *filename, float **all_points,
   /* assume only a single line per probe */
   /* multiple identical probes will be treated as separate probes */
   /* skip blank probes */
-  while(fgets_strip_realloc(&string, &max_string_len, data_file))
+  while ((string = line_reader_next(lr, NULL)) != NULL)
   {
     num_fields = split_tabs(string, &fields, &max_field);
 
@@ -342,8 +351,7 @@ affy_uint32 fill_all_points(char *filename, float **all_points,
   
   fclose(data_file);
 
-  if (string)
-    free(string);
+  line_reader_free(lr);
   if (fields)
     free(fields);
   
@@ -1044,26 +1052,9 @@ int main(int argc, char **argv)
           continue;
         }
         
-        if (affy_is_control_string(cdf->probe[temp_idx]->ps->name))
+        /* skip control, excluded and spikein probesets */
+        if (affy_probe_flags(cdf, temp_idx) & affy_training_mask_flags(&flags))
           continue;
-
-        /* skip excluded probesets */
-        if (flags.use_exclusions && cdf->exclusions)
-        {
-          if (bsearch(&cdf->probe[temp_idx]->ps->name, &cdf->exclusions[0],
-              cdf->numexclusions, sizeof(char *), compare_string))
-          {
-            continue;
-          }
-        }
-        if (flags.use_spikeins && cdf->spikeins)
-        {
-          if (bsearch(&cdf->probe[temp_idx]->ps->name, &cdf->spikeins[0],
-              cdf->numspikeins, sizeof(char *), compare_string))
-          {
-            continue;
-          }
-        }
         
         num_all_points++;
     }
@@ -1127,28 +1118,11 @@ int main(int argc, char **argv)
           continue;
         }
 
-        if (affy_is_control_string(cdf->probe[temp_idx]->ps->name))
+        /* skip control, excluded and spikein probesets */
+        if (affy_probe_flags(cdf, temp_idx) & affy_training_mask_flags(&flags))
           continue;
-
-        /* skip excluded probesets */
-        if (flags.use_exclusions && cdf->exclusions)
-        {
-          if (bsearch(&cdf->probe[temp_idx]->ps->name, &cdf->exclusions[0],
-              cdf->numexclusions, sizeof(char *), compare_string))
-          {
-            continue;
-          }
-        }
-        if (flags.use_spikeins && cdf->spikeins)
-        {
-          if (bsearch(&cdf->probe[temp_idx]->ps->name, &cdf->spikeins[0],
-              cdf->numspikeins, sizeof(char *), compare_string))
-          {
-            continue;
-          }
-        }
         
-        value = cel->data[x][y].value;
+        value = affy_cel_value(cel, x, y);
 
         if (opt_ignore_weak && value <= 0)
         {
@@ -1265,27 +1239,10 @@ int main(int argc, char **argv)
       num_all_points = 0;
       for (point_idx = 0; point_idx < num_probesets; point_idx++)
       {
-        if (affy_is_control_string(cdf->probeset[point_idx].name))
+        /* skip control, excluded and spikein probesets */
+        if (cdf->ps_flags[point_idx] & affy_training_mask_flags(&flags))
           continue;
 
-        /* skip excluded probesets */
-        if (flags.use_exclusions && cdf->exclusions)
-        {
-          if (bsearch(&cdf->probeset[point_idx].name, &cdf->exclusions[0],
-              cdf->numexclusions, sizeof(char *), compare_string))
-          {
-            continue;
-          }
-        }
-        if (flags.use_spikeins && cdf->spikeins)
-        {
-          if (bsearch(&cdf->probeset[point_idx].name, &cdf->spikeins[0],
-              cdf->numspikeins, sizeof(char *), compare_string))
-          {
-            continue;
-          }
-        }
-
         value = temp->chip[0]->probe_set[point_idx];
         
         if (opt_ignore_weak && value <= 0)
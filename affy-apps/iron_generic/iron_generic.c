@@ -35,6 +35,7 @@
  * 01/10/24: change -m default target mean to 0 (mean of sample means)
  * 04/25/24: add --norm-median (EAW)
  * 05/01/24: add --mnorm-include-min -mnorm-exclude-min (EAW)
+ * 10/16/26: added --binary-output-format (EAW)
  *
  **************************************************************************/
 
@@ -53,6 +54,7 @@ char     *means_file    = "means-rma.txt";
 char     *probe_file    = "probes-rma.txt";
 char     *directory     = ".";
 bool      gct_format    = false;
+int       binary_format = 0;
 bool      unlog_expr    = false;
 char    **filelist;
 int      *mempool;
@@ -90,6 +92,8 @@ static struct argp_option options[] = {
     "Write raw probe values to a file" },
   { "bg-none",5,0,0,"Disable background correction" },
   { "gct-output-format",'g',0,0,"Output expressions in gct format" },
+  { "binary-output-format", 153, "32|64", OPTION_ARG_OPTIONAL,
+    "Output expressions as a binary matrix of 32 or 64 (default) bit floats" },
   { "norm-mean",'m',"TARGET",OPTION_ARG_OPTIONAL,
    "Normalize geometric mean expression on chip to TARGET" },
   { "dir",'d',"DIRECTORY",0,"Use DIRECTORY as working directory" },
@@ -233,7 +237,14 @@ int main(int argc, char **argv)
     write_opts |= AFFY_WRITE_EXPR_LOG;
   
   /* Finally write out the entire expression array */
-  if (gct_format)
+  if (binary_format)
+  {
+    if (binary_format == 32)
+      write_opts |= AFFY_WRITE_EXPR_FLOAT32;
+
+    affy_write_expressions_binary(c, output_file, write_opts, err);
+  }
+  else if (gct_format)
     affy_write_expressions_gct(c, output_file, err);
   else
     affy_write_expressions(c, output_file, write_opts, err);
@@ -531,6 +542,14 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
     case 'g':
       gct_format = true;
       break;
+    case 153:
+      if (arg == NULL || strcmp(arg, "64") == 0)
+        binary_format = 64;
+      else if (strcmp(arg, "32") == 0)
+        binary_format = 32;
+      else
+        argp_error(state, "--binary-output-format must be 32 or 64");
+      break;
     case 'c':
       flags.cdf_directory = h_strdup(arg);
       hattach(flags.cdf_directory, mempool);
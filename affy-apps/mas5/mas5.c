@@ -27,6 +27,13 @@
  * 01/10/24: add -m short flag and =TARGET option to --norm-mean (EAW)
  * 01/10/24: change -m description to document that it has actually always
  *           been probe-only, not probesets, as originally described
+ * 10/16/26: added --threads (EAW)
+ * 10/16/26: added --no-cdf-cache, --cdf-cache-dir (EAW)
+ * 10/16/26: turn the CDF cache on here, it is off in the library (EAW)
+ * 10/16/26: added --binary-output-format (EAW)
+ * 10/16/26: added --compact-cel (EAW)
+ * 10/16/26: added --memory-budget, --spill-dir (EAW)
+ * 10/16/26: --threads also applies to median polish summarization (EAW)
  *
  **************************************************************************/
 
@@ -44,6 +51,7 @@
 char                 *output_file = "exprs-mas.txt";
 AFFY_COMBINED_FLAGS   flags;
 int                   gct_format = 0;
+int                   binary_format = 0;
 char                 *directory = ".";
 char                **filelist;
 int                  *mempool;
@@ -61,6 +69,8 @@ static struct argp_option options[] = {
   { "dump-probes", 'p', "probe_file", OPTION_ARG_OPTIONAL,
     "Write raw probe values to a file" },
   { "gct-output-format",'g',0,0,"Write expressions in GCT format" },
+  { "binary-output-format", 153, "32|64", OPTION_ARG_OPTIONAL,
+    "Output expressions as a binary matrix of 32 or 64 (default) bit floats" },
   { "output-present-absent",'r',0,0,"Include present/absent calls in output" },
   { "output",'o',"FILE",0,"Write expressions to FILE" },
 #if UNSUPPORTED
@@ -86,6 +96,12 @@ static struct argp_option options[] = {
   { "salvage",24,0,0,
     "Attempt to salvage corrupt CEL files (may still result in corrupt data!)" },
   { "ignore-chip-mismatch", 137,   0, 0, "Do not abort when multiple chips types are detected" },
+  { "threads", 150, "N", 0, "Load CEL files and summarize probesets using N worker threads (default 1)" },
+  { "no-cdf-cache", 151, 0, 0, "Don't load/save a compiled image of the CDF file" },
+  { "cdf-cache-dir", 152, "DIR", 0, "Keep compiled CDF images in DIR (default: next to the CDF)" },
+  { "compact-cel", 154, 0, 0, "Store CEL intensities as float32 (half the memory)" },
+  { "memory-budget", 155, "MB", 0, "Keep at most MB megabytes of chip data in memory, spill the rest to disk" },
+  { "spill-dir", 156, "DIR", 0, "Directory for the spill file (default: $TMPDIR or /tmp)" },
   {0}
 };
 
@@ -112,6 +128,9 @@ int main(int argc, char **argv)
   affy_rma_set_defaults(&flags);
   affy_mas5_set_defaults(&flags);
 
+  /* the library leaves the compiled CDF cache off, the apps use it */
+  flags.use_cdf_cache = true;
+
   argp_parse(&argp, argc, argv, 0, 0, 0);
                 
   /* If files is NULL, open all CEL files in the current working directory */
@@ -165,7 +184,13 @@ int main(int argc, char **argv)
     if (flags.output_log2)
       writeopts |= AFFY_WRITE_EXPR_LOG;
 
-    affy_write_expressions(c, output_file, writeopts, err);  
+    if (binary_format == 32)
+      writeopts |= AFFY_WRITE_EXPR_FLOAT32;
+
+    if (binary_format)
+      affy_write_expressions_binary(c, output_file, writeopts, err);
+    else
+      affy_write_expressions(c, output_file, writeopts, err);  
   }
 
   print_corrupt_chips_to_stderr(c);
@@ -303,9 +328,39 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
       flags.ignore_chip_mismatch = true;
       break;
 
+    case 150:
+      flags.num_threads = atoi(arg);
+      break;
+
+    case 151:
+      flags.use_cdf_cache = false;
+      break;
+    case 152:
+      flags.cdf_cache_directory = h_strdup(arg);
+      hattach(flags.cdf_cache_directory, mempool);
+      break;
+    case 154:
+      flags.use_compact_cel = true;
+      break;
+    case 155:
+      flags.memory_budget_mb = atol(arg);
+      break;
+    case 156:
+      flags.spill_directory = h_strdup(arg);
+      hattach(flags.spill_directory, mempool);
+      break;
+
     case 'g':
       gct_format = true;
       break;
+    case 153:
+      if (arg == NULL || strcmp(arg, "64") == 0)
+        binary_format = 64;
+      else if (strcmp(arg, "32") == 0)
+        binary_format = 32;
+      else
+        argp_error(state, "--binary-output-format must be 32 or 64");
+      break;
     case 'r':
       flags.output_present_absent = true;
       break;
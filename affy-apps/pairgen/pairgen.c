@@ -20,6 +20,11 @@
  * 05/22/19: added --ignore-chip-mismatch support (EAW)
  * 08/12/20: disable searching current working directory for CEL files (EAW)
  * 08/12/20: pass flags to affy_create_chipset() (EAW)
+ * 10/16/26: load CEL files through the threaded prefetch loader,
+ *           added --threads (EAW)
+ * 10/16/26: added --no-cdf-cache, --cdf-cache-dir (EAW)
+ * 10/16/26: added --compact-cel (EAW)
+ * 10/16/26: scan the CEL headers once up front, load from the index (EAW)
  *
  **************************************************************************/
 
@@ -51,6 +56,10 @@ static struct argp_option options[]  =
   { "average",  'a',           0,  0, "Use geometric mean of probes"        },
   { "median",   'm',           0,  0, "Use median of probes"                },
   { "salvage",  24,            0,  0, "Attempt to salvage corrupt CEL files (may still result in corrupt data!)" },
+  { "threads",  150,         "N",  0, "Load CEL files using N worker threads (default 1)" },
+  { "no-cdf-cache", 151,       0,  0, "Don't load/save a compiled image of the CDF file" },
+  { "cdf-cache-dir", 152,  "DIR",  0, "Keep compiled CDF images in DIR (default: next to the CDF)" },
+  { "compact-cel", 154,        0,  0, "Store CEL intensities as float32 (half the memory)" },
   { NULL }
 };
 
@@ -76,6 +85,8 @@ int main(int argc, char **argv)
   affy_int32        probe_idx;
   char             *chip_type, **p;
   LIBUTILS_PB_STATE pbs;
+  AFFY_CEL_PREFETCH *pf = NULL;
+  AFFY_CEL_INDEX   *idx;
   AFFY_ERROR       *err = NULL;
 
   pb_init(&pbs);
@@ -90,6 +101,7 @@ int main(int argc, char **argv)
   err = affy_get_default_error();
         
   flags.bioconductor_compatability = false;
+  flags.use_cdf_cache              = true;
   argp_parse(&argp, argc, argv, 0, 0, 0);
 
   /* If files is NULL, open all CEL files in the current working directory */
@@ -117,11 +129,14 @@ int main(int argc, char **argv)
   for (p = filelist, max_chips = 0; *p != NULL; p++)
     max_chips++;
   
-  /* Get the array type. */
-  chip_type = affy_get_cdf_name_from_cel(filelist[0], err);
+  /* Scan every CEL header once; the array type is the first file's */
+  idx = affy_scan_cel_headers(filelist, flags.num_threads, err);
   AFFY_CHECK_ERROR_GOTO(err, cleanup);
 
-  hattach(chip_type, mempool);
+  hattach(idx, mempool);
+
+  chip_type = affy_cel_index_array_type(idx, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
 
   /* Create temp chipset */
   cs = affy_create_chipset(1, chip_type, cdf_directory, &flags, err);
@@ -135,6 +150,8 @@ int main(int argc, char **argv)
 
   hattach(cs, mempool);
 
+  memset(&model_cel, 0, sizeof(AFFY_CELFILE));
+
   model_cel.filename    = output_file;
   
   model_cel.numrows     = cs->cdf->numrows;
@@ -184,11 +201,14 @@ int main(int argc, char **argv)
   for (probe_idx = 1; probe_idx < num_all_probes; probe_idx++)
     all_probes[probe_idx] = all_probes[probe_idx - 1] + max_chips;
 
+  pf = affy_cel_prefetch_start(filelist, idx, flags.num_threads, 0,
+                               cs->cel_storage, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
   for (i = 0; i < max_chips; i++)
   {
     /* Load each chip, abort on failure */
-    affy_load_chipset_single(cs, filelist[i],
-                             flags.ignore_chip_mismatch, err);
+    affy_load_chipset_next(cs, pf, flags.ignore_chip_mismatch, err);
     if (err->type != AFFY_ERROR_NONE)
       AFFY_CHECK_ERROR_GOTO(err, cleanup);
 
@@ -202,13 +222,17 @@ int main(int argc, char **argv)
       {
         probe_idx = (cs->cdf->numcols * row) + col;
         
-        all_probes[probe_idx][i] = temp->chip[0]->cel->data[row][col].value;
+        all_probes[probe_idx][i] =
+          affy_cel_value(temp->chip[0]->cel, row, col);
       }
     }
     
     affy_mostly_free_chip(temp->chip[0]);
   }
 
+  affy_cel_prefetch_free(pf);
+  pf = NULL;
+
   info("Finished reading %u CEL files", max_chips);
   
   if (opt_average_flag)
@@ -223,14 +247,14 @@ int main(int argc, char **argv)
       probe_idx = (cs->cdf->numcols * row) + col;
     
       if (opt_average_flag)
-        model_cel.data[row][col].value =
-               affy_mean_geometric_floor_1(all_probes[probe_idx], max_chips);
+        affy_cel_set_value(&model_cel, row, col,
+               affy_mean_geometric_floor_1(all_probes[probe_idx], max_chips));
       else
-        model_cel.data[row][col].value = affy_median(all_probes[probe_idx],
-                                                   max_chips, &flags);
+        affy_cel_set_value(&model_cel, row, col,
+                           affy_median(all_probes[probe_idx],
+                                       max_chips, &flags));
 #ifdef STORE_CEL_QC
-      model_cel.data[row][col].numpixels = 0;
-      model_cel.data[row][col].stddev    = 0.0;
+      affy_cel_set_qc(&model_cel, row, col, 0.0, 0);
 #endif
 
       pb_tick(&pbs, 1, "");
@@ -256,6 +280,7 @@ int main(int argc, char **argv)
   print_corrupt_chips_to_stderr(cs);
 
 cleanup:  
+  affy_cel_prefetch_free(pf);
   affy_free_chipset(cs);
   h_free(mempool);
   pb_cleanup(&pbs);
@@ -273,6 +298,19 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
     case 24:
       flags.salvage_corrupt = true;
       break;
+    case 150:
+      flags.num_threads = atoi(arg);
+      break;
+    case 151:
+      flags.use_cdf_cache = false;
+      break;
+    case 152:
+      flags.cdf_cache_directory = h_strdup(arg);
+      hattach(flags.cdf_cache_directory, mempool);
+      break;
+    case 154:
+      flags.use_compact_cel = true;
+      break;
     case 'd':
       directory = h_strdup(arg);
       hattach(directory, mempool);
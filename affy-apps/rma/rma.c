@@ -29,6 +29,14 @@
  * 05/22/19: added --ignore-chip-mismatch support (EAW)
  * 08/12/20: change description of --bioconductor-compatability (EAW)
  * 08/12/20: disable searching current working directory for CEL files (EAW)
+ * 10/16/26: added --threads (EAW)
+ * 10/16/26: added --no-cdf-cache, --cdf-cache-dir (EAW)
+ * 10/16/26: turn the CDF cache on here, it is off in the library (EAW)
+ * 10/16/26: added --binary-output-format (EAW)
+ * 10/16/26: added --compact-cel (EAW)
+ * 10/16/26: added --memory-budget, --spill-dir (EAW)
+ * 10/16/26: --threads also applies to median polish summarization (EAW)
+ * 10/16/26: added --dump-model, --read-model (frozen RMA) (EAW)
  *
  **************************************************************************/
 
@@ -49,6 +57,7 @@ char     *means_file    = "means-rma.txt";
 char     *probe_file    = "probes-rma.txt";
 char     *directory     = ".";
 bool      gct_format    = false;
+int       binary_format = 0;
 char    **filelist;
 int      *mempool;
 
@@ -74,10 +83,16 @@ static struct argp_option options[] = {
     "Use saved means (incremental RMA)" },
   { "dump-means",'w',"mean_file",OPTION_ARG_OPTIONAL,
     "Write mean values to a savefile" },
+  { "dump-model", 157, "model_file", OPTION_ARG_OPTIONAL,
+    "Write a frozen RMA model (means + affinities) to a binary file" },
+  { "read-model", 158, "model_file", 0,
+    "Process each CEL file on its own against a frozen RMA model" },
   { "dump-probes", 'p', "probe_file", OPTION_ARG_OPTIONAL,
     "Write raw probe values to a file" },
   { "bg-none",5,0,0,"Disable background correction" },
   { "gct-output-format",'g',0,0,"Output expressions in gct format" },
+  { "binary-output-format", 153, "32|64", OPTION_ARG_OPTIONAL,
+    "Output expressions as a binary matrix of 32 or 64 (default) bit floats" },
   { "norm-mean",'m',"TARGET",OPTION_ARG_OPTIONAL,
     "Normalize expression on chip to TARGET" },
   { "dir",'d',"DIRECTORY",0,"Use DIRECTORY as working directory" },
@@ -108,6 +123,12 @@ static struct argp_option options[] = {
   { "salvage",24,0,0,
     "Attempt to salvage corrupt CEL files (may still result in corrupt data!)" },
   { "ignore-chip-mismatch", 137,   0, 0, "Do not abort when multiple chips types are detected" },
+  { "threads", 150, "N", 0, "Load CEL files and summarize probesets using N worker threads (default 1)" },
+  { "no-cdf-cache", 151, 0, 0, "Don't load/save a compiled image of the CDF file" },
+  { "cdf-cache-dir", 152, "DIR", 0, "Keep compiled CDF images in DIR (default: next to the CDF)" },
+  { "compact-cel", 154, 0, 0, "Store CEL intensities as float32 (half the memory)" },
+  { "memory-budget", 155, "MB", 0, "Keep at most MB megabytes of chip data in memory, spill the rest to disk" },
+  { "spill-dir", 156, "DIR", 0, "Directory for the spill file (default: $TMPDIR or /tmp)" },
   {0}
 };
 
@@ -134,6 +155,10 @@ int main(int argc, char **argv)
         
   affy_mas5_set_defaults(&flags);
   affy_rma_set_defaults(&flags);
+
+  /* the library leaves the compiled CDF cache off, the apps use it */
+  flags.use_cdf_cache = true;
+
   argp_parse(&argp, argc, argv, 0, 0, 0);
 
   /* Check for mutually exclusive options. */
@@ -151,6 +176,22 @@ int main(int argc, char **argv)
     exit(EXIT_FAILURE);
   }
 
+  if (flags.use_frozen_model &&
+      (flags.dump_frozen_model || flags.use_saved_means ||
+       flags.use_saved_affinities || flags.dump_expression_means ||
+       flags.dump_probe_affinities))
+  {
+    fprintf(stderr, "Error: a frozen model cannot be combined with other "
+            "saved or dumped models, means or affinities\n");
+
+    h_free(mempool);
+
+    if (err)
+      free(err);
+
+    exit(EXIT_FAILURE);
+  }
+
   /* If files is NULL, open all CEL files in the current working directory */
   if (filelist == NULL && SEARCH_WORKING_DIR)
     filelist = affy_list_files(directory, ".cel", err);
@@ -192,7 +233,14 @@ int main(int argc, char **argv)
     write_opts |= AFFY_WRITE_EXPR_UNLOG;
   
   /* Finally write out the entire expression array */
-  if (gct_format)
+  if (binary_format)
+  {
+    if (binary_format == 32)
+      write_opts |= AFFY_WRITE_EXPR_FLOAT32;
+
+    affy_write_expressions_binary(c, output_file, write_opts, err);
+  }
+  else if (gct_format)
     affy_write_expressions_gct(c, output_file, err);
   else
     affy_write_expressions(c, output_file, write_opts, err);
@@ -304,6 +352,28 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
       flags.ignore_chip_mismatch = true;
       break;
 
+    case 150:
+      flags.num_threads = atoi(arg);
+      break;
+
+    case 151:
+      flags.use_cdf_cache = false;
+      break;
+    case 152:
+      flags.cdf_cache_directory = h_strdup(arg);
+      hattach(flags.cdf_cache_directory, mempool);
+      break;
+    case 154:
+      flags.use_compact_cel = true;
+      break;
+    case 155:
+      flags.memory_budget_mb = atol(arg);
+      break;
+    case 156:
+      flags.spill_directory = h_strdup(arg);
+      hattach(flags.spill_directory, mempool);
+      break;
+
     case 'd':
       directory = h_strdup(arg);
       hattach(directory, mempool);
@@ -348,9 +418,30 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
       flags.means_filename = h_strdup(arg);
       hattach(flags.means_filename, mempool);
       break;
+    case 157:
+      flags.dump_frozen_model = true;
+      if (arg != NULL) 
+      {
+        flags.frozen_model_filename = h_strdup(arg);
+        hattach(flags.frozen_model_filename, mempool);
+      }
+      break;
+    case 158:
+      flags.use_frozen_model = true;
+      flags.frozen_model_filename = h_strdup(arg);
+      hattach(flags.frozen_model_filename, mempool);
+      break;
     case 'g':
       gct_format = true;
       break;
+    case 153:
+      if (arg == NULL || strcmp(arg, "64") == 0)
+        binary_format = 64;
+      else if (strcmp(arg, "32") == 0)
+        binary_format = 32;
+      else
+        argp_error(state, "--binary-output-format must be 32 or 64");
+      break;
     case 'c':
       flags.cdf_directory = h_strdup(arg);
       hattach(flags.cdf_directory, mempool);
@@ -21,6 +21,11 @@
  *
  *      2024-01-25 EAW -- disable realloc being used as free entirely,
  *       as the check is causing problems with valgrind now
+ *
+ *      2026-10-16 EAW -- start out with the free'ing realloc instead of
+ *       picking it on first use, so that the first allocations made by
+ *       several threads at once don't race on setting it up; the O(n)
+ *       _relate() check in hattach() now needs -DHALLOC_CHECK_RELATE
  */
 
 #include <stdlib.h>  /* realloc */
@@ -47,22 +52,24 @@ typedef struct hblock
 
 #define sizeof_hblock offsetof(hblock_t, data)
 
-/*
- *
- */
-realloc_t halloc_allocator = NULL;
-
-#define allocator halloc_allocator
-
 /*
  *	static methods
  */
 static void _set_allocator(void);
 static void * _realloc(void * ptr, size_t n);
 
+#ifdef HALLOC_CHECK_RELATE
 static int  _relate(hblock_t * b, hblock_t * p);
+#endif
 static void _free_children(hblock_t * p);
 
+/*
+ *	set up statically, see _set_allocator()
+ */
+realloc_t halloc_allocator = _realloc;
+
+#define allocator halloc_allocator
+
 /*
  *	Core API
  */
@@ -144,7 +151,9 @@ void hattach(void * block, void * parent)
 	
 	/* sanity checks */
 	assert(b != p);          /* trivial */
+#ifdef HALLOC_CHECK_RELATE
 	assert(! _relate(p, b)); /* heavy ! */
+#endif
 
 	hlist_add(&p->children, &b->siblings);
 }
@@ -225,6 +234,7 @@ static void * _realloc(void * ptr, size_t n)
 	return NULL;
 }
 
+#ifdef HALLOC_CHECK_RELATE
 static int _relate(hblock_t * b, hblock_t * p)
 {
 	hlist_item_t * i;
@@ -245,6 +255,7 @@ static int _relate(hblock_t * b, hblock_t * p)
 	}
 	return 0;
 }
+#endif
 
 static void _free_children(hblock_t * p)
 {
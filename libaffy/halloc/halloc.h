@@ -39,6 +39,36 @@ char * h_strdup (const char * str);
 void *h_subcalloc(void *parent, size_t nmemb, size_t sz);
 void *h_suballoc(void *parent, size_t len);
 
+/*
+ * Scratch arenas for hot loops, see harena.c -- added by EAW 10/16/2026.
+ * Free an arena with h_free(), or along with its parent.
+ */
+typedef struct harena harena_t;
+
+typedef struct harena_mark
+{
+  void   *chunk;
+  size_t  used;
+} harena_mark_t;
+
+harena_t      *h_arena_create(void *parent, size_t chunk_size);
+void          *h_arena_alloc (harena_t *arena, size_t len);
+void          *h_arena_calloc(harena_t *arena, size_t n, size_t len);
+harena_mark_t  h_arena_mark  (harena_t *arena);
+void           h_arena_reset (harena_t *arena, harena_mark_t mark);
+
+/*
+ * Per-thread pools with deferred reparenting, see hpool.c -- added by EAW
+ * 10/16/2026.  Free a pool with h_free().
+ */
+typedef struct hpool hpool_t;
+
+hpool_t *h_pool_create      (void);
+void    *h_pool_alloc       (hpool_t *pool, size_t len);
+void    *h_pool_calloc      (hpool_t *pool, size_t n, size_t len);
+int      h_pool_defer_attach(hpool_t *pool, void *block, void *parent);
+void     h_pool_commit      (hpool_t *pool);
+
 /*
  *	the underlying allocator
  */
@@ -0,0 +1,183 @@
+/**************************************************************************
+ *
+ * Filename:  harena.c
+ *
+ * Purpose:   Scratch arena (bump) allocator on top of halloc.
+ *
+ * Creation:  October 16th, 2026
+ *
+ * Author:    Eric A. Welsh
+ *
+ * Copyright: Copyright (C) 2026, Moffitt Cancer Center.
+ *            All rights reserved.
+ *
+ * Update History
+ * --------------
+ * 10/16/26: Creation (EAW)
+ * 10/16/26: fail oversized requests instead of wrapping around (EAW)
+ *
+ **************************************************************************/
+
+#include <assert.h>
+#include <string.h>
+
+#include "halloc.h"
+#include "align.h"
+
+#ifndef SIZE_MAX
+#define SIZE_MAX ((size_t) -1)
+#endif
+
+/*
+ * An arena is a halloc block whose chunks are halloc children of it, so
+ * h_free(arena) (or freeing its parent) releases everything.  Allocation
+ * bumps a pointer through the current chunk.  Chunks are never given back
+ * before then: h_arena_reset() rewinds to a mark, and later allocations
+ * reuse the same chunks, so a loop that marks, allocates and resets stops
+ * calling malloc() once it has seen its largest iteration.
+ *
+ * An arena belongs to one thread; give each worker thread its own.
+ */
+
+typedef struct harena_chunk
+{
+  struct harena_chunk *next;     /* later chunk, kept for reuse           */
+  size_t               size;     /* usable bytes in data[]                */
+  halloc_max_align_t   data[1];  /* not allocated, see below              */
+} harena_chunk_t;
+
+#define sizeof_chunk offsetof(harena_chunk_t, data)
+
+struct harena
+{
+  harena_chunk_t *first;         /* oldest chunk                          */
+  harena_chunk_t *cur;           /* chunk being allocated from, or NULL   */
+  size_t          used;          /* bytes used in cur                     */
+  size_t          chunk_size;    /* minimum size of new chunks            */
+};
+
+#define HARENA_DEFAULT_CHUNK (64 * 1024)
+
+/*
+ * Create an arena attached to parent (which may be NULL).  chunk_size is
+ * the minimum size of each chunk, 0 for the default; larger requests get
+ * a chunk of their own size.
+ */
+harena_t *h_arena_create(void *parent, size_t chunk_size)
+{
+  harena_t *arena;
+
+  arena = h_calloc(1, sizeof(harena_t));
+  if (arena == NULL)
+    return (NULL);
+
+  arena->chunk_size = chunk_size ? chunk_size : HARENA_DEFAULT_CHUNK;
+
+  if (parent)
+    hattach(arena, parent);
+
+  return (arena);
+}
+
+/*
+ * Uninitialized, maximally aligned storage, valid until the arena is
+ * reset to a mark taken before it, or freed.  NULL if out of memory.
+ */
+void *h_arena_alloc(harena_t *arena, size_t len)
+{
+  harena_chunk_t *chunk;
+  void           *p;
+
+  assert(arena != NULL);
+
+  /* too large to round up and put in a chunk */
+  if (len > SIZE_MAX - sizeof(halloc_max_align_t) - sizeof_chunk)
+    return (NULL);
+
+  /* keep every allocation aligned */
+  len = (len + sizeof(halloc_max_align_t) - 1) &
+        ~(sizeof(halloc_max_align_t) - 1);
+  if (len == 0)
+    len = sizeof(halloc_max_align_t);
+
+  if (arena->cur && arena->used + len <= arena->cur->size)
+  {
+    p            = (char *)arena->cur->data + arena->used;
+    arena->used += len;
+
+    return (p);
+  }
+
+  /* move on to the next chunk that is large enough */
+  chunk = arena->cur ? arena->cur->next : arena->first;
+  while (chunk && chunk->size < len)
+    chunk = chunk->next;
+
+  /* none, add one right after the current chunk */
+  if (chunk == NULL)
+  {
+    size_t size = (len > arena->chunk_size) ? len : arena->chunk_size;
+
+    chunk = h_malloc(sizeof_chunk + size);
+    if (chunk == NULL)
+      return (NULL);
+
+    hattach(chunk, arena);
+    chunk->size = size;
+
+    if (arena->cur)
+    {
+      chunk->next      = arena->cur->next;
+      arena->cur->next = chunk;
+    }
+    else
+    {
+      chunk->next  = arena->first;
+      arena->first = chunk;
+    }
+  }
+
+  arena->cur  = chunk;
+  arena->used = len;
+
+  return (chunk->data);
+}
+
+/* Same as h_arena_alloc(), zeroed */
+void *h_arena_calloc(harena_t *arena, size_t n, size_t len)
+{
+  void *p;
+
+  /* n * len would wrap around */
+  if (len && n > SIZE_MAX / len)
+    return (NULL);
+
+  p = h_arena_alloc(arena, len *= n);
+
+  return (p ? memset(p, 0, len) : NULL);
+}
+
+/* Current position, to rewind to with h_arena_reset() */
+harena_mark_t h_arena_mark(harena_t *arena)
+{
+  harena_mark_t mark;
+
+  assert(arena != NULL);
+
+  mark.chunk = arena->cur;
+  mark.used  = arena->used;
+
+  return (mark);
+}
+
+/*
+ * Release everything allocated since mark was taken.  The storage stays
+ * with the arena for the allocations that follow.
+ */
+void h_arena_reset(harena_t *arena, harena_mark_t mark)
+{
+  assert(arena != NULL);
+
+  arena->cur  = mark.chunk;
+  arena->used = mark.used;
+}
@@ -40,6 +40,10 @@ struct hlist_item
 
 /*
  *	shared tail sentinel
+ *
+ *	Its prev pointer is never read, so it is never written either; this
+ *	keeps operations on unrelated lists from touching shared memory and
+ *	lets disjoint halloc trees be used from different threads.
  */
 struct hlist_item hlist_null;
 
@@ -102,7 +106,8 @@ static_inline void hlist_add(hlist_head_t * h, hlist_item_t * i)
 	assert(h && i);
 	
 	next = i->next = h->next;
-	next->prev = &i->next;
+	if (next != &hlist_null)
+		next->prev = &i->next;
 	h->next = i;
 	i->prev = &h->next;
 }
@@ -113,7 +118,8 @@ static_inline void hlist_del(hlist_item_t * i)
 	assert(i);
 
 	next = i->next;
-	next->prev = i->prev;
+	if (next != &hlist_null)
+		next->prev = i->prev;
 	*i->prev = next;
 	
 	hlist_init_item(i);
@@ -123,13 +129,15 @@ static_inline void hlist_relink(hlist_item_t * i)
 {
 	assert(i);
 	*i->prev = i;
-	i->next->prev = &i->next;
+	if (i->next != &hlist_null)
+		i->next->prev = &i->next;
 }
 
 static_inline void hlist_relink_head(hlist_head_t * h)
 {
 	assert(h);
-	h->next->prev = &h->next;
+	if (h->next != &hlist_null)
+		h->next->prev = &h->next;
 }
 
 #endif
@@ -0,0 +1,143 @@
+/**************************************************************************
+ *
+ * Filename:  hpool.c
+ *
+ * Purpose:   Per-thread halloc pools, with deferred reparenting of blocks
+ *            into trees owned by other threads.
+ *
+ * Creation:  October 16th, 2026
+ *
+ * Author:    Eric A. Welsh
+ *
+ * Copyright: Copyright (C) 2026, Moffitt Cancer Center.
+ *            All rights reserved.
+ *
+ * Update History
+ * --------------
+ * 10/16/26: Creation (EAW)
+ *
+ **************************************************************************/
+
+#include <assert.h>
+
+#include "halloc.h"
+
+/*
+ * halloc keeps no global state besides the allocator, so separate trees
+ * can be used from separate threads without any locking.  What can't be
+ * done is touching one tree from two threads, and hattach() touches both
+ * the block's old tree and its new parent's.
+ *
+ * A pool is a tree owned by one worker thread.  The worker allocates from
+ * it freely, and when it has a result that belongs under a block owned
+ * by some other thread, it queues the move with h_pool_defer_attach()
+ * instead of calling hattach().  Once the worker is done with the pool
+ * (joined, or handed the pool back under a lock), the thread that owns
+ * the destination trees runs all of the queued moves with
+ * h_pool_commit(), then frees the pool with h_free().  Anything never
+ * committed is freed along with the pool.
+ */
+
+typedef struct hpool_move
+{
+  void *block;
+  void *parent;
+} hpool_move_t;
+
+struct hpool
+{
+  hpool_move_t *moves;           /* queued reparenting, child of the pool */
+  size_t        num_moves;
+  size_t        max_moves;
+};
+
+/* A new pool, not attached to anything.  Free it with h_free(). */
+hpool_t *h_pool_create(void)
+{
+  return (h_calloc(1, sizeof(hpool_t)));
+}
+
+/* Same as h_malloc(), attached to the pool */
+void *h_pool_alloc(hpool_t *pool, size_t len)
+{
+  void *p;
+
+  assert(pool != NULL);
+
+  p = h_malloc(len);
+  if (p != NULL)
+    hattach(p, pool);
+
+  return (p);
+}
+
+/* Same as h_calloc(), attached to the pool */
+void *h_pool_calloc(hpool_t *pool, size_t n, size_t len)
+{
+  void *p;
+
+  assert(pool != NULL);
+
+  p = h_calloc(n, len);
+  if (p != NULL)
+    hattach(p, pool);
+
+  return (p);
+}
+
+/*
+ * Queue block to be attached to parent at the next h_pool_commit().
+ * block must belong to the calling thread: allocated from the pool, or
+ * a root block.  It is attached to the pool until then.  parent may be
+ * in any tree; it isn't touched here.  Returns -1 if out of memory, in
+ * which case nothing is queued and block is left where it was.
+ */
+int h_pool_defer_attach(hpool_t *pool, void *block, void *parent)
+{
+  assert(pool   != NULL);
+  assert(block  != NULL);
+  assert(parent != NULL);
+
+  if (pool->num_moves == pool->max_moves)
+  {
+    hpool_move_t *moves;
+    size_t        max_moves;
+
+    max_moves = pool->max_moves ? 2 * pool->max_moves : 16;
+
+    moves = h_realloc(pool->moves, max_moves * sizeof(hpool_move_t));
+    if (moves == NULL)
+      return (-1);
+
+    if (pool->moves == NULL)
+      hattach(moves, pool);
+
+    pool->moves     = moves;
+    pool->max_moves = max_moves;
+  }
+
+  hattach(block, pool);
+
+  pool->moves[pool->num_moves].block  = block;
+  pool->moves[pool->num_moves].parent = parent;
+  pool->num_moves++;
+
+  return (0);
+}
+
+/*
+ * Carry out the queued moves, in the order they were queued.  Must be
+ * called by the thread that owns the parents, once the pool's thread is
+ * no longer using the pool.
+ */
+void h_pool_commit(hpool_t *pool)
+{
+  size_t i;
+
+  assert(pool != NULL);
+
+  for (i = 0; i < pool->num_moves; i++)
+    hattach(pool->moves[i].block, pool->moves[i].parent);
+
+  pool->num_moves = 0;
+}
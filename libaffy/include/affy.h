@@ -47,6 +47,29 @@
  * 08/12/20: pass flags to more functions (EAW)
  * 01/10/24: pass flags to affy_mean_normalization() (EAW)
  * 04/25/24: added affy_median_normalization() (EAW)
+ * 10/16/26: added affy_decodeXX() in-memory endian decoders (EAW)
+ * 10/16/26: added threaded CEL prefetch loader, affy_load_chipset_next() (EAW)
+ * 10/16/26: added affy_fopen_input() for gzip-compressed input (EAW)
+ * 10/16/26: added compiled CDF cache, affy_load/write_cdf_cache() (EAW)
+ * 10/16/26: AFFY_TEXTIO now wraps a buffered LINE_READER (EAW)
+ * 10/16/26: added single-pass affy_load_generic_spreadsheet() (EAW)
+ * 10/16/26: added CEL header scan/index, affy_scan_cel_headers() (EAW)
+ * 10/16/26: added binary expression matrix output (EAW)
+ * 10/16/26: added compact float32 CEL storage, affy_cel_value() etc. (EAW)
+ * 10/16/26: added linear index cell accessors, affy_cel_value_at(),
+ *           affy_mark_probe_cells() (EAW)
+ * 10/16/26: added flat CSR probe tables to AFFY_CDFFILE (EAW)
+ * 10/16/26: added per-probeset attribute flags, cdf->ps_flags[] (EAW)
+ * 10/16/26: added hashed probeset name index, affy_cdf_find_probeset() (EAW)
+ * 10/16/26: *_scratch() variants of the median helpers (EAW)
+ * 10/16/26: added out-of-core AFFY_BACKING_STORE for chip arrays (EAW)
+ * 10/16/26: masks/outliers are sorted lists of cells instead of dense
+ *           planes (EAW)
+ * 10/16/26: added AFFY_CHIP qnorm_rank[] (EAW)
+ * 10/16/26: CEL layout is per chipset and passed to the loaders, instead
+ *           of a process-wide setting (EAW)
+ * 10/16/26: the CDF loaders build the name index up front, so
+ *           affy_cdf_find_probeset() no longer takes an AFFY_ERROR (EAW)
  *
  **************************************************************************/
 
@@ -82,6 +105,11 @@ extern "C"
 #define AFFY_QC_LOCATION        1
 #define AFFY_NORMAL_LOCATION    2
 
+  /* Probeset attribute bits, cdf->ps_flags[] */
+#define AFFY_PS_CONTROL         0x01  /* AFFX/control/spike-in name         */
+#define AFFY_PS_EXCLUDED        0x02  /* listed in the exclusions file      */
+#define AFFY_PS_SPIKEIN         0x04  /* listed in the spike-ins file       */
+
   /* Binary-format magic numbers. */
 #define AFFY_DAT_FILEMAGIC        0xFC
 #define AFFY_CDF_BINARYFILE_MAGIC 67
@@ -99,6 +127,7 @@ extern "C"
 #define AFFY_WRITE_EXPR_PA      1
 #define AFFY_WRITE_EXPR_UNLOG   2
 #define AFFY_WRITE_EXPR_LOG     4
+#define AFFY_WRITE_EXPR_FLOAT32 8    /* binary output only */
 
   /* Options for affy_pairwise_normalization() */
 #define AFFY_PAIRWISE_DEFAULT           0
@@ -106,6 +135,10 @@ extern "C"
 #define AFFY_PAIRWISE_GLOBAL_SCALING    2
 #define AFFY_PAIRWISE_LINEAR_SCALING    3
 
+  /* CEL intensity storage layouts, see affy_alloc_cel_data() */
+#define AFFY_CEL_STORAGE_CELLS   0   /* AFFY_CELL **data, double values   */
+#define AFFY_CEL_STORAGE_COMPACT 1   /* contiguous float32 planes         */
+
   /**************************************************************************/
 
   /* First, some primitive types used to compose the higher-level, more
@@ -168,10 +201,8 @@ extern "C"
    */
   typedef struct affy_textio_s
   {
-    FILE *fp;
-    char *buf;
-    int   max_buf_len;
-    bool  skip_read;
+    FILE        *fp;
+    LINE_READER *lr;
   } AFFY_TEXTIO;
 
   /* Forward reference for AFFY_PIXREGION */
@@ -282,12 +313,39 @@ extern "C"
     char         **spikeins;      /* An array of probe/probeset name strings */
     affy_int8      no_mm_flag;    /* set if CDF file is missing MM probes    */
     affy_int8      dupe_probes_flag;  /* probes shared between probesets   */
+
+    /* Flat (CSR) probe tables, see affy_cdf_build_index()                 */
+    affy_uint32   *pm_cell;       /* PM linear cell index, per probe         */
+    affy_uint32   *mm_cell;       /* MM linear cell index, per probe         */
+    affy_int32    *probe_ps;      /* Probeset of each probe                  */
+    affy_int32    *ps_offset;     /* First probe of each probeset, +1 entry  */
+    affy_uint8    *ps_flags;      /* AFFY_PS_* bits of each probeset         */
+
+    /* Probeset name hash, see affy_cdf_build_name_index()                 */
+    affy_int32    *name_hash;     /* Open-addressed slots, -1 if empty       */
+    affy_int32    *name_next;     /* Next probeset with the same name, or -1 */
+    affy_uint32    name_hash_mask;/* Number of slots - 1                     */
   } AFFY_CDFFILE;
 
   /*
    * Given the above definitions, a CEL file can be a simple entity: a
    * matrix of data. The CDF provides all other necessary mapping
    * (probes->probeset).
+   *
+   * The cells are stored one of two ways (see affy_alloc_cel_data()):
+   * as AFFY_CELL's in data[x][y], or in the compact layout, as one
+   * contiguous float plane per field indexed by [x * numrows + y] (data
+   * is then NULL).  Use affy_cel_value() and friends rather than either
+   * one directly.
+   *
+   * Either way the cells are one contiguous block in x-major order
+   * (data[x] == data[0] + x * numrows), so whole-chip passes should run
+   * x outer, y inner, or over a single linear index with
+   * affy_cel_value_at(); same for the CDF cell_type/seen_xy maps.
+   *
+   * Masks and outliers are few (usually none), so they are kept as sorted
+   * lists of linear cell indices, nummasks/numoutliers long, NULL when
+   * empty; see affy_cel_ismasked_at().
    */
   typedef struct affy_celfile_s
   {
@@ -297,11 +355,148 @@ extern "C"
     affy_uint32  nummasks;
     affy_uint32  numoutliers;
     AFFY_CELL  **data;
-    bitstr_t   **mask;
-    bitstr_t   **outlier;
+    float       *intensity;       /* Compact layout intensities            */
+#ifdef STORE_CEL_QC
+    float       *stddev;          /* Compact layout std. deviations        */
+    affy_int16  *numpixels;       /* Compact layout pixel counts           */
+#endif
+    affy_uint32 *mask;            /* Sorted linear indices of masked cells */
+    affy_uint32 *outlier;         /* Same, of outlier cells                */
     char         corrupt_flag;
   } AFFY_CELFILE;
 
+  /* Does cf still hold its cell data (in either layout)? */
+  static INLINE int affy_cel_has_data(const AFFY_CELFILE *cf)
+  {
+    return (cf->data != NULL || cf->intensity != NULL);
+  }
+
+  static INLINE double affy_cel_value(const AFFY_CELFILE *cf, int x, int y)
+  {
+    if (cf->intensity)
+      return (cf->intensity[(size_t)x * cf->numrows + y]);
+
+    return (cf->data[x][y].value);
+  }
+
+  static INLINE void affy_cel_set_value(AFFY_CELFILE *cf, int x, int y,
+                                        double value)
+  {
+    if (cf->intensity)
+      cf->intensity[(size_t)x * cf->numrows + y] = (float)value;
+    else
+      cf->data[x][y].value = value;
+  }
+
+  /* Number of cells, the bound for the linear index i = x * numrows + y */
+  static INLINE size_t affy_cel_num_cells(const AFFY_CELFILE *cf)
+  {
+    return ((size_t)cf->numrows * cf->numcols);
+  }
+
+  static INLINE double affy_cel_value_at(const AFFY_CELFILE *cf, size_t i)
+  {
+    if (cf->intensity)
+      return (cf->intensity[i]);
+
+    return (cf->data[0][i].value);
+  }
+
+  static INLINE void affy_cel_set_value_at(AFFY_CELFILE *cf, size_t i,
+                                           double value)
+  {
+    if (cf->intensity)
+      cf->intensity[i] = (float)value;
+    else
+      cf->data[0][i].value = value;
+  }
+
+  /* Is linear index i in the sorted cell list cells[0 .. n-1]? */
+  static INLINE int affy_cell_list_has(const affy_uint32 *cells,
+                                       affy_uint32 n,
+                                       size_t i)
+  {
+    affy_uint32 lo = 0, hi = n, mid;
+
+    while (lo < hi)
+    {
+      mid = lo + (hi - lo) / 2;
+
+      if (cells[mid] < i)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    return (lo < n && cells[lo] == i);
+  }
+
+  /*
+   * Most chips have no masks at all, which takes a single test.  Whole-chip
+   * passes in storage order can instead walk cf->mask[] alongside.
+   */
+  static INLINE int affy_cel_ismasked_at(const AFFY_CELFILE *cf, size_t i)
+  {
+    if (cf->mask == NULL)
+      return (0);
+
+    return (affy_cell_list_has(cf->mask, cf->nummasks, i));
+  }
+
+  static INLINE int affy_cel_isoutlier_at(const AFFY_CELFILE *cf, size_t i)
+  {
+    if (cf->outlier == NULL)
+      return (0);
+
+    return (affy_cell_list_has(cf->outlier, cf->numoutliers, i));
+  }
+
+  static INLINE int affy_cel_ismasked(const AFFY_CELFILE *cf, int x, int y)
+  {
+    return (affy_cel_ismasked_at(cf, (size_t)x * cf->numrows + y));
+  }
+
+  /* AFFY_PS_* bits of the probeset that probe p belongs to */
+  static INLINE affy_uint8 affy_probe_flags(const AFFY_CDFFILE *cdf,
+                                            affy_int32 p)
+  {
+    return (cdf->ps_flags[cdf->probe_ps[p]]);
+  }
+
+#ifdef STORE_CEL_QC
+  static INLINE double affy_cel_stddev(const AFFY_CELFILE *cf, int x, int y)
+  {
+    if (cf->intensity)
+      return (cf->stddev[(size_t)x * cf->numrows + y]);
+
+    return (cf->data[x][y].stddev);
+  }
+
+  static INLINE affy_int16 affy_cel_numpixels(const AFFY_CELFILE *cf,
+                                              int x, int y)
+  {
+    if (cf->intensity)
+      return (cf->numpixels[(size_t)x * cf->numrows + y]);
+
+    return (cf->data[x][y].numpixels);
+  }
+
+  static INLINE void affy_cel_set_qc(AFFY_CELFILE *cf, int x, int y,
+                                     double stddev, affy_int16 numpixels)
+  {
+    if (cf->intensity)
+    {
+      cf->stddev[(size_t)x * cf->numrows + y]    = (float)stddev;
+      cf->numpixels[(size_t)x * cf->numrows + y] = numpixels;
+    }
+    else
+    {
+      cf->data[x][y].stddev    = stddev;
+      cf->data[x][y].numpixels = numpixels;
+    }
+  }
+#endif
+
   /*
    * DAT file definition; a binary representation of individual
    * pixel intensity values.  The raw data for the higher level files.
@@ -333,6 +528,12 @@ extern "C"
     AFFY_PIXREGION pixels;
   } AFFY_DATFILE;
 
+  /*
+   * Optional out-of-core storage for per-chip arrays, shared by a chipset
+   * and its chips (see backing_store.c).
+   */
+  typedef struct affy_backing_store_s AFFY_BACKING_STORE;
+
   /*
    * We need a higher abstraction than a celfile, to pull everything 
    * together and provide a convenient storage place for expressions, etc.
@@ -360,6 +561,13 @@ extern "C"
 
     /* A convenience ptr: not globally used (RMA) */
     double *pm;
+
+    /* Quantile ranks of the pm values, between the chip and chipset
+       passes of RMA quantile normalization */
+    affy_int32 *qnorm_rank;
+
+    /* Where probe_set/pm come from, NULL for plain halloc storage */
+    AFFY_BACKING_STORE *store;
   } AFFY_CHIP;
 
   /*
@@ -381,8 +589,92 @@ extern "C"
     double       *t_values;
     char          mp_allocated_flag;
     char          mp_populated_flag;
+    /* out-of-core storage for the chips' arrays, owned by this chipset */
+    AFFY_BACKING_STORE *store;
+    /* AFFY_CEL_STORAGE_* layout of the CEL files loaded into it */
+    int           cel_storage;
   } AFFY_CHIPSET;
 
+  /*
+   * Opaque state for loading a list of CEL files in the background with
+   * a bounded pool of worker threads (see cel_prefetch.c).
+   */
+  typedef struct affy_cel_prefetch_s AFFY_CEL_PREFETCH;
+
+  /* On-disk CEL file formats */
+  typedef enum
+  {
+    AFFY_CEL_FORMAT_UNKNOWN = 0,
+    AFFY_CEL_FORMAT_TEXT,            /* version 3, ASCII          */
+    AFFY_CEL_FORMAT_XDA,             /* version 4, "old" binary   */
+    AFFY_CEL_FORMAT_CALVIN           /* Command Console "generic" */
+  } AFFY_CEL_FORMAT;
+
+  /*
+   * What a scan of a CEL file header found, without loading any cell
+   * data.  data_offset is where the intensities start, in the
+   * (decompressed) file; text and XDA files are loaded from there.  The
+   * mask and outlier counts are only known up front for XDA files.  err
+   * holds the outcome of the scan for entries of an AFFY_CEL_INDEX.
+   */
+  typedef struct affy_cel_header_s
+  {
+    AFFY_CEL_FORMAT  format;
+    char            *array_type;
+    affy_int32       numrows;
+    affy_int32       numcols;
+    affy_int32       nummasks;
+    affy_int32       numoutliers;
+    long             data_offset;
+    AFFY_ERROR       err;
+  } AFFY_CEL_HEADER;
+
+  /* Headers of a whole list of CEL files, in filelist order */
+  typedef struct affy_cel_index_s
+  {
+    char            **filelist;
+    int               num_files;
+    int               num_errors;      /* entries whose scan failed */
+    AFFY_CEL_HEADER  *headers;
+  } AFFY_CEL_INDEX;
+
+  /*
+   * Header of a binary expression matrix (affy_write_expressions_binary()).
+   * Everything is written in native byte order; byte_order reads as
+   * 0x01020304 on a machine with the same order as the writer.
+   *
+   * The header is followed by the names: numrows probeset names, then
+   * numcols sample names, each NUL-terminated.  The matrices start on 8
+   * byte boundaries at the given offsets (split into low/high 32 bits),
+   * row-major by probeset, value_size bytes per value (4 = float,
+   * 8 = double).  Missing values (log/unlog of 0) are NaN.  If the P/A
+   * planes are present (flags & AFFY_WRITE_EXPR_PA), the p-values follow
+   * as a second matrix of the same type, then the calls as a matrix of
+   * single 'P', 'M' or 'A' characters.
+   */
+#define AFFY_EXPR_BINARY_MAGIC      "AFFYEXPR"
+#define AFFY_EXPR_BINARY_VERSION    1
+#define AFFY_EXPR_BINARY_BYTE_ORDER 0x01020304
+
+  typedef struct affy_expr_binary_header_s
+  {
+    char        magic[8];
+    affy_uint32 version;
+    affy_uint32 byte_order;
+    affy_uint32 header_size;
+    affy_uint32 value_size;
+    affy_uint32 numrows;             /* probesets                */
+    affy_uint32 numcols;             /* samples                  */
+    affy_uint32 flags;               /* AFFY_WRITE_EXPR_* used   */
+    affy_uint32 names_len;           /* total bytes of all names */
+    affy_uint32 data_offset_lo;
+    affy_uint32 data_offset_hi;
+    affy_uint32 pvalue_offset_lo;    /* 0 if no P/A planes       */
+    affy_uint32 pvalue_offset_hi;
+    affy_uint32 call_offset_lo;
+    affy_uint32 call_offset_hi;
+  } AFFY_EXPR_BINARY_HEADER;
+
   /* 
    * These definitions attempt to model the internal structure of 
    * the new Affymetrix "Calvin" format, which is a self-describing,
@@ -522,6 +814,20 @@ extern "C"
   AFFY_CDFFILE          *affy_load_cdf_file_byname(char *filename,
                                                    char *chip_type,
                                                    AFFY_ERROR *err);
+  AFFY_CDFFILE          *affy_load_cdf_cache(const char *cdf_filename,
+                                             const char *cache_dir,
+                                             char *chip_type,
+                                             AFFY_ERROR *err);
+  void                   affy_write_cdf_cache(AFFY_CDFFILE *cdf,
+                                              const char *cdf_filename,
+                                              const char *cache_dir,
+                                              AFFY_ERROR *err);
+  void                   affy_cdf_build_index(AFFY_CDFFILE *cdf,
+                                              AFFY_ERROR *err);
+  void                   affy_cdf_build_name_index(AFFY_CDFFILE *cdf,
+                                                   AFFY_ERROR *err);
+  affy_int32             affy_cdf_find_probeset(AFFY_CDFFILE *cdf,
+                                                const char *name);
   void                   affy_load_binary_cdf_file(FILE *fp,
 						   AFFY_CDFFILE *cdf,
                                                    LIBUTILS_PB_STATE *pbs,
@@ -530,6 +836,12 @@ extern "C"
 						   AFFY_CELFILE *cf,
                                                    LIBUTILS_PB_STATE *pbs,
 						   AFFY_ERROR *err);
+  void                   affy_load_binary_cel_data(FILE *fp,
+                                                   AFFY_CELFILE *cf,
+                                                   const AFFY_CEL_HEADER *hdr,
+                                                   int storage,
+                                                   LIBUTILS_PB_STATE *pbs,
+                                                   AFFY_ERROR *err);
   void                   affy_write_binary_cel_file(FILE *fp,
                                                     AFFY_CHIP *cp,
                                                     AFFY_ERROR *err);
@@ -537,10 +849,22 @@ extern "C"
 						   AFFY_CELFILE *cf,
                                                    LIBUTILS_PB_STATE *pbs,
 						   AFFY_ERROR *err);
+  void                   affy_load_calvin_cel_data(FILE *fp,
+                                                   AFFY_CELFILE *cf,
+                                                   const AFFY_CEL_HEADER *hdr,
+                                                   int storage,
+                                                   LIBUTILS_PB_STATE *pbs,
+                                                   AFFY_ERROR *err);
   void                   affy_load_text_cel_file(FILE *fp, 
                                                  AFFY_CELFILE *cf, 
                                                  LIBUTILS_PB_STATE *pbs,
                                                  AFFY_ERROR *err);
+  void                   affy_load_text_cel_data(FILE *fp,
+                                                 AFFY_CELFILE *cf,
+                                                 const AFFY_CEL_HEADER *hdr,
+                                                 int storage,
+                                                 LIBUTILS_PB_STATE *pbs,
+                                                 AFFY_ERROR *err);
   void                   affy_load_calvin_dat_file(FILE *fp,
 						   AFFY_DATFILE *df,
                                                    LIBUTILS_PB_STATE *pbs,
@@ -563,6 +887,24 @@ extern "C"
   void                   affy_load_chipset(AFFY_CHIPSET *cs, 
                                            char **filelist,
                                            bool ignore_chip_mismatch);
+  void                   affy_load_chipset_threaded(AFFY_CHIPSET *cs, 
+                                                    char **filelist,
+                                                    bool ignore_chip_mismatch,
+                                                    int num_threads);
+  void                   affy_load_chipset_next(AFFY_CHIPSET *cs,
+                                                AFFY_CEL_PREFETCH *pf,
+                                                bool ignore_chip_mismatch,
+                                                AFFY_ERROR *err);
+  AFFY_CEL_PREFETCH     *affy_cel_prefetch_start(char **filelist,
+                                                 AFFY_CEL_INDEX *idx,
+                                                 int num_threads,
+                                                 int depth,
+                                                 int storage,
+                                                 AFFY_ERROR *err);
+  AFFY_CHIP             *affy_cel_prefetch_next(AFFY_CEL_PREFETCH *pf,
+                                                char **chip_type,
+                                                AFFY_ERROR *err);
+  void                   affy_cel_prefetch_free(AFFY_CEL_PREFETCH *pf);
   AFFY_CHIPSET          *affy_create_chipset(unsigned int max_chips,
                                              char *chip_type,
                                              char *cdf_hint,
@@ -581,15 +923,56 @@ extern "C"
                                                      AFFY_ERROR *err);
   AFFY_CHIP             *affy_clone_chip(AFFY_CHIP *cur_chip, AFFY_ERROR *err);
   AFFY_CHIP             *affy_load_chip(char *filename, AFFY_ERROR *err);
+  AFFY_CHIP             *affy_load_chip_indexed(char *filename,
+                                                AFFY_CEL_HEADER *hdr,
+                                                int storage,
+                                                bool quiet,
+                                                AFFY_ERROR *err);
   AFFY_CELFILE          *affy_load_cel_file(char *filename, AFFY_ERROR *err);
+  AFFY_CELFILE          *affy_load_cel_file_indexed(char *filename,
+                                                    AFFY_CEL_HEADER *hdr,
+                                                    int storage,
+                                                    bool quiet,
+                                                    AFFY_ERROR *err);
+  void                   affy_scan_cel_header_fp(FILE *fp,
+                                                 AFFY_CEL_HEADER *hdr,
+                                                 AFFY_ERROR *err);
+  AFFY_CEL_HEADER       *affy_scan_cel_header(const char *filename,
+                                              AFFY_ERROR *err);
+  AFFY_CEL_INDEX        *affy_scan_cel_headers(char **filelist,
+                                               int num_threads,
+                                               AFFY_ERROR *err);
+  char                  *affy_cel_index_array_type(AFFY_CEL_INDEX *idx,
+                                                   AFFY_ERROR *err);
+  void                   affy_free_cel_index(AFFY_CEL_INDEX *idx);
   AFFY_DATFILE          *affy_load_dat_file(char *filename, AFFY_ERROR *err);
   void                   affy_free_cel_file(AFFY_CELFILE *cf);
   void                   affy_mostly_free_cel_file(AFFY_CELFILE *cf);
+  void                   affy_alloc_cel_data(AFFY_CELFILE *cf,
+                                             int storage,
+                                             AFFY_ERROR *err);
+  void                   affy_free_cel_data(AFFY_CELFILE *cf);
+  affy_uint32            affy_sort_cell_list(affy_uint32 **cells,
+                                             affy_uint32 n);
   void                   affy_free_dat_file(AFFY_DATFILE *df);
   void                   affy_free_cdf_file(AFFY_CDFFILE *cdf);
   void                   affy_free_chip(AFFY_CHIP *ch);
   void                   affy_mostly_free_chip(AFFY_CHIP *ch);
   void                   affy_free_chipset(AFFY_CHIPSET *cs);
+  AFFY_BACKING_STORE    *affy_backing_store_create(long budget_mb,
+                                                   const char *dir,
+                                                   AFFY_ERROR *err);
+  void                  *affy_backing_store_calloc(AFFY_BACKING_STORE *bs,
+                                                   void *parent,
+                                                   size_t nmemb,
+                                                   size_t size);
+  void                   affy_backing_store_free_array(AFFY_BACKING_STORE *bs,
+                                                       void *p,
+                                                       size_t nmemb,
+                                                       size_t size);
+  bool                   affy_backing_store_owns(AFFY_BACKING_STORE *bs,
+                                                 void *p);
+  void                   affy_backing_store_free(AFFY_BACKING_STORE *bs);
   void                   affy_free_calvin_datagroup(AFFY_CALVIN_DATAGROUP *dg);
   void                   affy_free_calvin_fileheader(AFFY_CALVIN_FILEHEADER *fh);
   void                   affy_free_calvin_dataset(AFFY_CALVIN_DATASET *ds);
@@ -615,6 +998,8 @@ extern "C"
                                       affy_uint32 *return_max_rows,
                                       affy_uint32 *return_max_cols,
                                       AFFY_ERROR *err);
+  AFFY_CHIPSET *affy_load_generic_spreadsheet(char *filename,
+                                             AFFY_ERROR *err);
 
   /* Calvin-related functions. */
   AFFY_CALVINIO *affy_calvinio_init(FILE *fp, AFFY_ERROR *err);
@@ -707,8 +1092,19 @@ extern "C"
   int   affy_write32_be(FILE *output, void *buf);
   int   affy_write64_be(FILE *output, void *buf);
 
+  /* Endian-correcting decode from an in-memory buffer. */
+  void  affy_decode16_le(const void *src, void *dst);
+  void  affy_decode32_le(const void *src, void *dst);
+  void  affy_decode64_le(const void *src, void *dst);
+  void  affy_decode16_be(const void *src, void *dst);
+  void  affy_decode32_be(const void *src, void *dst);
+  void  affy_decode64_be(const void *src, void *dst);
+
   /* "Vectorized" reading function for convenience. */
   int   affy_readmulti(FILE *fp, const char *fmt, ...);
+
+  /* fopen(filename, "rb"), transparently decompressing gzip files. */
+  FILE *affy_fopen_input(const char *filename);
         
   /* Utility functions */
   void            affy_mean_normalization(AFFY_CHIPSET *d, double target_mean,
@@ -732,6 +1128,9 @@ extern "C"
                                          char         *filename, 
                                          unsigned int  opts,
                                          AFFY_ERROR   *err);
+  double          affy_expression_value(double data,
+                                        unsigned int opts,
+                                        bool *missing);
   void            affy_write_probe_values(AFFY_CHIPSET *c, 
                                           char *filename, 
                                           int opts,
@@ -739,13 +1138,19 @@ extern "C"
   void            affy_write_expressions_gct(AFFY_CHIPSET *c, 
                                              char *filename, 
                                              AFFY_ERROR *err);
+  void            affy_write_expressions_binary(AFFY_CHIPSET *c,
+                                                char         *filename,
+                                                unsigned int  opts,
+                                                AFFY_ERROR   *err);
   bool            affy_ismasked(AFFY_CHIP *chip, int x, int y);
   bool            affy_isoutlier(AFFY_CHIP *chip, int x, int y);
   bool            affy_is_control_probe(AFFY_PROBE *p_probe);
   bool            affy_is_control_probeset(AFFY_PROBESET *ps);
   bool            affy_is_control_string(char *string);
+  affy_uint8      affy_training_mask_flags(AFFY_COMBINED_FLAGS *f);
   bool            affy_isqc(AFFY_CHIP *chip, int x, int y);
   bool            affy_isundefined(AFFY_CHIP *chip, int x, int y);
+  void            affy_mark_probe_cells(AFFY_CDFFILE *cdf);
   AFFY_PIXREGION *affy_pixels_from_cell(AFFY_CHIP *cp, 
                                         int x, 
                                         int y, 
@@ -767,6 +1172,9 @@ extern "C"
   /* Statistical functions (from util). */
   double affy_median_save(double *x, int length, AFFY_COMBINED_FLAGS *f,
                           AFFY_ERROR *err);
+  double affy_median_save_scratch(double *x, int length,
+                                  AFFY_COMBINED_FLAGS *f,
+                                  harena_t *scratch, AFFY_ERROR *err);
   double affy_median(double *x, int length, AFFY_COMBINED_FLAGS *f);
   double affy_mean(double *x, int length);
   double affy_mean_geometric_floor_1(double *x, int length);
@@ -778,6 +1186,15 @@ extern "C"
                              int numcolumns,
                              AFFY_COMBINED_FLAGS *f,
                              AFFY_ERROR *err);
+  void   affy_get_row_median_scratch(double **z, 
+                                     double *rdelta, 
+                                     int startrow, 
+                                     int startcol, 
+                                     int numrows, 
+                                     int numcolumns,
+                                     AFFY_COMBINED_FLAGS *f,
+                                     harena_t *scratch,
+                                     AFFY_ERROR *err);
   void   affy_get_column_median(double **z, 
                                 double *cdelta, 
                                 int startrow, 
@@ -786,6 +1203,15 @@ extern "C"
                                 int numcolumns,
                                 AFFY_COMBINED_FLAGS *f,
                                 AFFY_ERROR *err);
+  void   affy_get_column_median_scratch(double **z, 
+                                        double *cdelta, 
+                                        int startrow, 
+                                        int startcol, 
+                                        int numrows, 
+                                        int numcolumns,
+                                        AFFY_COMBINED_FLAGS *f,
+                                        harena_t *scratch,
+                                        AFFY_ERROR *err);
   int    affy_median_sort(const void *p1, const void *p2);
   int    affy_qnorm_compare(const void *p1, const void *p2);
   void   affy_rank_order(double *rank, double **x, int n);
@@ -28,6 +28,12 @@
  *           probe norm (EAW)
  * 09/13/23: added iron_check_saturated flag (EAW)
  * 04/24/24: add variables for median normalization (EAW)
+ * 10/16/26: added num_threads (EAW)
+ * 10/16/26: added use_cdf_cache, cdf_cache_directory (EAW)
+ * 10/16/26: added use_compact_cel (EAW)
+ * 10/16/26: added memory_budget_mb, spill_directory (EAW)
+ * 10/16/26: added dump_frozen_model, use_frozen_model,
+ *           frozen_model_filename (EAW)
  *
  **************************************************************************/
 
@@ -49,6 +55,22 @@ typedef struct affy_combined_flag_struct
   /* full path to CDF file */
   char *cdf_filename;
 
+  /** (true) Load/save a compiled image of the CDF file */
+  bool use_cdf_cache;
+
+  /** (NULL) Where to keep compiled CDF images, NULL: next to the CDF */
+  char *cdf_cache_directory;
+
+  /** (false) Store CEL intensities as compact float32 planes */
+  bool use_compact_cel;
+
+  /** (0) Keep at most this many MB of per-chip arrays in memory and
+   *      spill the rest to disk, 0: keep everything in memory */
+  long memory_budget_mb;
+
+  /** (NULL) Where to create the spill file, NULL: $TMPDIR or /tmp */
+  char *spill_directory;
+
   /** (true) Run MAS5.0 background correction */
   bool use_background_correction;
 
@@ -106,6 +128,9 @@ typedef struct affy_combined_flag_struct
   
   bool salvage_corrupt;
 
+  /** (1) Number of worker threads used to load CEL files */
+  int num_threads;
+
 
 
   /* *** MAS5 specific options */
@@ -175,6 +200,15 @@ typedef struct affy_combined_flag_struct
       as normal. */
   bool use_saved_means;
   
+  /** (false) Write a frozen RMA model (quantile target + affinities) */
+  bool dump_frozen_model;
+
+  /** (false) Process each chip on its own against a frozen RMA model */
+  bool use_frozen_model;
+
+  /** ("rma-model.bin") Frozen RMA model filename */
+  char *frozen_model_filename;
+
   /** (false) Peform probeset summarization at the single-chip level */
   bool use_rma_probeset_singletons;
   
@@ -24,6 +24,10 @@
  * 04/06/11: HACK -- Added affy_illumina() entry point (EAW)
  * 03/13/19: add estimate_global_bg_sub() (EAW)
  * 08/12/20: add cdf_filename (EAW)
+ * 10/16/26: added affy_rma_median_polish_block(), on a contiguous row-major
+ *           block with a scratch arena (EAW)
+ * 10/16/26: frozen RMA models, affy_rma_frozen() (EAW)
+ * 10/16/26: added affy_rma_quantile_normalization_chips() (EAW)
  *
  **************************************************************************/
 
@@ -101,6 +105,28 @@ typedef struct affy_rma_flag_struct
   bool use_saved_means;
 } AFFY_RMA_FLAGS;
 
+/* Preprocessing a frozen model was built with */
+#define AFFY_RMA_FROZEN_BG_RMA  0x01  /* RMA background correction        */
+#define AFFY_RMA_FROZEN_AFFX    0x02  /* AFFX probes quantile normalized  */
+
+/**
+ * A frozen RMA model (see rma/rma_frozen_model.c): the quantile target
+ * and median polish parameters of a reference run, to process further
+ * chips one at a time exactly as if they had been part of it.
+ */
+typedef struct affy_rma_frozen_model
+{
+  char        *chip_type;
+  int          numprobes;
+  int          numprobesets;
+  affy_uint32  options;         /* AFFY_RMA_FROZEN_* bits                 */
+  affy_uint32  num_chips;       /* chips the model was built from         */
+  double      *mean;            /* quantile target, one per probe         */
+  double      *t_values;        /* one per probeset                       */
+  double     **affinities;      /* per probeset, into one block in
+                                   cdf->ps_offset[] order                 */
+} AFFY_RMA_FROZEN_MODEL;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -116,6 +142,19 @@ extern "C"
   AFFY_CHIPSET *affy_rma(char **filelist, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err);
   AFFY_CHIPSET *affy_illumina(char **filelist, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err);
 
+  /* Frozen RMA: new chips against a saved reference model */
+  AFFY_CHIPSET *affy_rma_frozen(char **filelist, AFFY_COMBINED_FLAGS *f,
+                                AFFY_ERROR *err);
+  void affy_rma_write_frozen_model(AFFY_CHIPSET *c,
+                                   double *mean,
+                                   AFFY_COMBINED_FLAGS *f,
+                                   const char *filename,
+                                   AFFY_ERROR *err);
+  AFFY_RMA_FROZEN_MODEL *affy_rma_load_frozen_model(const char *filename,
+                                                    AFFY_CDFFILE *cdf,
+                                                    AFFY_COMBINED_FLAGS *f,
+                                                    AFFY_ERROR *err);
+
   /* Individual functions used in RMA */
   void affy_rma_background_correct(AFFY_CHIPSET *c, 
                                    unsigned int chipnum, 
@@ -132,6 +171,10 @@ extern "C"
 					    double *mean, 
 					    AFFY_COMBINED_FLAGS *f,
                                             AFFY_ERROR *err);
+  void affy_rma_quantile_normalization_chips(AFFY_CHIPSET *c,
+                                             double *mean,
+                                             AFFY_COMBINED_FLAGS *f,
+                                             AFFY_ERROR *err);
   void affy_global_background_correct(AFFY_CHIPSET *c, 
                                       unsigned int chipnum, 
                                       AFFY_ERROR *err);
@@ -153,6 +196,16 @@ extern "C"
 			      double *t_val,
 			      AFFY_COMBINED_FLAGS *f,
                               AFFY_ERROR *err);
+  void affy_rma_median_polish_block(double *z, 
+                                    int numprobes, 
+                                    int numchips, 
+                                    int stride, 
+                                    double *results, 
+                                    double *affinities, 
+                                    double *t_val,
+                                    AFFY_COMBINED_FLAGS *f,
+                                    harena_t *scratch,
+                                    AFFY_ERROR *err);
   double estimate_global_bg_sub(double *pm, 
                                 int n,
                                 int already_logged_flag,
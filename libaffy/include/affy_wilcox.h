@@ -13,6 +13,7 @@
  * Update History
  * --------------
  * 09/16/10: initial version (EAW)
+ * 10/16/26: affy_mas5_calculate_call_pvalue_scratch() (EAW)
  *
  **************************************************************************/
 
@@ -30,3 +31,8 @@ double affy_mas5_calculate_call_pvalue(double *values,
                                        int n, 
                                        double tau,
                                        AFFY_ERROR *err);
+double affy_mas5_calculate_call_pvalue_scratch(double *values, 
+                                               int n, 
+                                               double tau,
+                                               harena_t *scratch,
+                                               AFFY_ERROR *err);
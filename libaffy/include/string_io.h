@@ -1,9 +1,46 @@
 /*
  * 04/06/11: Added fgets_strip_realloc() and split_tabs() (EAW)
  * 06/01/18: Added compare_string() function (EAW)
+ * 10/16/26: Added buffered LINE_READER (EAW)
+ * 10/16/26: Added strtod_fast() (EAW)
+ * 10/16/26: Added line_reader_offset() (EAW)
+ * 10/16/26: Added line_reader_reset_unget() (EAW)
  */
 
+/*
+ * Buffered line reader.  Reads the stream in large blocks and returns
+ * each line as a view into the block, NUL-terminated in place of its
+ * EOL.  The view is writable, and stays valid until the next call to
+ * line_reader_next().  Handles \r\n \n \r, including mixes of EOL
+ * characters within the same file.
+ *
+ * Users should not rely on the contents of this structure.
+ */
+typedef struct line_reader_s
+{
+  FILE   *fp;
+  long    buf_offset;    /* stream offset of buf[0], -1 if unknown    */
+  char   *buf;
+  size_t  buf_size;      /* usable size of buf, less the trailing NUL */
+  size_t  pos;           /* start of the next unread line             */
+  size_t  len;           /* number of bytes currently in buf          */
+  size_t  nl_pos;        /* next \n at or after pos, len if none      */
+  int     nl_valid;
+  char   *line;          /* last line returned                        */
+  size_t  line_len;
+  int     unget_flag;
+  int     eof_flag;
+} LINE_READER;
+
+extern LINE_READER * line_reader_init(FILE *infile);
+extern char * line_reader_next(LINE_READER *lr, size_t *return_length);
+extern void line_reader_unget(LINE_READER *lr);
+extern void line_reader_reset_unget(LINE_READER *lr);
+extern long line_reader_offset(LINE_READER *lr);
+extern void line_reader_free(LINE_READER *lr);
+
 extern char * fgets_strip_realloc(char **return_string, int *return_max_length,
                                   FILE *infile);
 extern int split_tabs(char *string, char ***fields, int *return_max_field);
 extern int compare_string(const void *f1, const void *f2);
+extern double strtod_fast(const char *string, char **endptr);
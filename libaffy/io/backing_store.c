@@ -0,0 +1,471 @@
+/**************************************************************************
+ *
+ * Filename:  backing_store.c
+ *
+ * Purpose:   Optional out-of-core storage for the large per-chip arrays
+ *            of a chipset (PM probe values, probeset expressions).
+ *
+ * Creation:  October 16th, 2026
+ *
+ * Author:    Eric A. Welsh
+ *
+ * Copyright: Copyright (C) 2026, Moffitt Cancer Center.
+ *            All rights reserved.
+ *
+ * Update History
+ * --------------
+ * 10/16/26: Creation (EAW)
+ * 10/16/26: map the spill file in large chunks, reuse released arrays
+ *           (EAW)
+ *
+ **************************************************************************/
+
+#include <affy.h>
+
+#ifdef AFFY_POSIX_ENV
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#endif
+
+/*
+ * A chipset created with a memory budget (--memory-budget) gets a backing
+ * store, and every chip loaded into it points at the same store.  Per-chip
+ * arrays are allocated through affy_backing_store_calloc(): while the
+ * arrays currently allocated in memory fit in the budget they are ordinary
+ * halloc children of the chip, after that each one is a page aligned
+ * region of a single spill file, mapped shared.  Pointers into either look
+ * the same to the code using them; the OS writes mapped pages back to the
+ * spill file and drops them as memory runs short, instead of swapping.
+ *
+ * The spill file is mapped in large chunks (BACKING_CHUNK_SIZE, or one
+ * array if that is bigger), and spilled arrays are carved out of them, so
+ * a run over thousands of chips needs a handful of mappings rather than a
+ * few per chip.  Arrays released with affy_backing_store_free_array()
+ * give their bytes back to the budget, or their region to a free list
+ * that later spilled arrays are taken from first.
+ *
+ * Every pass over these arrays (loading, normalization, median polish)
+ * walks each chip's array in order, so the mapped pages are read back
+ * sequentially and kernel readahead does the streaming.
+ *
+ * The spill file is created on first use in the spill directory ($TMPDIR
+ * or /tmp by default) and unlinked right away, so it goes away with the
+ * process however it ends.  The mappings are released by
+ * affy_free_chipset().  Arrays from affy_backing_store_calloc() must be
+ * released with affy_backing_store_free_array(), never h_free()d.
+ *
+ * Without POSIX mmap(), everything is kept in memory.
+ */
+
+/* spill file mappings are made this many bytes at a time */
+#define BACKING_CHUNK_SIZE  ((size_t)256 * 1024 * 1024)
+
+/* a mapped chunk of the spill file, handed out from the front */
+typedef struct
+{
+  char   *addr;
+  size_t  len;
+  size_t  used;
+} BACKING_CHUNK;
+
+/* a released region of a chunk, free for reuse */
+typedef struct
+{
+  char   *addr;
+  size_t  len;
+} BACKING_HOLE;
+
+struct affy_backing_store_s
+{
+  size_t         budget;       /* bytes to keep in memory               */
+  size_t         in_memory;    /* bytes currently allocated in memory   */
+  char          *dir;          /* where to create the spill file        */
+  int            fd;           /* spill file, -1 until first needed     */
+  size_t         file_len;     /* bytes of the spill file mapped        */
+  size_t         page;         /* spilled arrays are rounded up to this */
+  BACKING_CHUNK *chunks;       /* sorted by address                     */
+  int            num_chunks;
+  int            max_chunks;
+  BACKING_HOLE  *holes;        /* sorted by address                     */
+  int            num_holes;
+  int            max_holes;
+};
+
+/*
+ * affy_backing_store_create(): a store keeping at most budget_mb
+ * megabytes of arrays in memory at a time and spilling the rest to a
+ * file in dir (NULL for the default).
+ */
+AFFY_BACKING_STORE *affy_backing_store_create(long budget_mb,
+                                              const char *dir,
+                                              AFFY_ERROR *err)
+{
+  AFFY_BACKING_STORE *bs;
+
+  assert(budget_mb >= 0);
+
+  bs = h_calloc(1, sizeof(AFFY_BACKING_STORE));
+  if (bs == NULL)
+    AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, NULL);
+
+  bs->budget = (size_t)budget_mb * 1024 * 1024;
+  bs->fd     = -1;
+
+  if (dir == NULL || *dir == '\0')
+    dir = getenv("TMPDIR");
+  if (dir == NULL || *dir == '\0')
+    dir = "/tmp";
+
+  bs->dir = h_strdup(dir);
+  if (bs->dir == NULL)
+  {
+    h_free(bs);
+    AFFY_HANDLE_ERROR("strdup failed", AFFY_ERROR_OUTOFMEM, err, NULL);
+  }
+  hattach(bs->dir, bs);
+
+#ifdef AFFY_POSIX_ENV
+  bs->page = sysconf(_SC_PAGESIZE);
+#else
+  warn("out-of-core storage is not supported here, keeping all data in "
+       "memory");
+#endif
+
+  return (bs);
+}
+
+#ifdef AFFY_POSIX_ENV
+/* Index of the chunk holding p, -1 if none; binary search by address */
+static int find_chunk(AFFY_BACKING_STORE *bs, const char *p)
+{
+  int lo = 0, hi = bs->num_chunks - 1;
+
+  while (lo <= hi)
+  {
+    int mid = lo + (hi - lo) / 2;
+
+    if (p < bs->chunks[mid].addr)
+      hi = mid - 1;
+    else if (p >= bs->chunks[mid].addr + bs->chunks[mid].len)
+      lo = mid + 1;
+    else
+      return (mid);
+  }
+
+  return (-1);
+}
+
+/* Make room for one more element in *array, false if out of memory */
+static bool grow_array(AFFY_BACKING_STORE *bs, void **array, int num,
+                       int *max, size_t size)
+{
+  void *p;
+  int   new_max;
+
+  if (num < *max)
+    return (true);
+
+  new_max = *max ? 2 * *max : 64;
+
+  p = h_realloc(*array, new_max * size);
+  if (p == NULL)
+    return (false);
+  if (*array == NULL)
+    hattach(p, bs);
+
+  *array = p;
+  *max   = new_max;
+
+  return (true);
+}
+
+/* Map another chunk of at least len bytes of the spill file */
+static BACKING_CHUNK *map_chunk(AFFY_BACKING_STORE *bs, size_t len)
+{
+  BACKING_CHUNK *ch;
+  char          *addr;
+  int            i;
+
+  if (bs->fd < 0)
+  {
+    char *name;
+
+    name = h_malloc(strlen(bs->dir) + 32);
+    if (name == NULL)
+      return (NULL);
+
+    sprintf(name, "%s/libaffy-spill-XXXXXX", bs->dir);
+
+    bs->fd = mkstemp(name);
+    if (bs->fd < 0)
+    {
+      warn("could not create spill file in %s", bs->dir);
+      h_free(name);
+
+      return (NULL);
+    }
+
+    info("Spilling chip data to %s", bs->dir);
+
+    unlink(name);
+    h_free(name);
+  }
+
+  if (!grow_array(bs, (void **)&bs->chunks, bs->num_chunks,
+                  &bs->max_chunks, sizeof(BACKING_CHUNK)))
+    return (NULL);
+
+  if (len < BACKING_CHUNK_SIZE)
+    len = BACKING_CHUNK_SIZE;
+
+  /* the file grows zero filled */
+  if (ftruncate(bs->fd, (off_t)(bs->file_len + len)) != 0)
+    return (NULL);
+
+  addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, bs->fd,
+              (off_t)bs->file_len);
+  if (addr == MAP_FAILED)
+    return (NULL);
+
+  bs->file_len += len;
+
+  /* keep the table sorted by address for find_chunk() */
+  for (i = bs->num_chunks; i > 0 && bs->chunks[i - 1].addr > addr; i--)
+    bs->chunks[i] = bs->chunks[i - 1];
+
+  ch       = &bs->chunks[i];
+  ch->addr = addr;
+  ch->len  = len;
+  ch->used = 0;
+  bs->num_chunks++;
+
+  return (ch);
+}
+
+/* Zeroed, page aligned spill file storage for len bytes, NULL on failure */
+static void *spill_alloc(AFFY_BACKING_STORE *bs, size_t len)
+{
+  BACKING_CHUNK *ch = NULL;
+  char          *p;
+  int            i;
+
+  len = (len + bs->page - 1) / bs->page * bs->page;
+
+  /* reuse a released region first; it still holds its old contents */
+  for (i = 0; i < bs->num_holes; i++)
+  {
+    BACKING_HOLE *h = &bs->holes[i];
+
+    if (h->len < len)
+      continue;
+
+    p = h->addr;
+
+    h->addr += len;
+    h->len  -= len;
+    if (h->len == 0)
+    {
+      memmove(h, h + 1, (bs->num_holes - i - 1) * sizeof(BACKING_HOLE));
+      bs->num_holes--;
+    }
+
+    memset(p, 0, len);
+
+    return (p);
+  }
+
+  /* then the untouched (still zero) tail of a chunk */
+  for (i = 0; i < bs->num_chunks; i++)
+  {
+    if (bs->chunks[i].len - bs->chunks[i].used >= len)
+    {
+      ch = &bs->chunks[i];
+      break;
+    }
+  }
+
+  if (ch == NULL)
+    ch = map_chunk(bs, len);
+  if (ch == NULL)
+    return (NULL);
+
+  p         = ch->addr + ch->used;
+  ch->used += len;
+
+  return (p);
+}
+
+/* Put the len bytes at p, from chunk ch, on the free list */
+static void spill_release(AFFY_BACKING_STORE *bs, int ch, char *p,
+                          size_t len)
+{
+  BACKING_CHUNK *chunk = &bs->chunks[ch];
+  BACKING_HOLE  *h;
+  int            i;
+
+  len = (len + bs->page - 1) / bs->page * bs->page;
+
+  assert(p + len <= chunk->addr + chunk->used);
+
+  /* first hole past p */
+  for (i = 0; i < bs->num_holes && bs->holes[i].addr < p; i++)
+    ;
+
+  /* merge with the neighbouring holes of the same chunk */
+  if (i > 0 && bs->holes[i - 1].addr + bs->holes[i - 1].len == p &&
+      bs->holes[i - 1].addr >= chunk->addr)
+  {
+    h       = &bs->holes[i - 1];
+    h->len += len;
+
+    if (i < bs->num_holes && h->addr + h->len == bs->holes[i].addr &&
+        bs->holes[i].addr < chunk->addr + chunk->len)
+    {
+      h->len += bs->holes[i].len;
+      memmove(&bs->holes[i], &bs->holes[i + 1],
+              (bs->num_holes - i - 1) * sizeof(BACKING_HOLE));
+      bs->num_holes--;
+    }
+
+    return;
+  }
+
+  if (i < bs->num_holes && p + len == bs->holes[i].addr &&
+      bs->holes[i].addr < chunk->addr + chunk->len)
+  {
+    bs->holes[i].addr  = p;
+    bs->holes[i].len  += len;
+
+    return;
+  }
+
+  /* if there's no room to list it, the region is just lost until exit */
+  if (!grow_array(bs, (void **)&bs->holes, bs->num_holes, &bs->max_holes,
+                  sizeof(BACKING_HOLE)))
+    return;
+
+  memmove(&bs->holes[i + 1], &bs->holes[i],
+          (bs->num_holes - i) * sizeof(BACKING_HOLE));
+  bs->holes[i].addr = p;
+  bs->holes[i].len  = len;
+  bs->num_holes++;
+}
+#endif
+
+/*
+ * affy_backing_store_calloc(): zeroed storage for nmemb elements of size
+ * bytes, owned by parent.  With no store (bs == NULL), or while within
+ * the budget, this is h_subcalloc(parent, ...).  NULL if out of memory.
+ * Release it with affy_backing_store_free_array().
+ */
+void *affy_backing_store_calloc(AFFY_BACKING_STORE *bs,
+                                void *parent,
+                                size_t nmemb,
+                                size_t size)
+{
+  size_t  len = nmemb * size;
+  void   *p;
+
+  assert(parent != NULL);
+
+  if (bs == NULL)
+    return (h_subcalloc(parent, nmemb, size));
+
+#ifdef AFFY_POSIX_ENV
+  if (bs->in_memory + len > bs->budget)
+  {
+    p = spill_alloc(bs, len);
+    if (p != NULL)
+      return (p);
+
+    /* no room on disk either, try memory after all */
+  }
+#endif
+
+  p = h_subcalloc(parent, nmemb, size);
+  if (p != NULL)
+    bs->in_memory += len;
+
+  return (p);
+}
+
+/*
+ * affy_backing_store_free_array(): release p, allocated by
+ * affy_backing_store_calloc(bs, parent, nmemb, size) with the same nmemb
+ * and size.  Arrays in memory are h_free()d and no longer count against
+ * the budget, spilled ones are left for reuse.  NULL is ignored.
+ */
+void affy_backing_store_free_array(AFFY_BACKING_STORE *bs,
+                                   void *p,
+                                   size_t nmemb,
+                                   size_t size)
+{
+  size_t len = nmemb * size;
+
+  if (p == NULL)
+    return;
+
+  if (bs == NULL)
+  {
+    h_free(p);
+    return;
+  }
+
+#ifdef AFFY_POSIX_ENV
+  {
+    int ch = find_chunk(bs, p);
+
+    if (ch >= 0)
+    {
+      spill_release(bs, ch, p, len);
+      return;
+    }
+  }
+#endif
+
+  h_free(p);
+
+  bs->in_memory -= (len < bs->in_memory) ? len : bs->in_memory;
+}
+
+/*
+ * affy_backing_store_owns(): true if p was spilled to the store's file,
+ * and so must not be h_free()d.
+ */
+bool affy_backing_store_owns(AFFY_BACKING_STORE *bs, void *p)
+{
+  if (bs == NULL || p == NULL)
+    return (false);
+
+#ifdef AFFY_POSIX_ENV
+  return (find_chunk(bs, p) >= 0);
+#else
+  return (false);
+#endif
+}
+
+/*
+ * affy_backing_store_free(): release the spill file and every mapping of
+ * it.  Arrays kept in memory belong to their chips and are left alone.
+ */
+void affy_backing_store_free(AFFY_BACKING_STORE *bs)
+{
+  if (bs == NULL)
+    return;
+
+#ifdef AFFY_POSIX_ENV
+  {
+    int i;
+
+    for (i = 0; i < bs->num_chunks; i++)
+      munmap(bs->chunks[i].addr, bs->chunks[i].len);
+
+    if (bs->fd >= 0)
+      close(bs->fd);
+  }
+#endif
+
+  h_free(bs);
+}
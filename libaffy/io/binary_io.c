@@ -20,6 +20,7 @@
  * 01/10/08: Convert the native-endian read macros to functions (AMH)
  * 01/23/08: Remove some obsolete native-type-size I/O functions (AMH)
  * 10/08/10: Add write routines (AMH)
+ * 10/16/26: Add affy_decodeXX() routines for in-memory buffers (EAW)
  *
  **************************************************************************/
 
@@ -588,3 +589,85 @@ int affy_writechars(FILE *output, char *buf)
 
   return (0);
 }
+
+/*
+ * affy_decode16_le(), affy_decode32_le(), affy_decode64_le(),
+ * affy_decode16_be(), affy_decode32_be(), affy_decode64_be():
+ *   Decode a 16/32/64-bit integer or float of the given file endianness
+ *   from an in-memory byte buffer.
+ *
+ * Inputs: *src points to the raw bytes (no alignment requirement), *dst
+ *         points to allocated storage of the appropriate width.  src and
+ *         dst may be the same location, for decoding in place.
+ * Outputs: None.
+ * Side effects: None.
+ *
+ * Comments: Intended for bulk loaders which fread() a whole block of
+ *           records at once and then decode it in a single sweep,
+ *           avoiding per-value stdio calls.
+ */
+void affy_decode16_le(const void *src, void *dst)
+{
+  affy_uint16 tmp;
+
+  memcpy(&tmp, src, 2);
+#ifdef LIBUTILS_BIG_ENDIAN
+  AFFY_SWAP16(&tmp);
+#endif
+  memcpy(dst, &tmp, 2);
+}
+
+void affy_decode32_le(const void *src, void *dst)
+{
+  affy_uint32 tmp;
+
+  memcpy(&tmp, src, 4);
+#ifdef LIBUTILS_BIG_ENDIAN
+  AFFY_SWAP32(&tmp);
+#endif
+  memcpy(dst, &tmp, 4);
+}
+
+void affy_decode64_le(const void *src, void *dst)
+{
+  affy_uint8 tmp[8];
+
+  memcpy(tmp, src, 8);
+#ifdef LIBUTILS_BIG_ENDIAN
+  AFFY_SWAP64(tmp);
+#endif
+  memcpy(dst, tmp, 8);
+}
+
+void affy_decode16_be(const void *src, void *dst)
+{
+  affy_uint16 tmp;
+
+  memcpy(&tmp, src, 2);
+#ifndef LIBUTILS_BIG_ENDIAN
+  AFFY_SWAP16(&tmp);
+#endif
+  memcpy(dst, &tmp, 2);
+}
+
+void affy_decode32_be(const void *src, void *dst)
+{
+  affy_uint32 tmp;
+
+  memcpy(&tmp, src, 4);
+#ifndef LIBUTILS_BIG_ENDIAN
+  AFFY_SWAP32(&tmp);
+#endif
+  memcpy(dst, &tmp, 4);
+}
+
+void affy_decode64_be(const void *src, void *dst)
+{
+  affy_uint8 tmp[8];
+
+  memcpy(tmp, src, 8);
+#ifndef LIBUTILS_BIG_ENDIAN
+  AFFY_SWAP64(tmp);
+#endif
+  memcpy(dst, tmp, 8);
+}
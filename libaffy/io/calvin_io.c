@@ -19,10 +19,13 @@
  * 11/26/08: Rework the I/O layer significantly (AMH)
  * 09/20/10: Pooled memory allocator (AMH)
  * 05/13/13: Changes to support salvaging of corrupt CEL files (EAW)
+ * 10/16/26: Read dataset columns/rows in bulk blocks, decode in memory (EAW)
+ * 10/16/26: Inline 16/32-bit swap loops for single column datasets (EAW)
  *
  **************************************************************************/
 
 #include <affy.h>
+#include "endian_config.h"
 
 static char *read_string(FILE *fp, AFFY_ERROR *err);
 static char *read_wstring(FILE *fp, AFFY_ERROR *err);
@@ -41,15 +44,57 @@ static int   move_to_dataset(AFFY_CALVINIO *cio,
                              AFFY_ERROR *err);
 
 
+/* Target size of each bulk read of dataset rows */
+#define CALVIN_READ_BLOCK_SIZE  (1024 * 1024)
+
 typedef int(*affy_binary_reader)(FILE *, void *);
+typedef void(*affy_binary_decoder)(const void *, void *);
 
 struct calvin_type_info
 { 
-  const char        *label; 
-  affy_binary_reader read_func; 
-  size_t             size;
+  const char         *label; 
+  affy_binary_reader  read_func; 
+  affy_binary_decoder decode_func;
+  size_t              size;
 };
 
+static void decode8(const void *src, void *dst)
+{
+  *(affy_uint8 *)dst = *(const affy_uint8 *)src;
+}
+
+/*
+ * Big-endian to host conversion of a whole array of 16/32-bit values, in
+ * place, without a call through decode_func per element.  At -O3 gcc
+ * vectorizes the 16-bit loop; the 32-bit loop becomes one bswap per
+ * element, and is vectorized too when byte shuffles are available
+ * (e.g. -mssse3).
+ */
+static void swap16_be_block(affy_uint16 *p, size_t n)
+{
+#ifndef LIBUTILS_BIG_ENDIAN
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    p[i] = (affy_uint16)((p[i] << 8) | (p[i] >> 8));
+#endif
+}
+
+static void swap32_be_block(affy_uint32 *p, size_t n)
+{
+#ifndef LIBUTILS_BIG_ENDIAN
+  size_t i;
+
+  for (i = 0; i < n; i++)
+  {
+    affy_uint32 x = p[i];
+
+    p[i] = (x << 24) | ((x << 8) & 0x00ff0000UL)
+         | ((x >> 8) & 0x0000ff00UL) | (x >> 24);
+  }
+#endif
+}
+
 /* 
  * Be sure to keep the ordering of this table in sync with the
  * AFFY_CALVIN_DATA_TYPE enum.
@@ -57,25 +102,25 @@ struct calvin_type_info
 static const struct calvin_type_info calvin_type_table[] =
   {
     /* AFFY_CALVIN_BYTE    */
-    { "text/x-calvin-integer-8",           affy_read8,     1 },
+    { "text/x-calvin-integer-8",           affy_read8,     decode8,          1 },
     /* AFFY_CALVIN_UBYTE   */
-    { "text/x-calvin-unsigned-integer-8",  affy_read8,     1 },
+    { "text/x-calvin-unsigned-integer-8",  affy_read8,     decode8,          1 },
     /* AFFY_CALVIN_SHORT   */
-    { "text/x-calvin-integer-16",          affy_read16_be, 2 },
+    { "text/x-calvin-integer-16",          affy_read16_be, affy_decode16_be, 2 },
     /* AFFY_CALVIN_USHORT  */
-    { "text/x-calvin-unsigned-integer-16", affy_read16_be, 2 },
+    { "text/x-calvin-unsigned-integer-16", affy_read16_be, affy_decode16_be, 2 },
     /* AFFY_CALVIN_INT     */
-    { "text/x-calvin-integer-32",          affy_read32_be, 4 },
+    { "text/x-calvin-integer-32",          affy_read32_be, affy_decode32_be, 4 },
     /* AFFY_CALVIN_UINT    */
-    { "text/x-calvin-unsigned-integer-32", affy_read32_be, 4 },
+    { "text/x-calvin-unsigned-integer-32", affy_read32_be, affy_decode32_be, 4 },
     /* AFFY_CALVIN_FLOAT   */
-    { "text/x-calvin-float",               affy_read32_be, 4 },
+    { "text/x-calvin-float",               affy_read32_be, affy_decode32_be, 4 },
     /* AFFY_CALVIN_DOUBLE  */
-    { NULL,                                affy_read64_be, 8 },
+    { NULL,                                affy_read64_be, affy_decode64_be, 8 },
     /* AFFY_CALVIN_STRING  */
-    { "text/ascii",                        NULL,           0 },
+    { "text/ascii",                        NULL,           NULL,             0 },
     /* AFFY_CALVIN_WSTRING */
-    { "text/plain",                        NULL,           0 }
+    { "text/plain",                        NULL,           NULL,             0 }
   };
 
 /* Translate parameter type strings into an internal type enum. */
@@ -1073,8 +1118,34 @@ cleanup:
 }
 
 
+/*
+ * Number of whole dataset rows to read per bulk fread(), given the
+ * number of rows remaining.
+ */
+static affy_uint32 rows_per_block(AFFY_CALVIN_DATASET_IO *dio, 
+                                  affy_uint32 num_rows)
+{
+  affy_uint32 n;
+
+  if (dio->row_length == 0)
+    return (num_rows);
+
+  n = CALVIN_READ_BLOCK_SIZE / dio->row_length;
+  if (n < 1)
+    n = 1;
+  if (n > num_rows)
+    n = num_rows;
+
+  return (n);
+}
+
 /* 
  * Read a single column from the given dataset I/O context.
+ *
+ * Fixed-width columns are read a block of rows at a time and decoded
+ * from memory.  When the column is the only one in the dataset (the
+ * usual case for CEL intensities), the column is one contiguous span
+ * and is read straight into dest, then byte-swapped in place.
  */
 void affy_calvin_read_dataset_col(AFFY_CALVIN_DATASET_IO *dio,
                                   LIBUTILS_PB_STATE *pbs,
@@ -1085,15 +1156,19 @@ void affy_calvin_read_dataset_col(AFFY_CALVIN_DATASET_IO *dio,
   AFFY_CALVIN_DATASET  *metadata;
   AFFY_CALVIN_DATA_TYPE type;
   AFFY_CALVINIO        *cio;
-  affy_uint32           skip_distance, column_offset, i;
+  affy_uint32           skip_distance, column_offset, i, j, n;
+  affy_uint32           num_rows, block_rows;
+  size_t                col_size, nbytes;
   char                **string_dest = dest, *byte_dest = dest;
-  affy_binary_reader    read_func = NULL;
+  unsigned char        *block = NULL, *src;
+  affy_binary_decoder   decode_func = NULL;
  
   assert(dio  != NULL);
   assert(dest != NULL);
 
   metadata = dio->metadata;
   cio      = dio->calvin_io;
+  num_rows = metadata->num_rows;
 
   if (col_index >= metadata->num_cols)
     AFFY_HANDLE_ERROR_VOID("column index out of range",
@@ -1112,7 +1187,7 @@ void affy_calvin_read_dataset_col(AFFY_CALVIN_DATASET_IO *dio,
                              AFFY_ERROR_BADFORMAT,
                              err);
     default:
-      read_func = calvin_type_table[type].read_func;
+      decode_func = calvin_type_table[type].decode_func;
   }
 
   /* Calculate offsets. */
@@ -1122,44 +1197,118 @@ void affy_calvin_read_dataset_col(AFFY_CALVIN_DATASET_IO *dio,
       column_offset += metadata->columns[i].size;
   }
 
-  skip_distance = dio->row_length - metadata->columns[col_index].size;
+  col_size      = metadata->columns[col_index].size;
+  skip_distance = dio->row_length - col_size;
 
-  if (fseek(cio->fp, dio->initial_offset + column_offset, SEEK_SET) != 0)
+  /* Variable-length strings still have to be read one row at a time. */
+  if (decode_func == NULL)
+  {
+    if (fseek(cio->fp, dio->initial_offset + column_offset, SEEK_SET) != 0)
+      AFFY_HANDLE_ERROR_VOID("I/O error reading Calvin file",
+                             AFFY_ERROR_IO,
+                             err);
+
+    for (i = 0; i < num_rows; i++)
+    {
+      if (type == AFFY_CALVIN_WSTRING)
+        *(string_dest++) = read_wstring(cio->fp, err);
+      else
+        *(string_dest++) = read_string(cio->fp, err);
+      AFFY_CHECK_ERROR_VOID(err);
+
+      /* Move to the same column on the next row. */
+      if (fseek(cio->fp, skip_distance, SEEK_CUR) != 0)
+        AFFY_HANDLE_ERROR_VOID("I/O error reading Calvin file",
+                               AFFY_ERROR_IO,
+                               err);
+      pb_tick(pbs, 1,"");
+    }
+
+    return;
+  }
+
+  if (col_size != calvin_type_table[type].size)
+    AFFY_HANDLE_ERROR_VOID("column size does not match column type",
+                           AFFY_ERROR_BADFORMAT,
+                           err);
+
+  if (fseek(cio->fp, dio->initial_offset, SEEK_SET) != 0)
     AFFY_HANDLE_ERROR_VOID("I/O error reading Calvin file",
                            AFFY_ERROR_IO,
                            err);
 
-  for (i = 0; i < metadata->num_rows; i++)
+  /* Single column dataset: one contiguous span, decode in place. */
+  if (skip_distance == 0)
   {
+    block_rows = rows_per_block(dio, num_rows);
 
-    if (type == AFFY_CALVIN_WSTRING)
-    {
-      *(string_dest++) = read_wstring(cio->fp, err);
-      AFFY_CHECK_ERROR_VOID(err);
-    }
-    else if (type == AFFY_CALVIN_STRING)
+    for (i = 0; i < num_rows; i += n)
     {
-      *(string_dest++) = read_string(cio->fp, err);
-      AFFY_CHECK_ERROR_VOID(err);
-    }
-    else
-    {
-      if (read_func(cio->fp, (void *)byte_dest) != 0)
+      n      = ((num_rows - i) < block_rows) ? (num_rows - i) : block_rows;
+      nbytes = (size_t)n * col_size;
+
+      if (fread(byte_dest, 1, nbytes, cio->fp) != nbytes)
         AFFY_HANDLE_ERROR_VOID("I/O error reading Calvin file",
                                AFFY_ERROR_IO,
                                err);
-      byte_dest += calvin_type_table[type].size;
+
+      /* dest is an array of the column's type, so naturally aligned */
+      if (col_size == 2 && ((size_t)byte_dest & 1) == 0)
+        swap16_be_block((affy_uint16 *)byte_dest, n);
+      else if (col_size == 4 && ((size_t)byte_dest & 3) == 0)
+        swap32_be_block((affy_uint32 *)byte_dest, n);
+      else if (col_size != 1)
+      {
+        for (j = 0; j < n; j++)
+          decode_func(byte_dest + (size_t)j * col_size,
+                      byte_dest + (size_t)j * col_size);
+      }
+
+      byte_dest += nbytes;
+
+      pb_tick(pbs, n, "");
     }
-    
-    /* Move to the same column on the next row. */
-    if (fseek(cio->fp, skip_distance, SEEK_CUR) != 0)
-      AFFY_HANDLE_ERROR_VOID("I/O error reading Calvin file",
+
+    return;
+  }
+
+  /* Interleaved columns: read whole rows, pick out the one column. */
+  block_rows = rows_per_block(dio, num_rows);
+
+  block = h_malloc((size_t)block_rows * dio->row_length);
+  if (block == NULL)
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+
+  for (i = 0; i < num_rows; i += n)
+  {
+    n      = ((num_rows - i) < block_rows) ? (num_rows - i) : block_rows;
+    nbytes = (size_t)n * dio->row_length;
+
+    if (fread(block, 1, nbytes, cio->fp) != nbytes)
+      AFFY_HANDLE_ERROR_GOTO("I/O error reading Calvin file",
                              AFFY_ERROR_IO,
-                             err);
-    pb_tick(pbs, 1,"");
+                             err,
+                             cleanup);
+
+    for (j = 0, src = block + column_offset; 
+         j < n; 
+         j++, src += dio->row_length, byte_dest += col_size)
+    {
+      decode_func(src, byte_dest);
+    }
+
+    pb_tick(pbs, n, "");
   }
+
+cleanup:
+  h_free(block);
 }
 
+/*
+ * Read a range of rows from the given dataset I/O context, storing the
+ * columns named in the offsets mapping at the given offsets within each
+ * base_sz-sized destination record.  Unmapped columns are skipped.
+ */
 void affy_calvin_read_dataset_rows(AFFY_CALVIN_DATASET_IO *dio,
                                    LIBUTILS_PB_STATE *pbs,                  
                                    affy_uint32 start_row,
@@ -1169,11 +1318,18 @@ void affy_calvin_read_dataset_rows(AFFY_CALVIN_DATASET_IO *dio,
                                    const AFFY_CALVIN_COLUMN_MAPPING *offsets,
                                    AFFY_ERROR *err)
 {
-  affy_uint32                       ds_rows, i, j;
+  affy_uint32                       ds_rows, i, j, k, n, block_rows;
+  affy_uint32                       num_mapped, col_offset;
   char                             *byte_base = base;
+  unsigned char                    *block = NULL, *row;
+  size_t                            nbytes;
   FILE                             *fp;
   AFFY_CALVIN_DATASET              *metadata;
   const AFFY_CALVIN_COLUMN_MAPPING *cmap;
+  affy_uint32                      *src_offset = NULL;
+  size_t                           *dest_offset = NULL;
+  affy_binary_decoder              *decode_func = NULL;
+  int                              *mempool;
 
   assert(dio     != NULL);
   assert(base    != NULL);
@@ -1188,44 +1344,85 @@ void affy_calvin_read_dataset_rows(AFFY_CALVIN_DATASET_IO *dio,
                            AFFY_ERROR_BADPARAM,
                            err);
 
+  if (num_rows == 0)
+    return;
+
+  mempool = h_malloc(sizeof(int));
+  if (mempool == NULL)
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+
+  /* Resolve the column mappings once, rather than once per row. */
+  src_offset  = h_subcalloc(mempool, metadata->num_cols + 1, 
+                            sizeof(affy_uint32));
+  dest_offset = h_subcalloc(mempool, metadata->num_cols + 1, sizeof(size_t));
+  decode_func = h_subcalloc(mempool, metadata->num_cols + 1,
+                            sizeof(affy_binary_decoder));
+  if ((src_offset == NULL) || (dest_offset == NULL) || (decode_func == NULL))
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+  for (j = num_mapped = col_offset = 0; j < metadata->num_cols; j++)
+  {
+    cmap = mapping_for_column(offsets, metadata->columns[j].name);
+
+    if (cmap != NULL)
+    {
+      AFFY_CALVIN_DATA_TYPE type = metadata->columns[j].type;
+
+      if ((type == AFFY_CALVIN_UNKNOWN) ||
+          (calvin_type_table[type].decode_func == NULL) ||
+          (calvin_type_table[type].size != metadata->columns[j].size))
+        AFFY_HANDLE_ERROR_GOTO("unsupported column type",
+                               AFFY_ERROR_NOTSUPP,
+                               err,
+                               cleanup);
+
+      src_offset[num_mapped]  = col_offset;
+      dest_offset[num_mapped] = cmap->offset;
+      decode_func[num_mapped] = calvin_type_table[type].decode_func;
+      num_mapped++;
+    }
+
+    col_offset += metadata->columns[j].size;
+  }
+
+  block_rows = rows_per_block(dio, num_rows);
+
+  block = h_suballoc(mempool, (size_t)block_rows * dio->row_length);
+  if (block == NULL)
+    AFFY_HANDLE_ERROR_GOTO("malloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
   if (fseek(fp, 
             dio->initial_offset + (start_row * dio->row_length), 
             SEEK_SET) != 0)
-    AFFY_HANDLE_ERROR_VOID("I/O error reading Calvin file",
+    AFFY_HANDLE_ERROR_GOTO("I/O error reading Calvin file",
                            AFFY_ERROR_IO,
-                           err);
+                           err,
+                           cleanup);
 
-  for (i = start_row; i < start_row + num_rows; i++)
+  for (i = 0; i < num_rows; i += n)
   {
-    for (j = 0; j < metadata->num_cols; j++)
-    {
-      cmap = mapping_for_column(offsets, metadata->columns[j].name);
+    n      = ((num_rows - i) < block_rows) ? (num_rows - i) : block_rows;
+    nbytes = (size_t)n * dio->row_length;
 
-      if (cmap != NULL)
-      {
-        void              *dest = byte_base + cmap->offset;
-        affy_binary_reader read_func;
-        
-        read_func = calvin_type_table[metadata->columns[j].type].read_func;
+    if (fread(block, 1, nbytes, fp) != nbytes)
+      AFFY_HANDLE_ERROR_GOTO("I/O error reading Calvin file",
+                             AFFY_ERROR_IO,
+                             err,
+                             cleanup);
 
-        if (read_func(fp, dest) != 0)
-          AFFY_HANDLE_ERROR_VOID("I/O error reading Calvin file",
-                                 AFFY_ERROR_IO,
-                                 err);
-      }
-      else /* skip column */
-      {
-        if (fseek(fp, metadata->columns[j].size, SEEK_CUR) != 0)
-          AFFY_HANDLE_ERROR_VOID("I/O error reading Calvin file",
-                                 AFFY_ERROR_IO,
-                                 err); 
-      }
-    }
+    for (j = 0, row = block; j < n; j++, row += dio->row_length)
+    {
+      for (k = 0; k < num_mapped; k++)
+        decode_func[k](row + src_offset[k], byte_base + dest_offset[k]);
 
-    byte_base += base_sz;
+      byte_base += base_sz;
+    }
 
-    pb_tick(pbs, 1,"");
+    pb_tick(pbs, n, "");
   }
+
+cleanup:
+  h_free(mempool);
 }
 
 /* 
@@ -0,0 +1,708 @@
+/**************************************************************************
+ *
+ * Filename:  cdf_cache.c
+ *
+ * Purpose:   Read/write "compiled" CDF images, so that a parsed CDF file
+ *            can be loaded again without re-parsing it.
+ *
+ * Creation:  October 16th, 2026
+ *
+ * Author:    Eric A. Welsh
+ *
+ * Copyright: Copyright (C) 2026, Moffitt Cancer Center.
+ *            All rights reserved.
+ *
+ * Update History
+ * --------------
+ * 10/16/26: Creation (EAW)
+ * 10/16/26: build the flat probe tables after loading an image (EAW)
+ * 10/16/26: key images on the CDF's device/inode, size and mtime rather
+ *           than on the path string it was reached by (EAW)
+ * 10/16/26: range check every record of a loaded image (EAW)
+ * 10/16/26: version 3, rebuild images of text CDFs with multiblock
+ *           probesets, whose earlier blocks were saved zeroed (EAW)
+ * 10/16/26: build the probeset name index after loading an image (EAW)
+ *
+ **************************************************************************/
+
+#include <affy.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef AFFY_POSIX_ENV
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+/*
+ * A compiled CDF image is a flat, native-endian dump of everything the
+ * CDF loaders produce: the cell_type/seen_xy maps, one record per
+ * probeset, one record per probe, the linear probe list (as indices into
+ * the probe records) and a single blob holding all probeset names.
+ *
+ * Loading it back takes a handful of bulk allocations and copies, plus
+ * one pass to turn indices back into pointers.  There is no per-probe or
+ * per-name allocation.  On POSIX systems the image is mmap()ed rather
+ * than read, but only while loading: everything is copied out of it, so
+ * the CDF doesn't depend on the image file once loaded.  The image is
+ * untrusted input, every offset, count and coordinate in it is range
+ * checked before use.
+ *
+ * The image records the device, inode, size and mtime of the CDF file it
+ * was built from, and is silently rebuilt if any of them change.  The
+ * path is stored too, but only for reference: "/data/X.CDF",
+ * "/data//X.CDF" and "../data/X.CDF" all find the same image.  It is
+ * written to a temporary file and rename()d into place, so concurrent
+ * processes never see a partial image.
+ *
+ * Every section starts on an 8 byte boundary.
+ */
+
+#define CDF_CACHE_MAGIC      "AFFYCDFC"
+#define CDF_CACHE_VERSION    3
+#define CDF_CACHE_BYTE_ORDER 0x01020304
+#define CDF_CACHE_SUFFIX     ".affycdf"
+#define CDF_CACHE_ALIGN      8
+
+#define CDF_CACHE_PAD(x) \
+  (((x) + CDF_CACHE_ALIGN - 1) & ~((size_t)CDF_CACHE_ALIGN - 1))
+
+/* Halves of a (possibly only 32-bit wide) unsigned stat field */
+#define CDF_CACHE_LO(x) ((affy_uint32)((x) & 0xFFFFFFFFU))
+#define CDF_CACHE_HI(x) ((affy_uint32)(((x) >> 16) >> 16))
+
+/* Identity of the source CDF file, compared as a whole */
+typedef struct
+{
+  affy_uint32 dev_lo;
+  affy_uint32 dev_hi;
+  affy_uint32 ino_lo;
+  affy_uint32 ino_hi;
+  affy_uint32 size_lo;
+  affy_uint32 size_hi;
+  affy_uint32 mtime_lo;
+  affy_uint32 mtime_hi;
+} CDF_CACHE_SOURCE;
+
+typedef struct
+{
+  char        magic[8];
+  affy_uint32 version;
+  affy_uint32 byte_order;
+  affy_uint32 header_size;
+  affy_uint32 path_len;        /* includes the terminating NUL          */
+  CDF_CACHE_SOURCE src;
+  affy_uint32 numrows;
+  affy_uint32 numcols;
+  affy_int32  numprobes;
+  affy_int32  numprobesets;
+  affy_int32  numqcunits;
+  affy_int32  numpool;         /* number of probe records               */
+  affy_uint32 names_len;
+  affy_int8   no_mm_flag;
+  affy_int8   dupe_probes_flag;
+  affy_int8   pad[6];
+} CDF_CACHE_HEADER;
+
+typedef struct
+{
+  affy_int32 index;
+  affy_int32 numprobes;
+  affy_int32 name_ofs;         /* -1 if NULL                            */
+  affy_int32 pool_ofs;         /* first probe record, -1 if NULL        */
+} CDF_CACHE_PROBESET;
+
+typedef struct
+{
+  affy_int32 index;
+  affy_int32 ps;               /* parent probeset, -1 if NULL           */
+  affy_int32 mm_x;
+  affy_int32 mm_y;
+  affy_int32 pm_x;
+  affy_int32 pm_y;
+} CDF_CACHE_PROBE;
+
+/*
+ * Location of the cache image for a given CDF file (h_free() it).  In a
+ * shared cache_dir the name is hashed from the file's identity, so every
+ * path leading to the same CDF shares one image.
+ */
+static char *cache_filename(const char *cdf_filename, const char *cache_dir,
+                            const CDF_CACHE_SOURCE *src)
+{
+  const char  *base, *s, *key, *end;
+  char        *result;
+  affy_uint32  h1, h2 = 0;
+  size_t       len;
+
+  if (cache_dir == NULL || *cache_dir == '\0')
+  {
+    len    = strlen(cdf_filename) + strlen(CDF_CACHE_SUFFIX) + 1;
+    result = h_malloc(len);
+    if (result != NULL)
+      sprintf(result, "%s%s", cdf_filename, CDF_CACHE_SUFFIX);
+
+    return (result);
+  }
+
+  /*
+   * FNV-1a hash keeps same-named CDFs apart.  Without inode numbers
+   * (win32) the best we have is the path itself.
+   */
+#ifdef AFFY_POSIX_ENV
+  key = (const char *)src;
+  end = key + 4 * sizeof(affy_uint32);
+#else
+  key = cdf_filename;
+  end = key + strlen(cdf_filename);
+#endif
+
+  h1 = (affy_uint32)fnv1a_hash(FNV1A_INIT, key, end - key);
+  for (s = key; s < end; s++)
+    h2 = (h2 * 31) + (unsigned char)*s;
+
+  base = strrchr(cdf_filename, DIRECTORY_SEPARATOR);
+  base = (base != NULL) ? base + 1 : cdf_filename;
+
+  len    = strlen(cache_dir) + strlen(base) + strlen(CDF_CACHE_SUFFIX) + 20;
+  result = h_malloc(len);
+  if (result != NULL)
+    sprintf(result, "%s%c%s.%08x%08x%s",
+            cache_dir, DIRECTORY_SEPARATOR, base,
+            (unsigned int)h1, (unsigned int)h2, CDF_CACHE_SUFFIX);
+
+  return (result);
+}
+
+/*
+ * Device, inode, size and mtime of the source CDF file, returns -1 if it
+ * can't stat it.  stat() follows symlinks, so a link to a CDF file finds
+ * the same image as the file itself.
+ */
+static int source_stat(const char *cdf_filename, CDF_CACHE_SOURCE *src)
+{
+  struct stat st;
+
+  if (stat(cdf_filename, &st) != 0)
+    return (-1);
+
+  /* no portable 64-bit type, split into two 32-bit halves */
+  memset(src, 0, sizeof(CDF_CACHE_SOURCE));
+  src->dev_lo   = CDF_CACHE_LO(st.st_dev);
+  src->dev_hi   = CDF_CACHE_HI(st.st_dev);
+  src->ino_lo   = CDF_CACHE_LO(st.st_ino);
+  src->ino_hi   = CDF_CACHE_HI(st.st_ino);
+  src->size_lo  = CDF_CACHE_LO(st.st_size);
+  src->size_hi  = CDF_CACHE_HI(st.st_size);
+  src->mtime_lo = CDF_CACHE_LO(st.st_mtime);
+  src->mtime_hi = CDF_CACHE_HI(st.st_mtime);
+
+  return (0);
+}
+
+/* Write zero padding so the next section starts aligned. */
+static int write_padded(FILE *fp, const void *buf, size_t len)
+{
+  static const char zeroes[CDF_CACHE_ALIGN] = { 0 };
+  size_t            pad = CDF_CACHE_PAD(len) - len;
+
+  if (len && fwrite(buf, 1, len, fp) != len)
+    return (-1);
+  if (pad && fwrite(zeroes, 1, pad, fp) != pad)
+    return (-1);
+
+  return (0);
+}
+
+/*
+ * affy_write_cdf_cache(): write a compiled image of cdf, which was loaded
+ *   from cdf_filename.  The image is placed next to the CDF file, or in
+ *   cache_dir if it is not NULL.  Failing to write the image (read-only
+ *   directory, full disk, ...) is not an error, the next run will simply
+ *   parse the CDF file again.
+ */
+void affy_write_cdf_cache(AFFY_CDFFILE *cdf,
+                          const char *cdf_filename,
+                          const char *cache_dir,
+                          AFFY_ERROR *err)
+{
+  CDF_CACHE_HEADER    hdr;
+  CDF_CACHE_PROBESET *ps_rec   = NULL;
+  CDF_CACHE_PROBE    *pool_rec = NULL;
+  affy_int32         *list     = NULL;
+  char               *names    = NULL;
+  char               *filename = NULL, *tmp_filename = NULL;
+  int                *mempool  = NULL;
+  FILE               *fp       = NULL;
+  size_t              numcells, names_len = 0;
+  affy_int32          i, j, numpool = 0;
+
+  assert(cdf          != NULL);
+  assert(cdf_filename != NULL);
+
+#ifdef STORE_XY_REF
+  /* xy_ref isn't stored in the image */
+  return;
+#endif
+
+  memset(&hdr, 0, sizeof(CDF_CACHE_HEADER));
+
+  if (source_stat(cdf_filename, &hdr.src) != 0)
+    return;
+
+  mempool = h_malloc(sizeof(int));
+  if (mempool == NULL)
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+
+  numcells = (size_t)cdf->numrows * cdf->numcols;
+
+  ps_rec = h_subcalloc(mempool, cdf->numprobesets + 1,
+                       sizeof(CDF_CACHE_PROBESET));
+  list   = h_subcalloc(mempool, cdf->numprobes + 1, sizeof(affy_int32));
+  if (ps_rec == NULL || list == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, done);
+
+  /* Probesets: names and the layout of their probe arrays */
+  for (i = 0; i < cdf->numprobesets; i++)
+  {
+    AFFY_PROBESET *ps = &cdf->probeset[i];
+
+    ps_rec[i].index     = ps->index;
+    ps_rec[i].numprobes = ps->numprobes;
+    ps_rec[i].name_ofs  = -1;
+    ps_rec[i].pool_ofs  = -1;
+
+    if (ps->name != NULL)
+    {
+      ps_rec[i].name_ofs = names_len;
+      names_len         += strlen(ps->name) + 1;
+    }
+
+    if (ps->probe != NULL)
+    {
+      ps_rec[i].pool_ofs = numpool;
+      numpool           += ps->numprobes;
+    }
+  }
+
+  /*
+   * Linear probe list.  Nearly every entry points into its probeset's
+   * probe array; any that don't (left behind when a probeset's array was
+   * replaced) get probe records of their own after the probeset arrays.
+   */
+  j = numpool;
+  for (i = 0; i < cdf->numprobes; i++)
+  {
+    AFFY_PROBE    *p  = cdf->probe[i];
+    AFFY_PROBESET *ps = p->ps;
+
+    if (ps != NULL && ps->probe != NULL &&
+        p >= ps->probe && p < ps->probe + ps->numprobes)
+      list[i] = ps_rec[ps - cdf->probeset].pool_ofs + (p - ps->probe);
+    else
+      list[i] = j++;
+  }
+
+  pool_rec = h_subcalloc(mempool, j + 1, sizeof(CDF_CACHE_PROBE));
+  names    = h_subcalloc(mempool, names_len + 1, 1);
+  if (pool_rec == NULL || names == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, done);
+
+  for (i = 0; i < cdf->numprobesets; i++)
+  {
+    AFFY_PROBESET *ps = &cdf->probeset[i];
+
+    if (ps->name != NULL)
+      strcpy(names + ps_rec[i].name_ofs, ps->name);
+  }
+
+  for (i = 0; i < cdf->numprobesets + cdf->numprobes; i++)
+  {
+    AFFY_PROBE      *p;
+    CDF_CACHE_PROBE *r;
+    affy_int32       k;
+
+    /* probeset arrays first, then the stragglers */
+    if (i < cdf->numprobesets)
+    {
+      AFFY_PROBESET *ps = &cdf->probeset[i];
+
+      for (k = 0; ps->probe != NULL && k < ps->numprobes; k++)
+      {
+        p       = &ps->probe[k];
+        r       = &pool_rec[ps_rec[i].pool_ofs + k];
+        r->index = p->index;
+        r->ps    = (p->ps != NULL) ? (affy_int32)(p->ps - cdf->probeset) : -1;
+        r->mm_x  = p->mm.x;
+        r->mm_y  = p->mm.y;
+        r->pm_x  = p->pm.x;
+        r->pm_y  = p->pm.y;
+      }
+    }
+    else
+    {
+      k = i - cdf->numprobesets;
+      if (list[k] < numpool)
+        continue;
+
+      p        = cdf->probe[k];
+      r        = &pool_rec[list[k]];
+      r->index = p->index;
+      r->ps    = (p->ps != NULL) ? (affy_int32)(p->ps - cdf->probeset) : -1;
+      r->mm_x  = p->mm.x;
+      r->mm_y  = p->mm.y;
+      r->pm_x  = p->pm.x;
+      r->pm_y  = p->pm.y;
+    }
+  }
+
+  memcpy(hdr.magic, CDF_CACHE_MAGIC, 8);
+  hdr.version          = CDF_CACHE_VERSION;
+  hdr.byte_order       = CDF_CACHE_BYTE_ORDER;
+  hdr.header_size      = sizeof(CDF_CACHE_HEADER);
+  hdr.path_len         = strlen(cdf_filename) + 1;
+  hdr.numrows          = cdf->numrows;
+  hdr.numcols          = cdf->numcols;
+  hdr.numprobes        = cdf->numprobes;
+  hdr.numprobesets     = cdf->numprobesets;
+  hdr.numqcunits       = cdf->numqcunits;
+  hdr.numpool          = j;
+  hdr.names_len        = names_len;
+  hdr.no_mm_flag       = cdf->no_mm_flag;
+  hdr.dupe_probes_flag = cdf->dupe_probes_flag;
+
+  filename = cache_filename(cdf_filename, cache_dir, &hdr.src);
+  if (filename == NULL)
+    AFFY_HANDLE_ERROR_GOTO("malloc failed", AFFY_ERROR_OUTOFMEM, err, done);
+  hattach(filename, mempool);
+
+  tmp_filename = h_suballoc(mempool, strlen(filename) + 32);
+  if (tmp_filename == NULL)
+    AFFY_HANDLE_ERROR_GOTO("malloc failed", AFFY_ERROR_OUTOFMEM, err, done);
+#ifdef AFFY_POSIX_ENV
+  sprintf(tmp_filename, "%s.%ld.tmp", filename, (long)getpid());
+#else
+  sprintf(tmp_filename, "%s.%ld.tmp", filename, (long)time(NULL));
+#endif
+
+  fp = fopen(tmp_filename, "wb");
+  if (fp == NULL)
+  {
+    info("Couldn't write compiled CDF file %s", filename);
+    goto done;
+  }
+
+  if (write_padded(fp, &hdr, sizeof(CDF_CACHE_HEADER))                    ||
+      write_padded(fp, cdf_filename, hdr.path_len)                        ||
+      write_padded(fp, cdf->cell_type[0], numcells)                       ||
+      write_padded(fp, cdf->seen_xy[0], numcells)                         ||
+      write_padded(fp, ps_rec,
+                   cdf->numprobesets * sizeof(CDF_CACHE_PROBESET))        ||
+      write_padded(fp, pool_rec, j * sizeof(CDF_CACHE_PROBE))             ||
+      write_padded(fp, list, cdf->numprobes * sizeof(affy_int32))         ||
+      write_padded(fp, names, names_len)                                  ||
+      fclose(fp) != 0)
+  {
+    if (fp != NULL)
+      fclose(fp);
+    fp = NULL;
+
+    remove(tmp_filename);
+    info("Couldn't write compiled CDF file %s", filename);
+    goto done;
+  }
+  fp = NULL;
+
+#ifdef AFFY_WIN32_ENV
+  /* rename() won't replace an existing file on win32 */
+  remove(filename);
+#endif
+
+  if (rename(tmp_filename, filename) != 0)
+  {
+    remove(tmp_filename);
+    info("Couldn't write compiled CDF file %s", filename);
+    goto done;
+  }
+
+  info("Wrote compiled CDF file %s", filename);
+
+done:
+  h_free(mempool);
+}
+
+/*
+ * affy_load_cdf_cache(): load a CDF from its compiled image, if there is
+ *   one and it is up to date with cdf_filename.  Returns NULL without
+ *   setting an error if there is no usable image.
+ */
+AFFY_CDFFILE *affy_load_cdf_cache(const char *cdf_filename,
+                                  const char *cache_dir,
+                                  char *chip_type,
+                                  AFFY_ERROR *err)
+{
+  CDF_CACHE_HEADER          hdr;
+  const CDF_CACHE_PROBESET *ps_rec;
+  const CDF_CACHE_PROBE    *pool_rec;
+  const affy_int32         *list;
+  const char               *image = NULL, *names;
+  char                     *filename = NULL;
+  AFFY_CDFFILE             *cdf = NULL;
+  AFFY_PROBE               *pool;
+  CDF_CACHE_SOURCE          src;
+  size_t                    image_len = 0, ofs, numcells;
+  affy_int32                i;
+#ifdef AFFY_POSIX_ENV
+  bool                      mapped = false;
+#endif
+
+  assert(cdf_filename != NULL);
+
+#ifdef STORE_XY_REF
+  return (NULL);
+#endif
+
+  if (source_stat(cdf_filename, &src))
+    return (NULL);
+
+  filename = cache_filename(cdf_filename, cache_dir, &src);
+  if (filename == NULL)
+    AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, NULL);
+
+  /* Map (or read) the whole image */
+#ifdef AFFY_POSIX_ENV
+  {
+    struct stat st;
+    int         fd;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+      goto done;
+
+    if (fstat(fd, &st) == 0 && st.st_size >= sizeof(CDF_CACHE_HEADER))
+    {
+      image_len = st.st_size;
+      image     = mmap(NULL, image_len, PROT_READ, MAP_SHARED, fd, 0);
+      if (image == MAP_FAILED)
+        image = NULL;
+      else
+        mapped = true;
+    }
+
+    close(fd);
+  }
+#else
+  {
+    FILE *fp;
+    long  len;
+
+    fp = fopen(filename, "rb");
+    if (fp == NULL)
+      goto done;
+
+    if (fseek(fp, 0, SEEK_END) == 0 &&
+        (len = ftell(fp)) >= (long)sizeof(CDF_CACHE_HEADER))
+    {
+      char *buf;
+
+      rewind(fp);
+      buf = h_malloc(len);
+      if (buf != NULL && fread(buf, 1, len, fp) == (size_t)len)
+      {
+        image     = buf;
+        image_len = len;
+      }
+      else
+        h_free(buf);
+    }
+
+    fclose(fp);
+  }
+#endif
+
+  if (image == NULL)
+    goto done;
+
+  /* Check that the image matches this build and this CDF file */
+  memcpy(&hdr, image, sizeof(CDF_CACHE_HEADER));
+
+  if (memcmp(hdr.magic, CDF_CACHE_MAGIC, 8) != 0           ||
+      hdr.version      != CDF_CACHE_VERSION                ||
+      hdr.byte_order   != CDF_CACHE_BYTE_ORDER             ||
+      hdr.header_size  != sizeof(CDF_CACHE_HEADER)         ||
+      memcmp(&hdr.src, &src, sizeof(CDF_CACHE_SOURCE))     ||
+      hdr.path_len     == 0                                ||
+      hdr.numprobes    < 0 || hdr.numprobesets < 0         ||
+      hdr.numpool      < 0)
+    goto done;
+
+  numcells = (size_t)hdr.numrows * hdr.numcols;
+
+  ofs = CDF_CACHE_PAD(sizeof(CDF_CACHE_HEADER)) + CDF_CACHE_PAD(hdr.path_len)
+      + 2 * CDF_CACHE_PAD(numcells)
+      + CDF_CACHE_PAD(hdr.numprobesets * sizeof(CDF_CACHE_PROBESET))
+      + CDF_CACHE_PAD(hdr.numpool * sizeof(CDF_CACHE_PROBE))
+      + CDF_CACHE_PAD(hdr.numprobes * sizeof(affy_int32))
+      + CDF_CACHE_PAD(hdr.names_len);
+
+  if (ofs != image_len)
+    goto done;
+
+  /* the stored path is informational, skip it */
+  ofs = CDF_CACHE_PAD(sizeof(CDF_CACHE_HEADER)) + CDF_CACHE_PAD(hdr.path_len);
+
+  info("Loading compiled CDF file %s", filename);
+
+  /* Build the CDF structure */
+  cdf = h_calloc(1, sizeof(AFFY_CDFFILE));
+  if (cdf == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, done);
+
+  if (chip_type != NULL)
+  {
+    cdf->array_type = h_strdup(chip_type);
+    if (cdf->array_type == NULL)
+      AFFY_HANDLE_ERROR_GOTO("strdup failed", AFFY_ERROR_OUTOFMEM, err, done);
+    hattach(cdf->array_type, cdf);
+  }
+
+  cdf->numrows          = hdr.numrows;
+  cdf->numcols          = hdr.numcols;
+  cdf->numprobes        = hdr.numprobes;
+  cdf->numprobesets     = hdr.numprobesets;
+  cdf->numqcunits       = hdr.numqcunits;
+  cdf->no_mm_flag       = hdr.no_mm_flag;
+  cdf->dupe_probes_flag = hdr.dupe_probes_flag;
+
+  /* cell_type and seen_xy */
+  cdf->cell_type = h_subcalloc(cdf, cdf->numcols + 1, sizeof(affy_uint8 *));
+  cdf->seen_xy   = h_subcalloc(cdf, cdf->numcols + 1, sizeof(affy_uint8 *));
+  if (cdf->cell_type == NULL || cdf->seen_xy == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, done);
+
+  cdf->cell_type[0] = h_suballoc(cdf->cell_type, numcells + 1);
+  cdf->seen_xy[0]   = h_suballoc(cdf->seen_xy, numcells + 1);
+  if (cdf->cell_type[0] == NULL || cdf->seen_xy[0] == NULL)
+    AFFY_HANDLE_ERROR_GOTO("malloc failed", AFFY_ERROR_OUTOFMEM, err, done);
+
+  memcpy(cdf->cell_type[0], image + ofs, numcells);
+  ofs += CDF_CACHE_PAD(numcells);
+  memcpy(cdf->seen_xy[0], image + ofs, numcells);
+  ofs += CDF_CACHE_PAD(numcells);
+
+  for (i = 1; i < cdf->numcols; i++)
+  {
+    cdf->cell_type[i] = cdf->cell_type[i-1] + cdf->numrows;
+    cdf->seen_xy[i]   = cdf->seen_xy[i-1] + cdf->numrows;
+  }
+
+  ps_rec    = (const CDF_CACHE_PROBESET *)(image + ofs);
+  ofs      += CDF_CACHE_PAD(hdr.numprobesets * sizeof(CDF_CACHE_PROBESET));
+  pool_rec  = (const CDF_CACHE_PROBE *)(image + ofs);
+  ofs      += CDF_CACHE_PAD(hdr.numpool * sizeof(CDF_CACHE_PROBE));
+  list      = (const affy_int32 *)(image + ofs);
+  ofs      += CDF_CACHE_PAD(hdr.numprobes * sizeof(affy_int32));
+  names     = image + ofs;
+
+  /* One allocation each for probesets, probes, the probe list and names */
+  cdf->probeset = h_subcalloc(cdf, cdf->numprobesets + 1,
+                              sizeof(AFFY_PROBESET));
+  pool          = h_subcalloc(cdf, hdr.numpool + 1, sizeof(AFFY_PROBE));
+  cdf->probe    = h_subcalloc(cdf, cdf->numprobes + 1, sizeof(AFFY_PROBE *));
+  if (cdf->probeset == NULL || pool == NULL || cdf->probe == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, done);
+
+  if (hdr.names_len)
+  {
+    char *name_blob = h_suballoc(cdf, hdr.names_len);
+
+    if (name_blob == NULL)
+      AFFY_HANDLE_ERROR_GOTO("malloc failed", AFFY_ERROR_OUTOFMEM, err, done);
+
+    memcpy(name_blob, names, hdr.names_len);
+    name_blob[hdr.names_len - 1] = '\0';
+    names = name_blob;
+  }
+
+  for (i = 0; i < cdf->numprobesets; i++)
+  {
+    const CDF_CACHE_PROBESET *r  = &ps_rec[i];
+    AFFY_PROBESET            *ps = &cdf->probeset[i];
+
+    if (r->numprobes < 0                                   ||
+        r->name_ofs < -1                                   ||
+        r->name_ofs >= (affy_int32)hdr.names_len           ||
+        r->pool_ofs < -1                                   ||
+        (r->pool_ofs < 0 && r->numprobes > 0)              ||
+        (r->pool_ofs >= 0 &&
+         r->numprobes > hdr.numpool - r->pool_ofs))
+      goto bad_image;
+
+    ps->index     = r->index;
+    ps->numprobes = r->numprobes;
+    ps->name      = (r->name_ofs >= 0)
+                    ? (char *)names + r->name_ofs : NULL;
+    ps->probe     = (r->pool_ofs >= 0) ? pool + r->pool_ofs : NULL;
+  }
+
+  for (i = 0; i < hdr.numpool; i++)
+  {
+    const CDF_CACHE_PROBE *r = &pool_rec[i];
+
+    /* probes without an MM carry their PM coordinates in mm */
+    if (r->ps < -1 || r->ps >= cdf->numprobesets                      ||
+        r->pm_x < 0 || (affy_uint32)r->pm_x >= hdr.numcols            ||
+        r->pm_y < 0 || (affy_uint32)r->pm_y >= hdr.numrows            ||
+        r->mm_x < 0 || (affy_uint32)r->mm_x >= hdr.numcols            ||
+        r->mm_y < 0 || (affy_uint32)r->mm_y >= hdr.numrows)
+      goto bad_image;
+
+    pool[i].index = r->index;
+    pool[i].ps    = (r->ps >= 0) ? &cdf->probeset[r->ps] : NULL;
+    pool[i].mm.x  = r->mm_x;
+    pool[i].mm.y  = r->mm_y;
+    pool[i].pm.x  = r->pm_x;
+    pool[i].pm.y  = r->pm_y;
+  }
+
+  for (i = 0; i < cdf->numprobes; i++)
+  {
+    if (list[i] < 0 || list[i] >= hdr.numpool)
+      goto bad_image;
+
+    cdf->probe[i] = pool + list[i];
+  }
+
+  affy_cdf_build_index(cdf, err);
+  AFFY_CHECK_ERROR_GOTO(err, done);
+  affy_cdf_build_name_index(cdf, err);
+  AFFY_CHECK_ERROR_GOTO(err, done);
+
+  info("Number of Probesets: %d", cdf->numprobesets);
+
+  goto done;
+
+bad_image:
+  info("Ignoring corrupt compiled CDF file %s", filename);
+  affy_free_cdf_file(cdf);
+  cdf = NULL;
+
+done:
+#ifdef AFFY_POSIX_ENV
+  if (mapped)
+    munmap((void *)image, image_len);
+#else
+  h_free((void *)image);
+#endif
+  h_free(filename);
+
+  if (err->type != AFFY_ERROR_NONE)
+  {
+    affy_free_cdf_file(cdf);
+    return (NULL);
+  }
+
+  return (cdf);
+}
@@ -0,0 +1,123 @@
+/**************************************************************************
+ *
+ * Filename:  cdf_index.c
+ *
+ * Purpose:   Build the flat (CSR) probe tables of a loaded CDF.
+ *
+ * Creation:  October 16th, 2026
+ *
+ * Author:    Eric A. Welsh
+ *
+ * Copyright: Copyright (C) 2026, Moffitt Cancer Center.
+ *            All rights reserved.
+ *
+ * Update History
+ * --------------
+ * 10/16/26: Creation (EAW)
+ *
+ **************************************************************************/
+
+#include <affy.h>
+
+/*
+ * affy_cdf_build_index(): fill in the flat probe tables of a loaded CDF,
+ * in cdf->probe[] order:
+ *
+ *   pm_cell[p], mm_cell[p]   linear cell index (x * numrows + y) of the
+ *                            PM/MM cells of probe p, the same index as
+ *                            affy_cel_value_at() and seen_xy[0][]
+ *   probe_ps[p]              probeset of probe p
+ *   ps_offset[ps]            first probe of probeset ps; its probes are
+ *                            ps_offset[ps] .. ps_offset[ps + 1] - 1
+ *   ps_flags[ps]             AFFY_PS_* bits of probeset ps; only
+ *                            AFFY_PS_CONTROL here, the exclusions and
+ *                            spike-ins loaders add the others
+ *
+ * so that the PM/MM gathers are walks over plain integer arrays rather
+ * than chases through cdf->probe[p]->pm and probeset[].probe[].  The
+ * loaders add probes to cdf->probe[] a probeset at a time, from the
+ * probeset's own probe[] slots, so probe ps_offset[ps] + i is slot i of
+ * probeset ps; that is checked here, since the per-probeset code (and
+ * --dump-probes, P/A calls, ...) rely on it.  Called once by the CDF
+ * loaders.
+ */
+void affy_cdf_build_index(AFFY_CDFFILE *cdf, AFFY_ERROR *err)
+{
+  AFFY_PROBE *probe;
+  affy_int32  p, ps, last_ps, i;
+
+  assert(cdf != NULL);
+
+  cdf->pm_cell   = h_subcalloc(cdf, cdf->numprobes + 1, sizeof(affy_uint32));
+  cdf->mm_cell   = h_subcalloc(cdf, cdf->numprobes + 1, sizeof(affy_uint32));
+  cdf->probe_ps  = h_subcalloc(cdf, cdf->numprobes + 1, sizeof(affy_int32));
+  cdf->ps_offset = h_subcalloc(cdf, cdf->numprobesets + 1,
+                               sizeof(affy_int32));
+  cdf->ps_flags  = h_subcalloc(cdf, cdf->numprobesets + 1,
+                               sizeof(affy_uint8));
+  if (cdf->pm_cell  == NULL || cdf->mm_cell   == NULL ||
+      cdf->probe_ps == NULL || cdf->ps_offset == NULL ||
+      cdf->ps_flags == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+  for (p = 0, last_ps = -1; p < cdf->numprobes; p++)
+  {
+    probe = cdf->probe[p];
+    ps    = (probe->ps != NULL) ? probe->ps->index : -1;
+
+    if (ps < 0 || ps < last_ps || ps >= cdf->numprobesets)
+      AFFY_HANDLE_ERROR_GOTO("CDF probes are not grouped by probeset",
+                             AFFY_ERROR_BADFORMAT,
+                             err,
+                             cleanup);
+
+    /* probesets without any probes start where the next one does */
+    for (last_ps++; last_ps <= ps; last_ps++)
+      cdf->ps_offset[last_ps] = p;
+    last_ps = ps;
+
+    cdf->pm_cell[p]  = (affy_uint32)probe->pm.x * cdf->numrows + probe->pm.y;
+    cdf->mm_cell[p]  = (affy_uint32)probe->mm.x * cdf->numrows + probe->mm.y;
+    cdf->probe_ps[p] = ps;
+  }
+
+  for (last_ps++; last_ps <= cdf->numprobesets; last_ps++)
+    cdf->ps_offset[last_ps] = cdf->numprobes;
+
+  /* each probeset's probes are its own slots, in order */
+  for (ps = 0; ps < cdf->numprobesets; ps++)
+  {
+    AFFY_PROBESET *pset = &cdf->probeset[ps];
+
+    for (p = cdf->ps_offset[ps], i = 0; p < cdf->ps_offset[ps + 1]; p++, i++)
+      if (i >= pset->numprobes || cdf->probe[p] != &pset->probe[i])
+        AFFY_HANDLE_ERROR_GOTO("CDF probes are not in probeset order",
+                               AFFY_ERROR_BADFORMAT,
+                               err,
+                               cleanup);
+  }
+
+  /*
+   * classify the names once, rather than once per probe per chip; blank
+   * spreadsheet CDFs are named later, by their loader
+   */
+  for (ps = 0; ps < cdf->numprobesets; ps++)
+    if (cdf->probeset[ps].name != NULL &&
+        affy_is_control_probeset(&cdf->probeset[ps]))
+      cdf->ps_flags[ps] |= AFFY_PS_CONTROL;
+
+  return;
+
+cleanup:
+  h_free(cdf->pm_cell);
+  h_free(cdf->mm_cell);
+  h_free(cdf->probe_ps);
+  h_free(cdf->ps_offset);
+  h_free(cdf->ps_flags);
+
+  cdf->pm_cell   = NULL;
+  cdf->mm_cell   = NULL;
+  cdf->probe_ps  = NULL;
+  cdf->ps_offset = NULL;
+  cdf->ps_flags  = NULL;
+}
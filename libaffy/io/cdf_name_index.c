@@ -0,0 +1,129 @@
+/**************************************************************************
+ *
+ * Filename:  cdf_name_index.c
+ *
+ * Purpose:   Hashed probeset name --> probeset index lookups on a CDF.
+ *
+ * Creation:  October 16th, 2026
+ *
+ * Author:    Eric A. Welsh
+ *
+ * Copyright: Copyright (C) 2026, Moffitt Cancer Center.
+ *            All rights reserved.
+ *
+ * Update History
+ * --------------
+ * 10/16/26: Creation (EAW)
+ *
+ **************************************************************************/
+
+#include <affy.h>
+
+static affy_uint32 hash_name(const char *name)
+{
+  return ((affy_uint32)fnv1a_hash_string(FNV1A_INIT, name));
+}
+
+/*
+ * affy_cdf_build_name_index(): hash the probeset names of a CDF.
+ *
+ * cdf->name_hash[] is an open-addressed (linear probing) table holding
+ * the first probeset of each distinct name, cdf->name_next[] chains any
+ * later probesets sharing that name.  Probesets without names (blank
+ * spreadsheet CDFs, before their loader names them) are left out.
+ *
+ * The CDF loaders call this once the names are final; anything that
+ * renames probesets afterwards must call it again.
+ */
+void affy_cdf_build_name_index(AFFY_CDFFILE *cdf, AFFY_ERROR *err)
+{
+  affy_uint32 size, slot, mask;
+  affy_int32  ps, last;
+  char       *name;
+
+  assert(cdf != NULL);
+
+  h_free(cdf->name_hash);
+  h_free(cdf->name_next);
+  cdf->name_hash = NULL;
+  cdf->name_next = NULL;
+
+  /* at most half full */
+  for (size = 16; size < 2 * (affy_uint32)cdf->numprobesets; size <<= 1)
+    ;
+  mask = size - 1;
+
+  cdf->name_hash = h_subcalloc(cdf, size, sizeof(affy_int32));
+  cdf->name_next = h_subcalloc(cdf, cdf->numprobesets + 1,
+                               sizeof(affy_int32));
+  if (cdf->name_hash == NULL || cdf->name_next == NULL)
+  {
+    h_free(cdf->name_hash);
+    h_free(cdf->name_next);
+    cdf->name_hash = NULL;
+    cdf->name_next = NULL;
+
+    AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
+  }
+
+  memset(cdf->name_hash, 0xff, size * sizeof(affy_int32));
+  memset(cdf->name_next, 0xff, (cdf->numprobesets + 1) * sizeof(affy_int32));
+
+  for (ps = 0; ps < cdf->numprobesets; ps++)
+  {
+    name = cdf->probeset[ps].name;
+    if (name == NULL)
+      continue;
+
+    for (slot = hash_name(name) & mask;
+         cdf->name_hash[slot] >= 0;
+         slot = (slot + 1) & mask)
+    {
+      if (strcmp(cdf->probeset[cdf->name_hash[slot]].name, name) == 0)
+        break;
+    }
+
+    if (cdf->name_hash[slot] < 0)
+    {
+      cdf->name_hash[slot] = ps;
+      continue;
+    }
+
+    /* duplicate name, append to the end of its chain */
+    for (last = cdf->name_hash[slot];
+         cdf->name_next[last] >= 0;
+         last = cdf->name_next[last])
+      ;
+    cdf->name_next[last] = ps;
+  }
+
+  cdf->name_hash_mask = mask;
+}
+
+/*
+ * affy_cdf_find_probeset(): index of the first probeset named name, or -1
+ * if there is none.  Any others with the same name follow it in
+ * cdf->name_next[], ending with -1.  Read-only, so threads can share
+ * the CDF.
+ */
+affy_int32 affy_cdf_find_probeset(AFFY_CDFFILE *cdf, const char *name)
+{
+  affy_uint32 slot;
+  affy_int32  ps;
+
+  assert(cdf  != NULL);
+  assert(name != NULL);
+
+  if (cdf->name_hash == NULL)
+    return (-1);
+
+  for (slot = hash_name(name) & cdf->name_hash_mask;
+       (ps = cdf->name_hash[slot]) >= 0;
+       slot = (slot + 1) & cdf->name_hash_mask)
+  {
+    if (strcmp(cdf->probeset[ps].name, name) == 0)
+      return (ps);
+  }
+
+  return (-1);
+}
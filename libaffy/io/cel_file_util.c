@@ -19,6 +19,9 @@
  * 03/11/08: New error handling scheme (AMH)
  * 09/20/10: Pooled memory allocator (AMH)
  * 05/10/13: Added affy_mostly_free_cel_file() (EAW)
+ * 10/16/26: Added compact float32 storage, affy_alloc_cel_data() (EAW)
+ * 10/16/26: Added affy_sort_cell_list() for sparse masks/outliers (EAW)
+ * 10/16/26: Removed the process-wide affy_set_cel_storage() (EAW)
  *
  **************************************************************************/
 
@@ -35,16 +38,125 @@ void affy_mostly_free_cel_file(AFFY_CELFILE *cf)
 {
   if (cf)
   {
-    if (cf->data)    h_free(cf->data);
+    affy_free_cel_data(cf);
+
     if (cf->mask)    h_free(cf->mask);
     if (cf->outlier) h_free(cf->outlier);
     
-    cf->data    = NULL;
     cf->mask    = NULL;
     cf->outlier = NULL;
   }
 }
 
+/*
+ * affy_alloc_cel_data(): allocate zeroed cell storage for cf, using its
+ * numrows and numcols, in the given layout.  AFFY_CEL_STORAGE_CELLS
+ * keeps an AFFY_CELL of doubles per cell; AFFY_CEL_STORAGE_COMPACT keeps
+ * one float plane per field instead, which takes half the memory (less
+ * with STORE_CEL_QC), at the cost of rounding intensities to float.
+ */
+void affy_alloc_cel_data(AFFY_CELFILE *cf, int storage, AFFY_ERROR *err)
+{
+  size_t n;
+  int    i;
+
+  assert(cf != NULL);
+
+  n = (size_t)cf->numrows * cf->numcols;
+
+  cf->data      = NULL;
+  cf->intensity = NULL;
+
+  if (storage == AFFY_CEL_STORAGE_COMPACT)
+  {
+    cf->intensity = h_subcalloc(cf, n, sizeof(float));
+    if (cf->intensity == NULL)
+      AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
+
+#ifdef STORE_CEL_QC
+    cf->stddev    = h_subcalloc(cf->intensity, n, sizeof(float));
+    cf->numpixels = h_subcalloc(cf->intensity, n, sizeof(affy_int16));
+    if (cf->stddev == NULL || cf->numpixels == NULL)
+    {
+      affy_free_cel_data(cf);
+      AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
+    }
+#endif
+
+    return;
+  }
+
+  cf->data = h_suballoc(cf, cf->numcols * sizeof(AFFY_CELL *));
+  if (cf->data == NULL)
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+
+  cf->data[0] = h_subcalloc(cf->data, n, sizeof(AFFY_CELL));
+  if (cf->data[0] == NULL)
+  {
+    affy_free_cel_data(cf);
+    AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
+  }
+
+  for (i = 1; i < cf->numcols; i++)
+    cf->data[i] = cf->data[0] + (i * cf->numrows);
+}
+
+/* free the cell storage (either layout) */
+void affy_free_cel_data(AFFY_CELFILE *cf)
+{
+  if (cf == NULL)
+    return;
+
+  /* the QC planes are children of the intensity plane */
+  h_free(cf->data);
+  h_free(cf->intensity);
+
+  cf->data      = NULL;
+  cf->intensity = NULL;
+#ifdef STORE_CEL_QC
+  cf->stddev    = NULL;
+  cf->numpixels = NULL;
+#endif
+}
+
+static int compare_cells(const void *a, const void *b)
+{
+  affy_uint32 i = *(const affy_uint32 *)a;
+  affy_uint32 j = *(const affy_uint32 *)b;
+
+  return ((i > j) - (i < j));
+}
+
+/*
+ * affy_sort_cell_list(): finish a mask or outlier list of n linear cell
+ * indices, as read from the CEL file: sort it and drop duplicate cells.
+ * Returns the number of cells left; an empty list is freed and set to
+ * NULL.
+ */
+affy_uint32 affy_sort_cell_list(affy_uint32 **cells, affy_uint32 n)
+{
+  affy_uint32 *list = *cells;
+  affy_uint32  i, j;
+
+  if (n == 0)
+  {
+    h_free(list);
+    *cells = NULL;
+
+    return (0);
+  }
+
+  qsort(list, n, sizeof(affy_uint32), compare_cells);
+
+  for (i = 1, j = 1; i < n; i++)
+  {
+    if (list[i] != list[j - 1])
+      list[j++] = list[i];
+  }
+
+  return (j);
+}
+
 /* 
  * affy_matrix_from_cel(): Extract cell value matrix from an AFFY_CELFILE
  *
@@ -80,7 +192,7 @@ double **affy_matrix_from_cel(AFFY_CELFILE *cf, AFFY_ERROR *err)
    */
   for (y = 0; y < cf->numrows; y++)
     for (x = 0; x < cf->numcols; x++)
-      matrix[y][x] = cf->data[y][x].value;
+      matrix[y][x] = affy_cel_value(cf, y, x);
 
   return (matrix);
 }
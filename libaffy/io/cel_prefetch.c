@@ -0,0 +1,440 @@
+/**************************************************************************
+ *
+ * Filename:  cel_prefetch.c
+ *
+ * Purpose:   Load a list of CEL files with a bounded pool of worker
+ *            threads, decoding the next few files in the background while
+ *            the caller processes the current one.
+ *
+ * Creation:  October 16th, 2026
+ *
+ * Author:    Eric A. Welsh
+ *
+ * Copyright: Copyright (C) 2026, Moffitt Cancer Center.
+ *            All rights reserved.
+ *
+ * Update History
+ * --------------
+ * 10/16/26: Creation (EAW)
+ * 10/16/26: open each file once, the array type comes from the header
+ *           scan done while loading (EAW)
+ * 10/16/26: take the headers from a CEL header index, if given (EAW)
+ * 10/16/26: workers load into a halloc pool per file, which is moved
+ *           into the prefetch context when the chip is claimed (EAW)
+ * 10/16/26: workers load quietly, each file is reported when it is
+ *           claimed (EAW)
+ * 10/16/26: cell layout is an argument, not a process-wide setting (EAW)
+ *
+ **************************************************************************/
+
+#include <affy.h>
+
+#ifdef AFFY_HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+/*
+ * Loaded chips are always handed back in filelist order.  A worker may
+ * only start on file i once i < (next file to hand back) + depth, so at
+ * most depth decoded-but-unclaimed chips exist at any one time.
+ *
+ * Each file is loaded into a halloc pool (see hpool.c) of its own by
+ * exactly one worker, which queues the chip and its array type to move
+ * into the prefetch context.  The caller's thread carries out the move
+ * with h_pool_commit() when it claims the chip, so no halloc tree is
+ * ever touched by two threads at once.  Anything loaded but never
+ * claimed belongs to the prefetch context and is freed with it.
+ *
+ * Workers load quietly, so their output isn't interleaved with each
+ * other's or with the caller's; the caller's thread reports each file
+ * as it claims it, in filelist order.
+ *
+ * Without pthreads, or with num_threads <= 1, files are simply loaded
+ * one at a time as they are requested.
+ */
+
+typedef enum
+{
+  PREFETCH_PENDING = 0,
+  PREFETCH_LOADING,
+  PREFETCH_DONE
+} PREFETCH_STATE;
+
+typedef struct
+{
+  PREFETCH_STATE  state;
+  hpool_t        *pool;           /* loaded results, until committed  */
+  AFFY_CHIP      *chip;
+  char           *chip_type;
+  AFFY_ERROR      err;
+} PREFETCH_SLOT;
+
+struct affy_cel_prefetch_s
+{
+  char          **filelist;
+  AFFY_CEL_INDEX *idx;            /* headers scanned up front, or NULL */
+  int             num_files;
+  int             num_threads;
+  int             depth;
+  int             storage;        /* AFFY_CEL_STORAGE_* of the chips  */
+
+  int             next_issue;     /* next file a worker should load   */
+  int             next_claim;     /* next file to hand to the caller  */
+  bool            shutdown;
+
+  PREFETCH_SLOT  *slots;
+
+#ifdef AFFY_HAVE_PTHREADS
+  pthread_t      *threads;
+  int             num_started;
+  pthread_mutex_t lock;
+  pthread_cond_t  slot_done;      /* a slot changed to PREFETCH_DONE  */
+  pthread_cond_t  slot_claimed;   /* the caller claimed a slot        */
+#endif
+};
+
+/*
+ * Load one file (array type + CEL data) into its slot's pool.  With an
+ * index, the file's header is already scanned and loading starts from
+ * its intensities; the array type is copied, since the index keeps its
+ * own.  The results are queued to move into pf, the caller's tree.
+ */
+static void load_slot(AFFY_CEL_PREFETCH *pf, int i, bool quiet)
+{
+  PREFETCH_SLOT   *slot = pf->slots + i;
+  AFFY_ERROR      *err  = &slot->err;
+  AFFY_CEL_HEADER  hdr, *ihdr;
+
+  err->type    = AFFY_ERROR_NONE;
+  err->handler = NULL;
+
+  slot->pool = h_pool_create();
+  if (slot->pool == NULL)
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+
+  if (pf->idx != NULL)
+  {
+    ihdr = pf->idx->headers + i;
+
+    if (ihdr->err.type != AFFY_ERROR_NONE)
+    {
+      affy_clone_error(err, &ihdr->err);
+      return;
+    }
+
+    slot->chip_type = h_strdup(ihdr->array_type);
+    if (slot->chip_type == NULL)
+      AFFY_HANDLE_ERROR_VOID("strdup failed", AFFY_ERROR_OUTOFMEM, err);
+
+    slot->chip = affy_load_chip_indexed(pf->filelist[i], ihdr, pf->storage,
+                                        quiet, err);
+  }
+  else
+  {
+    hdr.format     = AFFY_CEL_FORMAT_UNKNOWN;
+    hdr.array_type = NULL;
+
+    slot->chip      = affy_load_chip_indexed(pf->filelist[i], &hdr,
+                                             pf->storage, quiet, err);
+    slot->chip_type = hdr.array_type;
+  }
+
+  /* until committed, the pool owns them (and frees them along with it) */
+  if ((slot->chip_type != NULL &&
+       h_pool_defer_attach(slot->pool, slot->chip_type, pf) != 0) ||
+      (slot->chip != NULL &&
+       h_pool_defer_attach(slot->pool, slot->chip, pf) != 0))
+  {
+    /* nothing may be committed now; the pool frees what it holds */
+    affy_free_chip(slot->chip);
+    if (slot->chip_type != NULL)
+      hattach(slot->chip_type, slot->pool);
+    h_free(slot->pool);
+    slot->pool      = NULL;
+    slot->chip      = NULL;
+    slot->chip_type = NULL;
+
+    AFFY_HANDLE_ERROR_VOID("realloc failed", AFFY_ERROR_OUTOFMEM, err);
+  }
+}
+
+/*
+ * Move a loaded slot's results into pf, from the thread that owns pf,
+ * once the worker is done with the slot.
+ */
+static void commit_slot(PREFETCH_SLOT *slot)
+{
+  if (slot->pool == NULL)
+    return;
+
+  h_pool_commit(slot->pool);
+  h_free(slot->pool);
+  slot->pool = NULL;
+}
+
+#ifdef AFFY_HAVE_PTHREADS
+static void *prefetch_worker(void *arg)
+{
+  AFFY_CEL_PREFETCH *pf = arg;
+  int                i;
+
+  pthread_mutex_lock(&pf->lock);
+
+  for (;;)
+  {
+    while (!pf->shutdown &&
+           pf->next_issue < pf->num_files &&
+           pf->next_issue >= pf->next_claim + pf->depth)
+      pthread_cond_wait(&pf->slot_claimed, &pf->lock);
+
+    if (pf->shutdown || pf->next_issue >= pf->num_files)
+      break;
+
+    i = pf->next_issue++;
+    pf->slots[i].state = PREFETCH_LOADING;
+
+    pthread_mutex_unlock(&pf->lock);
+
+    load_slot(pf, i, true);
+
+    pthread_mutex_lock(&pf->lock);
+
+    pf->slots[i].state = PREFETCH_DONE;
+    pthread_cond_broadcast(&pf->slot_done);
+  }
+
+  pthread_mutex_unlock(&pf->lock);
+
+  return (NULL);
+}
+#endif
+
+/*
+ * affy_cel_prefetch_start(): begin loading the given NULL-terminated
+ *   list of CEL files using up to num_threads worker threads, keeping at
+ *   most depth loaded chips waiting to be claimed.  depth <= 0 defaults
+ *   to twice the number of threads.  idx, if not NULL, is the header
+ *   index of the same filelist (affy_scan_cel_headers()), and must
+ *   outlive the prefetch context.  The chips' cells are stored in the
+ *   given AFFY_CEL_STORAGE_* layout, normally the chipset's cel_storage.
+ */
+AFFY_CEL_PREFETCH *affy_cel_prefetch_start(char **filelist,
+                                           AFFY_CEL_INDEX *idx,
+                                           int num_threads,
+                                           int depth,
+                                           int storage,
+                                           AFFY_ERROR *err)
+{
+  AFFY_CEL_PREFETCH *pf;
+  char             **p;
+
+  assert(filelist != NULL);
+
+  pf = h_calloc(1, sizeof(AFFY_CEL_PREFETCH));
+  if (pf == NULL)
+    AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, NULL);
+
+  for (p = filelist; *p != NULL; p++)
+    pf->num_files++;
+
+  if (num_threads < 1)
+    num_threads = 1;
+  if (depth <= 0)
+    depth = 2 * num_threads;
+  if (num_threads > depth)
+    num_threads = depth;
+  if (num_threads > pf->num_files)
+    num_threads = pf->num_files;
+
+  assert(idx == NULL || idx->num_files == pf->num_files);
+
+  pf->filelist    = filelist;
+  pf->idx         = idx;
+  pf->num_threads = num_threads;
+  pf->depth       = depth;
+  pf->storage     = storage;
+  pf->next_issue  = 0;
+  pf->next_claim  = 0;
+  pf->shutdown    = false;
+
+  pf->slots = h_subcalloc(pf, pf->num_files + 1, sizeof(PREFETCH_SLOT));
+  if (pf->slots == NULL)
+  {
+    h_free(pf);
+    AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, NULL);
+  }
+
+#ifdef AFFY_HAVE_PTHREADS
+  if (pf->num_threads > 1)
+  {
+    int i;
+
+    pf->threads = h_subcalloc(pf, pf->num_threads, sizeof(pthread_t));
+    if (pf->threads == NULL)
+    {
+      h_free(pf);
+      AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, NULL);
+    }
+
+    pthread_mutex_init(&pf->lock, NULL);
+    pthread_cond_init(&pf->slot_done, NULL);
+    pthread_cond_init(&pf->slot_claimed, NULL);
+
+    for (i = 0; i < pf->num_threads; i++)
+    {
+      if (pthread_create(&pf->threads[i], NULL, prefetch_worker, pf) != 0)
+        break;
+
+      pf->num_started++;
+    }
+
+    /* couldn't start any threads, fall back to loading serially */
+    if (pf->num_started == 0)
+    {
+      pthread_mutex_destroy(&pf->lock);
+      pthread_cond_destroy(&pf->slot_done);
+      pthread_cond_destroy(&pf->slot_claimed);
+
+      pf->num_threads = 1;
+    }
+  }
+  else
+    pf->num_threads = 1;
+#else
+  pf->num_threads = 1;
+#endif
+
+  if (pf->num_threads > 1)
+    info("Loading CEL files with %d threads", pf->num_threads);
+
+  return (pf);
+}
+
+/*
+ * affy_cel_prefetch_next(): claim the next chip in filelist order,
+ *   waiting for it to finish loading if necessary.  The caller takes
+ *   ownership of the returned chip and, if chip_type is not NULL, of the
+ *   array type string read from the CEL header.  Returns NULL with no
+ *   error once the list is exhausted.
+ */
+AFFY_CHIP *affy_cel_prefetch_next(AFFY_CEL_PREFETCH *pf,
+                                  char **chip_type,
+                                  AFFY_ERROR *err)
+{
+  PREFETCH_SLOT *slot;
+  AFFY_CHIP     *chip;
+
+  assert(pf != NULL);
+
+  if (chip_type != NULL)
+    *chip_type = NULL;
+
+  if (pf->next_claim >= pf->num_files)
+    return (NULL);
+
+  slot = pf->slots + pf->next_claim;
+
+#ifdef AFFY_HAVE_PTHREADS
+  if (pf->num_threads > 1)
+  {
+    pthread_mutex_lock(&pf->lock);
+
+    while (slot->state != PREFETCH_DONE)
+      pthread_cond_wait(&pf->slot_done, &pf->lock);
+
+    pf->next_claim++;
+    pthread_cond_broadcast(&pf->slot_claimed);
+
+    pthread_mutex_unlock(&pf->lock);
+  }
+  else
+#endif
+  {
+    load_slot(pf, pf->next_claim, false);
+    slot->state = PREFETCH_DONE;
+
+    pf->next_claim++;
+  }
+
+  commit_slot(slot);
+
+  /* the caller owns them from here on */
+  if (slot->chip != NULL)
+    hattach(slot->chip, NULL);
+  if (slot->chip_type != NULL)
+    hattach(slot->chip_type, NULL);
+
+  chip            = slot->chip;
+  slot->chip      = NULL;
+
+  if (slot->err.type != AFFY_ERROR_NONE)
+  {
+    if (chip != NULL)
+      affy_free_chip(chip);
+    h_free(slot->chip_type);
+    slot->chip_type = NULL;
+
+    affy_clone_error(err, &slot->err);
+    if (err->handler != NULL)
+      (err->handler)(err);
+
+    return (NULL);
+  }
+
+  if (chip_type != NULL)
+    *chip_type = slot->chip_type;
+  else
+    h_free(slot->chip_type);
+  slot->chip_type = NULL;
+
+  /* what a quiet load didn't say */
+  if (pf->num_threads > 1)
+  {
+    info("Loading CEL file %s", chip->filename);
+    info("CEL Dimensions: %" AFFY_PRNd32 "x%" AFFY_PRNd32,
+         chip->cel->numcols,
+         chip->cel->numrows);
+  }
+
+  return (chip);
+}
+
+/*
+ * affy_cel_prefetch_free(): stop the workers and release any chips that
+ *   were loaded but never claimed.
+ */
+void affy_cel_prefetch_free(AFFY_CEL_PREFETCH *pf)
+{
+  int i;
+
+  if (pf == NULL)
+    return;
+
+#ifdef AFFY_HAVE_PTHREADS
+  if (pf->num_threads > 1)
+  {
+    pthread_mutex_lock(&pf->lock);
+    pf->shutdown = true;
+    pthread_cond_broadcast(&pf->slot_claimed);
+    pthread_mutex_unlock(&pf->lock);
+
+    for (i = 0; i < pf->num_started; i++)
+      pthread_join(pf->threads[i], NULL);
+
+    pthread_mutex_destroy(&pf->lock);
+    pthread_cond_destroy(&pf->slot_done);
+    pthread_cond_destroy(&pf->slot_claimed);
+  }
+#endif
+
+  /* unclaimed chips; their array types go along with pf */
+  for (i = pf->next_claim; i < pf->num_files; i++)
+  {
+    commit_slot(pf->slots + i);
+
+    if (pf->slots[i].chip)
+      affy_free_chip(pf->slots[i].chip);
+  }
+
+  h_free(pf);
+}
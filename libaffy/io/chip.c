@@ -14,6 +14,10 @@
  * Update History
  * --------------
  * 04/11/11: Creation (EAW)
+ * 10/16/26: clone either cell storage layout (EAW)
+ * 10/16/26: a cloned chip shares the original's backing store (EAW)
+ * 10/16/26: copy the sparse mask/outlier lists (EAW)
+ * 10/16/26: initialize chip->qnorm_rank (EAW)
  *
  **************************************************************************/
 
@@ -32,7 +36,7 @@ AFFY_CHIP *affy_clone_chip(AFFY_CHIP *cur_chip, AFFY_ERROR *err)
   AFFY_CELFILE *cur_cel = cur_chip->cel;
   AFFY_CHIP    *chip = NULL;
   AFFY_CELFILE *cf   = NULL;
-  int           j, nbytes;
+  size_t        n;
 
   assert(cur_chip != NULL);
 
@@ -62,50 +66,49 @@ AFFY_CHIP *affy_clone_chip(AFFY_CHIP *cur_chip, AFFY_ERROR *err)
   cf->mask        = NULL;
   cf->outlier     = NULL;
 
-  nbytes = numbytes(cf->numcols);
+  affy_alloc_cel_data(cf,
+                      cur_cel->intensity ? AFFY_CEL_STORAGE_COMPACT
+                                         : AFFY_CEL_STORAGE_CELLS,
+                      err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
 
-  cf->data = h_subcalloc(cf, cf->numrows, sizeof(AFFY_CELL *));
-  if (cf->data == NULL)
-    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
-
-  cf->data[0] = h_subcalloc(cf->data, 
-                            cf->numcols * cf->numrows, 
-                            sizeof(AFFY_CELL));
-  if (cf->data[0] == NULL)
-    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+  if (cur_cel->mask)
+  {
+    n = cf->nummasks * sizeof(affy_uint32);
 
-  cf->mask = h_subcalloc(cf, cf->numrows, sizeof(bitstr_t *));
-  if (cf->mask == NULL)
-    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+    cf->mask = h_suballoc(cf, n);
+    if (cf->mask == NULL)
+      AFFY_HANDLE_ERROR_GOTO("malloc failed", AFFY_ERROR_OUTOFMEM, err,
+                             cleanup);
+    memcpy(cf->mask, cur_cel->mask, n);
+  }
 
-  cf->mask[0] = h_subcalloc(cf->mask, nbytes * cf->numrows, sizeof(bitstr_t));
-  if (cf->mask[0] == NULL)
-    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+  if (cur_cel->outlier)
+  {
+    n = cf->numoutliers * sizeof(affy_uint32);
 
-  cf->outlier = h_subcalloc(cf, cf->numrows, sizeof(bitstr_t *));
-  if (cf->outlier == NULL)
-    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+    cf->outlier = h_suballoc(cf, n);
+    if (cf->outlier == NULL)
+      AFFY_HANDLE_ERROR_GOTO("malloc failed", AFFY_ERROR_OUTOFMEM, err,
+                             cleanup);
+    memcpy(cf->outlier, cur_cel->outlier, n);
+  }
 
-  cf->outlier[0] = h_subcalloc(cf->outlier, 
-                               nbytes * cf->numrows, 
-                               sizeof(bitstr_t));
-  if (cf->outlier[0] == NULL)
-    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
-  
-  for (j = 1; j < cf->numrows; j++)
+  /* copy cel arrays */
+  if (cur_cel->intensity)
   {
-    cf->data[j]    = cf->data[0] + (j * cf->numcols);
-    cf->mask[j]    = cf->mask[0] + (j * nbytes);
-    cf->outlier[j] = cf->outlier[0] + (j * nbytes);
+    memcpy(cf->intensity, cur_cel->intensity,
+           cf->numcols * cf->numrows * sizeof(float));
+#ifdef STORE_CEL_QC
+    memcpy(cf->stddev, cur_cel->stddev,
+           cf->numcols * cf->numrows * sizeof(float));
+    memcpy(cf->numpixels, cur_cel->numpixels,
+           cf->numcols * cf->numrows * sizeof(affy_int16));
+#endif
   }
-  
-  /* copy cel arrays */
-  memcpy(cf->data[0], cur_cel->data[0],
-         cf->numcols * cf->numrows * sizeof(AFFY_CELL));
-  memcpy(cf->mask[0], cur_cel->mask[0],
-         nbytes * cf->numrows * sizeof(bitstr_t));
-  memcpy(cf->outlier[0], cur_cel->outlier[0],
-         nbytes * cf->numrows * sizeof(bitstr_t));
+  else
+    memcpy(cf->data[0], cur_cel->data[0],
+           cf->numcols * cf->numrows * sizeof(AFFY_CELL));
 
   /* initialize/point chip stuff */
   chip->cdf                   = cur_chip->cdf;
@@ -115,6 +118,8 @@ AFFY_CHIP *affy_clone_chip(AFFY_CHIP *cur_chip, AFFY_ERROR *err)
   chip->probe_set             = NULL;
   chip->probe_set_call_pvalue = NULL;
   chip->pm                    = NULL;
+  chip->qnorm_rank            = NULL;
+  chip->store                 = cur_chip->store;
 
   hattach(chip->cel, chip);
 
@@ -16,6 +16,8 @@
  * 01/08/09: Creation (SAE)
  * 09/20/10: Pooled memory allocator (AMH)
  * 04/11/11: Added affy_clone_chipset_one_chip() (EAW)
+ * 10/16/26: clones don't own the backing store (EAW)
+ * 10/16/26: clones load CEL files in the same layout (EAW)
  *
  **************************************************************************/
 
@@ -57,6 +59,11 @@ AFFY_CHIPSET *affy_clone_chipset(AFFY_CHIPSET *cur_chip,
   cs->numcols    = cur_chip->numcols;
   cs->array_type = cur_chip->array_type;
 
+  /* the original chipset releases it */
+  cs->store      = NULL;
+
+  cs->cel_storage = cur_chip->cel_storage;
+
   return (cs);
 
  cleanup:
@@ -103,6 +110,11 @@ AFFY_CHIPSET *affy_clone_chipset_one_chip(AFFY_CHIPSET *cur_chip,
   cs->numcols    = cur_chip->numcols;
   cs->array_type = cur_chip->array_type;
 
+  /* the original chipset releases it */
+  cs->store      = NULL;
+
+  cs->cel_storage = cur_chip->cel_storage;
+
   return (cs);
 
  cleanup:
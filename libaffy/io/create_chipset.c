@@ -25,6 +25,10 @@
  * 08/13/19: fix AFFY_HANDLE_ERROR_VOID where AFFY_HANDLE_ERROR needed (EAW)
  * 08/12/20: pass flags to affy_create_chipset() (EAW)
  * 01/10/24: swap create_blank_generic_cdf() numrows/numcols (EAW)
+ * 10/16/26: build the flat probe tables of the generic cdf (EAW)
+ * 10/16/26: optional out-of-core backing store (EAW)
+ * 10/16/26: CEL storage layout from use_compact_cel (EAW)
+ * 10/16/26: build the (empty) name index of the generic cdf (EAW)
  *
  **************************************************************************/
 
@@ -78,6 +82,22 @@ AFFY_CHIPSET *affy_create_chipset(unsigned int max_chips,
   cs->mp_allocated_flag = 0;
   cs->mp_populated_flag = 0;
 
+  /* how the chips loaded into it store their cells */
+  cs->cel_storage = AFFY_CEL_STORAGE_CELLS;
+  if (f != NULL && f->use_compact_cel)
+    cs->cel_storage = AFFY_CEL_STORAGE_COMPACT;
+
+  /* spill per-chip arrays past the memory budget to disk */
+  cs->store = NULL;
+  if (f != NULL && f->memory_budget_mb > 0)
+  {
+    cs->store = affy_backing_store_create(f->memory_budget_mb,
+                                          f->spill_directory,
+                                          err);
+    AFFY_CHECK_ERROR_GOTO(err, cleanup);
+    hattach(cs->store, cs);
+  }
+
   return (cs);
 
 cleanup:
@@ -210,6 +230,12 @@ AFFY_CDFFILE *create_blank_generic_cdf(unsigned int max_chips,
     cdf->probe[i]->ps    = &(cdf->probeset[i]);
   }
 
+  affy_cdf_build_index(cdf, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+  /* no names yet, whoever names the probesets builds it again */
+  affy_cdf_build_name_index(cdf, err);
+
 cleanup:
 
   if (err->type != AFFY_ERROR_NONE)
@@ -265,6 +291,8 @@ AFFY_CHIPSET *create_blank_generic_chipset(unsigned int max_chips,
   cs->mp_allocated_flag = 0;
   cs->mp_populated_flag = 0;
 
+  cs->cel_storage = AFFY_CEL_STORAGE_CELLS;
+
   return (cs);
 
 cleanup:
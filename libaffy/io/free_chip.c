@@ -17,11 +17,33 @@
  * 05/27/05: Creation (AMH)
  * 09/20/10: Pooled memory allocator (AMH)
  * 05/10/13: Added affy_mostly_free_chip() (EAW)
+ * 10/16/26: leave spilled arrays to the backing store, release the
+ *           store with its chipset (EAW)
+ * 10/16/26: free chip->qnorm_rank (EAW)
+ * 10/16/26: release per-chip arrays through the backing store (EAW)
  *
  **************************************************************************/
 
 #include <affy.h>
 
+/* Release the arrays allocated through the chip's backing store */
+static void free_store_arrays(AFFY_CHIP *ch)
+{
+  if (ch->cdf == NULL)
+    return;
+
+  affy_backing_store_free_array(ch->store, ch->probe_set,
+                                ch->cdf->numprobesets, sizeof(double));
+  affy_backing_store_free_array(ch->store, ch->pm,
+                                ch->cdf->numprobes, sizeof(double));
+  affy_backing_store_free_array(ch->store, ch->qnorm_rank,
+                                ch->cdf->numprobes, sizeof(affy_int32));
+
+  ch->probe_set  = NULL;
+  ch->pm         = NULL;
+  ch->qnorm_rank = NULL;
+}
+
 /* 
  * affy_free_chip():
  *
@@ -31,6 +53,10 @@
  */
 void affy_free_chip(AFFY_CHIP *ch)
 {
+  if (ch == NULL)
+    return;
+
+  free_store_arrays(ch);
   h_free(ch);
 }
 
@@ -48,14 +74,12 @@ void affy_mostly_free_chip(AFFY_CHIP *ch)
 {
   if (ch->cel)                   affy_mostly_free_cel_file(ch->cel);
   if (ch->dat)                   h_free(ch->dat);
-  if (ch->probe_set)             h_free(ch->probe_set);
   if (ch->probe_set_call_pvalue) h_free(ch->probe_set_call_pvalue);
-  if (ch->pm)                    h_free(ch->pm);
+
+  free_store_arrays(ch);
   
   ch->dat                        = NULL;
-  ch->probe_set                  = NULL;
   ch->probe_set_call_pvalue      = NULL;
-  ch->pm                         = NULL;
 }
 
 
@@ -68,5 +92,9 @@ void affy_mostly_free_chip(AFFY_CHIP *ch)
  */
 void affy_free_chipset(AFFY_CHIPSET *cs)
 {
+  if (cs == NULL)
+    return;
+
+  affy_backing_store_free(cs->store);
   h_free(cs);
 }
@@ -20,13 +20,15 @@
  * 03/11/08: New error handling scheme (AMH)
  * 09/20/10: Pooled memory allocator (AMH)
  * 09/05/23: change fgets() calls to EOL-safe functions (EAW)
+ * 10/16/26: read gzip-compressed CEL files (EAW)
+ * 10/16/26: use buffered LINE_READER for text CEL files (EAW)
+ * 10/16/26: affy_get_cdf_name_from_cel() uses the shared header scan,
+ *           XDA headers are read by their stored length (EAW)
  *
  **************************************************************************/
 
 #include <affy.h>
 
-#define HDR_OFFSET 20
-
 /*
  * Given a string which is the DatHeader line of a CEL file, figure
  * out the corresponding CDF file.
@@ -66,123 +68,17 @@ char *affy_get_cdf_name(const char *buf, AFFY_ERROR *err)
  */
 char *affy_get_cdf_name_from_cel(const char *filename, AFFY_ERROR *err)
 {
-  FILE       *fp;
-  affy_int32  int_magic;
-  affy_uint8  byte_magic;
-  int         max_string_len = 0;
-  char        buf[MAXBUF];
-  char       *fgets_buffer = NULL;
-  char       *result       = NULL;
+  AFFY_CEL_HEADER *hdr;
+  char            *result;
 
   assert(filename != NULL);
 
-  /* Figure out if file is txt (V3) or binary (V4) */
-  fp = fopen(filename, "rb");
-  if (fp == NULL)
-  {
-    fprintf(stderr, "CEL file: %s\n", filename);
-    AFFY_HANDLE_ERROR("CEL file fopen failed", AFFY_ERROR_NOTFOUND, err, NULL);
-  }
-
-  if (affy_read32_le(fp, (void *)(&int_magic)) < 0)
-    AFFY_HANDLE_ERROR("I/O error reading CEL magic", 
-                      AFFY_ERROR_IO, 
-                      err,
-                      NULL);
-  
-  rewind(fp);
-
-  if (affy_read8(fp, (void *)(&byte_magic)) < 0)
-    AFFY_HANDLE_ERROR("I/O error reading CEL magic", 
-                      AFFY_ERROR_IO, 
-                      err, 
-                      NULL);
-
-  rewind(fp);
-
-  if (int_magic == AFFY_CEL_BINARYFILE_MAGIC)
-  {
-    affy_int32 hdrlen;
-    int        readin = 0;
-
-    if (fseek(fp, HDR_OFFSET, SEEK_SET) == -1)
-    {
-      fclose(fp);
-      AFFY_HANDLE_ERROR("seek failed", AFFY_ERROR_IO, err, NULL);
-    }
-   
-    if (affy_read32_le(fp, (void *)&hdrlen) != 0)
-    {
-      fclose(fp);
-      AFFY_HANDLE_ERROR("couldn't read CEL header", AFFY_ERROR_IO, err, NULL);
-    }
-
-    while (affy_readchars(fp, buf, MAXBUF) && readin < hdrlen)
-    {
-      if (!strncmp(buf, "DatHeader=", 10))
-        break;
-      readin = ftell(fp) - HDR_OFFSET + 4;
-    }
-
-    result = affy_get_cdf_name(buf, err);
-
-    fclose(fp);
-  }
-  else if (byte_magic == AFFY_CALVIN_FILEMAGIC)
-  {
-    AFFY_CALVINIO          *cio;
-    AFFY_CALVIN_DATAHEADER *dh;
-    AFFY_CALVIN_PARAM      *cp;
-    
-    cio = affy_calvinio_init(fp, err);
-    AFFY_CHECK_ERROR(err, NULL);
-
-    dh = affy_calvin_get_dataheader(cio, err);
-    AFFY_CHECK_ERROR(err, NULL);
-
-    cp = affy_calvin_find_param(dh->params, 
-                                dh->num_params, 
-                                "affymetrix-array-type");
-
-    if (cp != NULL)
-    {
-      result = h_strdup(cp->value.string_val);
-
-      affy_free_calvin_dataheader(dh);
-      affy_calvinio_free(cio);
-      fclose(fp);
-      
-      if (result == NULL)
-        AFFY_HANDLE_ERROR("strdup failed", AFFY_ERROR_OUTOFMEM, err, NULL);
-    }
-    else
-    {
-      affy_free_calvin_dataheader(dh);
-      affy_calvinio_free(cio);
-      fclose(fp);
-      
-      AFFY_HANDLE_ERROR("couldn't determine Calvin array type",
-                        AFFY_ERROR_BADFORMAT,
-                        err,
-                        NULL);
-    }
-  }
-  else /* text CEL file */
-  {
-    /* Find the dat header line */
-    while (fgets_strip_realloc(&fgets_buffer, &max_string_len, fp) != NULL)
-      if (!strncmp(fgets_buffer, "DatHeader=", 10))
-        break;
-    
-    result = affy_get_cdf_name(fgets_buffer, err);
-
-    fclose(fp);
-    
-    if (fgets_buffer)
-        free(fgets_buffer);
-
-    AFFY_CHECK_ERROR(err, NULL);
-  }
+  hdr = affy_scan_cel_header(filename, err);
+  AFFY_CHECK_ERROR(err, NULL);
+
+  result = hdr->array_type;
+  hattach(result, NULL);
+  h_free(hdr);
 
   return (result);
 }
@@ -24,11 +24,29 @@
  * 05/13/13: Partial support for salvaging corrupt CEL files (EAW)
  * 03/10/14: #ifdef out CEL qc fields to save memory (EAW)
  * 03/17/14: fixed row/col memory allocation errors, the dimensions were swapped (EAW)
+ * 10/16/26: read/decode intensity section in bulk blocks of rows (EAW)
+ * 10/16/26: support compact float32 cell storage (EAW)
+ * 10/16/26: keep masks/outliers as sorted cell lists (EAW)
+ * 10/16/26: added affy_load_binary_cel_data(), to load from a header
+ *           scan's data offset (EAW)
+ * 10/16/26: affy_load_binary_cel_data() is quiet without a progress bar
+ *           (EAW)
+ * 10/16/26: affy_load_binary_cel_data() takes the cell layout (EAW)
  *
  **************************************************************************/
 
 #include <affy.h>
 
+/* Each intensity record: float32 mean, float32 stddev, int16 npixels */
+#define XDA_CELL_RECORD_SIZE  10
+
+/* Target size of each bulk read of the intensity section */
+#define XDA_READ_BLOCK_SIZE   (1024 * 1024)
+
+static void process_data_sections(FILE *fp,
+                                  AFFY_CELFILE *cf,
+                                  LIBUTILS_PB_STATE *pbs,
+                                  AFFY_ERROR *err);
 static void process_header_section(FILE *fp, 
                                    AFFY_CELFILE *cf, 
                                    AFFY_ERROR *err);
@@ -66,6 +84,52 @@ void affy_load_binary_cel_file(FILE *fp,
   if (cf->corrupt_flag)
     return;
 
+  process_data_sections(fp, cf, pbs, err);
+}
+
+/*
+ * affy_load_binary_cel_data(): load an XDA CEL file whose header was
+ *   already scanned into hdr, reading from the start of the intensities.
+ *   With no progress bar (pbs is NULL), nothing is reported.
+ */
+void affy_load_binary_cel_data(FILE *fp,
+                               AFFY_CELFILE *cf,
+                               const AFFY_CEL_HEADER *hdr,
+                               int storage,
+                               LIBUTILS_PB_STATE *pbs,
+                               AFFY_ERROR *err)
+{
+  assert(hdr         != NULL);
+  assert(hdr->format == AFFY_CEL_FORMAT_XDA);
+
+  if (fseek(fp, hdr->data_offset, SEEK_SET) != 0)
+    AFFY_HANDLE_ERROR_VOID("fseek failed", AFFY_ERROR_IO, err);
+
+  cf->numrows     = hdr->numrows;
+  cf->numcols     = hdr->numcols;
+  cf->nummasks    = hdr->nummasks;
+  cf->numoutliers = hdr->numoutliers;
+
+  affy_alloc_cel_data(cf, storage, err);
+  AFFY_CHECK_ERROR_VOID(err);
+
+  cf->mask    = NULL;
+  cf->outlier = NULL;
+
+  if (pbs != NULL)
+    info("CEL Dimensions: %" AFFY_PRNd32 "x%" AFFY_PRNd32, 
+         cf->numcols, 
+         cf->numrows);
+
+  process_data_sections(fp, cf, pbs, err);
+}
+
+/* Everything past the header: intensities, masks, outliers */
+static void process_data_sections(FILE *fp,
+                                  AFFY_CELFILE *cf,
+                                  LIBUTILS_PB_STATE *pbs,
+                                  AFFY_ERROR *err)
+{
   process_intensity_section(fp, cf, pbs, err);
   AFFY_CHECK_ERROR_VOID(err);
   if (cf->corrupt_flag)
@@ -117,40 +181,12 @@ static void process_header_section(FILE *fp, AFFY_CELFILE *cf, AFFY_ERROR *err)
   
   info("Found XDA (binary) CEL version: %" AFFY_PRNd32, version);
        
-  cf->data = h_suballoc(cf, cf->numcols * sizeof(AFFY_CELL *));
-  if (cf->data == NULL)
-    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
-
-  cf->data[0] = h_subcalloc(cf->data, 
-                            cf->numcols * cf->numrows, 
-                            sizeof(AFFY_CELL));
-  if (cf->data[0] == NULL)
-    AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
-
-  cf->mask = h_suballoc(cf, cf->numcols * sizeof(affy_uint8 *));
-  if (cf->mask == NULL)
-    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
-
-  cf->mask[0] = h_subcalloc(cf->mask, cf->numrows * cf->numcols, sizeof(affy_uint8));
-  if (cf->mask[0] == NULL)
-    AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
-
-  cf->outlier = h_suballoc(cf, cf->numcols * sizeof(affy_uint8 *));
-  if (cf->outlier == NULL)
-    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
-
-  cf->outlier[0] = h_subcalloc(cf->outlier, 
-                               cf->numrows * cf->numcols, 
-                               sizeof(affy_uint8));
-  if (cf->outlier[0] == NULL)
-    AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
+  affy_alloc_cel_data(cf, AFFY_CEL_STORAGE_CELLS, err);
+  AFFY_CHECK_ERROR_VOID(err);
 
-  for (i = 1; i < cf->numcols; i++)
-  {
-    cf->data[i]    = cf->data[0] + (i * cf->numrows);
-    cf->mask[i]    = cf->mask[0] + (i * cf->numrows);
-    cf->outlier[i] = cf->outlier[0] + (i * cf->numrows);
-  }
+  /* allocated once their sections tell how many there are */
+  cf->mask    = NULL;
+  cf->outlier = NULL;
 
   for (i = 0; i < 3; i++)
   {
@@ -172,16 +208,24 @@ static void process_header_section(FILE *fp, AFFY_CELFILE *cf, AFFY_ERROR *err)
        cf->numrows);
 }
 
+/*
+ * Intensities are stored row-major (x varies fastest) as fixed-size
+ * little-endian records.  Rather than issue one readmulti() per cell,
+ * read as many whole rows as fit in XDA_READ_BLOCK_SIZE with a single
+ * fread() and decode the block in one pass.
+ */
 static void process_intensity_section(FILE *fp, 
                                       AFFY_CELFILE *cf,
                                       LIBUTILS_PB_STATE *pbs,
                                       AFFY_ERROR *err)
 {
-  affy_int32 x, y, i, num_cells;
-
-#ifndef STORE_CEL_QC
-  double     stddev;
-  affy_int16 numpixels;
+  affy_int32     x, y, y_start, y_end, num_cells, rows_per_block;
+  size_t         row_bytes, block_bytes;
+  unsigned char *block, *rec;
+  affy_float32   value;
+#ifdef STORE_CEL_QC
+  affy_float32   stddev;
+  affy_int16     numpixels;
 #endif
 
   assert(fp != NULL);
@@ -189,40 +233,63 @@ static void process_intensity_section(FILE *fp,
 
   num_cells = cf->numrows * cf->numcols;
 
-  x = 0;
-  y = 0;
+  pb_begin(pbs, cf->numrows, "Loading intensities");
 
-  pb_begin(pbs, num_cells, "Loading intensities");
-        
-  for (i = 0; i < num_cells; i++) 
+  if (num_cells <= 0)
+  {
+    pb_finish(pbs, "%" AFFY_PRNd32 " cells", num_cells);
+    return;
+  }
+
+  row_bytes      = (size_t)cf->numcols * XDA_CELL_RECORD_SIZE;
+  rows_per_block = XDA_READ_BLOCK_SIZE / row_bytes;
+  if (rows_per_block < 1)
+    rows_per_block = 1;
+  if (rows_per_block > cf->numrows)
+    rows_per_block = cf->numrows;
+
+  block = h_malloc(rows_per_block * row_bytes);
+  if (block == NULL)
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+
+  for (y_start = 0; y_start < cf->numrows; y_start = y_end)
   {
-    /* Check for next row */
-    if (x == cf->numcols) 
+    y_end = y_start + rows_per_block;
+    if (y_end > cf->numrows)
+      y_end = cf->numrows;
+
+    block_bytes = (y_end - y_start) * row_bytes;
+
+    if (fread(block, 1, block_bytes, fp) != block_bytes)
     {
-      x = 0;
-      y++;
-    }
-    
-#ifdef STORE_CEL_QC
-    if (affy_readmulti(fp, "%2Dl%hl", 
-                       (void *)&(cf->data[x][y].value),
-                       (void *)&(cf->data[x][y].stddev),
-                       (void *)&(cf->data[x][y].numpixels)) <= 0)
-#else
-    if (affy_readmulti(fp, "%2Dl%hl", 
-                       (void *)&(cf->data[x][y].value),
-                       (void *)&(stddev),
-                       (void *)&(numpixels)) <= 0)
-#endif
+      h_free(block);
       AFFY_HANDLE_ERROR_VOID("I/O error in CEL intensity section", 
                              AFFY_ERROR_IO, 
                              err);
+    }
 
-    x++;
+    rec = block;
+    for (y = y_start; y < y_end; y++)
+    {
+      for (x = 0; x < cf->numcols; x++, rec += XDA_CELL_RECORD_SIZE)
+      {
+        affy_decode32_le(rec, &value);
+        affy_cel_set_value(cf, x, y, value);
 
-    pb_tick(pbs, 1, "");
+#ifdef STORE_CEL_QC
+        affy_decode32_le(rec + 4, &stddev);
+        affy_decode16_le(rec + 8, &numpixels);
+
+        affy_cel_set_qc(cf, x, y, stddev, numpixels);
+#endif
+      }
+    }
+
+    pb_tick(pbs, y_end - y_start, "");
   }
 
+  h_free(block);
+
   pb_finish(pbs, "%" AFFY_PRNd32 " cells", num_cells);
 }
 
@@ -237,6 +304,13 @@ static void process_mask_section(FILE *fp,
 
   pb_begin(pbs, cf->nummasks, "Loading masks");
 
+  if (cf->nummasks)
+  {
+    cf->mask = h_suballoc(cf, cf->nummasks * sizeof(affy_uint32));
+    if (cf->mask == NULL)
+      AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+  }
+
   j = 0;
   for (i = 0; i < cf->nummasks; i++) 
   {
@@ -272,14 +346,14 @@ static void process_mask_section(FILE *fp,
     if (corrupt_flag)
       continue;
 
-    bit_set(cf->mask[x], y);
+    cf->mask[j] = (affy_uint32)x * cf->numrows + y;
 
     pb_tick(pbs, 1, "");
     
     j++;
   }
   
-  cf->nummasks = j;
+  cf->nummasks = affy_sort_cell_list(&cf->mask, j);
 
   pb_finish(pbs, "%" AFFY_PRNu32 " masks", cf->nummasks);
 }
@@ -295,6 +369,13 @@ static void process_outlier_section(FILE *fp,
         
   pb_begin(pbs, cf->numoutliers, "Loading outliers");
 
+  if (cf->numoutliers)
+  {
+    cf->outlier = h_suballoc(cf, cf->numoutliers * sizeof(affy_uint32));
+    if (cf->outlier == NULL)
+      AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+  }
+
   j = 0;
   for (i = 0; i < cf->numoutliers; i++) 
   {
@@ -330,14 +411,14 @@ static void process_outlier_section(FILE *fp,
     if (corrupt_flag)
       continue;
 
-    bit_set(cf->outlier[x], y);
+    cf->outlier[j] = (affy_uint32)x * cf->numrows + y;
 
     pb_tick(pbs, 1,"");
     
     j++;
   }
   
-  cf->numoutliers = j;
+  cf->numoutliers = affy_sort_cell_list(&cf->outlier, j);
 
   pb_finish(pbs, "%" AFFY_PRNu32 " outliers", cf->numoutliers);
 }
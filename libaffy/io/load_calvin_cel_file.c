@@ -25,11 +25,23 @@
  * 03/10/14: #ifdef out CEL qc fields to save memory (EAW)
  * 03/17/14: fixed swapped row/col when reading data,
  *            only affected asymmetric chips (EAW)
+ * 10/16/26: read each dataset with a single bulk call, rather than
+ *           one call per cell/mask/outlier (EAW)
+ * 10/16/26: support compact float32 cell storage (EAW)
+ * 10/16/26: keep masks/outliers as sorted cell lists (EAW)
+ * 10/16/26: quiet without a progress bar (EAW)
+ * 10/16/26: added affy_load_calvin_cel_data(), to load in a given cell
+ *           layout (EAW)
  *
  **************************************************************************/
 
 #include <affy.h>
 
+static void load_calvin_cel(FILE *fp,
+                            AFFY_CELFILE *cf,
+                            int storage,
+                            LIBUTILS_PB_STATE *pbs,
+                            AFFY_ERROR *err);
 static void process_intensity_dataset(AFFY_CALVINIO *cio,
                                       AFFY_CELFILE *cf,
                                       LIBUTILS_PB_STATE *pbs,
@@ -62,12 +74,42 @@ void affy_load_calvin_cel_file(FILE *fp,
                                AFFY_CELFILE *cf,
                                LIBUTILS_PB_STATE *pbs,
                                AFFY_ERROR *err)
+{
+  load_calvin_cel(fp, cf, AFFY_CEL_STORAGE_CELLS, pbs, err);
+}
+
+/*
+ * affy_load_calvin_cel_data(): load a Calvin CEL file whose header was
+ *   already scanned into hdr, storing its cells in the given
+ *   AFFY_CEL_STORAGE_* layout.  The datasets are located through the
+ *   file's own header, so it is read from the start regardless.  With no
+ *   progress bar (pbs is NULL), nothing is reported.
+ */
+void affy_load_calvin_cel_data(FILE *fp,
+                               AFFY_CELFILE *cf,
+                               const AFFY_CEL_HEADER *hdr,
+                               int storage,
+                               LIBUTILS_PB_STATE *pbs,
+                               AFFY_ERROR *err)
+{
+  assert(hdr         != NULL);
+  assert(hdr->format == AFFY_CEL_FORMAT_CALVIN);
+
+  rewind(fp);
+
+  load_calvin_cel(fp, cf, storage, pbs, err);
+}
+
+static void load_calvin_cel(FILE *fp,
+                            AFFY_CELFILE *cf,
+                            int storage,
+                            LIBUTILS_PB_STATE *pbs,
+                            AFFY_ERROR *err)
 {
   AFFY_CALVINIO          *cio = NULL;
   AFFY_CALVIN_FILEHEADER *fh = NULL;
   AFFY_CALVIN_DATAHEADER *dh = NULL;
   AFFY_CALVIN_PARAM      *param;
-  affy_int32              i;
 
   assert(fp != NULL);
   assert(cf != NULL);
@@ -81,7 +123,9 @@ void affy_load_calvin_cel_file(FILE *fp,
   dh = affy_calvin_get_dataheader(cio, err);
   AFFY_CHECK_ERROR_GOTO(err, cleanup);
 
-  info("Found Calvin (generic) CEL version: %" AFFY_PRNu8, fh->file_version);
+  if (pbs != NULL)
+    info("Found Calvin (generic) CEL version: %" AFFY_PRNu8,
+         fh->file_version);
 
   if ((param = affy_calvin_find_param(dh->params, 
                                       dh->num_params,
@@ -103,65 +147,18 @@ void affy_load_calvin_cel_file(FILE *fp,
 
   cf->numrows = param->value.int_val;
 
-  info("CEL Dimensions: %" AFFY_PRNd32 "x%" AFFY_PRNd32,
-       cf->numcols,
-       cf->numrows);
-
-  cf->data = h_suballoc(cf, cf->numcols * sizeof(AFFY_CELL *));
-  if (cf->data == NULL)
-    AFFY_HANDLE_ERROR_GOTO("malloc failed", 
-                           AFFY_ERROR_OUTOFMEM, 
-                           err, 
-                           cleanup);
-
-  cf->data[0] = h_subcalloc(cf->data, 
-                            cf->numcols * cf->numrows, 
-                            sizeof(AFFY_CELL));
-  if (cf->data[0] == NULL)
-    AFFY_HANDLE_ERROR_GOTO("calloc failed", 
-                           AFFY_ERROR_OUTOFMEM, 
-                           err, 
-                           cleanup);
-
-  cf->mask = h_suballoc(cf, cf->numcols * sizeof(affy_uint8 *));
-  if (cf->mask == NULL)
-    AFFY_HANDLE_ERROR_GOTO("malloc failed", 
-                           AFFY_ERROR_OUTOFMEM, 
-                           err, 
-                           cleanup);
-
-  cf->mask[0] = h_subcalloc(cf->mask,
-                            cf->numcols * cf->numrows,
-                            sizeof(affy_uint8));
-  if (cf->mask[0] == NULL)
-    AFFY_HANDLE_ERROR_GOTO("calloc failed", 
-                           AFFY_ERROR_OUTOFMEM, 
-                           err, 
-                           cleanup);
+  if (pbs != NULL)
+    info("CEL Dimensions: %" AFFY_PRNd32 "x%" AFFY_PRNd32,
+         cf->numcols,
+         cf->numrows);
 
-  cf->outlier = h_suballoc(cf, cf->numcols * sizeof(affy_uint8 *));
-  if (cf->outlier == NULL)
-    AFFY_HANDLE_ERROR_GOTO("malloc failed", 
-                           AFFY_ERROR_OUTOFMEM, 
-                           err, 
-                           cleanup);
+  affy_alloc_cel_data(cf, storage, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
 
-  cf->outlier[0] = h_subcalloc(cf->outlier, 
-                               cf->numcols * cf->numrows, 
-                               sizeof(affy_uint8));
-  if (cf->outlier[0] == NULL)
-    AFFY_HANDLE_ERROR_GOTO("calloc failed", 
-                           AFFY_ERROR_OUTOFMEM, 
-                           err, 
-                           cleanup);
+  /* filled in by the mask and outlier datasets */
+  cf->mask    = NULL;
+  cf->outlier = NULL;
 
-  for (i = 1; i < cf->numcols; i++)
-  {
-    cf->data[i]    = cf->data[0] + (i * cf->numrows);
-    cf->mask[i]    = cf->mask[0] + (i * cf->numrows);
-    cf->outlier[i] = cf->outlier[0] + (i * cf->numrows);
-  }
-  
   process_intensity_dataset(cio, cf, pbs, err);
   AFFY_CHECK_ERROR_VOID(err);
   if (cf->corrupt_flag)
@@ -197,56 +194,96 @@ void affy_load_calvin_cel_file(FILE *fp,
   affy_free_calvin_dataheader(dh);
 }
 
+/*
+ * Read an entire per-cell column (Intensity, StdDev, Pixel) into a
+ * temporary array with one bulk read, to be scattered into the cell
+ * storage by the caller.  Cells are stored row-major (x varies fastest).
+ */
+static void *read_cell_column(AFFY_CALVINIO *cio,
+                              AFFY_CELFILE *cf,
+                              affy_uint32 ds_index,
+                              const char *col_name,
+                              size_t elem_size,
+                              LIBUTILS_PB_STATE *pbs,
+                              AFFY_ERROR *err)
+{
+  AFFY_CALVIN_DATASET_IO *dio;
+  void                   *vals = NULL;
+  affy_int32              col_index;
+  affy_uint32             num_cells;
+
+  num_cells = cf->numrows * cf->numcols;
+
+  dio = affy_calvin_prepare_dataset(cio, 0, ds_index, err);
+  AFFY_CHECK_ERROR(err, NULL);
+
+  if (dio->metadata->num_rows != num_cells)
+    AFFY_HANDLE_ERROR_GOTO("dataset size does not match CEL dimensions",
+                           AFFY_ERROR_BADFORMAT,
+                           err,
+                           cleanup);
+
+  col_index = affy_calvin_find_column_index(dio, col_name, err);
+  if (col_index == -1)
+    AFFY_HANDLE_ERROR_GOTO("dataset column not found",
+                           AFFY_ERROR_BADFORMAT,
+                           err,
+                           cleanup);
+
+  if (dio->metadata->columns[col_index].size != elem_size)
+    AFFY_HANDLE_ERROR_GOTO("unexpected dataset column size",
+                           AFFY_ERROR_BADFORMAT,
+                           err,
+                           cleanup);
+
+  vals = h_malloc(num_cells * elem_size);
+  if (vals == NULL)
+    AFFY_HANDLE_ERROR_GOTO("malloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+  affy_calvin_read_dataset_col(dio, pbs, col_index, vals, err);
+  if (err->type != AFFY_ERROR_NONE)
+  {
+    h_free(vals);
+    vals = NULL;
+  }
+
+cleanup:
+  affy_calvin_close_dataset(dio);
+
+  return (vals);
+}
+
 static void process_intensity_dataset(AFFY_CALVINIO *cio,
                                       AFFY_CELFILE *cf,
                                       LIBUTILS_PB_STATE *pbs,
                                       AFFY_ERROR *err)
 {
-  AFFY_CALVIN_DATASET_IO    *dio;
-  affy_uint32                ds_index, num_cells;
-  AFFY_CALVIN_COLUMN_MAPPING ofs[] = { { "Intensity", 0 }, { NULL, 0 } };
-
-  affy_int32 row, col;
+  affy_uint32   ds_index, num_cells;
+  affy_float32 *vals, *vp;
+  affy_int32    row, col;
 
   num_cells = cf->numrows * cf->numcols;
 
-  pb_begin(pbs, num_cells, "Loading intensities");
-
   ds_index = affy_calvin_find_dataset_index(cio, 0, "Intensity", err);
   if (ds_index == -1)
     AFFY_HANDLE_ERROR_VOID("Intensity dataset not found",
                            AFFY_ERROR_BADFORMAT,
                            err);
 
-  dio = affy_calvin_prepare_dataset(cio, 0, ds_index, err);
+  pb_begin(pbs, num_cells, "Loading intensities");
+
+  vals = read_cell_column(cio, cf, ds_index, "Intensity", 
+                          sizeof(affy_float32),
+                          pbs, err);
   AFFY_CHECK_ERROR_VOID(err);
 
-  for (row = 0; row < cf->numrows; row++)
-  {
+  for (row = 0, vp = vals; row < cf->numrows; row++)
     for (col = 0; col < cf->numcols; col++)
-    {
-      affy_float32 val;
-      
-      affy_calvin_read_dataset_rows(dio,
-                                    pbs,
-                                    col + (row * cf->numcols),
-                                    1,
-                                    (void *)(&val),
-                                    sizeof(affy_float32),
-                                    ofs,
-                                    err);
-      AFFY_CHECK_ERROR_GOTO(err, cleanup);
-      
-      cf->data[col][row].value = val;
-      
-      pb_tick(pbs, 1,"");
-    }
-  }
+      affy_cel_set_value(cf, col, row, *vp++);
+
+  h_free(vals);
   
   pb_finish(pbs, "%" AFFY_PRNu32 " cells", num_cells);
-
-cleanup:
-  affy_calvin_close_dataset(dio);
 }
 
 #ifdef STORE_CEL_QC
@@ -255,9 +292,9 @@ static void process_stddev_dataset(AFFY_CALVINIO *cio,
                                    LIBUTILS_PB_STATE *pbs,
                                    AFFY_ERROR *err)
 {
-  AFFY_CALVIN_DATASET_IO    *dio;
-  affy_uint32                ds_index, num_cells, i;
-  AFFY_CALVIN_COLUMN_MAPPING ofs[] = { { "StdDev", 0 }, { NULL, 0 } };
+  affy_uint32   ds_index, num_cells;
+  affy_float32 *vals, *vp;
+  affy_int32    row, col;
 
   num_cells = cf->numrows * cf->numcols;
 
@@ -272,30 +309,23 @@ static void process_stddev_dataset(AFFY_CALVINIO *cio,
 
   pb_begin(pbs, num_cells, "Loading standard deviations");
 
-  dio = affy_calvin_prepare_dataset(cio, 0, ds_index, err);
+  vals = read_cell_column(cio, cf, ds_index, "StdDev",
+                          sizeof(affy_float32),
+                          pbs, err);
   AFFY_CHECK_ERROR_VOID(err);
 
-  for (i = 0; i < num_cells; i++)
-  {
-    affy_float32 val;
-
-    affy_calvin_read_dataset_rows(dio,
-                                  pbs, 
-                                  i, 
-                                  1, 
-                                  (void *)(&val),
-                                  sizeof(affy_float32),
-                                  ofs,
-                                  err);
-    AFFY_CHECK_ERROR_GOTO(err, cleanup);
+  for (row = 0, vp = vals; row < cf->numrows; row++)
+    for (col = 0; col < cf->numcols; col++, vp++)
+    {
+      if (cf->intensity)
+        cf->stddev[(size_t)col * cf->numrows + row] = *vp;
+      else
+        cf->data[col][row].stddev = *vp;
+    }
 
-    cf->data[0][i].stddev = val;
-  }
+  h_free(vals);
   
   pb_finish(pbs, "%" AFFY_PRNu32 " cells", num_cells);
-
-cleanup:
-  affy_calvin_close_dataset(dio);
 }
 
 static void process_cellpixel_dataset(AFFY_CALVINIO *cio,
@@ -303,11 +333,9 @@ static void process_cellpixel_dataset(AFFY_CALVINIO *cio,
                                       LIBUTILS_PB_STATE *pbs,
                                       AFFY_ERROR *err)
 {
-  AFFY_CALVIN_DATASET_IO    *dio;
-  affy_uint32                ds_index, num_cells;
-  AFFY_CALVIN_COLUMN_MAPPING ofs[] = { { "Pixel", offsetof(AFFY_CELL, numpixels) },
-                                       { NULL, 0 } };
-
+  affy_uint32  ds_index, num_cells;
+  affy_int16  *vals, *vp;
+  affy_int32   row, col;
 
   num_cells = cf->numrows * cf->numcols;
 
@@ -322,23 +350,23 @@ static void process_cellpixel_dataset(AFFY_CALVINIO *cio,
 
   pb_begin(pbs, num_cells, "Loading cell pixel counts");
 
-  dio = affy_calvin_prepare_dataset(cio, 0, ds_index, err);
+  vals = read_cell_column(cio, cf, ds_index, "Pixel",
+                          sizeof(affy_int16),
+                          pbs, err);
   AFFY_CHECK_ERROR_VOID(err);
 
-  affy_calvin_read_dataset_rows(dio, 
-                                pbs, 
-                                0, 
-                                num_cells, 
-                                (void *)(cf->data[0]),
-                                sizeof(AFFY_CELL),
-                                ofs,
-                                err);
-  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+  for (row = 0, vp = vals; row < cf->numrows; row++)
+    for (col = 0; col < cf->numcols; col++, vp++)
+    {
+      if (cf->intensity)
+        cf->numpixels[(size_t)col * cf->numrows + row] = *vp;
+      else
+        cf->data[col][row].numpixels = *vp;
+    }
+
+  h_free(vals);
   
   pb_finish(pbs, "%" AFFY_PRNu32 " cells", num_cells);
-
-cleanup:
-  affy_calvin_close_dataset(dio);
 }
 #endif    /* STORE_CEL_QC */
 
@@ -348,7 +376,7 @@ static void process_mask_dataset(AFFY_CALVINIO *cio,
                                  AFFY_ERROR *err)
 {
   AFFY_CALVIN_DATASET_IO    *dio;
-  AFFY_POINT16                 ap;
+  AFFY_POINT16              *points = NULL, ap;
   affy_uint32                ds_index, i, j;
   int                        corrupt_flag = 0;
 
@@ -369,22 +397,45 @@ static void process_mask_dataset(AFFY_CALVINIO *cio,
 
   pb_begin(pbs, cf->nummasks, "Loading masks");
 
-  j = 0;
-  for (i = 0; i < cf->nummasks; i++)
+  if (cf->nummasks)
   {
-    ap.x = -9999;
-    ap.y = -9999;
+    points = h_malloc(cf->nummasks * sizeof(AFFY_POINT16));
+    if (points == NULL)
+      AFFY_HANDLE_ERROR_GOTO("malloc failed", 
+                             AFFY_ERROR_OUTOFMEM, 
+                             err, 
+                             cleanup);
+
+    /* missing X or Y columns are left as invalid coordinates */
+    for (i = 0; i < cf->nummasks; i++)
+    {
+      points[i].x = -9999;
+      points[i].y = -9999;
+    }
 
     affy_calvin_read_dataset_rows(dio, 
                                   pbs, 
-                                  i,
-                                  1, 
-                                  (void *)&ap,
+                                  0,
+                                  cf->nummasks, 
+                                  (void *)points,
                                   sizeof(AFFY_POINT16),
                                   point_map,
                                   err);
     AFFY_CHECK_ERROR_GOTO(err, cleanup);
 
+    cf->mask = h_suballoc(cf, cf->nummasks * sizeof(affy_uint32));
+    if (cf->mask == NULL)
+      AFFY_HANDLE_ERROR_GOTO("malloc failed", 
+                             AFFY_ERROR_OUTOFMEM, 
+                             err, 
+                             cleanup);
+  }
+
+  j = 0;
+  for (i = 0; i < cf->nummasks; i++)
+  {
+    ap = points[i];
+
     if ((ap.x >= cf->numcols) || (ap.y >= cf->numrows) ||
         (ap.x < 0) || (ap.y < 0))
     {
@@ -403,16 +454,17 @@ static void process_mask_dataset(AFFY_CALVINIO *cio,
     if (corrupt_flag)
       continue;
 
-    bit_set(cf->mask[ap.x], ap.y);
+    cf->mask[j] = (affy_uint32)ap.x * cf->numrows + ap.y;
     
     j++;
   }
   
-  cf->nummasks = j;
+  cf->nummasks = affy_sort_cell_list(&cf->mask, j);
   
   pb_finish(pbs, "%" AFFY_PRNu32 " masks", cf->nummasks);
 
 cleanup:
+  h_free(points);
   affy_calvin_close_dataset(dio);
 }
 
@@ -422,7 +474,7 @@ static void process_outlier_dataset(AFFY_CALVINIO *cio,
                                     AFFY_ERROR *err)
 {
   AFFY_CALVIN_DATASET_IO    *dio;
-  AFFY_POINT16                 ap;
+  AFFY_POINT16              *points = NULL, ap;
   affy_uint32                ds_index, i, j;
   int                        corrupt_flag = 0;
 
@@ -443,22 +495,45 @@ static void process_outlier_dataset(AFFY_CALVINIO *cio,
 
   pb_begin(pbs, cf->numoutliers, "Loading outliers");
 
-  j = 0;
-  for (i = 0; i < cf->numoutliers; i++)
+  if (cf->numoutliers)
   {
-    ap.x = -9999;
-    ap.y = -9999;
-  
+    points = h_malloc(cf->numoutliers * sizeof(AFFY_POINT16));
+    if (points == NULL)
+      AFFY_HANDLE_ERROR_GOTO("malloc failed", 
+                             AFFY_ERROR_OUTOFMEM, 
+                             err, 
+                             cleanup);
+
+    /* missing X or Y columns are left as invalid coordinates */
+    for (i = 0; i < cf->numoutliers; i++)
+    {
+      points[i].x = -9999;
+      points[i].y = -9999;
+    }
+
     affy_calvin_read_dataset_rows(dio, 
                                   pbs, 
-                                  i,
-                                  1, 
-                                  (void *)&ap,
+                                  0,
+                                  cf->numoutliers, 
+                                  (void *)points,
                                   sizeof(AFFY_POINT16),
                                   point_map,
                                   err);
     AFFY_CHECK_ERROR_GOTO(err, cleanup);
 
+    cf->outlier = h_suballoc(cf, cf->numoutliers * sizeof(affy_uint32));
+    if (cf->outlier == NULL)
+      AFFY_HANDLE_ERROR_GOTO("malloc failed", 
+                             AFFY_ERROR_OUTOFMEM, 
+                             err, 
+                             cleanup);
+  }
+
+  j = 0;
+  for (i = 0; i < cf->numoutliers; i++)
+  {
+    ap = points[i];
+
     if ((ap.x >= cf->numcols) || (ap.y >= cf->numrows) ||
         (ap.x < 0) || (ap.y < 0))
     {
@@ -478,15 +553,16 @@ static void process_outlier_dataset(AFFY_CALVINIO *cio,
     if (corrupt_flag)
       continue;
 
-    bit_set(cf->outlier[ap.x], ap.y);
+    cf->outlier[j] = (affy_uint32)ap.x * cf->numrows + ap.y;
     
     j++;
   }
   
-  cf->numoutliers = j;
+  cf->numoutliers = affy_sort_cell_list(&cf->outlier, j);
 
   pb_finish(pbs, "%" AFFY_PRNu32 " outliers", cf->numoutliers);
 
 cleanup:
+  h_free(points);
   affy_calvin_close_dataset(dio);
 }
@@ -25,6 +25,10 @@
  * 06/01/18: change cdf malloc to calloc, so it is initialized to zeroes (EAW)
  * 08/12/20: store full path to CDF file in flags, so we can print later (EAW)
  * 09/05/23: fopen() everything as "rb" (EAW)
+ * 10/16/26: read gzip-compressed CDF files, look for .CDF.gz too (EAW)
+ * 10/16/26: load/save compiled CDF images (EAW)
+ * 10/16/26: build the flat probe tables after loading (EAW)
+ * 10/16/26: build the probeset name index after loading (EAW)
  *
  **************************************************************************/
 
@@ -63,7 +67,7 @@ AFFY_CDFFILE *affy_load_cdf_file_byname(char *cdf_filename,
   pb_init(&pbs);
 
   /* Open file */
-  fp = fopen(cdf_filename, "rb");
+  fp = affy_fopen_input(cdf_filename);
   if (fp == NULL)
     AFFY_HANDLE_ERROR("error opening CDF file", AFFY_ERROR_IO, err, NULL);
 
@@ -110,7 +114,7 @@ AFFY_CDFFILE *affy_load_cdf_file_byname(char *cdf_filename,
     /* Reopen cdf file in binary mode - for PC's */
     fclose(fp);
 
-    if ((fp = fopen(cdf_filename, "rb")) == NULL)
+    if ((fp = affy_fopen_input(cdf_filename)) == NULL)
       AFFY_HANDLE_ERROR_GOTO("couldn't reopen CDF in binary mode", 
                              AFFY_ERROR_IO,
                              err, 
@@ -125,6 +129,11 @@ AFFY_CDFFILE *affy_load_cdf_file_byname(char *cdf_filename,
     affy_load_text_cdf_file(fp, cdf, &pbs, err);
   }
 
+  if (err->type == AFFY_ERROR_NONE)
+    affy_cdf_build_index(cdf, err);
+  if (err->type == AFFY_ERROR_NONE)
+    affy_cdf_build_name_index(cdf, err);
+
 cleanup:
   fclose(fp);
   pb_cleanup(&pbs);
@@ -152,7 +161,8 @@ AFFY_CDFFILE *affy_load_cdf_file(char *chip_type, char *dir,
                                  AFFY_COMBINED_FLAGS *f,
                                  AFFY_ERROR *err)
 {
-  char cdf_filename[MAXBUF];
+  char          cdf_filename[MAXBUF];
+  AFFY_CDFFILE *cdf;
 
   assert(chip_type != NULL);
 
@@ -171,6 +181,13 @@ AFFY_CDFFILE *affy_load_cdf_file(char *chip_type, char *dir,
       sprintf(cdf_filename, "%s", dir);
       goto FOUND;
     }
+    /* Check if dir is actually a gzip-compressed cdf file */
+    if ((endsWith(dir, ".CDF.gz") || endsWith(dir, ".cdf.gz")) &&
+        file_readable(dir))
+    {
+      sprintf(cdf_filename, "%s", dir);
+      goto FOUND;
+    }
 
     /* Otherwise, treat it as a directory */
     sprintf(cdf_filename, "%s/%s.CDF", dir, chip_type);
@@ -180,6 +197,14 @@ AFFY_CDFFILE *affy_load_cdf_file(char *chip_type, char *dir,
     sprintf(cdf_filename, "%s/%s.cdf", dir, chip_type);
     if (file_readable(cdf_filename))
       goto FOUND;
+
+    sprintf(cdf_filename, "%s/%s.CDF.gz", dir, chip_type);
+    if (file_readable(cdf_filename))
+      goto FOUND;
+
+    sprintf(cdf_filename, "%s/%s.cdf.gz", dir, chip_type);
+    if (file_readable(cdf_filename))
+      goto FOUND;
   }
 
   /* Even if not asked, check the current directory */
@@ -191,6 +216,14 @@ AFFY_CDFFILE *affy_load_cdf_file(char *chip_type, char *dir,
   if (file_readable(cdf_filename))
     goto FOUND;
 
+  sprintf(cdf_filename, "%s.CDF.gz", chip_type);
+  if (file_readable(cdf_filename))
+    goto FOUND;
+
+  sprintf(cdf_filename, "%s.cdf.gz", chip_type);
+  if (file_readable(cdf_filename))
+    goto FOUND;
+
   /* If we got here, can't find it and die */
   AFFY_HANDLE_ERROR("can't locate CDF file", AFFY_ERROR_NOTFOUND, err, NULL);
 
@@ -202,5 +235,24 @@ FOUND:
   /* continuation of print_flags(), since we cannot know it ahead of time */
   printf("Path to CDF file:                    %s\n\n", f->cdf_filename);
 
-  return (affy_load_cdf_file_byname(cdf_filename, chip_type, err));
+  if (!f->use_cdf_cache)
+    return (affy_load_cdf_file_byname(cdf_filename, chip_type, err));
+
+  cdf = affy_load_cdf_cache(cdf_filename, f->cdf_cache_directory,
+                            chip_type, err);
+  if (cdf != NULL || err->type != AFFY_ERROR_NONE)
+    return (cdf);
+
+  cdf = affy_load_cdf_file_byname(cdf_filename, chip_type, err);
+  if (cdf == NULL)
+    return (NULL);
+
+  affy_write_cdf_cache(cdf, cdf_filename, f->cdf_cache_directory, err);
+  if (err->type != AFFY_ERROR_NONE)
+  {
+    affy_free_cdf_file(cdf);
+    return (NULL);
+  }
+
+  return (cdf);
 }
@@ -21,6 +21,17 @@
  * 09/20/10: Pooled memory allocator (AMH)
  * 09/19/12: Added sanity checker for NaN and Inf (EAW)
  * 09/05/23: fopen() everything as "rb" (EAW)
+ * 10/16/26: read gzip-compressed CEL files (EAW)
+ * 10/16/26: added affy_load_cel_file_indexed(), which takes or fills in
+ *           the header scan from the same open file (EAW)
+ * 10/16/26: affy_cel_sanity_fix() uses the cell accessors, zero the new
+ *           AFFY_CELFILE (EAW)
+ * 10/16/26: affy_cel_sanity_fix() walks the cells in storage order (EAW)
+ * 10/16/26: text and XDA files with a scanned header are loaded from the
+ *           start of their intensities (EAW)
+ * 10/16/26: affy_load_cel_file_indexed() can load quietly, for worker
+ *           threads (EAW)
+ * 10/16/26: affy_load_cel_file_indexed() takes the cell layout (EAW)
  *
  **************************************************************************/
 
@@ -29,24 +40,20 @@
 #if PARANOID_CEL_LOADER
 int affy_cel_sanity_fix(AFFY_CELFILE *cf)
 {
-    AFFY_CELL **data = cf->data;
-    int numrows = cf->numrows;
-    int numcols = cf->numcols;
-    int row, col;
+    size_t numcells = affy_cel_num_cells(cf);
+    size_t i;
     int num_bogus = 0;
     double value;
     
-    for (row = 0; row < numrows; row++)
+    /* one pass in storage order */
+    for (i = 0; i < numcells; i++)
     {
-        for (col = 0; col < numcols; col++)
+        value = affy_cel_value_at(cf, i);
+        
+        if (isinf(value) || isnan(value))
         {
-            value = data[row][col].value;
-            
-            if (isinf(value) || isnan(value))
-            {
-                data[row][col].value = 0.0;
-                num_bogus++;
-            }
+            affy_cel_set_value_at(cf, i, 0.0);
+            num_bogus++;
         }
     }
 
@@ -56,29 +63,78 @@ int affy_cel_sanity_fix(AFFY_CELFILE *cf)
 
 AFFY_CELFILE *affy_load_cel_file(char *filename, AFFY_ERROR *err)
 {
-  FILE             *fp;
-  AFFY_CELFILE     *cf = NULL;
-  affy_int32        int_magic;
-  affy_uint8        byte_magic;
-  LIBUTILS_PB_STATE pbs;
+  return (affy_load_cel_file_indexed(filename, 
+                                     NULL, 
+                                     AFFY_CEL_STORAGE_CELLS, 
+                                     false, 
+                                     err));
+}
+
+/*
+ * affy_load_cel_file_indexed(): load a CEL file, as affy_load_cel_file(),
+ *   storing its cells in the given AFFY_CEL_STORAGE_* layout.
+ *
+ *   If hdr is from an index (hdr->format is known), it is trusted and the
+ *   header isn't scanned again.  Otherwise the header is scanned from the
+ *   same open file before loading and stored in hdr, so the caller gets
+ *   the array type without opening the file a second time;
+ *   hdr->array_type is then owned by the caller.
+ *
+ *   Either way, text and XDA files are then read from hdr->data_offset
+ *   on, without parsing their headers again.  Calvin files locate their
+ *   datasets through the file's own header, so they are still loaded
+ *   from the start.
+ *
+ *   A quiet load (which needs hdr) prints no progress or file details,
+ *   only warnings.  It is for loading on a worker thread, whose output
+ *   would be interleaved with everybody else's; whoever takes the file
+ *   reports it.
+ */
+AFFY_CELFILE *affy_load_cel_file_indexed(char *filename,
+                                         AFFY_CEL_HEADER *hdr,
+                                         int storage,
+                                         bool quiet,
+                                         AFFY_ERROR *err)
+{
+  FILE              *fp;
+  AFFY_CELFILE      *cf = NULL;
+  AFFY_CEL_HEADER    local_hdr;
+  AFFY_CEL_FORMAT    format;
+  affy_int32         int_magic;
+  affy_uint8         byte_magic;
+  LIBUTILS_PB_STATE  pbs, *pbp;
 #if PARANOID_CEL_LOADER
   int num_bogus = 0;
 #endif
         
   assert(filename != NULL);
+  assert(!quiet || hdr != NULL);
 
   pb_init(&pbs);
 
+  /* the format loaders are quiet without a progress bar */
+  pbp = quiet ? NULL : &pbs;
+
+  /* only the header based loaders take a layout, so scan one here */
+  if (hdr == NULL && storage != AFFY_CEL_STORAGE_CELLS)
+  {
+    memset(&local_hdr, 0, sizeof(local_hdr));
+    local_hdr.format = AFFY_CEL_FORMAT_UNKNOWN;
+
+    hdr = &local_hdr;
+  }
+
   /* Open file. */
-  fp = fopen(filename, "rb");
+  fp = affy_fopen_input(filename);
   if (fp == NULL)
     AFFY_HANDLE_ERROR("couldn't open CEL file", AFFY_ERROR_NOTFOUND, err, NULL);
 
-  info("Loading CEL file %s", filename);
+  if (!quiet)
+    info("Loading CEL file %s", filename);
 
-  cf = h_malloc(sizeof(AFFY_CELFILE));
+  cf = h_calloc(1, sizeof(AFFY_CELFILE));
   if (cf == NULL)
-    AFFY_HANDLE_ERROR_GOTO("malloc failed", AFFY_ERROR_OUTOFMEM, err, done);
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, done);
 
   cf->filename = h_strdup(filename);
   if (cf->filename == NULL)
@@ -87,38 +143,64 @@ AFFY_CELFILE *affy_load_cel_file(char *filename, AFFY_ERROR *err)
   
   cf->corrupt_flag = 0;
 
-  /* 
-   * Check the file magic and call appropriate loading function.  The
-   * reading of two magic values is needed since the old binary format
-   * magic is stored in a full int, which may be backwards due to
-   * endianness, bla bla...
-   */
-  if (affy_read32_le(fp, (void *)(&int_magic)) < 0)
-    AFFY_HANDLE_ERROR_GOTO("I/O error reading CEL magic", 
-                           AFFY_ERROR_IO, 
-                           err,
-                           done);
-
-  rewind(fp);
-
-  if (affy_read8(fp, (void *)(&byte_magic)) < 0)
-    AFFY_HANDLE_ERROR_GOTO("I/O error reading CEL magic", 
-                           AFFY_ERROR_IO, 
-                           err, 
-                           done);
-
-  rewind(fp);
-
-  /* Check for Calvin magic first. */
-  if (byte_magic == AFFY_CALVIN_FILEMAGIC)
+  if (hdr != NULL)
+  {
+    if (hdr->format == AFFY_CEL_FORMAT_UNKNOWN)
+    {
+      affy_scan_cel_header_fp(fp, hdr, err);
+      AFFY_CHECK_ERROR_GOTO(err, done);
+    }
+
+    format = hdr->format;
+  }
+  else
+  {
+    /* 
+     * Check the file magic and call appropriate loading function.  The
+     * reading of two magic values is needed since the old binary format
+     * magic is stored in a full int, which may be backwards due to
+     * endianness, bla bla...
+     */
+    if (affy_read32_le(fp, (void *)(&int_magic)) < 0)
+      AFFY_HANDLE_ERROR_GOTO("I/O error reading CEL magic", 
+                             AFFY_ERROR_IO, 
+                             err,
+                             done);
+
+    rewind(fp);
+
+    if (affy_read8(fp, (void *)(&byte_magic)) < 0)
+      AFFY_HANDLE_ERROR_GOTO("I/O error reading CEL magic", 
+                             AFFY_ERROR_IO, 
+                             err, 
+                             done);
+
+    rewind(fp);
+
+    /* Check for Calvin magic first. */
+    if (byte_magic == AFFY_CALVIN_FILEMAGIC)
+      format = AFFY_CEL_FORMAT_CALVIN;
+    else if (int_magic == AFFY_CEL_BINARYFILE_MAGIC)
+      format = AFFY_CEL_FORMAT_XDA;
+    else
+      format = AFFY_CEL_FORMAT_TEXT;
+  }
+
+  if (format == AFFY_CEL_FORMAT_CALVIN)
   {
     /* Calvin (Command Console) "generic" format. */
-    affy_load_calvin_cel_file(fp, cf, &pbs, err);
+    if (hdr != NULL)
+      affy_load_calvin_cel_data(fp, cf, hdr, storage, pbp, err);
+    else
+      affy_load_calvin_cel_file(fp, cf, pbp, err);
   }
-  else if (int_magic == AFFY_CEL_BINARYFILE_MAGIC)
+  else if (format == AFFY_CEL_FORMAT_XDA)
   {
     /* "Old" binary (GC) format. */
-    affy_load_binary_cel_file(fp, cf, &pbs, err);
+    if (hdr != NULL)
+      affy_load_binary_cel_data(fp, cf, hdr, storage, pbp, err);
+    else
+      affy_load_binary_cel_file(fp, cf, pbp, err);
   } 
   else 
   {
@@ -133,7 +215,10 @@ AFFY_CELFILE *affy_load_cel_file(char *filename, AFFY_ERROR *err)
                              done);
 #endif
 
-    affy_load_text_cel_file(fp, cf, &pbs, err);
+    if (hdr != NULL)
+      affy_load_text_cel_data(fp, cf, hdr, storage, pbp, err);
+    else
+      affy_load_text_cel_file(fp, cf, pbp, err);
   }
   
 #if PARANOID_CEL_LOADER
@@ -148,6 +233,9 @@ done:
   fclose(fp);
   pb_cleanup(&pbs);
 
+  if (hdr == &local_hdr)
+    h_free(local_hdr.array_type);
+
   if (err->type != AFFY_ERROR_NONE)
     affy_free_cel_file(cf);
 
@@ -17,6 +17,11 @@
  * 04/08/05: Imported/repaired from old libaffy (AMH)
  * 03/14/08: New error handling scheme (AMH)
  * 09/20/10: Pooled memory allocator (AMH)
+ * 10/16/26: added affy_load_chip_indexed() (EAW)
+ * 10/16/26: initialize chip->store (EAW)
+ * 10/16/26: initialize chip->qnorm_rank (EAW)
+ * 10/16/26: affy_load_chip_indexed() can load quietly (EAW)
+ * 10/16/26: affy_load_chip_indexed() takes the cell layout (EAW)
  *
  **************************************************************************/
 
@@ -24,6 +29,24 @@
 #include <utils.h>
 
 AFFY_CHIP *affy_load_chip(char *filename, AFFY_ERROR *err)
+{
+  return (affy_load_chip_indexed(filename, 
+                                 NULL, 
+                                 AFFY_CEL_STORAGE_CELLS, 
+                                 false, 
+                                 err));
+}
+
+/*
+ * Load a chip, taking or filling in its header scan along the way, with
+ * its cells in the given AFFY_CEL_STORAGE_* layout, and quietly if asked
+ * to (see affy_load_cel_file_indexed()).  hdr may be NULL if not quiet.
+ */
+AFFY_CHIP *affy_load_chip_indexed(char *filename,
+                                  AFFY_CEL_HEADER *hdr,
+                                  int storage,
+                                  bool quiet,
+                                  AFFY_ERROR *err)
 {
   AFFY_CELFILE *c;
   AFFY_CHIP    *chip;
@@ -31,7 +54,7 @@ AFFY_CHIP *affy_load_chip(char *filename, AFFY_ERROR *err)
   assert(filename != NULL);
 
   /* First try and open the file, if not quit now */
-  c = affy_load_cel_file(filename, err);
+  c = affy_load_cel_file_indexed(filename, hdr, storage, quiet, err);
   AFFY_CHECK_ERROR(err, NULL);
 
   /* OK, allocate storage */
@@ -50,6 +73,8 @@ AFFY_CHIP *affy_load_chip(char *filename, AFFY_ERROR *err)
   chip->probe_set             = NULL;
   chip->probe_set_call_pvalue = NULL;
   chip->pm                    = NULL;
+  chip->qnorm_rank            = NULL;
+  chip->store                 = NULL;
 
   hattach(chip->cel, chip);
 
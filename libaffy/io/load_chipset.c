@@ -21,6 +21,15 @@
  * 09/20/10: Pooled memory allocator (AMH)
  * 10/26/10: Fixed missing warn %s arg in affy_load_chipset_single() (EAW)
  * 05/22/19: Added --ignore-chip-mismatch support (EAW)
+ * 10/16/26: Added affy_load_chipset_next() for prefetched loading,
+ *           affy_load_chipset() now loads in parallel (EAW)
+ * 10/16/26: affy_load_chipset_single() opens the CEL file only once (EAW)
+ * 10/16/26: chips share the chipset's backing store (EAW)
+ * 10/16/26: affy_load_chipset_single() checks the array type before
+ *           loading the intensities (EAW)
+ * 10/16/26: affy_load_chipset() keeps its signature, parallel loading is
+ *           affy_load_chipset_threaded() (EAW)
+ * 10/16/26: chips are loaded in the chipset's cel_storage layout (EAW)
  *
  **************************************************************************/
 
@@ -32,7 +41,8 @@ void affy_load_chipset_single(AFFY_CHIPSET *cs,
                               bool ignore_chip_mismatch,
                               AFFY_ERROR *err)
 {
-  char *chip_type;
+  AFFY_CHIP       *chip;
+  AFFY_CEL_HEADER *hdr;
 
   assert(cs       != NULL);
   assert(pathname != NULL);
@@ -42,41 +52,100 @@ void affy_load_chipset_single(AFFY_CHIPSET *cs,
   if (cs->num_chips == cs->max_chips)
     AFFY_HANDLE_ERROR_VOID("chipset is full", AFFY_ERROR_LIMITREACHED, err);
   
+  /* only the header is read until the array type is known to match */
+  hdr = affy_scan_cel_header(pathname, err);
+  AFFY_CHECK_ERROR_VOID(err);
+  
   /* 
    * Check the array type against the type recorded for this
    * chipset.
    */
-  chip_type = affy_get_cdf_name_from_cel(pathname, err);
-  AFFY_CHECK_ERROR_VOID(err);
-  
   assert(cs->array_type != NULL);
-  if (strcmp(chip_type, cs->array_type) != 0 &&
+  if (strcmp(hdr->array_type, cs->array_type) != 0 &&
       ignore_chip_mismatch == 0)
   {
     warn("Array type mismatch for CEL file %s.  Expected %s, "
          "found %s", 
          pathname,
          cs->array_type, 
-         chip_type);
+         hdr->array_type);
 
     AFFY_HANDLE_ERROR_GOTO("CEL file array type does not match chipset", 
                            AFFY_ERROR_WRONGTYPE, 
                            err, 
                            done);
   }
-  else
+
+  /* loading starts from the intensities the scan found */
+  chip = affy_load_chip_indexed(pathname, hdr, cs->cel_storage, false, err);
+  AFFY_CHECK_ERROR_GOTO(err, done);
+
+  /* Everything is in order, add the chip. */
+  assert(cs->chip != NULL);
+  cs->chip[cs->num_chips] = chip;
+  hattach(cs->chip[cs->num_chips], cs->chip);
+  cs->chip[cs->num_chips]->cdf = cs->cdf;
+  cs->chip[cs->num_chips]->store = cs->store;
+  cs->num_chips++;
+
+done:
+  h_free(hdr);
+}
+
+/*
+ * Prefetched equivalent of affy_load_chipset_single(): claim the next
+ * chip (in filelist order) from a prefetch context, check its array type
+ * and add it to the chipset.
+ */
+void affy_load_chipset_next(AFFY_CHIPSET *cs,
+                            AFFY_CEL_PREFETCH *pf,
+                            bool ignore_chip_mismatch,
+                            AFFY_ERROR *err)
+{
+  AFFY_CHIP *chip;
+  char      *chip_type = NULL;
+
+  assert(cs != NULL);
+  assert(pf != NULL);
+
+  assert(cs->num_chips <= cs->max_chips);
+
+  if (cs->num_chips == cs->max_chips)
+    AFFY_HANDLE_ERROR_VOID("chipset is full", AFFY_ERROR_LIMITREACHED, err);
+
+  chip = affy_cel_prefetch_next(pf, &chip_type, err);
+  AFFY_CHECK_ERROR_VOID(err);
+
+  if (chip == NULL)
+    AFFY_HANDLE_ERROR_VOID("no CEL files left to load", 
+                           AFFY_ERROR_LIMITREACHED, 
+                           err);
+
+  assert(cs->array_type != NULL);
+  if (strcmp(chip_type, cs->array_type) != 0 &&
+      ignore_chip_mismatch == 0)
   {
-    /* Everything is in order, attempt to load the chip. */
-    assert(cs->chip != NULL);
-    cs->chip[cs->num_chips] = affy_load_chip(pathname, err);
-    if (err->type == AFFY_ERROR_NONE)
-    {
-      hattach(cs->chip[cs->num_chips], cs->chip);
-      cs->chip[cs->num_chips]->cdf = cs->cdf;
-      cs->num_chips++;
-    }
+    warn("Array type mismatch for CEL file %s.  Expected %s, "
+         "found %s", 
+         chip->filename,
+         cs->array_type, 
+         chip_type);
+
+    affy_free_chip(chip);
+
+    AFFY_HANDLE_ERROR_GOTO("CEL file array type does not match chipset", 
+                           AFFY_ERROR_WRONGTYPE, 
+                           err, 
+                           done);
   }
 
+  assert(cs->chip != NULL);
+  cs->chip[cs->num_chips] = chip;
+  hattach(cs->chip[cs->num_chips], cs->chip);
+  cs->chip[cs->num_chips]->cdf = cs->cdf;
+  cs->chip[cs->num_chips]->store = cs->store;
+  cs->num_chips++;
+
 done:
   h_free(chip_type);
 }
@@ -84,13 +153,38 @@ done:
 void affy_load_chipset(AFFY_CHIPSET *cs, char **filelist,
                        bool ignore_chip_mismatch)
 {
-  char     **p;
-  AFFY_ERROR err;
+  affy_load_chipset_threaded(cs, filelist, ignore_chip_mismatch, 1);
+}
+
+/*
+ * affy_load_chipset_threaded(): affy_load_chipset(), loading the CEL
+ *   files on num_threads worker threads (see cel_prefetch.c).
+ */
+void affy_load_chipset_threaded(AFFY_CHIPSET *cs, char **filelist,
+                                bool ignore_chip_mismatch, int num_threads)
+{
+  char             **p;
+  AFFY_ERROR         err;
+  AFFY_CEL_PREFETCH *pf;
 
   assert(cs       != NULL);
   assert(filelist != NULL);
 
+  /* errors on individual chips are skipped, not fatal */
+  err.type    = AFFY_ERROR_NONE;
+  err.handler = NULL;
+
+  pf = affy_cel_prefetch_start(filelist, NULL, num_threads, 0,
+                               cs->cel_storage, &err);
+  if (pf == NULL)
+    return;
+
   /* Load each chip. */
   for (p = filelist; (*p != NULL) && (cs->num_chips < cs->max_chips); p++)
-    affy_load_chipset_single(cs, *p, ignore_chip_mismatch, &err);
+  {
+    err.type = AFFY_ERROR_NONE;
+    affy_load_chipset_next(cs, pf, ignore_chip_mismatch, &err);
+  }
+
+  affy_cel_prefetch_free(pf);
 }
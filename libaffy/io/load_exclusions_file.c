@@ -20,12 +20,40 @@
  * 2018-09-14: added related new spikein code here as well (EAW)
  * 2019-03-14: changed int mempool to void mempool (EAW)
  * 2020-03-20: handle empty files without crashing (EAW)
+ * 2026-10-16: read with LINE_READER (EAW)
+ * 2026-10-16: flag listed probesets in cdf->ps_flags[] once, at load (EAW)
+ * 2026-10-16: find listed probesets with affy_cdf_find_probeset() (EAW)
  *
  **************************************************************************/
 
 #include <affy.h>
 #include "halloc.h"
 
+/* set flag in cdf->ps_flags[] for each probeset named in the list, clear
+ * it for all others, so that the normalization code doesn't have to search
+ * the list per probe per chip
+ */
+static void flag_listed_probesets(AFFY_CDFFILE *cdf, char **list, int count,
+                                  affy_uint8 flag)
+{
+  affy_int32 ps;
+  int        i;
+
+  assert(cdf->ps_flags != NULL);
+
+  for (ps = 0; ps < cdf->numprobesets; ps++)
+    cdf->ps_flags[ps] &= ~flag;
+
+  for (i = 0; i < count; i++)
+  {
+    ps = affy_cdf_find_probeset(cdf, list[i]);
+
+    for (; ps >= 0; ps = cdf->name_next[ps])
+      cdf->ps_flags[ps] |= flag;
+  }
+}
+
+
 /* store the list in the CDF structure
  * seemed like a reasonable place to put it
  *
@@ -36,7 +64,7 @@ void affy_load_exclusions_file(char *filename, AFFY_CDFFILE *cdf,
                                AFFY_ERROR *err)
 {
   FILE *data_file;
-  int max_string_len = 0;
+  LINE_READER *lr;
   char *string = NULL;
   char **fields = NULL;
   char *sptr;
@@ -55,8 +83,15 @@ void affy_load_exclusions_file(char *filename, AFFY_CDFFILE *cdf,
   if (!data_file)
     AFFY_HANDLE_ERROR_VOID("can not open data file", AFFY_ERROR_NOTFOUND, err);
 
+  lr = line_reader_init(data_file);
+  if (lr == NULL)
+  {
+    fclose(data_file);
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+  }
+
   /* assume the file is just a single column list, no header line */
-  while(fgets_strip_realloc(&string, &max_string_len, data_file))
+  while ((string = line_reader_next(lr, NULL)) != NULL)
   {
       num_fields = split_tabs(string, &fields, &max_field);
       
@@ -99,11 +134,12 @@ void affy_load_exclusions_file(char *filename, AFFY_CDFFILE *cdf,
   /* sort exclusions strings */
   qsort(cdf->exclusions, count, sizeof(char *), compare_string);
 
+  flag_listed_probesets(cdf, cdf->exclusions, count, AFFY_PS_EXCLUDED);
+
   if (cdf->exclusions)
     hattach(cdf->exclusions, cdf);
   
-  if (string)
-    free(string);
+  line_reader_free(lr);
 
   if (fields)
     free(fields);
@@ -120,7 +156,7 @@ void affy_load_spikeins_file(char *filename, AFFY_CDFFILE *cdf,
                              AFFY_ERROR *err)
 {
   FILE *data_file;
-  int max_string_len = 0;
+  LINE_READER *lr;
   char *string = NULL;
   char **fields = NULL;
   char *sptr;
@@ -139,8 +175,15 @@ void affy_load_spikeins_file(char *filename, AFFY_CDFFILE *cdf,
   if (!data_file)
     AFFY_HANDLE_ERROR_VOID("can not open data file", AFFY_ERROR_NOTFOUND, err);
 
+  lr = line_reader_init(data_file);
+  if (lr == NULL)
+  {
+    fclose(data_file);
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+  }
+
   /* assume the file is just a single column list, no header line */
-  while(fgets_strip_realloc(&string, &max_string_len, data_file))
+  while ((string = line_reader_next(lr, NULL)) != NULL)
   {
       num_fields = split_tabs(string, &fields, &max_field);
       
@@ -183,11 +226,12 @@ void affy_load_spikeins_file(char *filename, AFFY_CDFFILE *cdf,
   /* sort spikeins strings */
   qsort(cdf->spikeins, count, sizeof(char *), compare_string);
 
+  flag_listed_probesets(cdf, cdf->spikeins, count, AFFY_PS_SPIKEIN);
+
   if (cdf->spikeins)
     hattach(cdf->spikeins, cdf);
   
-  if (string)
-    free(string);
+  line_reader_free(lr);
 
   if (fields)
     free(fields);
@@ -30,6 +30,8 @@
  * 03/12/14: print Number of Probests after probes are loaded (EAW)
  * 10/22/18: support broken BrainArray CDFs with all MM probes missing (EAW)
  * 05/23/19: workaround more errors in HuEx-1_0-st-v2.text.cdf controls (EAW)
+ * 10/16/26: keep the probes of earlier blocks of a multiblock probeset
+ *           when growing its probe array, they were left zeroed (EAW)
  *
  **************************************************************************/
 
@@ -358,6 +360,7 @@ static int process_probe_section(AFFY_TEXTIO *tf,
   char  *kv[2], *s;
   int    x, y, i, j;
   int    old_numprobes, new_numprobes;
+  AFFY_PROBE *old_probes;
   int    mm_count, pm_count;
   char   pbase, tbase;
   int    atom, old_atom;
@@ -468,11 +471,34 @@ static int process_probe_section(AFFY_TEXTIO *tf,
   }
 
   /* Allocate enough storage for all probes in this probe set */
+  old_probes = cdf->probeset[ps].probe;
   cdf->probeset[ps].probe = h_subcalloc(cdf, new_numprobes,
                                         sizeof(AFFY_PROBE));
   if (cdf->probeset[ps].probe == NULL)
     AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, -1);
 
+  /* carry over the earlier blocks, and point everything at the copies */
+  if (old_numprobes)
+  {
+    AFFY_PROBE *probe = cdf->probeset[ps].probe;
+
+    memcpy(probe, old_probes, old_numprobes * sizeof(AFFY_PROBE));
+
+    for (i = 0; i < old_numprobes; i++)
+    {
+      if (cdf->probe[probe[i].index] == &old_probes[i])
+        cdf->probe[probe[i].index] = &probe[i];
+#ifdef STORE_XY_REF
+      if (cdf->xy_ref[probe[i].pm.x][probe[i].pm.y] == &old_probes[i])
+        cdf->xy_ref[probe[i].pm.x][probe[i].pm.y] = &probe[i];
+      if (cdf->xy_ref[probe[i].mm.x][probe[i].mm.y] == &old_probes[i])
+        cdf->xy_ref[probe[i].mm.x][probe[i].mm.y] = &probe[i];
+#endif
+    }
+
+    h_free(old_probes);
+  }
+
   cdf->probeset[ps].numprobes = new_numprobes;
   cdf->probeset[ps].index     = ps;
 
@@ -0,0 +1,273 @@
+/**************************************************************************
+ *
+ * Filename:  open_input_file.c
+ *
+ * Purpose:   Open a CEL/CDF file for reading, transparently decompressing
+ *            it if it is gzip-compressed.
+ *
+ * Creation:  October 16th, 2026
+ *
+ * Author:    Eric A. Welsh
+ *
+ * Copyright: Copyright (C) 2026, Moffitt Cancer Center.
+ *            All rights reserved.
+ *
+ * Update History
+ * --------------
+ * 10/16/26: Creation (EAW)
+ * 10/16/26: stream through gzread()/gzseek() instead of decompressing
+ *           the whole file into memory first (EAW)
+ *
+ **************************************************************************/
+
+/* fopencookie() */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <limits.h>
+
+#include <affy.h>
+
+#ifdef AFFY_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#define GZIP_MAGIC_1      0x1f
+#define GZIP_MAGIC_2      0x8b
+
+/* size of zlib's input buffer, and of each block copied to a tmpfile */
+#define GZIP_BUFFER_SIZE  (256 * 1024)
+
+/*
+ * A gzip file is wrapped in a stdio FILE that decompresses it as it is
+ * read, so that every loader can keep using fread()/fseek()/ftell() on
+ * it without knowing it was compressed.  Only zlib's buffers are held in
+ * memory, never the whole file, however many files are open at once.
+ *
+ * glibc (fopencookie()) and the BSDs (funopen()) read through gzread()
+ * and seek with gzseek().  Forward seeks just decompress and discard;
+ * backward ones restart from the top of the file, which is cheap for
+ * the Calvin parser since it only goes back within the headers.
+ * Anywhere else the file is decompressed a block at a time into an
+ * anonymous tmpfile().
+ */
+
+#ifdef AFFY_HAVE_ZLIB
+
+static gzFile gz_open(const char *filename)
+{
+  gzFile gz;
+
+  gz = gzopen(filename, "rb");
+  if (gz == NULL)
+    return (NULL);
+
+#if ZLIB_VERNUM >= 0x1240
+  gzbuffer(gz, GZIP_BUFFER_SIZE);
+#endif
+
+  return (gz);
+}
+
+/*
+ * Read up to size bytes, returns -1 on a read error or a truncated or
+ * corrupt stream, 0 at the end.
+ */
+static long gz_read_block(gzFile gz, char *buf, size_t size)
+{
+  int n, errnum;
+
+  if (size > INT_MAX)
+    size = INT_MAX;
+
+  n = gzread(gz, buf, (unsigned int)size);
+  if (n < 0)
+    return (-1);
+
+  /* a truncated stream just ends early, with Z_BUF_ERROR set */
+  if (n == 0)
+  {
+    gzerror(gz, &errnum);
+    if (errnum != Z_OK)
+      return (-1);
+  }
+
+  return (n);
+}
+
+/* gzseek() can't seek from the end, the size isn't known up front */
+static long long gz_seek(gzFile gz, long long offset, int whence)
+{
+  z_off_t pos;
+
+  if (whence != SEEK_SET && whence != SEEK_CUR)
+    return (-1);
+
+  pos = gzseek(gz, (z_off_t)offset, whence);
+  if (pos < 0)
+    return (-1);
+
+  return (pos);
+}
+
+#if defined(__GLIBC__)
+
+static ssize_t gz_cookie_read(void *cookie, char *buf, size_t size)
+{
+  return (gz_read_block(cookie, buf, size));
+}
+
+static int gz_cookie_seek(void *cookie, off64_t *offset, int whence)
+{
+  long long pos;
+
+  pos = gz_seek(cookie, *offset, whence);
+  if (pos < 0)
+    return (-1);
+
+  *offset = pos;
+
+  return (0);
+}
+
+static int gz_cookie_close(void *cookie)
+{
+  return ((gzclose(cookie) == Z_OK) ? 0 : -1);
+}
+
+static FILE *gz_stream(gzFile gz)
+{
+  cookie_io_functions_t funcs;
+  FILE                 *fp;
+
+  funcs.read  = gz_cookie_read;
+  funcs.write = NULL;
+  funcs.seek  = gz_cookie_seek;
+  funcs.close = gz_cookie_close;
+
+  fp = fopencookie(gz, "rb", funcs);
+  if (fp == NULL)
+    gzclose(gz);
+
+  return (fp);
+}
+
+#elif defined(__APPLE__) || defined(__FreeBSD__) || \
+      defined(__NetBSD__) || defined(__OpenBSD__)
+
+static int gz_cookie_read(void *cookie, char *buf, int size)
+{
+  return ((int)gz_read_block(cookie, buf, size));
+}
+
+static fpos_t gz_cookie_seek(void *cookie, fpos_t offset, int whence)
+{
+  return (gz_seek(cookie, offset, whence));
+}
+
+static int gz_cookie_close(void *cookie)
+{
+  return ((gzclose(cookie) == Z_OK) ? 0 : -1);
+}
+
+static FILE *gz_stream(gzFile gz)
+{
+  FILE *fp;
+
+  fp = funopen(gz, gz_cookie_read, NULL, gz_cookie_seek, gz_cookie_close);
+  if (fp == NULL)
+    gzclose(gz);
+
+  return (fp);
+}
+
+#else
+
+/* No custom stdio streams, decompress into a temp file instead */
+static FILE *gz_stream(gzFile gz)
+{
+  FILE *fp;
+  char *buf;
+  long  n;
+
+  fp  = tmpfile();
+  buf = h_malloc(GZIP_BUFFER_SIZE);
+  if (fp == NULL || buf == NULL)
+    goto fail;
+
+  while ((n = gz_read_block(gz, buf, GZIP_BUFFER_SIZE)) > 0)
+  {
+    if (fwrite(buf, 1, n, fp) != (size_t)n)
+      goto fail;
+  }
+
+  if (n < 0)
+    goto fail;
+
+  h_free(buf);
+  gzclose(gz);
+  rewind(fp);
+
+  return (fp);
+
+fail:
+  if (fp != NULL)
+    fclose(fp);
+  h_free(buf);
+  gzclose(gz);
+
+  return (NULL);
+}
+
+#endif
+
+#endif /* AFFY_HAVE_ZLIB */
+
+/*
+ * affy_fopen_input(): open a file for binary reading, as with
+ *   fopen(filename, "rb").  If the file starts with the gzip magic, the
+ *   returned stream yields the decompressed contents instead.  Close it
+ *   with fclose() as usual.  Returns NULL on failure.
+ */
+FILE *affy_fopen_input(const char *filename)
+{
+  FILE *fp;
+  int   c1, c2;
+
+  assert(filename != NULL);
+
+  fp = fopen(filename, "rb");
+  if (fp == NULL)
+    return (NULL);
+
+  c1 = getc(fp);
+  c2 = getc(fp);
+
+  if (c1 != GZIP_MAGIC_1 || c2 != GZIP_MAGIC_2)
+  {
+    rewind(fp);
+    return (fp);
+  }
+
+#ifdef AFFY_HAVE_ZLIB
+  {
+    gzFile gz;
+
+    fclose(fp);
+
+    gz = gz_open(filename);
+    if (gz == NULL)
+      return (NULL);
+
+    return (gz_stream(gz));
+  }
+#else
+  /* let the loader complain about the (compressed) contents */
+  warn("%s is gzip-compressed, but zlib support is not compiled in",
+       filename);
+  rewind(fp);
+
+  return (fp);
+#endif
+}
@@ -0,0 +1,580 @@
+/**************************************************************************
+ *
+ * Filename:  scan_cel_header.c
+ *
+ * Purpose:   Read just the header of a CEL file (format, dimensions,
+ *            array type, start of the intensity data), and build an
+ *            index of the headers of a whole list of CEL files.
+ *
+ * Creation:  October 16th, 2026
+ *
+ * Author:    Eric A. Welsh
+ *
+ * Copyright: Copyright (C) 2026, Moffitt Cancer Center.
+ *            All rights reserved.
+ *
+ * Update History
+ * --------------
+ * 10/16/26: Creation (EAW)
+ * 10/16/26: each worker scans into its own halloc pool, array types are
+ *           moved into the index with h_pool_commit() (EAW)
+ * 10/16/26: record the XDA mask/outlier counts, added
+ *           affy_cel_index_array_type() (EAW)
+ * 10/16/26: read text headers with LINE_READER (EAW)
+ *
+ **************************************************************************/
+
+#include <ctype.h>
+
+#include <affy.h>
+#include <utils.h>
+
+#ifdef AFFY_HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+/*
+ * Find the DatHeader line in a block of header text and extract the
+ * array type from it.  Headers without a DatHeader line fall back to
+ * looking for the .1sq name anywhere in the text.
+ */
+static char *datheader_array_type(char *header, AFFY_ERROR *err)
+{
+  char *line, *eol;
+
+  for (line = header; line != NULL; line = eol ? eol + 1 : NULL)
+  {
+    eol = strchr(line, '\n');
+
+    if (strncmp(line, "DatHeader=", 10) == 0)
+    {
+      if (eol)
+        *eol = '\0';
+
+      return (affy_get_cdf_name(line + 10, err));
+    }
+  }
+
+  return (affy_get_cdf_name(header, err));
+}
+
+/* "Old" binary format: everything is in the fixed-layout preamble */
+static void scan_xda_header(FILE *fp, AFFY_CEL_HEADER *hdr, AFFY_ERROR *err)
+{
+  affy_int32  magic, version, numcells, len;
+  char       *header;
+  int         i;
+
+  if (affy_read32_le(fp, (void *)&magic)        != 0 ||
+      affy_read32_le(fp, (void *)&version)      != 0 ||
+      affy_read32_le(fp, (void *)&hdr->numcols) != 0 ||
+      affy_read32_le(fp, (void *)&hdr->numrows) != 0 ||
+      affy_read32_le(fp, (void *)&numcells)     != 0 ||
+      affy_read32_le(fp, (void *)&len)          != 0)
+    AFFY_HANDLE_ERROR_VOID("I/O error in CEL header section",
+                           AFFY_ERROR_IO,
+                           err);
+
+  if (len < 0)
+    AFFY_HANDLE_ERROR_VOID("bad CEL header length",
+                           AFFY_ERROR_BADFORMAT,
+                           err);
+
+  header = h_malloc(len + 1);
+  if (header == NULL)
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+
+  if (fread(header, 1, len, fp) != (size_t)len)
+  {
+    h_free(header);
+    AFFY_HANDLE_ERROR_VOID("I/O error in CEL header section",
+                           AFFY_ERROR_IO,
+                           err);
+  }
+  header[len] = '\0';
+
+  hdr->array_type = datheader_array_type(header, err);
+  h_free(header);
+  AFFY_CHECK_ERROR_VOID(err);
+
+  /* Skip the algorithm name and parameters */
+  for (i = 0; i < 2; i++)
+  {
+    if (affy_read32_le(fp, (void *)&len) != 0 ||
+        fseek(fp, len, SEEK_CUR) != 0)
+      AFFY_HANDLE_ERROR_VOID("I/O error in CEL header section",
+                             AFFY_ERROR_IO,
+                             err);
+  }
+
+  /* Cell margin, #outliers, #masks, #subgrids */
+  if (affy_readmulti(fp, "%x%2dl%x",
+                     4,
+                     (void *)&hdr->numoutliers,
+                     (void *)&hdr->nummasks,
+                     4) <= 0)
+    AFFY_HANDLE_ERROR_VOID("I/O error in CEL header section",
+                           AFFY_ERROR_IO,
+                           err);
+
+  hdr->data_offset = ftell(fp);
+}
+
+/* Calvin format: parameters of the data header, offset of the dataset */
+static void scan_calvin_header(FILE *fp,
+                               AFFY_CEL_HEADER *hdr,
+                               AFFY_ERROR *err)
+{
+  AFFY_CALVINIO          *cio = NULL;
+  AFFY_CALVIN_DATAHEADER *dh  = NULL;
+  AFFY_CALVIN_DATASET_IO *dio = NULL;
+  AFFY_CALVIN_PARAM      *cp;
+  affy_int32              ds_index;
+
+  cio = affy_calvinio_init(fp, err);
+  AFFY_CHECK_ERROR_VOID(err);
+
+  dh = affy_calvin_get_dataheader(cio, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+  cp = affy_calvin_find_param(dh->params, dh->num_params,
+                              "affymetrix-array-type");
+  if (cp == NULL)
+    AFFY_HANDLE_ERROR_GOTO("couldn't determine Calvin array type",
+                           AFFY_ERROR_BADFORMAT,
+                           err,
+                           cleanup);
+
+  hdr->array_type = h_strdup(cp->value.string_val);
+  if (hdr->array_type == NULL)
+    AFFY_HANDLE_ERROR_GOTO("strdup failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+  cp = affy_calvin_find_param(dh->params, dh->num_params,
+                              "affymetrix-cel-cols");
+  if (cp == NULL)
+    AFFY_HANDLE_ERROR_GOTO("CEL column parameter not found",
+                           AFFY_ERROR_BADFORMAT,
+                           err,
+                           cleanup);
+  hdr->numcols = cp->value.int_val;
+
+  cp = affy_calvin_find_param(dh->params, dh->num_params,
+                              "affymetrix-cel-rows");
+  if (cp == NULL)
+    AFFY_HANDLE_ERROR_GOTO("CEL row parameter not found",
+                           AFFY_ERROR_BADFORMAT,
+                           err,
+                           cleanup);
+  hdr->numrows = cp->value.int_val;
+
+  ds_index = affy_calvin_find_dataset_index(cio, 0, "Intensity", err);
+  if (ds_index == -1)
+    AFFY_HANDLE_ERROR_GOTO("Intensity dataset not found",
+                           AFFY_ERROR_BADFORMAT,
+                           err,
+                           cleanup);
+
+  dio = affy_calvin_prepare_dataset(cio, 0, ds_index, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+  hdr->data_offset = dio->initial_offset;
+
+cleanup:
+  if (dio)
+    affy_calvin_close_dataset(dio);
+  if (dh)
+    affy_free_calvin_dataheader(dh);
+  affy_calvinio_free(cio);
+}
+
+/*
+ * Text format: [HEADER] key=value lines, up to the [INTENSITY] line.
+ * The intensities start right after that line, wherever the line reader
+ * has read ahead to.
+ */
+static void scan_text_header(FILE *fp, AFFY_CEL_HEADER *hdr, AFFY_ERROR *err)
+{
+  LINE_READER *lr;
+  char        *line, *s, *end, *value;
+  bool         in_header = false;
+
+  lr = line_reader_init(fp);
+  if (lr == NULL)
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+
+  while ((line = line_reader_next(lr, NULL)) != NULL)
+  {
+    /* trim whitespace, as the text I/O layer does */
+    for (s = line; isspace((unsigned char)*s); s++)
+      ;
+    for (end = s + strlen(s); end > s && isspace((unsigned char)end[-1]); )
+      *--end = '\0';
+
+    if (*s == '[')
+    {
+      if (STREQ(s, "[INTENSITY]"))
+      {
+        hdr->data_offset = line_reader_offset(lr);
+        break;
+      }
+
+      in_header = STREQ(s, "[HEADER]");
+      continue;
+    }
+
+    if (!in_header || (value = strchr(s, '=')) == NULL)
+      continue;
+
+    *value++ = '\0';
+
+    if (STREQ(s, "Cols"))
+      hdr->numcols = strtol(value, NULL, 10);
+    else if (STREQ(s, "Rows"))
+      hdr->numrows = strtol(value, NULL, 10);
+    else if (STREQ(s, "DatHeader") && hdr->array_type == NULL)
+    {
+      hdr->array_type = affy_get_cdf_name(value, err);
+      AFFY_CHECK_ERROR_GOTO(err, cleanup);
+    }
+  }
+
+  if (hdr->data_offset <= 0)
+    AFFY_HANDLE_ERROR_GOTO("no intensity section in CEL file",
+                           AFFY_ERROR_BADFORMAT,
+                           err,
+                           cleanup);
+
+  if (hdr->array_type == NULL)
+    AFFY_HANDLE_ERROR_GOTO("bad DatHeader format",
+                           AFFY_ERROR_BADFORMAT,
+                           err,
+                           cleanup);
+
+cleanup:
+  line_reader_free(lr);
+}
+
+/*
+ * affy_scan_cel_header_fp(): read the header of the CEL file open on fp
+ *   (positioned at its start) and fill in hdr.  hdr->array_type is a new
+ *   allocation owned by the caller.  The stream is left somewhere inside
+ *   the file; seek to hdr->data_offset (text, XDA) or rewind (Calvin)
+ *   before loading.
+ */
+void affy_scan_cel_header_fp(FILE *fp, AFFY_CEL_HEADER *hdr, AFFY_ERROR *err)
+{
+  affy_int32 int_magic;
+  affy_uint8 byte_magic;
+
+  assert(fp  != NULL);
+  assert(hdr != NULL);
+
+  hdr->format      = AFFY_CEL_FORMAT_UNKNOWN;
+  hdr->array_type  = NULL;
+  hdr->numrows     = 0;
+  hdr->numcols     = 0;
+  hdr->nummasks    = 0;
+  hdr->numoutliers = 0;
+  hdr->data_offset = 0;
+
+  if (affy_read32_le(fp, (void *)(&int_magic)) < 0)
+    AFFY_HANDLE_ERROR_VOID("I/O error reading CEL magic", AFFY_ERROR_IO, err);
+
+  rewind(fp);
+
+  if (affy_read8(fp, (void *)(&byte_magic)) < 0)
+    AFFY_HANDLE_ERROR_VOID("I/O error reading CEL magic", AFFY_ERROR_IO, err);
+
+  rewind(fp);
+
+  /* Check for Calvin magic first, as the loader does */
+  if (byte_magic == AFFY_CALVIN_FILEMAGIC)
+  {
+    hdr->format = AFFY_CEL_FORMAT_CALVIN;
+    scan_calvin_header(fp, hdr, err);
+  }
+  else if (int_magic == AFFY_CEL_BINARYFILE_MAGIC)
+  {
+    hdr->format = AFFY_CEL_FORMAT_XDA;
+    scan_xda_header(fp, hdr, err);
+  }
+  else
+  {
+    hdr->format = AFFY_CEL_FORMAT_TEXT;
+    scan_text_header(fp, hdr, err);
+  }
+
+  if (err->type == AFFY_ERROR_NONE &&
+      (hdr->numrows <= 0 || hdr->numcols <= 0))
+    AFFY_HANDLE_ERROR_GOTO("invalid CEL file dimensions",
+                           AFFY_ERROR_BADFORMAT,
+                           err,
+                           failed);
+
+  if (err->type == AFFY_ERROR_NONE)
+    return;
+
+failed:
+  h_free(hdr->array_type);
+  hdr->array_type = NULL;
+}
+
+/*
+ * affy_scan_cel_header(): open a CEL file and read only its header.
+ *   The returned header (and its array_type) is freed with h_free().
+ */
+AFFY_CEL_HEADER *affy_scan_cel_header(const char *filename, AFFY_ERROR *err)
+{
+  AFFY_CEL_HEADER *hdr;
+  FILE            *fp;
+
+  assert(filename != NULL);
+
+  hdr = h_calloc(1, sizeof(AFFY_CEL_HEADER));
+  if (hdr == NULL)
+    AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, NULL);
+
+  fp = affy_fopen_input(filename);
+  if (fp == NULL)
+  {
+    h_free(hdr);
+    fprintf(stderr, "CEL file: %s\n", filename);
+    AFFY_HANDLE_ERROR("CEL file fopen failed", AFFY_ERROR_NOTFOUND, err, NULL);
+  }
+
+  affy_scan_cel_header_fp(fp, hdr, err);
+  fclose(fp);
+
+  if (err->type != AFFY_ERROR_NONE)
+  {
+    h_free(hdr);
+    return (NULL);
+  }
+
+  hattach(hdr->array_type, hdr);
+
+  return (hdr);
+}
+
+/*
+ * Index construction.  Workers claim the next unscanned file under a
+ * lock, and scan it into its own entry.  Each worker has its own halloc
+ * pool; the array type strings are queued there to move into the index,
+ * which happens once all workers are done, so no tree is shared between
+ * threads.
+ */
+typedef struct
+{
+  AFFY_CEL_INDEX *idx;
+  int             next;
+#ifdef AFFY_HAVE_PTHREADS
+  pthread_mutex_t lock;
+#endif
+} SCAN_STATE;
+
+typedef struct
+{
+  SCAN_STATE *st;
+  hpool_t    *pool;
+} SCAN_WORKER;
+
+static void scan_one(AFFY_CEL_INDEX *idx, int i, hpool_t *pool)
+{
+  AFFY_CEL_HEADER *hdr = idx->headers + i;
+  AFFY_ERROR      *err = &hdr->err;
+  FILE            *fp;
+
+  err->type    = AFFY_ERROR_NONE;
+  err->handler = NULL;
+
+  fp = affy_fopen_input(idx->filelist[i]);
+  if (fp == NULL)
+    AFFY_HANDLE_ERROR_VOID("CEL file fopen failed", AFFY_ERROR_NOTFOUND, err);
+
+  affy_scan_cel_header_fp(fp, hdr, err);
+  fclose(fp);
+
+  if (hdr->array_type &&
+      h_pool_defer_attach(pool, hdr->array_type, idx) != 0)
+  {
+    h_free(hdr->array_type);
+    hdr->array_type = NULL;
+
+    AFFY_HANDLE_ERROR_VOID("realloc failed", AFFY_ERROR_OUTOFMEM, err);
+  }
+}
+
+#ifdef AFFY_HAVE_PTHREADS
+static void *scan_worker(void *arg)
+{
+  SCAN_WORKER *w  = arg;
+  SCAN_STATE  *st = w->st;
+  int          i;
+
+  for (;;)
+  {
+    pthread_mutex_lock(&st->lock);
+    i = st->next++;
+    pthread_mutex_unlock(&st->lock);
+
+    if (i >= st->idx->num_files)
+      break;
+
+    scan_one(st->idx, i, w->pool);
+  }
+
+  return (NULL);
+}
+#endif
+
+/*
+ * affy_scan_cel_headers(): scan the headers of a NULL-terminated list of
+ *   CEL files, using up to num_threads threads.  A file that can't be
+ *   scanned does not stop the others; its entry records the error in
+ *   headers[i].err and num_errors counts them.  Free the index with
+ *   affy_free_cel_index().
+ */
+AFFY_CEL_INDEX *affy_scan_cel_headers(char **filelist,
+                                      int num_threads,
+                                      AFFY_ERROR *err)
+{
+  AFFY_CEL_INDEX *idx;
+  SCAN_STATE      st;
+  SCAN_WORKER    *workers;
+  char          **p;
+  int             i, num_started = 0;
+
+  assert(filelist != NULL);
+
+  idx = h_calloc(1, sizeof(AFFY_CEL_INDEX));
+  if (idx == NULL)
+    AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, NULL);
+
+  for (p = filelist; *p != NULL; p++)
+    idx->num_files++;
+
+  idx->filelist = filelist;
+
+  idx->headers = h_subcalloc(idx, idx->num_files + 1, sizeof(AFFY_CEL_HEADER));
+  if (idx->headers == NULL)
+  {
+    h_free(idx);
+    AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, NULL);
+  }
+
+  st.idx  = idx;
+  st.next = 0;
+
+  if (num_threads > idx->num_files)
+    num_threads = idx->num_files;
+  if (num_threads < 1)
+    num_threads = 1;
+
+  /* one pool per worker, not attached to anything until they're done */
+  workers = h_subcalloc(idx, num_threads, sizeof(SCAN_WORKER));
+  if (workers == NULL)
+  {
+    h_free(idx);
+    AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, NULL);
+  }
+
+  for (i = 0; i < num_threads; i++)
+  {
+    workers[i].st   = &st;
+    workers[i].pool = h_pool_create();
+    if (workers[i].pool == NULL)
+    {
+      for (i--; i >= 0; i--)
+        h_free(workers[i].pool);
+      h_free(idx);
+      AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, NULL);
+    }
+  }
+
+#ifdef AFFY_HAVE_PTHREADS
+  if (num_threads > 1)
+  {
+    pthread_t *threads;
+
+    threads = h_subcalloc(idx, num_threads, sizeof(pthread_t));
+    if (threads == NULL)
+    {
+      for (i = 0; i < num_threads; i++)
+        h_free(workers[i].pool);
+      h_free(idx);
+      AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, NULL);
+    }
+
+    pthread_mutex_init(&st.lock, NULL);
+
+    for (i = 0; i < num_threads; i++)
+    {
+      if (pthread_create(&threads[i], NULL, scan_worker, &workers[i]) != 0)
+        break;
+
+      num_started++;
+    }
+
+    for (i = 0; i < num_started; i++)
+      pthread_join(threads[i], NULL);
+
+    pthread_mutex_destroy(&st.lock);
+    h_free(threads);
+  }
+#endif
+
+  /* single threaded, or no threads could be started */
+  if (num_started == 0)
+  {
+    for (i = 0; i < idx->num_files; i++)
+      scan_one(idx, i, workers[0].pool);
+  }
+
+  /* all workers are finished, move their results into the index */
+  for (i = 0; i < num_threads; i++)
+  {
+    h_pool_commit(workers[i].pool);
+    h_free(workers[i].pool);
+  }
+  h_free(workers);
+
+  for (i = 0; i < idx->num_files; i++)
+  {
+    if (idx->headers[i].err.type != AFFY_ERROR_NONE)
+      idx->num_errors++;
+  }
+
+  return (idx);
+}
+
+/*
+ * affy_cel_index_array_type(): the array type of the first file in the
+ *   index, which is what a chipset for the whole list is created for.
+ *   Reports the error instead if that file couldn't be scanned.  The
+ *   string belongs to the index.
+ */
+char *affy_cel_index_array_type(AFFY_CEL_INDEX *idx, AFFY_ERROR *err)
+{
+  assert(idx != NULL);
+
+  if (idx->num_files == 0)
+    AFFY_HANDLE_ERROR("no CEL files to scan", AFFY_ERROR_NOTFOUND, err, NULL);
+
+  if (idx->headers[0].err.type != AFFY_ERROR_NONE)
+  {
+    fprintf(stderr, "CEL file: %s\n", idx->filelist[0]);
+
+    affy_clone_error(err, &idx->headers[0].err);
+    if (err->handler != NULL)
+      (err->handler)(err);
+
+    return (NULL);
+  }
+
+  return (idx->headers[0].array_type);
+}
+
+void affy_free_cel_index(AFFY_CEL_INDEX *idx)
+{
+  h_free(idx);
+}
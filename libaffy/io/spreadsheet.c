@@ -14,6 +14,12 @@
  * Update History
  * --------------
  * 04/11/11: Creation (EAW)
+ * 10/16/26: read with LINE_READER (EAW)
+ * 10/16/26: added single-pass affy_load_generic_spreadsheet() (EAW)
+ * 10/16/26: set AFFY_PS_CONTROL flags along with the probeset names (EAW)
+ * 10/16/26: chips share the chipset's backing store (EAW)
+ * 10/16/26: no mask/outlier planes, spreadsheets have none (EAW)
+ * 10/16/26: build the probeset name index once the names are set (EAW)
  *
  **************************************************************************/
 
@@ -26,7 +32,7 @@ void get_generic_spreadsheet_bounds(char *filename,
                                     AFFY_ERROR *err)
 {
   FILE *data_file;
-  int max_string_len = 0;
+  LINE_READER *lr;
   char *string = NULL;
   char **fields = NULL;
   char *sptr;
@@ -41,9 +47,16 @@ void get_generic_spreadsheet_bounds(char *filename,
   data_file = fopen(filename, "rb");
   if (!data_file)
     AFFY_HANDLE_ERROR_VOID("can not open data file", AFFY_ERROR_NOTFOUND, err);
+
+  lr = line_reader_init(data_file);
+  if (lr == NULL)
+  {
+    fclose(data_file);
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+  }
   
   /* read header line */
-  fgets_strip_realloc(&string, &max_string_len, data_file);
+  string = line_reader_next(lr, NULL);
   num_fields = split_tabs(string, &fields, &max_field);
   
   /* first field is probe, the rest are samples, skip empty columns */
@@ -68,7 +81,7 @@ void get_generic_spreadsheet_bounds(char *filename,
   /* assume only a single line per probe */
   /* multiple identical probes will be treated as separate probes */
   /* skip blank probes */
-  while(fgets_strip_realloc(&string, &max_string_len, data_file))
+  while ((string = line_reader_next(lr, NULL)) != NULL)
   {
     num_fields = split_tabs(string, &fields, &max_field);
 
@@ -92,8 +105,267 @@ void get_generic_spreadsheet_bounds(char *filename,
   *return_max_cols = max_cols;
   *return_max_rows = max_rows;
   
-  if (string)
-    free(string);
+  line_reader_free(lr);
   if (fields)
     free(fields);
 }
+
+
+/* initial number of rows allocated per column, doubled as needed */
+#define SPREADSHEET_INITIAL_ROWS  4096
+
+/*
+ * Wrap one finished column of values in a chip, the same way the
+ * generic CDF expects it: numprobes rows of 1 column.  The column is
+ * adopted, not copied.
+ */
+static AFFY_CHIP *create_generic_chip(const char *name,
+                                      AFFY_CELL *column,
+                                      unsigned int numprobes,
+                                      AFFY_ERROR *err)
+{
+  AFFY_CHIP    *chip;
+  AFFY_CELFILE *cf;
+  unsigned int  j;
+
+  chip = h_calloc(1, sizeof(AFFY_CHIP));
+  if (chip == NULL)
+    AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, NULL);
+
+  cf = h_subcalloc(chip, 1, sizeof(AFFY_CELFILE));
+  if (cf == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+  chip->cel = cf;
+
+  chip->filename = h_strdup(name);
+  if (chip->filename == NULL)
+    AFFY_HANDLE_ERROR_GOTO("strdup failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+  hattach(chip->filename, chip);
+
+  cf->filename = h_strdup(name);
+  if (cf->filename == NULL)
+    AFFY_HANDLE_ERROR_GOTO("strdup failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+  hattach(cf->filename, cf);
+
+  cf->numrows     = numprobes;
+  cf->numcols     = 1;
+  cf->nummasks    = 0;
+  cf->numoutliers = 0;
+  cf->mask        = NULL;
+  cf->outlier     = NULL;
+
+  cf->data = h_subcalloc(cf, cf->numrows, sizeof(AFFY_CELL *));
+  if (cf->data == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+  cf->data[0] = column;
+  hattach(cf->data[0], cf->data);
+
+  for (j = 1; j < cf->numrows; j++)
+    cf->data[j] = cf->data[0] + (j * cf->numcols);
+
+  chip->cdf       = NULL;
+  chip->dat       = NULL;
+  chip->probe_set = NULL;
+  chip->pm        = NULL;
+
+  return (chip);
+
+cleanup:
+  h_free(chip);
+
+  return (NULL);
+}
+
+/*
+ * affy_load_generic_spreadsheet(): load a tab-delimited spreadsheet
+ *   (probe names in the first column, one sample per remaining column,
+ *   one header line) into a new generic chipset, reading the file only
+ *   once.  Values are collected into one growing column per sample,
+ *   which then becomes that chip's CEL data directly.
+ *
+ *   Every header column after the first is a sample and every line after
+ *   the header is a probe.  Missing values are 0, values past the last
+ *   header column are ignored.
+ */
+AFFY_CHIPSET *affy_load_generic_spreadsheet(char *filename, AFFY_ERROR *err)
+{
+  AFFY_CHIPSET  *cs = NULL;
+  FILE          *data_file;
+  LINE_READER   *lr = NULL;
+  AFFY_CELL    **columns = NULL;
+  char         **probe_names = NULL;
+  char         **sample_names = NULL;
+  char          *string;
+  char         **fields = NULL;
+  int            num_fields;
+  int            max_field = 0;
+  int           *mempool;
+  unsigned int   num_chips, numprobes = 0, max_rows;
+  unsigned int   i, j;
+
+  assert(filename != NULL);
+
+  data_file = fopen(filename, "rb");
+  if (!data_file)
+    AFFY_HANDLE_ERROR("can not open data file", AFFY_ERROR_NOTFOUND, err, NULL);
+
+  /* temporary storage lives here until it is handed to the chipset */
+  mempool = h_malloc(sizeof(int));
+  if (mempool == NULL)
+  {
+    fclose(data_file);
+    AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, NULL);
+  }
+
+  lr = line_reader_init(data_file);
+  if (lr == NULL)
+    AFFY_HANDLE_ERROR_GOTO("malloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+  /* read header line, first field is probe, the rest are samples */
+  string = line_reader_next(lr, NULL);
+  if (string == NULL)
+    AFFY_HANDLE_ERROR_GOTO("missing spreadsheet header line",
+                           AFFY_ERROR_BADFORMAT, err, cleanup);
+
+  num_fields = split_tabs(string, &fields, &max_field);
+  num_chips  = num_fields - 1;
+
+  sample_names = h_subcalloc(mempool, num_chips + 1, sizeof(char *));
+  columns      = h_subcalloc(mempool, num_chips + 1, sizeof(AFFY_CELL *));
+  if (sample_names == NULL || columns == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+  max_rows = SPREADSHEET_INITIAL_ROWS;
+
+  probe_names = h_subcalloc(mempool, max_rows, sizeof(char *));
+  if (probe_names == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+  for (i = 0; i < num_chips; i++)
+  {
+    sample_names[i] = h_strdup(fields[i + 1]);
+    if (sample_names[i] == NULL)
+      AFFY_HANDLE_ERROR_GOTO("strdup failed",
+                             AFFY_ERROR_OUTOFMEM, err, cleanup);
+    hattach(sample_names[i], mempool);
+
+    columns[i] = h_subcalloc(mempool, max_rows, sizeof(AFFY_CELL));
+    if (columns[i] == NULL)
+      AFFY_HANDLE_ERROR_GOTO("calloc failed",
+                             AFFY_ERROR_OUTOFMEM, err, cleanup);
+  }
+
+  /* assume only a single line per probe */
+  /* multiple identical probes will be treated as separate probes */
+  while ((string = line_reader_next(lr, NULL)) != NULL)
+  {
+    num_fields = split_tabs(string, &fields, &max_field);
+
+    if (numprobes == max_rows)
+    {
+      char **new_names;
+
+      max_rows *= 2;
+
+      new_names = h_realloc(probe_names, max_rows * sizeof(char *));
+      if (new_names == NULL)
+        AFFY_HANDLE_ERROR_GOTO("realloc failed",
+                               AFFY_ERROR_OUTOFMEM, err, cleanup);
+      probe_names = new_names;
+
+      for (i = 0; i < num_chips; i++)
+      {
+        AFFY_CELL *new_column;
+
+        new_column = h_realloc(columns[i], max_rows * sizeof(AFFY_CELL));
+        if (new_column == NULL)
+          AFFY_HANDLE_ERROR_GOTO("realloc failed",
+                                 AFFY_ERROR_OUTOFMEM, err, cleanup);
+        columns[i] = new_column;
+      }
+    }
+
+    /* probeset name */
+    probe_names[numprobes] = h_strdup(fields[0]);
+    if (probe_names[numprobes] == NULL)
+      AFFY_HANDLE_ERROR_GOTO("strdup failed",
+                             AFFY_ERROR_OUTOFMEM, err, cleanup);
+    hattach(probe_names[numprobes], mempool);
+
+    /* store intensity data */
+    for (i = 0; i < num_chips; i++)
+    {
+      AFFY_CELL *cell = &columns[i][numprobes];
+
+      cell->value     = (i + 1 < num_fields) ?
+                        strtod_fast(fields[i + 1], NULL) : 0.0;
+#ifdef STORE_CEL_QC
+      cell->stddev    = 0;
+      cell->numpixels = 0;
+      cell->pixels    = NULL;
+#endif
+    }
+
+    numprobes++;
+  }
+
+  cs = create_blank_generic_chipset(num_chips, numprobes, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+  for (j = 0; j < numprobes; j++)
+  {
+    cs->cdf->probeset[j].name = probe_names[j];
+    hattach(probe_names[j], cs->cdf);
+
+    if (affy_is_control_string(probe_names[j]))
+      cs->cdf->ps_flags[j] |= AFFY_PS_CONTROL;
+  }
+
+  affy_cdf_build_name_index(cs->cdf, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+  for (i = 0; i < num_chips; i++)
+  {
+    AFFY_CHIP *chip;
+
+    /* give back the unused tail of the column */
+    if (numprobes && numprobes < max_rows)
+    {
+      AFFY_CELL *new_column;
+
+      new_column = h_realloc(columns[i], numprobes * sizeof(AFFY_CELL));
+      if (new_column != NULL)
+        columns[i] = new_column;
+    }
+
+    chip = create_generic_chip(sample_names[i], columns[i], numprobes, err);
+    AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+    chip->cdf   = cs->cdf;
+    chip->store = cs->store;
+
+    cs->chip[i] = chip;
+    hattach(chip, cs->chip);
+    cs->num_chips++;
+  }
+
+cleanup:
+  fclose(data_file);
+
+  line_reader_free(lr);
+  if (fields)
+    free(fields);
+
+  h_free(mempool);
+
+  if (err->type != AFFY_ERROR_NONE)
+  {
+    affy_free_chipset(cs);
+
+    return (NULL);
+  }
+
+  return (cs);
+}
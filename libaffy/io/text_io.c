@@ -18,9 +18,12 @@
  * 03/18/08: Thread safety improvements (AMH)
  * 09/20/10: Pooled memory allocator (AMH)
  * 09/05/23: modifications to replace fgets() with EOL-safe function
+ * 10/16/26: read through a buffered LINE_READER instead of fgetc() (EAW)
  *
  **************************************************************************/
 
+#include <ctype.h>
+
 #include <affy.h>
 #include <utils.h>
 
@@ -35,11 +38,9 @@ void affy_textio_free(AFFY_TEXTIO *tf)
 {
   assert(tf != NULL);
   
-  /* free buffer, which was allocated with malloc() instead of h_free() */
-  if (tf->buf)
-    free(tf->buf);
-  tf->buf         = NULL;
-  tf->max_buf_len = 0;
+  /* line reader was allocated with malloc() instead of h_alloc() */
+  line_reader_free(tf->lr);
+  tf->lr = NULL;
 
   h_free(tf);
 }
@@ -47,6 +48,9 @@ void affy_textio_free(AFFY_TEXTIO *tf)
 /*
  * Initialize an AFFY_TEXTIO structure and return it.  This must be
  * done before using the text I/O routines.
+ *
+ * The text I/O layer reads ahead of the stream position, so nothing
+ * else should read from fp until the AFFY_TEXTIO is freed.
  */
 AFFY_TEXTIO *affy_textio_init(FILE *fp, AFFY_ERROR *err)
 {
@@ -58,12 +62,10 @@ AFFY_TEXTIO *affy_textio_init(FILE *fp, AFFY_ERROR *err)
   if (tf == NULL)
     AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, NULL);
 
-  tf->skip_read   = false;
-  tf->fp          = fp;
-  tf->buf         = calloc(MAXBUF, sizeof(char));   /* don't use h_alloc() */
-  tf->max_buf_len = MAXBUF;   /* needed for fgets_strip_realloc() */
+  tf->fp = fp;
+  tf->lr = line_reader_init(fp);   /* don't use h_alloc() */
 
-  if (tf->buf == NULL)
+  if (tf->lr == NULL)
   {
     h_free(tf);
     
@@ -76,46 +78,47 @@ AFFY_TEXTIO *affy_textio_init(FILE *fp, AFFY_ERROR *err)
 /* Read a single line from the data file, trim it, and return it */
 char *affy_textio_get_next_line(AFFY_TEXTIO *tf)
 {
-  char *p = NULL;
+  char   *p, *end;
+  size_t  len;
 
   assert(tf != NULL);
 
-  while (1)
+  /* Trim the whitespace, skip empty lines */
+  while ((p = line_reader_next(tf->lr, &len)) != NULL)
   {
-    /* A special flag allows us to unget a line */
-    if (tf->skip_read)
-    {
-      tf->skip_read = false;
-    }
-    else if (fgets_strip_realloc(&(tf->buf),
-                                 &(tf->max_buf_len), tf->fp) == NULL)
-    {
-      return (NULL);
-    }
+    end = p + len;
 
-    /* Trim the whitespace */
-    p = trim(tf->buf);
+    while (p < end && isspace((unsigned char)*p))
+      p++;
+    while (end > p && isspace((unsigned char)end[-1]))
+      end--;
 
-    /* If not empty, return it */
-    if (strlen(p) > 0)
+    if (p < end)
+    {
+      *end = '\0';
       return (p);
+    }
   }
 
-  /* Not reached */
+  return (NULL);
 }
 
+/*
+ * The next call to affy_textio_get_next_line() returns the same line
+ * again.  Only the most recent line can be pushed back.
+ */
 void affy_textio_unget_next_line(AFFY_TEXTIO *tf)
 {
   assert(tf != NULL);
 
-  tf->skip_read = true;
+  line_reader_unget(tf->lr);
 }
 
 void affy_textio_reset_next_line(AFFY_TEXTIO *tf)
 {
   assert(tf != NULL);
 
-  tf->skip_read = false;
+  line_reader_reset_unget(tf->lr);
 }
 
 void affy_textio_skip_to_next_header(AFFY_TEXTIO *tf)
@@ -16,6 +16,8 @@
  * --------------
  * 10/08/10: Initial creation (AMH)
  * 03/10/14: #ifdef out CEL qc fields to save memory (EAW)
+ * 10/16/26: read cells through the cell accessors (EAW)
+ * 10/16/26: write masks/outliers straight from their sorted lists (EAW)
  *
  **************************************************************************/
 
@@ -179,39 +181,30 @@ static void write_intensity_section(FILE *fp,
     for (x = 0; x < cp->cel->numcols; x++)
     {
       affy_float32 tmp_f;
-
-#ifndef STORE_CEL_QC
       affy_int16   tmp_i16;
-#endif
 
-      tmp_f = cp->cel->data[x][y].value;
+      tmp_f = affy_cel_value(cp->cel, x, y);
       if (affy_write32_le(fp, &tmp_f) != 0)
         AFFY_HANDLE_ERROR_VOID("I/O error writing binary CEL file",
                                AFFY_ERROR_IO,
                                err);
 
 #ifdef STORE_CEL_QC
-      tmp_f = cp->cel->data[x][y].stddev;
+      tmp_f   = affy_cel_stddev(cp->cel, x, y);
+      tmp_i16 = affy_cel_numpixels(cp->cel, x, y);
 #else
-      tmp_f = 0.0;
+      tmp_f   = 0.0;
+      tmp_i16 = 1;
 #endif
       if (affy_write32_le(fp, &tmp_f) != 0)
         AFFY_HANDLE_ERROR_VOID("I/O error writing binary CEL file",
                                AFFY_ERROR_IO,
                                err);
 
-#ifdef STORE_CEL_QC
-      if (affy_write16_le(fp, &(cp->cel->data[x][y].numpixels)) != 0)
-        AFFY_HANDLE_ERROR_VOID("I/O error writing binary CEL file",
-                               AFFY_ERROR_IO,
-                               err);
-#else
-      tmp_i16 = 1;
       if (affy_write16_le(fp, &tmp_i16) != 0)
         AFFY_HANDLE_ERROR_VOID("I/O error writing binary CEL file",
                                AFFY_ERROR_IO,
                                err);
-#endif
       
       pb_tick(pbs, 1, "");
     }
@@ -219,52 +212,48 @@ static void write_intensity_section(FILE *fp,
   pb_finish(pbs, "%" AFFY_PRNu32 " cells", num_cells);
 }
 
-static void write_mask_section(FILE *fp, 
-                               AFFY_CHIP *cp,
-                               AFFY_ERROR *err)
+/* cells are sorted linear indices, which come out in x-major order */
+static void write_cell_list(FILE *fp,
+                            const affy_uint32 *cells,
+                            affy_uint32 num_cells,
+                            affy_int32 numrows,
+                            AFFY_ERROR *err)
 {
-  affy_int16 x, y;
+  affy_uint32 k;
+  affy_int16  x, y;
 
-  if (cp->cel->nummasks == 0)
+  if (cells == NULL)
     return;
 
-  for (x = 0; x < cp->cel->numcols; x++)
-    for (y = 0; y < cp->cel->numrows; y++)
-      if (affy_ismasked(cp, x, y))
-      {
-        if (affy_write16_le(fp, &x) != 0)
-          AFFY_HANDLE_ERROR_VOID("I/O error writing binary CEL file",
-                                 AFFY_ERROR_IO,
-                                 err);
-
-        if (affy_write16_le(fp, &y) != 0)
-          AFFY_HANDLE_ERROR_VOID("I/O error writing binary CEL file",
-                                 AFFY_ERROR_IO,
-                                 err);
-      }
+  for (k = 0; k < num_cells; k++)
+  {
+    x = cells[k] / numrows;
+    y = cells[k] % numrows;
+
+    if (affy_write16_le(fp, &x) != 0)
+      AFFY_HANDLE_ERROR_VOID("I/O error writing binary CEL file",
+                             AFFY_ERROR_IO,
+                             err);
+
+    if (affy_write16_le(fp, &y) != 0)
+      AFFY_HANDLE_ERROR_VOID("I/O error writing binary CEL file",
+                             AFFY_ERROR_IO,
+                             err);
+  }
+}
+
+static void write_mask_section(FILE *fp, 
+                               AFFY_CHIP *cp,
+                               AFFY_ERROR *err)
+{
+  write_cell_list(fp, cp->cel->mask, cp->cel->nummasks, cp->cel->numrows,
+                  err);
 }
 
 static void write_outlier_section(FILE *fp, 
                                   AFFY_CHIP *cp, 
                                   AFFY_ERROR *err)
 {
-  affy_int16 x, y;
-
-  if (cp->cel->numoutliers == 0)
-    return;
-
-  for (x = 0; x < cp->cel->numcols; x++)
-    for (y = 0; y < cp->cel->numrows; y++)
-      if (affy_isoutlier(cp, x, y))
-      {
-        if (affy_write16_le(fp, &x) != 0)
-          AFFY_HANDLE_ERROR_VOID("I/O error writing binary CEL file",
-                                 AFFY_ERROR_IO,
-                                 err);
-
-        if (affy_write16_le(fp, &y) != 0)
-          AFFY_HANDLE_ERROR_VOID("I/O error writing binary CEL file",
-                                 AFFY_ERROR_IO,
-                                 err);
-      }
+  write_cell_list(fp, cp->cel->outlier, cp->cel->numoutliers,
+                  cp->cel->numrows, err);
 }
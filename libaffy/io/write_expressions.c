@@ -21,6 +21,10 @@
  * 10/19/10: Add unlog option (AMH)
  * 08/12/20: use ProbeID as top-left header instead of output filename (EAW)
  * 08/12:20: if log/unlog transform, print missing (original 0) data as blanks (EAW)
+ * 10/16/26: format numbers with fmt_fixed()/fmt_exp() into an OUTPUT_BUFFER,
+ *           instead of one fprintf() per value (EAW)
+ * 10/16/26: factor out the log/unlog transform into
+ *           affy_expression_value(), shared with the GCT/binary writers (EAW)
  *
  **************************************************************************/
 
@@ -29,38 +33,68 @@
 #include "affy_mas5.h"
 #include "math.h"
 
+/*
+ * affy_expression_value(): the value the expression writers output for
+ *   data, after any log/unlog transform requested in opts
+ *   (AFFY_WRITE_EXPR_LOG/AFFY_WRITE_EXPR_UNLOG).
+ *
+ * Inputs: data is the probeset expression value, opts the writer options.
+ * Outputs: the transformed value; *missing is set if the value should be
+ *          written as missing (blank, or NaN in binary output).
+ * Side effects: None.
+ */
+double affy_expression_value(double data, unsigned int opts, bool *missing)
+{
+  unsigned int unlog_flag = opts & AFFY_WRITE_EXPR_UNLOG;
+  unsigned int log_flag   = opts & AFFY_WRITE_EXPR_LOG;
+
+  /* assume a value this close to zero is supposed to be zero */
+  *missing = false;
+  if ((log_flag || unlog_flag) && fabs(data) < 1E-14)
+    *missing = true;
+
+  /* preserve missing data */
+  if (data)
+  {
+    if (unlog_flag && !log_flag)
+      data = pow(2.0, data);
+    else if (log_flag && !unlog_flag)
+      data = log(data) / log(2.0);
+  }
+
+  return (data);
+}
+
 void affy_write_expressions(AFFY_CHIPSET *c, 
                             char         *filename, 
                             unsigned int  opts,
                             AFFY_ERROR   *err)
 {
-  unsigned int n, i, print_pa, unlog_flag, log_flag;
-  int          ret;
-  FILE        *fp;
-  double       log2 = log(2.0);
-  int          missing;
+  unsigned int   n, i, print_pa;
+  FILE          *fp;
+  OUTPUT_BUFFER *ob;
+  bool           missing;
 
   assert(filename != NULL);
   assert(c        != NULL);
 
-  print_pa   = opts & AFFY_WRITE_EXPR_PA;
-  unlog_flag = opts & AFFY_WRITE_EXPR_UNLOG;
-  log_flag   = opts & AFFY_WRITE_EXPR_LOG;
+  print_pa = opts & AFFY_WRITE_EXPR_PA;
 
   fp = fopen(filename, "w");
   if (fp == NULL)
     AFFY_HANDLE_ERROR_VOID("couldn't open output file", AFFY_ERROR_IO, err);
 
-  /* Print the header first */
-  /* if (fprintf(fp, "%s\t", filename) < 0) */
-  if (fprintf(fp, "%s\t", "ProbeID") < 0)
+  ob = output_buffer_init(fp);
+  if (ob == NULL)
   {
     fclose(fp);
-    AFFY_HANDLE_ERROR_VOID("I/O error writing expressions", 
-                           AFFY_ERROR_IO, 
-                           err);
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
   }
 
+  /* Print the header first */
+  /* output_buffer_printf(ob, "%s\t", filename); */
+  output_buffer_puts(ob, "ProbeID\t");
+
   for (i = 0; i < c->num_chips; i++) 
   {
     char *filestem = stem_from_filename_safer(c->chip[i]->filename);
@@ -68,6 +102,7 @@ void affy_write_expressions(AFFY_CHIPSET *c,
 
     if (filestem == NULL)
     {
+      output_buffer_free(ob);
       fclose(fp);
       AFFY_HANDLE_ERROR_VOID("stem_from_filename_safer failed", 
                              AFFY_ERROR_OUTOFMEM,
@@ -78,24 +113,16 @@ void affy_write_expressions(AFFY_CHIPSET *c,
 
     if (print_pa)
     {
-      ret = fprintf(fp, "%s_EXTR\t%s_CALL\t%s_PVAL%c", 
-                    filestem,
-                    filestem,
-                    filestem,
-                    sep);
+      output_buffer_printf(ob, "%s_EXTR\t%s_CALL\t%s_PVAL%c", 
+                           filestem,
+                           filestem,
+                           filestem,
+                           sep);
     }
     else
     {
-      ret = fprintf(fp, "%s%c", filestem, sep);
-    }
-
-    if (ret < 0)
-    {
-      fclose(fp);
-      free(filestem);
-      AFFY_HANDLE_ERROR_VOID("I/O error writing expressions", 
-                             AFFY_ERROR_IO, 
-                             err);
+      output_buffer_puts(ob, filestem);
+      output_buffer_putc(ob, sep);
     }
 
     free(filestem);
@@ -105,60 +132,49 @@ void affy_write_expressions(AFFY_CHIPSET *c,
   for (i = 0; i < c->cdf->numprobesets; i++)
   {
     /* checking for write errors once per row should be quite sufficient */
-    if (fprintf(fp, "%s", c->cdf->probeset[i].name) < 0)
+    if (output_buffer_error(ob))
       goto err;
 
+    output_buffer_puts(ob, c->cdf->probeset[i].name);
+
     for (n = 0; n < c->num_chips; n++) 
     {
-      double data = c->chip[n]->probe_set[i];
-
-      /* assume a value this close to zero is supposed to be zero */
-      missing = 0;
-      if ((log_flag || unlog_flag) && fabs(data) < 1E-14)
-        missing = 1;
-      
-      /* preserve missing data */
-      if (data)
-      {
-        if (unlog_flag && !log_flag)
-          data = pow(2.0, data);
-        else if (log_flag && !unlog_flag)
-          data = log(data) / log2;
-      }
-      
+      double data = affy_expression_value(c->chip[n]->probe_set[i],
+                                          opts,
+                                          &missing);
+
       /* print blank (missing) for log2 of zero */
-      if (missing)
-      {
-        if (fprintf(fp, "\t") < 0)
-          goto err;
-      }
-      else
-      {
-        if (fprintf(fp, "\t%f", data) < 0)
-          goto err;
-      }
+      output_buffer_putc(ob, '\t');
+      if (!missing)
+        output_buffer_fixed(ob, data, 6);
 
       if (print_pa)
       {
         double pvalue = c->chip[n]->probe_set_call_pvalue[i];
 
-        if (fprintf(fp, "\t%c", affy_mas5_pvalue_call(pvalue)) < 0)
-          goto err;
-        if (fprintf(fp, "\t%e", pvalue) < 0)
-          goto err; 
+        output_buffer_putc(ob, '\t');
+        output_buffer_putc(ob, affy_mas5_pvalue_call(pvalue));
+        output_buffer_putc(ob, '\t');
+        output_buffer_exp(ob, pvalue, 6);
       }
     }
 
-    if (fprintf(fp, "\n") < 0)
-      goto err;
+    output_buffer_putc(ob, '\n');
   }
   
-  fclose(fp);
+  if (output_buffer_free(ob) != 0)
+  {
+    ob = NULL;
+    goto err;
+  }
+
+  if (fclose(fp) != 0)
+    AFFY_HANDLE_ERROR_VOID("I/O error writing expressions", AFFY_ERROR_IO, err);
 
   return;
 
 err:
+  output_buffer_free(ob);
   fclose(fp);
   AFFY_HANDLE_ERROR_VOID("I/O error writing expressions", AFFY_ERROR_IO, err);
 }
-
@@ -0,0 +1,257 @@
+/**************************************************************************
+ *
+ * Filename:  write_expressions_binary.c
+ *
+ * Purpose:   Write expression data from a set of chips as a binary,
+ *            memory-mappable matrix.
+ *
+ * Creation:  October 16th, 2026
+ *
+ * Author:    Eric A. Welsh
+ *
+ * Copyright: Copyright (C) 2026, Moffitt Cancer Center.
+ *            All rights reserved.
+ *
+ * Update History
+ * --------------
+ * 10/16/26: Creation (EAW)
+ * 10/16/26: share affy_expression_value() with the text writers, compute
+ *           the matrix offsets in size_t (EAW)
+ *
+ **************************************************************************/
+
+#include "affy.h"
+#include "utils.h"
+#include "affy_mas5.h"
+#include "math.h"
+
+/*
+ * The layout is described with AFFY_EXPR_BINARY_HEADER in affy.h.  The
+ * values are the same as affy_write_expressions() would print (both go
+ * through affy_expression_value(), with NaN in place of blanks), but
+ * written a row at a time instead of one fprintf() per value, and
+ * without any rounding to 6 decimal places.
+ */
+
+#define EXPR_BINARY_ALIGN 8
+
+#define EXPR_BINARY_PAD(x) \
+  (((x) + EXPR_BINARY_ALIGN - 1) & ~((size_t)EXPR_BINARY_ALIGN - 1))
+
+/* which matrix write_plane() writes */
+#define EXPR_PLANE_DATA   0
+#define EXPR_PLANE_PVALUE 1
+#define EXPR_PLANE_CALL   2
+
+/* size_t may be only 32 bits wide, so shift the high half in two steps */
+static void split_offset(size_t offset, affy_uint32 *lo, affy_uint32 *hi)
+{
+  *lo = (affy_uint32)(offset & 0xFFFFFFFFU);
+  *hi = (affy_uint32)((offset >> 16) >> 16);
+}
+
+static int write_zeroes(FILE *fp, size_t len)
+{
+  static const char zeroes[EXPR_BINARY_ALIGN] = { 0 };
+
+  return (len && fwrite(zeroes, 1, len, fp) != len);
+}
+
+/* Write one whole matrix, a row (probeset) at a time. */
+static int write_plane(FILE *fp,
+                       AFFY_CHIPSET *c,
+                       int plane,
+                       unsigned int opts,
+                       void *row)
+{
+  unsigned int n, i;
+  size_t       value_size;
+  double       value;
+  bool         missing;
+
+  if (plane == EXPR_PLANE_CALL)
+    value_size = 1;
+  else if (opts & AFFY_WRITE_EXPR_FLOAT32)
+    value_size = sizeof(float);
+  else
+    value_size = sizeof(double);
+
+  for (i = 0; i < c->cdf->numprobesets; i++)
+  {
+    for (n = 0; n < c->num_chips; n++)
+    {
+      if (plane == EXPR_PLANE_CALL)
+      {
+        ((char *)row)[n] =
+          affy_mas5_pvalue_call(c->chip[n]->probe_set_call_pvalue[i]);
+        continue;
+      }
+
+      if (plane == EXPR_PLANE_PVALUE)
+        value = c->chip[n]->probe_set_call_pvalue[i];
+      else
+      {
+        value = affy_expression_value(c->chip[n]->probe_set[i],
+                                      opts,
+                                      &missing);
+        if (missing)
+          value = NAN;
+      }
+
+      if (value_size == sizeof(float))
+        ((float *)row)[n] = (float)value;
+      else
+        ((double *)row)[n] = value;
+    }
+
+    if (fwrite(row, value_size, c->num_chips, fp) != c->num_chips)
+      return (-1);
+  }
+
+  return (0);
+}
+
+void affy_write_expressions_binary(AFFY_CHIPSET *c,
+                                   char         *filename,
+                                   unsigned int  opts,
+                                   AFFY_ERROR   *err)
+{
+  AFFY_EXPR_BINARY_HEADER hdr;
+  unsigned int            n, i, print_pa;
+  FILE                   *fp       = NULL;
+  char                  **stems    = NULL;
+  void                   *row      = NULL;
+  size_t                  names_len = 0, header_end, matrix_pad;
+  size_t                  offset, matrix_bytes;
+
+  assert(filename != NULL);
+  assert(c        != NULL);
+  assert(c->cdf   != NULL);
+
+  print_pa = opts & AFFY_WRITE_EXPR_PA;
+
+  memset(&hdr, 0, sizeof(AFFY_EXPR_BINARY_HEADER));
+  memcpy(hdr.magic, AFFY_EXPR_BINARY_MAGIC, sizeof(hdr.magic));
+  hdr.version     = AFFY_EXPR_BINARY_VERSION;
+  hdr.byte_order  = AFFY_EXPR_BINARY_BYTE_ORDER;
+  hdr.header_size = sizeof(AFFY_EXPR_BINARY_HEADER);
+  hdr.value_size  = (opts & AFFY_WRITE_EXPR_FLOAT32) ? sizeof(float)
+                                                     : sizeof(double);
+  hdr.numrows     = c->cdf->numprobesets;
+  hdr.numcols     = c->num_chips;
+  hdr.flags       = opts;
+
+  /* sample names, same as the text output */
+  stems = h_calloc(c->num_chips + 1, sizeof(char *));
+  if (stems == NULL)
+    AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
+
+  for (n = 0; n < c->num_chips; n++)
+  {
+    char *filestem = stem_from_filename_safer(c->chip[n]->filename);
+
+    if (filestem == NULL)
+      AFFY_HANDLE_ERROR_GOTO("stem_from_filename_safer failed",
+                             AFFY_ERROR_OUTOFMEM,
+                             err,
+                             cleanup);
+
+    stems[n] = h_strdup(filestem);
+    free(filestem);
+
+    if (stems[n] == NULL)
+      AFFY_HANDLE_ERROR_GOTO("strdup failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+    hattach(stems[n], stems);
+    names_len += strlen(stems[n]) + 1;
+  }
+
+  for (i = 0; i < c->cdf->numprobesets; i++)
+    names_len += strlen(c->cdf->probeset[i].name) + 1;
+
+  hdr.names_len = names_len;
+
+  /* lay out the matrices */
+  header_end   = sizeof(AFFY_EXPR_BINARY_HEADER) + names_len;
+  matrix_bytes = (size_t)hdr.numrows * hdr.numcols * hdr.value_size;
+  matrix_pad   = (hdr.value_size == sizeof(float) &&
+                  (hdr.numrows % 2) && (hdr.numcols % 2)) ? 4 : 0;
+
+  offset = EXPR_BINARY_PAD(header_end);
+  split_offset(offset, &hdr.data_offset_lo, &hdr.data_offset_hi);
+
+  if (print_pa)
+  {
+    offset += matrix_bytes + matrix_pad;
+    split_offset(offset, &hdr.pvalue_offset_lo, &hdr.pvalue_offset_hi);
+
+    offset += matrix_bytes + matrix_pad;
+    split_offset(offset, &hdr.call_offset_lo, &hdr.call_offset_hi);
+  }
+
+  row = h_malloc((c->num_chips + 1) * sizeof(double));
+  if (row == NULL)
+    AFFY_HANDLE_ERROR_GOTO("malloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+  fp = fopen(filename, "wb");
+  if (fp == NULL)
+    AFFY_HANDLE_ERROR_GOTO("couldn't open output file",
+                           AFFY_ERROR_IO,
+                           err,
+                           cleanup);
+
+  if (fwrite(&hdr, sizeof(AFFY_EXPR_BINARY_HEADER), 1, fp) != 1)
+    goto write_err;
+
+  for (i = 0; i < c->cdf->numprobesets; i++)
+  {
+    char *name = c->cdf->probeset[i].name;
+
+    if (fwrite(name, 1, strlen(name) + 1, fp) != strlen(name) + 1)
+      goto write_err;
+  }
+
+  for (n = 0; n < c->num_chips; n++)
+  {
+    if (fwrite(stems[n], 1, strlen(stems[n]) + 1, fp) != strlen(stems[n]) + 1)
+      goto write_err;
+  }
+
+  if (write_zeroes(fp, EXPR_BINARY_PAD(header_end) - header_end))
+    goto write_err;
+
+  if (write_plane(fp, c, EXPR_PLANE_DATA, opts, row))
+    goto write_err;
+
+  if (print_pa)
+  {
+    if (write_zeroes(fp, matrix_pad)                          ||
+        write_plane(fp, c, EXPR_PLANE_PVALUE, opts, row)      ||
+        write_zeroes(fp, matrix_pad)                          ||
+        write_plane(fp, c, EXPR_PLANE_CALL, opts, row))
+      goto write_err;
+  }
+
+  if (fclose(fp) != 0)
+  {
+    fp = NULL;
+    goto write_err;
+  }
+  fp = NULL;
+
+cleanup:
+  if (fp)
+    fclose(fp);
+  h_free(row);
+  h_free(stems);
+
+  return;
+
+write_err:
+  if (fp)
+    fclose(fp);
+  h_free(row);
+  h_free(stems);
+
+  AFFY_HANDLE_ERROR_VOID("I/O error writing expressions", AFFY_ERROR_IO, err);
+}
@@ -21,6 +21,9 @@
  * --------------
  * 09/04/07: File creation, copied from write_expressions.c (AMH)
  * 03/14/08: New error handling scheme (AMH)
+ * 10/16/26: format numbers with fmt_fixed() into an OUTPUT_BUFFER (EAW)
+ * 10/16/26: values go through affy_expression_value(), like the other
+ *           expression writers (EAW)
  *
  **************************************************************************/
 
@@ -31,8 +34,10 @@ void affy_write_expressions_gct(AFFY_CHIPSET *c,
                                 char *filename, 
                                 AFFY_ERROR *err)
 {
-  unsigned int n, i;
-  FILE        *fp;
+  unsigned int   n, i;
+  FILE          *fp;
+  OUTPUT_BUFFER *ob;
+  bool           missing;
 
   assert(c        != NULL);
   assert(filename != NULL);
@@ -41,59 +46,43 @@ void affy_write_expressions_gct(AFFY_CHIPSET *c,
   if (fp == NULL)
     AFFY_HANDLE_ERROR_VOID("couldn't open output file", AFFY_ERROR_IO, err);
 
-  /* First, the version string, always the same. */
-  if (fprintf(fp, "#1.2\t%s\n", c->cdf->array_type) < 0)
+  ob = output_buffer_init(fp);
+  if (ob == NULL)
   {
     fclose(fp);
-    AFFY_HANDLE_ERROR_VOID("I/O error writing expressions", 
-                           AFFY_ERROR_IO, 
-                           err);
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
   }
 
+  /* First, the version string, always the same. */
+  output_buffer_printf(ob, "#1.2\t%s\n", c->cdf->array_type);
+
   /* 
    * Next, the number of rows (probesets/genes) and columns 
    * (samples/CEL files) 
    */
-  if (fprintf(fp, "%d\t%d\n", c->cdf->numprobesets, c->num_chips) < 0)
-  {
-    fclose(fp);
-    AFFY_HANDLE_ERROR_VOID("I/O error writing expressions", 
-                           AFFY_ERROR_IO, 
-                           err);
-  }
+  output_buffer_printf(ob, "%d\t%d\n", c->cdf->numprobesets, c->num_chips);
 
   /* 
    * Next a list of the sample identifiers.  In this case we will simply
    * reuse the code from write_expressions() and print the CEL filename
    * stems, which seems reasonable.
    */
-  if (fprintf(fp, "Name\tDescription\t") < 0)
-  {
-    fclose(fp);
-    AFFY_HANDLE_ERROR_VOID("I/O error writing expressions", 
-                           AFFY_ERROR_IO, 
-                           err);
-  }
+  output_buffer_puts(ob, "Name\tDescription\t");
 
   for (i = 0; i < c->num_chips; i++) 
   {
     char *filestem = stem_from_filename_safer(c->chip[i]->filename);
     if (filestem == NULL)
     {
+      output_buffer_free(ob);
       fclose(fp);
       AFFY_HANDLE_ERROR_VOID("stem_from_filename_safer failed", 
                              AFFY_ERROR_OUTOFMEM,
                              err);
     }
 	       
-    if (fprintf(fp, "%s%c", filestem, (i < c->num_chips - 1) ? '\t' : '\n') < 0)
-    {
-      fclose(fp);
-      free(filestem);
-      AFFY_HANDLE_ERROR_VOID("I/O error writing expressions", 
-                             AFFY_ERROR_IO, 
-                             err);
-    }
+    output_buffer_puts(ob, filestem);
+    output_buffer_putc(ob, (i < c->num_chips - 1) ? '\t' : '\n');
     
     free(filestem);
   }
@@ -103,39 +92,35 @@ void affy_write_expressions_gct(AFFY_CHIPSET *c,
   {
     char *ps_name = c->cdf->probeset[i].name;
 
+    if (output_buffer_error(ob))
+      break;
+
     /* 
      * Note the difference from write_expressions() here; in GCT there
      * is a second column with a description, it isn't used by any
      * programs though so we just repeat the probeset name.
      */ 
-    if (fprintf(fp, "%s\t%s", ps_name, ps_name) < 0)
-    {
-      fclose(fp);
-      AFFY_HANDLE_ERROR_VOID("I/O error writing expressions", 
-                             AFFY_ERROR_IO, 
-                             err);
-    }
+    output_buffer_puts(ob, ps_name);
+    output_buffer_putc(ob, '\t');
+    output_buffer_puts(ob, ps_name);
 
+    /* GCT has no log/unlog options, so nothing is ever missing */
     for (n = 0; n < c->num_chips; n++)
     {
-      if (fprintf(fp, "\t%f", c->chip[n]->probe_set[i]) < 0)
-      {
-        fclose(fp);
-        AFFY_HANDLE_ERROR_VOID("I/O error writing expressions", 
-                               AFFY_ERROR_IO, 
-                               err);
-        
-      }
-    }
+      double data = affy_expression_value(c->chip[n]->probe_set[i],
+                                          AFFY_WRITE_EXPR_DEFAULT,
+                                          &missing);
 
-    if (fprintf(fp, "\n") < 0)
-    {
-      fclose(fp);
-      AFFY_HANDLE_ERROR_VOID("I/O error writing expressions", 
-                             AFFY_ERROR_IO, 
-                             err);
+      output_buffer_putc(ob, '\t');
+      if (!missing)
+        output_buffer_fixed(ob, data, 6);
     }
+
+    output_buffer_putc(ob, '\n');
   }
   
-  fclose(fp);
+  if (output_buffer_free(ob) != 0 || fclose(fp) != 0)
+    AFFY_HANDLE_ERROR_VOID("I/O error writing expressions", 
+                           AFFY_ERROR_IO, 
+                           err);
 }
@@ -19,6 +19,9 @@
  * 11/20/10: Support printing values < 0.000001 (EAW)
  * 03/17/14: changed a few variable types to be more correct,
  *            should not have any effect on results (EAW)
+ * 10/16/26: format numbers with fmt_fixed()/fmt_exp() into an
+ *           OUTPUT_BUFFER, report write errors (EAW)
+ * 10/16/26: read cells with affy_cel_value() (EAW)
  *
  **************************************************************************/
 
@@ -30,27 +33,34 @@ void affy_write_probe_values(AFFY_CHIPSET *cs,
                              int opts,
                              AFFY_ERROR *err)
 {
-  FILE        *values_file;
-  affy_int32   ps_idx, p_idx;
-  unsigned int c_idx;
+  FILE          *values_file;
+  OUTPUT_BUFFER *ob;
+  affy_int32     ps_idx, p_idx;
+  unsigned int   c_idx;
 
   if ((values_file = fopen(filename, "w")) == NULL)
     AFFY_HANDLE_ERROR_VOID("couldn't open probe values file for writing",
                            AFFY_ERROR_IO,
                            err);
 
+  if ((ob = output_buffer_init(values_file)) == NULL)
+  {
+    fclose(values_file);
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+  }
+
   /* print header */
-  /* fprintf(values_file, "%s\t", filename); */
-  fprintf(values_file, "%s\t", "ProbeID");
+  /* output_buffer_printf(ob, "%s\t", filename); */
+  output_buffer_puts(ob, "ProbeID\t");
   for (c_idx = 0; c_idx < cs->num_chips; c_idx++)
   {
-    fprintf(values_file, "%s", cs->chip[c_idx]->filename);
+    output_buffer_puts(ob, cs->chip[c_idx]->filename);
       
     if (c_idx < (cs->num_chips - 1))
-      fprintf(values_file, "\t");
+      output_buffer_putc(ob, '\t');
   }
 
-  fprintf(values_file, "\n");
+  output_buffer_putc(ob, '\n');
 
   /* print probe values */
   for (ps_idx = 0; ps_idx < cs->cdf->numprobesets; ps_idx++)
@@ -62,7 +72,9 @@ void affy_write_probe_values(AFFY_CHIPSET *cs,
       affy_int32 x_loc = ps->probe[p_idx].pm.x;
       affy_int32 y_loc = ps->probe[p_idx].pm.y;
 
-      fprintf(values_file, "%s.%" AFFY_PRNd32, ps->name, p_idx);
+      output_buffer_puts(ob, ps->name);
+      output_buffer_putc(ob, '.');
+      output_buffer_int(ob, p_idx);
 
       for (c_idx = 0; c_idx < cs->num_chips; c_idx++)
       {
@@ -75,18 +87,22 @@ void affy_write_probe_values(AFFY_CHIPSET *cs,
         }
         else
         {
-          val = c->cel->data[x_loc][y_loc].value;
+          val = affy_cel_value(c->cel, x_loc, y_loc);
         }
 
+        output_buffer_putc(ob, '\t');
         if (val < 0.000001)
-          fprintf(values_file, "\t%e", val);
+          output_buffer_exp(ob, val, 6);
         else
-          fprintf(values_file, "\t%f", val);
+          output_buffer_fixed(ob, val, 6);
       }
 
-      fprintf(values_file, "\n");
+      output_buffer_putc(ob, '\n');
     }
   }
     
-  fclose(values_file);
+  if (output_buffer_free(ob) != 0 || fclose(values_file) != 0)
+    AFFY_HANDLE_ERROR_VOID("I/O error writing probe values",
+                           AFFY_ERROR_IO,
+                           err);
 }
@@ -26,7 +26,15 @@
  * 01/10/24: don't free cel data that doesn't exist (EAW)
  * 01/10/24: pass flags to affy_mean_normalization() (EAW)
  * 04/25/24: add affy_median_normalization() (EAW)
+ * 10/16/26: read spreadsheet and saved means with LINE_READER (EAW)
+ * 10/16/26: load the spreadsheet in one pass with
+ *           affy_load_generic_spreadsheet() (EAW)
  * 
+ * 10/16/26: access cells through affy_cel_value() and friends (EAW)
+ * 10/16/26: gather PM probes through cdf->pm_cell[] (EAW)
+ * 10/16/26: per-chip arrays go through the chipset's backing store (EAW)
+ * 10/16/26: rank the chips for quantile normalization after loading, in
+ *           parallel (EAW)
  *
  **************************************************************************/
 
@@ -67,215 +75,6 @@ int strcmp_insensitive(const char *str1, const char *str2)
   return 0;
 }
 
-static void load_generic_spreadsheet(AFFY_CHIPSET *cs, char *filename,
-                                AFFY_ERROR *err)
-{
-  FILE *data_file;
-  AFFY_CHIP    *chip = NULL;
-  AFFY_CELFILE *cf   = NULL;
-  int max_string_len = 0;
-  char *string       = NULL;
-  char **fields      = NULL;
-  char *sptr;
-  int num_fields = 0;
-  int max_field  = 0;
-  int nbytes;
-
-  int numprobes = 0;
-  int ok_chip_flag, ok_probe_flag;
-  int i, j;
-  
-  data_file = fopen(filename, "rb");
-  if (!data_file)
-    AFFY_HANDLE_ERROR_VOID("can not open data file", AFFY_ERROR_NOTFOUND, err);
-  
-  /* read header line */
-  fgets_strip_realloc(&string, &max_string_len, data_file);
-  num_fields = split_tabs(string, &fields, &max_field);
-  
-  cs->num_chips = 0;
-  
-  /* allocate chips */
-  /* first field is probe, the rest are samples, skip empty columns */
-  for (i = 1; i < num_fields; i++)
-  {
-    ok_chip_flag = 0;
-
-    /* skip empty columns */
-    for (sptr = fields[i]; sptr; sptr++)
-    {
-      if (!isspace(*sptr))
-      {
-        ok_chip_flag = 1;
-        break;
-      }
-    }
-    
-    /* allocate chip */
-    if (ok_chip_flag)
-    {
-      chip = h_calloc(1, sizeof(AFFY_CHIP));
-      if (chip == NULL)
-      {
-        AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
-      }
-      
-      /* allocate CEL */
-      cf = h_calloc(1, sizeof(AFFY_CELFILE));
-      if (cf == NULL)
-        AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
-
-      cf->filename = h_strdup(fields[i]);
-      if (cf->filename == NULL)
-      {
-        AFFY_HANDLE_ERROR_VOID("strdup failed", AFFY_ERROR_OUTOFMEM, err);
-      }
-      hattach(cf->filename, cf);
-      
-      cf->numrows     = cs->numrows;
-      cf->numcols     = cs->numcols;
-      cf->nummasks    = 0;
-      cf->numoutliers = 0;
-      cf->mask        = NULL;
-      cf->outlier     = NULL;
-
-      nbytes = numbytes(cf->numcols);
-
-      cf->data = h_subcalloc(cf, cf->numrows, sizeof(AFFY_CELL *));
-      if (cf->data == NULL)
-        AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
-
-      cf->data[0] = h_subcalloc(cf->data, 
-                                cf->numcols * cf->numrows, 
-                                sizeof(AFFY_CELL));
-      if (cf->data[0] == NULL)
-        AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
-
-      cf->mask = h_subcalloc(cf, cf->numrows, sizeof(bitstr_t *));
-      if (cf->mask == NULL)
-        AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
-
-      cf->mask[0] = h_subcalloc(cf->mask, nbytes * cf->numrows, sizeof(bitstr_t));
-      if (cf->mask[0] == NULL)
-        AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
-
-      cf->outlier = h_subcalloc(cf, cf->numrows, sizeof(bitstr_t *));
-      if (cf->outlier == NULL)
-        AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
-
-      cf->outlier[0] = h_subcalloc(cf->outlier, 
-                                   nbytes * cf->numrows, 
-                                   sizeof(bitstr_t));
-      if (cf->outlier[0] == NULL)
-        AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
-      
-      for (j = 1; j < cf->numrows; j++)
-      {
-        cf->data[j]    = cf->data[0] + (j * cf->numcols);
-        cf->mask[j]    = cf->mask[0] + (j * nbytes);
-        cf->outlier[j] = cf->outlier[0] + (j * nbytes);
-      }
-
-      chip->cdf       = NULL;
-      chip->cel       = cf;
-      chip->dat       = NULL;
-      chip->filename  = NULL;
-      chip->probe_set = NULL;
-      chip->pm        = NULL;
-
-      hattach(chip->cel, chip);
-
-      chip->filename = h_strdup(fields[i]);
-      if (chip->filename == NULL)
-      {
-        affy_free_chip(chip);
-
-        AFFY_HANDLE_ERROR_VOID("strdup failed", AFFY_ERROR_OUTOFMEM, err);
-      }
-      hattach(chip->filename, chip);
-
-      cs->chip[cs->num_chips] = chip;
-      hattach(cs->chip[cs->num_chips], cs->chip);
-      cs->chip[cs->num_chips]->cdf = cs->cdf;
-      cs->num_chips++;
-    }
-  }
-
-  /* assume only a single line per probe */
-  /* multiple identical probes will be treated as separate probes */
-  /* skip blank probes */
-  while(fgets_strip_realloc(&string, &max_string_len, data_file))
-  {
-    num_fields = split_tabs(string, &fields, &max_field);
-
-    ok_probe_flag = 0;
-
-    /* skip empty columns */
-    for (sptr = fields[0]; sptr; sptr++)
-    {
-      if (!isspace(*sptr))
-      {
-        ok_probe_flag = 1;
-        break;
-      }
-    }
-    
-    if (ok_probe_flag)
-    {
-      /* probeset name */
-      cs->cdf->probeset[numprobes].name = h_strdup(fields[0]);
-      if (cs->cdf->probeset[numprobes].name == NULL)
-      {
-        AFFY_HANDLE_ERROR_VOID("strdup failed", AFFY_ERROR_OUTOFMEM, err);
-      }
-      hattach(cs->cdf->probeset[numprobes].name, cs->cdf);
-
-
-      cs->num_chips = 0;
-
-      for (i = 1; i < num_fields; i++)
-      {
-        ok_chip_flag = 0;
-
-        /* skip empty columns */
-        for (sptr = fields[i]; sptr; sptr++)
-        {
-          if (!isspace(*sptr))
-          {
-            ok_chip_flag = 1;
-            break;
-          }
-        }
-
-        /* store intensity data */
-        if (ok_chip_flag)
-        {
-          chip = cs->chip[cs->num_chips];
-          cf   = chip->cel;
-
-          cf->data[0][numprobes].value     = atof(fields[i]);
-#ifdef STORE_CEL_QC
-          cf->data[0][numprobes].stddev    = 0;
-          cf->data[0][numprobes].numpixels = 0;
-          cf->data[0][numprobes].pixels    = NULL;
-#endif
-          
-          cs->num_chips++;
-        }
-      }
-
-      numprobes++;
-    }
-  }
-  
-  fclose(data_file);
-
-  if (string)
-    free(string);
-  if (fields)
-    free(fields);
-}
-
 static void load_pm(AFFY_CHIP *cp, AFFY_ERROR *err)
 {
   affy_int32 numprobes, k;
@@ -283,25 +82,19 @@ static void load_pm(AFFY_CHIP *cp, AFFY_ERROR *err)
   assert(cp            != NULL);
   assert(cp->cdf       != NULL);
   assert(cp->cel       != NULL);
-  assert(cp->cel->data != NULL);
+  assert(affy_cel_has_data(cp->cel));
 
   numprobes = cp->cdf->numprobes;
 
-  cp->pm = h_subcalloc(cp, numprobes, sizeof(double));
+  cp->pm = affy_backing_store_calloc(cp->store, cp, numprobes,
+                                     sizeof(double));
   if (cp->pm == NULL)
     AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
   
   for (k = 0; k < numprobes; k++)
-  {
-    int x = cp->cdf->probe[k]->pm.x;
-    int y = cp->cdf->probe[k]->pm.y;
+    cp->pm[k] = affy_cel_value_at(cp->cel, cp->cdf->pm_cell[k]);
 
-    cp->pm[k] = cp->cel->data[x][y].value;
-  }
-
-  if (cp->cel->data)
-    h_free(cp->cel->data);
-  cp->cel->data = NULL;
+  affy_free_cel_data(cp->cel);
 }
 
 
@@ -312,7 +105,7 @@ int fill_probesets_with_probes(AFFY_CHIPSET *cs,
   affy_int32    x, y, numprobes, numprobesets;
   affy_uint32  i, p;
   AFFY_CDFFILE *cdf;
-  AFFY_CELL   **chip_data;
+  AFFY_CELFILE *chip_cel;
 
   assert(cs              != NULL);
   assert(cs->cdf         != NULL);
@@ -329,14 +122,16 @@ int fill_probesets_with_probes(AFFY_CHIPSET *cs,
   {
     assert(numprobes == numprobesets);
 
-    cs->chip[i]->probe_set = h_subcalloc(cs->chip[i], numprobesets,
-                                         sizeof(double));
+    cs->chip[i]->probe_set = affy_backing_store_calloc(cs->chip[i]->store,
+                                                       cs->chip[i],
+                                                       numprobesets,
+                                                       sizeof(double));
     if (cs->chip[i]->probe_set == NULL)
       AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, err);
 
     cs->chip[i]->numprobesets = numprobesets;
 
-    chip_data = cs->chip[i]->cel->data;
+    chip_cel = cs->chip[i]->cel;
 
     if (cs->chip[i]->pm)
     {
@@ -345,14 +140,14 @@ int fill_probesets_with_probes(AFFY_CHIPSET *cs,
         cs->chip[i]->probe_set[p] = cs->chip[i]->pm[p];
       }
     }
-    if (cdf->probe && chip_data)
+    if (cdf->probe && affy_cel_has_data(chip_cel))
     {
       for (p = 0; p < numprobes; p++)
       {
         x = cdf->probe[p]->pm.x;
         y = cdf->probe[p]->pm.y;
 
-        cs->chip[i]->probe_set[p] = chip_data[x][y].value;
+        cs->chip[i]->probe_set[p] = affy_cel_value(chip_cel, x, y);
       }
     }
   }
@@ -401,21 +196,15 @@ AFFY_CHIPSET *affy_illumina(char **filelist, AFFY_COMBINED_FLAGS *f,
   hattach(chip_type, mempool);
 #endif
 
-  /* scan for max probes and max chips */
+  /* Read in data, sizing the chipset as it goes */
   /* only read data in from the first file, ignore all others */
-  get_generic_spreadsheet_bounds(filelist[0], &numprobes, &max_chips, err);
+  result = affy_load_generic_spreadsheet(filelist[0], err);
   AFFY_CHECK_ERROR_GOTO(err, cleanup);
-  
-  info("NumSamples:\t%d\tNumProbes:\t%d", max_chips, numprobes);
-
 
-  /* Create structure */
-  result = create_blank_generic_chipset(max_chips, numprobes, err);
-  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+  max_chips = result->max_chips;
+  numprobes = result->cdf->numprobes;
 
-  /* Read in data */
-  load_generic_spreadsheet(result, filelist[0], err);
-  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+  info("NumSamples:\t%d\tNumProbes:\t%d", max_chips, numprobes);
 
   /* allocate chip names */
   sample_names = h_subcalloc(mempool, max_chips, sizeof(char **));
@@ -586,28 +375,23 @@ AFFY_CHIPSET *affy_illumina(char **filelist, AFFY_COMBINED_FLAGS *f,
       load_pm(result->chip[cur_chip], err);
       AFFY_CHECK_ERROR_GOTO(err, cleanup);
     }
-    
-    /* Normalize (partially) */
-    if (f->use_normalization)
-    {
-      if (!f->use_mean_normalization && !f->use_median_normalization &&
-          !f->use_pairwise_normalization)
-      {
-        /* Default is quantile normalization */
-        if (mean == NULL)
-        {
-          mean = h_subcalloc(mempool, numprobes, sizeof(double));
-          if (mean == NULL)
-            AFFY_HANDLE_ERROR_GOTO("calloc failed",
-                                   AFFY_ERROR_OUTOFMEM,
-                                   err,
-                                   cleanup);
-        }
-
-        affy_rma_quantile_normalization_chip(result, cur_chip, mean, f, err);
-        AFFY_CHECK_ERROR_GOTO(err, cleanup);
-      }
-    }
+  }
+
+  /* Normalize (partially): rank every chip, the chips in parallel */
+  if (f->use_normalization &&
+      !f->use_mean_normalization && !f->use_median_normalization &&
+      !f->use_pairwise_normalization)
+  {
+    /* Default is quantile normalization */
+    mean = h_subcalloc(mempool, numprobes, sizeof(double));
+    if (mean == NULL)
+      AFFY_HANDLE_ERROR_GOTO("calloc failed",
+                             AFFY_ERROR_OUTOFMEM,
+                             err,
+                             cleanup);
+
+    affy_rma_quantile_normalization_chips(result, mean, f, err);
+    AFFY_CHECK_ERROR_GOTO(err, cleanup);
   }
 
   /* Option to use mean normalization */
@@ -630,13 +414,10 @@ AFFY_CHIPSET *affy_illumina(char **filelist, AFFY_COMBINED_FLAGS *f,
   {
     if (f->use_saved_means)
     {
-      FILE *fp;
-      char *nl, *err_str;
-      int   i = 0;
-      int   max_string_len;
-      
-      nl             = NULL;
-      max_string_len = 0;
+      FILE        *fp;
+      LINE_READER *lr;
+      char        *nl, *err_str;
+      int          i = 0;
 
       fp = fopen(f->means_filename, "rb");
       if (fp == NULL)
@@ -645,14 +426,24 @@ AFFY_CHIPSET *affy_illumina(char **filelist, AFFY_COMBINED_FLAGS *f,
                                err,
                                cleanup);
 
-      /* while ((nl = utils_getline(fp)) != NULL) */
-      while (fgets_strip_realloc(&nl, &max_string_len, fp) != NULL)
+      lr = line_reader_init(fp);
+      if (lr == NULL)
+      {
+        fclose(fp);
+        AFFY_HANDLE_ERROR_GOTO("malloc failed",
+                               AFFY_ERROR_OUTOFMEM,
+                               err,
+                               cleanup);
+      }
+
+      while ((nl = line_reader_next(lr, NULL)) != NULL)
       {
 	mean[i] = strtod(nl, &err_str);
 	
 	if ((nl == err_str) && (mean[i] == 0))
         {
-          if (nl) free(nl);
+          line_reader_free(lr);
+          fclose(fp);
 
 	  warn("error parsing mean value from %s, line %d\n", 
                f->means_filename, 
@@ -666,8 +457,7 @@ AFFY_CHIPSET *affy_illumina(char **filelist, AFFY_COMBINED_FLAGS *f,
 	i++;
       }
       fclose(fp);
-      
-      if (nl) free(nl);
+      line_reader_free(lr);
 
       if (i != numprobes)
       {
@@ -12,7 +12,7 @@ void affy_iron_background_correction_probeset(AFFY_CHIPSET *cs,
                                               AFFY_ERROR *err)
 {
   AFFY_CDFFILE       *cdf;
-  AFFY_CELL         **chip_data;
+  AFFY_CELFILE       *chip_cel;
   AFFY_CHIP          *chip;
   int                *mempool;
   int                 numprobes, numprobesets;
@@ -40,7 +40,7 @@ void affy_iron_background_correction_probeset(AFFY_CHIPSET *cs,
     double *probe_set_ptr;
   
     chip = cs->chip[i];
-    chip_data = chip->cel->data;
+    chip_cel = chip->cel;
     probe_set_ptr = chip->probe_set;
   }
 
@@ -29,6 +29,11 @@
  * 2019/03/15: only floor probesets if unlog_flag is set (EAW)
  * 2019/10/15: added affy_floor_probeset_non_zero_to_one() (EAW)
  * 2023/09/13: mask/floor values < 1.0 or 1E-5 depending on --iron-ignore-low (EAW)
+ * 2026/10/16: access cells through affy_cel_value() and friends (EAW)
+ * 2026/10/16: look cells up in the sparse mask lists (EAW)
+ * 2026/10/16: floor probe cells in storage order (EAW)
+ * 2026/10/16: test control/exclusion/spikein bits in cdf->ps_flags[],
+ *             rather than the probeset names, per probe per chip (EAW)
  *
  * *** TODO -- fix 1:many probe:probeset stuff ***
  *
@@ -58,8 +63,9 @@ void affy_pairwise_normalization(AFFY_CHIPSET *cs,
   int          *mempool;
   unsigned int  i, j;
   affy_uint32   p;
+  affy_uint8    skip_flags, spikein_flag;
   AFFY_CDFFILE *cdf;
-  AFFY_CELL   **chip_data;
+  AFFY_CELFILE *chip_cel;
   AFFY_CELFILE *model_cel;
   char         *filestem = NULL;
 
@@ -119,6 +125,10 @@ void affy_pairwise_normalization(AFFY_CHIPSET *cs,
   if (f->iron_ignore_low)
     low_value = 1.0;
 
+  /* probesets to leave out of training, and to leave unscaled */
+  skip_flags   = affy_training_mask_flags(f);
+  spikein_flag = f->use_spikeins ? AFFY_PS_SPIKEIN : 0;
+
   /* NOTE -- there will be some minor issues with exclusions of probes
    *  that belong to multiple probesets.  If even one copy of a probe
    *  is not excluded, one copy is left unmasked.
@@ -147,37 +157,18 @@ void affy_pairwise_normalization(AFFY_CHIPSET *cs,
       x = cdf->probe[p]->pm.x;
       y = cdf->probe[p]->pm.y;
       
-      mask_char = (bit_test(model_cel->mask[x], y)) ||
+      mask_char = affy_cel_ismasked(model_cel, x, y) ||
         (cdf->cell_type[x][y] == AFFY_UNDEFINED_LOCATION) ||
         (cdf->cell_type[x][y] == AFFY_QC_LOCATION);
 
-      /* skip AFFX/control probesets */
-      if (affy_is_control_string(cdf->probe[p]->ps->name))
+      /* skip AFFX/control probesets, exclusions and spikeins */
+      if (affy_probe_flags(cdf, p) & skip_flags)
         mask_char = 1;
 
       /* mask low intensity points */
       if (model_signals[p] < low_value)
         mask_char = 1;
 
-      /* mask probesets that we want to exclude from training */
-      if (f->use_exclusions && cdf->exclusions)
-      {
-        if (bsearch(&cdf->probe[p]->ps->name, &cdf->exclusions[0],
-            cdf->numexclusions, sizeof(char *), compare_string))
-        {
-          mask_char = 1;
-        }
-      }
-      /* we also want to exclude spikins */
-      if (f->use_spikeins && cdf->spikeins)
-      {
-        if (bsearch(&cdf->probe[p]->ps->name, &cdf->spikeins[0],
-            cdf->numspikeins, sizeof(char *), compare_string))
-        {
-          mask_char = 1;
-        }
-      }
-
       /* mask all but the first unmasked copy of duplicate probes */
       if (mask_char == 0 && cdf->seen_xy[x][y] == 0)
         cdf->seen_xy[x][y] = 1;
@@ -196,38 +187,19 @@ void affy_pairwise_normalization(AFFY_CHIPSET *cs,
       x = cdf->probe[p]->pm.x;
       y = cdf->probe[p]->pm.y;
       
-      model_signals[j] = model_cel->data[x][y].value;
-      mask_char = (bit_test(model_cel->mask[x], y)) ||
+      model_signals[j] = affy_cel_value(model_cel, x, y);
+      mask_char = affy_cel_ismasked(model_cel, x, y) ||
         (cdf->cell_type[x][y] == AFFY_UNDEFINED_LOCATION) ||
         (cdf->cell_type[x][y] == AFFY_QC_LOCATION);
 
-      /* skip AFFX/control probesets */
-      if (affy_is_control_string(cdf->probe[p]->ps->name))
+      /* skip AFFX/control probesets, exclusions and spikeins */
+      if (affy_probe_flags(cdf, p) & skip_flags)
         mask_char = 1;
 
       /* mask low intensity points */
       if (model_signals[j] < low_value)
         mask_char = 1;
 
-      /* mask probesets that we want to exclude from training */
-      if (f->use_exclusions && cdf->exclusions)
-      {
-        if (bsearch(&cdf->probe[p]->ps->name, &cdf->exclusions[0],
-            cdf->numexclusions, sizeof(char *), compare_string))
-        {
-          mask_char = 1;
-        }
-      }
-      /* we also want to exclude spikeins */
-      if (f->use_spikeins && cdf->spikeins)
-      {
-        if (bsearch(&cdf->probe[p]->ps->name, &cdf->spikeins[0],
-            cdf->numspikeins, sizeof(char *), compare_string))
-        {
-          mask_char = 1;
-        }
-      }
-
       /* mask all but the first unmasked copy of duplicate probes */
       if (mask_char == 0 && cdf->seen_xy[x][y] == 0)
         cdf->seen_xy[x][y] = 1;
@@ -252,7 +224,7 @@ void affy_pairwise_normalization(AFFY_CHIPSET *cs,
         y = cdf->probe[p]->mm.y;
 
         /* do not train on MM probes */
-        model_signals[j] = model_cel->data[x][y].value;
+        model_signals[j] = affy_cel_value(model_cel, x, y);
         mask_model[j] = 1;
 
         j++;
@@ -262,7 +234,7 @@ void affy_pairwise_normalization(AFFY_CHIPSET *cs,
 
   for (i = 0; i < cs->num_chips; i++)
   {
-    chip_data = cs->chip[i]->cel->data;
+    chip_cel  = cs->chip[i]->cel;
     filestem  = stem_from_filename_safer(cs->chip[i]->filename);
 
     if (opts & AFFY_PAIRWISE_PM_ONLY)
@@ -277,7 +249,7 @@ void affy_pairwise_normalization(AFFY_CHIPSET *cs,
         x = cdf->probe[p]->pm.x;
         y = cdf->probe[p]->pm.y;
 
-        mask[p] = mask_model[p] | bit_test(cs->chip[i]->cel->mask[x], y);
+        mask[p] = mask_model[p] | affy_cel_ismasked(chip_cel, x, y);
 
         /* mask low intensity points */
         if (input_signals[p] < low_value)
@@ -291,8 +263,8 @@ void affy_pairwise_normalization(AFFY_CHIPSET *cs,
         x = cdf->probe[p]->pm.x;
         y = cdf->probe[p]->pm.y;
 
-        input_signals[j] = chip_data[x][y].value;
-        mask[j] = mask_model[j] | bit_test(cs->chip[i]->cel->mask[x], y);
+        input_signals[j] = affy_cel_value(chip_cel, x, y);
+        mask[j] = mask_model[j] | affy_cel_ismasked(chip_cel, x, y);
 
         /* mask low intensity points */
         if (input_signals[j] < low_value)
@@ -313,7 +285,7 @@ void affy_pairwise_normalization(AFFY_CHIPSET *cs,
           y = cdf->probe[p]->mm.y;
 
           /* do not train on MM probes */
-          input_signals[j] = chip_data[x][y].value;
+          input_signals[j] = affy_cel_value(chip_cel, x, y);
           mask[j] = 1;
 
           j++;
@@ -378,14 +350,8 @@ void affy_pairwise_normalization(AFFY_CHIPSET *cs,
         if (cs->chip[i]->pm[p])
         {
           /* HACK -- set scaling factors for spikein probesets to 1 */
-          if (f->use_spikeins && cdf->spikeins)
-          {
-            if (bsearch(&cdf->probe[p]->ps->name, &cdf->spikeins[0],
-                cdf->numspikeins, sizeof(char *), compare_string))
-            {
-              scale_factors[p] = 1.0;
-            }
-          }
+          if (affy_probe_flags(cdf, p) & spikein_flag)
+            scale_factors[p] = 1.0;
 
           if (scale_factors[p] > 0)
             cs->chip[i]->pm[p] *= scale_factors[p];
@@ -407,31 +373,27 @@ void affy_pairwise_normalization(AFFY_CHIPSET *cs,
         y = cdf->probe[p]->pm.y;
 
         /* preserve missing data */
-        if (chip_data[x][y].value)
+        if (affy_cel_value(chip_cel, x, y))
         {
           /* HACK -- set scaling factors for spikein probesets to 1 */
-          if (f->use_spikeins && cdf->spikeins)
-          {
-            if (bsearch(&cdf->probe[p]->ps->name, &cdf->spikeins[0],
-                cdf->numspikeins, sizeof(char *), compare_string))
-            {
-              scale_factors[j] = 1.0;
-            }
-          }
+          if (affy_probe_flags(cdf, p) & spikein_flag)
+            scale_factors[j] = 1.0;
           
           if (scale_factors[j] > 0 && scale_factors[j] != 1.0)
           {
             /* only scale a duplicate probe once */
             if (cdf->seen_xy[x][y] == 0)
             {
-              chip_data[x][y].value *= scale_factors[j];
+              affy_cel_set_value(chip_cel, x, y,
+                                 scale_factors[j] *
+                                 affy_cel_value(chip_cel, x, y));
               cdf->seen_xy[x][y] = 1;
             }
           }
 
 #if DO_FLOOR
-          if (chip_data[x][y].value < MIN_SIGNAL)
-            chip_data[x][y].value = MIN_SIGNAL;
+          if (affy_cel_value(chip_cel, x, y) < MIN_SIGNAL)
+            affy_cel_set_value(chip_cel, x, y, MIN_SIGNAL);
 #endif
         }
 
@@ -450,17 +412,11 @@ void affy_pairwise_normalization(AFFY_CHIPSET *cs,
           y = cdf->probe[p]->mm.y;
 
           /* preserve missing data */
-          if (chip_data[x][y].value)
+          if (affy_cel_value(chip_cel, x, y))
           {
             /* HACK -- set scaling factors for spikein probesets to 1 */
-            if (f->use_spikeins && cdf->spikeins)
-            {
-              if (bsearch(&cdf->probe[p]->ps->name, &cdf->spikeins[0],
-                  cdf->numspikeins, sizeof(char *), compare_string))
-              {
-                scale_factors[j] = 1.0;
-              }
-            }
+            if (affy_probe_flags(cdf, p) & spikein_flag)
+              scale_factors[j] = 1.0;
 
 
             if (scale_factors[j] > 0 && scale_factors[j] != 1.0)
@@ -468,14 +424,16 @@ void affy_pairwise_normalization(AFFY_CHIPSET *cs,
               /* only scale a duplicate probe once */
               if (cdf->seen_xy[x][y] == 0)
               {
-                chip_data[x][y].value *= scale_factors[j];
+                affy_cel_set_value(chip_cel, x, y,
+                                   scale_factors[j] *
+                                   affy_cel_value(chip_cel, x, y));
                 cdf->seen_xy[x][y] = 1;
               }
             }
 
 #if DO_FLOOR
-            if (chip_data[x][y].value < MIN_SIGNAL)
-              chip_data[x][y].value = MIN_SIGNAL;
+            if (affy_cel_value(chip_cel, x, y) < MIN_SIGNAL)
+              affy_cel_set_value(chip_cel, x, y, MIN_SIGNAL);
 #endif
           }
 
@@ -507,6 +465,7 @@ void affy_pairwise_normalization_probeset(AFFY_CHIPSET *cs,
   int          *mempool;
   unsigned int  i;
   affy_uint32   p;
+  affy_uint8    skip_flags, spikein_flag;
   AFFY_CDFFILE *cdf;
   char         *filestem = NULL;
 
@@ -549,6 +508,10 @@ void affy_pairwise_normalization_probeset(AFFY_CHIPSET *cs,
   if (f->iron_ignore_low)
     low_value = 1.0;
 
+  /* probesets to leave out of training, and to leave unscaled */
+  skip_flags   = affy_training_mask_flags(f);
+  spikein_flag = f->use_spikeins ? AFFY_PS_SPIKEIN : 0;
+
   model_signals  = model_chip->probe_set;
   if (unlog_flag)
     for (p = 0; p < numprobesets; p++)
@@ -566,8 +529,8 @@ void affy_pairwise_normalization_probeset(AFFY_CHIPSET *cs,
     memset(mask, 0, numprobesets * sizeof(char));
     for (p = 0; p < numprobesets; p++)
     {
-      /* mask obvious AFFX control probesets */
-      if (affy_is_control_probeset(&cdf->probeset[p]))
+      /* mask obvious AFFX control probesets, exclusions and spikeins */
+      if (cdf->ps_flags[p] & skip_flags)
         mask[p] = 1;
     
       /* mask low intensity points */
@@ -575,25 +538,6 @@ void affy_pairwise_normalization_probeset(AFFY_CHIPSET *cs,
       {
         mask[p] = 1;
       }
-
-      /* mask probesets that we want to exclude from training */
-      if (f->use_exclusions && cdf->exclusions)
-      {
-        if (bsearch(&cdf->probeset[p].name, &cdf->exclusions[0],
-            cdf->numexclusions, sizeof(char *), compare_string))
-        {
-          mask[p] = 1;
-        }
-      }
-      /* we also want to exclude spikeins */
-      if (f->use_spikeins && cdf->spikeins)
-      {
-        if (bsearch(&cdf->probeset[p].name, &cdf->spikeins[0],
-            cdf->numspikeins, sizeof(char *), compare_string))
-        {
-          mask[p] = 1;
-        }
-      }
     }
 
     /* mask additional noise-level data */
@@ -647,14 +591,8 @@ void affy_pairwise_normalization_probeset(AFFY_CHIPSET *cs,
     for (p = 0; p < numprobesets; p++)
     {
       /* HACK -- set scaling factors for spikein probesets to 1 */
-      if (f->use_spikeins && cdf->spikeins)
-      {
-        if (bsearch(&cdf->probeset[p].name, &cdf->spikeins[0],
-            cdf->numspikeins, sizeof(char *), compare_string))
-        {
-            scale_factors[p] = 1.0;
-        }
-      }
+      if (cdf->ps_flags[p] & spikein_flag)
+        scale_factors[p] = 1.0;
     
       if (scale_factors[p] > 0)
         input_signals[p] *= scale_factors[p];
@@ -692,11 +630,11 @@ void affy_floor_probe(AFFY_CHIPSET *cs,
                       double floor_value,
                       AFFY_ERROR *err)
 {
-  affy_int32    x, y, numprobes;
+  affy_int32    numprobes;
   unsigned int  i;
   affy_uint32   p;
   AFFY_CDFFILE *cdf;
-  AFFY_CELL   **chip_data;
+  AFFY_CELFILE *chip_cel;
 
   assert(cs              != NULL);
   assert(cs->cdf         != NULL);
@@ -710,7 +648,7 @@ void affy_floor_probe(AFFY_CHIPSET *cs,
 
   for (i = 0; i < cs->num_chips; i++)
   {
-    chip_data = cs->chip[i]->cel->data;
+    chip_cel = cs->chip[i]->cel;
 
     if (cs->chip[i]->pm)
     {
@@ -720,41 +658,21 @@ void affy_floor_probe(AFFY_CHIPSET *cs,
           cs->chip[i]->pm[p] = floor_value;
       }
     }
-    if (cdf->probe && chip_data)
+    if (cdf->probe && affy_cel_has_data(chip_cel))
     {
-      memset(cdf->seen_xy[0], 0, cdf->numrows*cdf->numcols*sizeof(affy_uint8));
+      size_t k;
 
-      for (p = 0; p < numprobes; p++)
-      {
-        x = cdf->probe[p]->pm.x;
-        y = cdf->probe[p]->pm.y;
+      assert(chip_cel->numrows == cdf->numrows &&
+             chip_cel->numcols == cdf->numcols);
 
-        if (cdf->seen_xy[x][y] == 0)
-        {
-          if (chip_data[x][y].value < floor_value)
-            chip_data[x][y].value = floor_value;
-        }
-        cdf->seen_xy[x][y] = 1;
-
-        /* hack for missing MM probes, where MM coords == PM coords
-         */
-        if (cdf->probe[p]->pm.x == cdf->probe[p]->mm.x &&
-            cdf->probe[p]->pm.y == cdf->probe[p]->mm.y)
-        {
-          continue;
-        }
-        else
-        {
-          x = cdf->probe[p]->mm.x;
-          y = cdf->probe[p]->mm.y;
+      /* floor each PM and MM cell, walking the chip in storage order */
+      affy_mark_probe_cells(cdf);
 
-          if (cdf->seen_xy[x][y] == 0)
-          {
-            if (chip_data[x][y].value < floor_value)
-              chip_data[x][y].value = floor_value;
-          }
-          cdf->seen_xy[x][y] = 1;
-        }
+      for (k = 0; k < affy_cel_num_cells(chip_cel); k++)
+      {
+        if (cdf->seen_xy[0][k] &&
+            affy_cel_value_at(chip_cel, k) < floor_value)
+          affy_cel_set_value_at(chip_cel, k, floor_value);
       }
     }
   }
@@ -40,6 +40,12 @@
  *           probe norm (EAW)
  * 01/10/24: pass flags to affy_mean_normalization() (EAW)
  * 12/16/24: add --normalize-before-bg (EAW)
+ * 10/16/26: load CEL files through the threaded prefetch loader (EAW)
+ * 10/16/26: access cells through affy_cel_value() and friends (EAW)
+ * 10/16/26: gather/scatter PM/MM probes through cdf->pm_cell[] and
+ *           cdf->mm_cell[] (EAW)
+ * 10/16/26: per-chip arrays go through the chipset's backing store (EAW)
+ * 10/16/26: scan the CEL headers once up front, load from the index (EAW)
  *
  **************************************************************************/
 
@@ -62,26 +68,22 @@ static void mas5_to_rma_pm(AFFY_CHIP *cp, AFFY_ERROR *err)
   assert(cp            != NULL);
   assert(cp->cdf       != NULL);
   assert(cp->cel       != NULL);
-  assert(cp->cel->data != NULL);
+  assert(affy_cel_has_data(cp->cel));
 
   numprobes = cp->cdf->numprobes;
 
   if (cp->pm == NULL)
-    cp->pm = h_subcalloc(cp, numprobes, sizeof(double));
+    cp->pm = affy_backing_store_calloc(cp->store, cp, numprobes,
+                                       sizeof(double));
   if (cp->pm == NULL)
     AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
   
   for (k = 0; k < numprobes; k++)
-  {
-    int x = cp->cdf->probe[k]->pm.x;
-    int y = cp->cdf->probe[k]->pm.y;
-    
-    cp->pm[k] = cp->cel->data[x][y].value;
-  }
+    cp->pm[k] = affy_cel_value_at(cp->cel, cp->cdf->pm_cell[k]);
 }
 
 
-/* free cel->data after converting to RMA PM-only array */
+/* free the cell data after converting to RMA PM-only array */
 static void mas5_to_rma_pm_free(AFFY_CHIP *cp, AFFY_ERROR *err)
 {
   affy_int32 numprobes, k;
@@ -89,25 +91,20 @@ static void mas5_to_rma_pm_free(AFFY_CHIP *cp, AFFY_ERROR *err)
   assert(cp            != NULL);
   assert(cp->cdf       != NULL);
   assert(cp->cel       != NULL);
-  assert(cp->cel->data != NULL);
+  assert(affy_cel_has_data(cp->cel));
 
   numprobes = cp->cdf->numprobes;
 
   if (cp->pm == NULL)
-    cp->pm = h_subcalloc(cp, numprobes, sizeof(double));
+    cp->pm = affy_backing_store_calloc(cp->store, cp, numprobes,
+                                       sizeof(double));
   if (cp->pm == NULL)
     AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
   
   for (k = 0; k < numprobes; k++)
-  {
-    int x = cp->cdf->probe[k]->pm.x;
-    int y = cp->cdf->probe[k]->pm.y;
-    
-    cp->pm[k] = cp->cel->data[x][y].value;
-  }
+    cp->pm[k] = affy_cel_value_at(cp->cel, cp->cdf->pm_cell[k]);
   
-  h_free(cp->cel->data);
-  cp->cel->data = NULL;
+  affy_free_cel_data(cp->cel);
 }
 
 
@@ -118,34 +115,22 @@ static void rma_to_mas5_pm(AFFY_CHIP *cp, AFFY_ERROR *err)
   assert(cp            != NULL);
   assert(cp->cdf       != NULL);
   assert(cp->cel       != NULL);
-  assert(cp->cel->data != NULL);
+  assert(affy_cel_has_data(cp->cel));
   assert(cp->pm        != NULL);
 
   numprobes = cp->cdf->numprobes;
 
   for (k = 0; k < numprobes; k++)
   {
-    int x, y;
-    
-    x = cp->cdf->probe[k]->pm.x;
-    y = cp->cdf->probe[k]->pm.y;
+    affy_uint32 pm_cell = cp->cdf->pm_cell[k];
+    affy_uint32 mm_cell = cp->cdf->mm_cell[k];
 
-    cp->cel->data[x][y].value = cp->pm[k];
+    affy_cel_set_value_at(cp->cel, pm_cell, cp->pm[k]);
 
     /* hack for missing MM probes, where MM coords == PM coords
      */
-    if (cp->cdf->probe[k]->pm.x == cp->cdf->probe[k]->mm.x &&
-        cp->cdf->probe[k]->pm.y == cp->cdf->probe[k]->mm.y)
-    {
-      continue;
-    }
-    else
-    {
-      x = cp->cdf->probe[k]->mm.x;
-      y = cp->cdf->probe[k]->mm.y;
-
-      cp->cel->data[x][y].value = 0;
-    }
+    if (mm_cell != pm_cell)
+      affy_cel_set_value_at(cp->cel, mm_cell, 0);
   }
 }
 
@@ -153,6 +138,8 @@ AFFY_CHIPSET *affy_mas5(char **filelist, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err
 {
   AFFY_CHIPSET         *result, *temp, *model_chipset = NULL;
   AFFY_CHIP            *model_chip = NULL;
+  AFFY_CEL_PREFETCH    *pf = NULL;
+  AFFY_CEL_INDEX       *idx = NULL;
   AFFY_COMBINED_FLAGS  default_flags;
   int                  i, max_chips, chips_processed;
   char                 *chip_type = NULL, **p;
@@ -166,10 +153,6 @@ AFFY_CHIPSET *affy_mas5(char **filelist, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err
   result = temp = NULL;
   chips_processed = 0;
 
-  /* Get the array type. */
-  chip_type = affy_get_cdf_name_from_cel(filelist[0], err);
-  AFFY_CHECK_ERROR(err, NULL);
-
   /* In case flags not used, create default entry */
   if (f == NULL)
   {
@@ -178,6 +161,13 @@ AFFY_CHIPSET *affy_mas5(char **filelist, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err
     f = &default_flags;
   }
 
+  /* Scan every CEL header once; the array type is the first file's */
+  idx = affy_scan_cel_headers(filelist, f->num_threads, err);
+  AFFY_CHECK_ERROR(err, NULL);
+
+  chip_type = affy_cel_index_array_type(idx, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
   i = (f->use_quantile_normalization == true) 
       + (f->use_pairwise_normalization == true) 
       + (f->use_mean_normalization == true);
@@ -299,6 +289,11 @@ AFFY_CHIPSET *affy_mas5(char **filelist, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err
   result = affy_resize_chipset(result, max_chips, err);
   AFFY_CHECK_ERROR_GOTO(err, cleanup);
 
+  /* Start loading CEL files in the background */
+  pf = affy_cel_prefetch_start(filelist, idx, f->num_threads, 0,
+                               result->cel_storage, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
   /* Load each chip */
   for (i = 0; i < max_chips; i++)
   {
@@ -311,8 +306,7 @@ AFFY_CHIPSET *affy_mas5(char **filelist, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err
      */
 
     /* Load chip, skipping CEL files that can't be loaded */
-    affy_load_chipset_single(result, filelist[i],
-                             f->ignore_chip_mismatch, err);
+    affy_load_chipset_next(result, pf, f->ignore_chip_mismatch, err);
     if (err->type != AFFY_ERROR_NONE)
       continue;
 
@@ -467,6 +461,9 @@ AFFY_CHIPSET *affy_mas5(char **filelist, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err
     chips_processed++;
   }
 
+  affy_cel_prefetch_free(pf);
+  pf = NULL;
+
   /* Option to use mean normalization */
   /* Must go after all chips are loaded now, so that mean of means can be
    * calculated if target mean = 0.
@@ -853,14 +850,15 @@ AFFY_CHIPSET *affy_mas5(char **filelist, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err
   
   /* Free up the temp & model chipsets */
   h_free(temp);
-  h_free(chip_type);
+  affy_free_cel_index(idx);
 
   info("MAS5/IRON finished on %d samples", chips_processed);
 
   return (result);
 
 cleanup:
-  h_free(chip_type);
+  affy_cel_prefetch_free(pf);
+  affy_free_cel_index(idx);
   h_free(temp);
   h_free(result);
 
@@ -20,6 +20,10 @@
  * 03/07/08: New error handling scheme (AMH)
  * 09/20/10: Pooled memory allocator (AMH)
  * 10/22/10: Use new AFFY_COMBINED_FLAGS instead of AFFY_MAS5_FLAGS
+ * 10/16/26: access cells through affy_cel_value() and friends (EAW)
+ * 10/16/26: walk the chip x outer, y inner (storage order), and use
+ *           per-axis distance tables instead of recomputing w_k() (EAW)
+ * 10/16/26: step through the sorted mask list alongside the cells (EAW)
  *
  **************************************************************************/
 
@@ -38,14 +42,17 @@ static bool   bioconductor_compatability;
 static AFFY_POINT *center;
 static double     *bZ;
 static double     *nZ;
+static double     *dx2;    /* [x * K + k]: x part of squared distance to k */
+static double     *dy2;    /* [y * K + k]: y part of squared distance to k */
 static int         dim, default_grid_y_length, default_grid_x_length;
 
 static int    find_centers(int rows, int cols);
+static void   find_distances(int rows, int cols);
 static void   output_statistics();
 static int    estimate_zone_background(AFFY_CHIP *chip, AFFY_ERROR *err);
 static int    calculate_background();
-static int    background(int x, int y, double *b, double *n);
-static double w_k(int x, int y, int k);
+static void   background(const double *dx, const double *dy,
+                         double *b, double *n);
 static int    zone_information(int k, int type);
 
 /*
@@ -103,6 +110,14 @@ int affy_mas5_background_correction(AFFY_CHIPSET *c,
     AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, -1);
   }
 
+  dx2 = h_subcalloc(mempool, (size_t)c->numcols * K, sizeof(double));
+  dy2 = h_subcalloc(mempool, (size_t)c->numrows * K, sizeof(double));
+  if (dx2 == NULL || dy2 == NULL)
+  {
+    h_free(mempool);
+    AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, -1);
+  }
+
   /*
    * Three steps: find grid centers, estimate zone background, then
    * finally compute the background intensities. The background is not
@@ -111,6 +126,7 @@ int affy_mas5_background_correction(AFFY_CHIPSET *c,
    */
   pb_tick(&pbs,1,"Finding centers...");
   find_centers(c->numrows, c->numcols);
+  find_distances(c->numrows, c->numcols);
   pb_tick(&pbs,1,"Estimating zone background and calculating background correction: ");
 
   for (n = 0; n < c->num_chips; n++)
@@ -172,6 +188,46 @@ static int find_centers(int rows, int cols)
   return (0);
 }
 
+/*
+ * The squared distance from (x,y) to a zone center splits into an x
+ * part and a y part, so tabulate those once per chipset rather than
+ * once per cell and zone.
+ *
+ * Although C operates on 0-based indexing, both Bioconductor and
+ * MAS5.0 assume that the grid is 1-based indexing, so the tables are
+ * for x + 1 and y + 1.  This does not address the intensity at (x,y)
+ * from the cel file, which is 0-based indexing.
+ *
+ * From my understanding of the Bioconductor code, an additional 0.5
+ * is added to the computation of the centers, which since they use
+ * floating point won't be truncated. Here, we (optionally) add that
+ * additional value back in, since our centers are integers.
+ */
+static void find_distances(int rows, int cols)
+{
+  double offset = bioconductor_compatability ? 0.5 : 0.0;
+  double d;
+  int    x, y, k;
+
+  for (x = 0; x < cols; x++)
+  {
+    for (k = 0; k < K; k++)
+    {
+      d = (x + 1) - center[k].x - offset;
+      dx2[(size_t)x * K + k] = d * d;
+    }
+  }
+
+  for (y = 0; y < rows; y++)
+  {
+    for (k = 0; k < K; k++)
+    {
+      d = (y + 1) - center[k].y - offset;
+      dy2[(size_t)y * K + k] = d * d;
+    }
+  }
+}
+
 /*
  * A zone is bit weird but here is the deal, thanks to perls of
  * wisdom gleaned from GNU Affymetrix code:
@@ -235,44 +291,50 @@ static int estimate_zone_background(AFFY_CHIP *chip, AFFY_ERROR *err)
     for (i = 0; i < num_in_bg; i++) 
       bgvals[i] = -1;
 
-    /* Accumulate lower 2% of region */
-    for (y = 0; y < lengthy; y++)
+    /*
+     * Accumulate lower 2% of region.  The list is kept sorted, so the
+     * order the cells are visited in doesn't matter: go in storage order.
+     */
+    for (x = 0; x < lengthx; x++)
     {
-      for (x = 0; x < lengthx; x++)
+      int    rx = startx + x;    /* Real x offset */
+      size_t column = (size_t)rx * cf->numrows;
+
+      for (y = 0; y < lengthy; y++)
       {
-        int ry = starty + y;    /* Real y offset */
-        int rx = startx + x;    /* Real x offset */
+        int    ry = starty + y;    /* Real y offset */
+        double value;
 
         /* Skip over masked cells and undefined cells and QC cells */
-        if (affy_ismasked(chip, rx, ry) 
+        if (affy_cel_ismasked_at(cf, column + ry)
             || affy_isundefined(chip, rx, ry) 
             || affy_isqc(chip, rx, ry))
           continue;
 
         total_vals++;
 
+        value = affy_cel_value_at(cf, column + ry);
+
         /* Insert into bgvals list, in sorted order */
         if (num_bgvals < num_in_bg)
         {
           /* Insert into list */
-          for (i = num_bgvals;
-               i > 0 && bgvals[i - 1] > cf->data[rx][ry].value; i--)
+          for (i = num_bgvals; i > 0 && bgvals[i - 1] > value; i--)
             bgvals[i] = bgvals[i - 1];
-          bgvals[i] = cf->data[rx][ry].value;
+          bgvals[i] = value;
           num_bgvals++;
         }
-        else if (bgvals[num_in_bg-1] < cf->data[rx][ry].value)
+        else if (bgvals[num_in_bg-1] < value)
         {
           /* Do nothing */
         }
         else
         {
           /* Insert into list */
-          for (i = num_in_bg - 1;
-               i > 0 && bgvals[i - 1] > cf->data[rx][ry].value; i--)
+          for (i = num_in_bg - 1; i > 0 && bgvals[i - 1] > value; i--)
             bgvals[i] = bgvals[i - 1];
           
-          bgvals[i] = cf->data[rx][ry].value;
+          bgvals[i] = value;
         }
       }
     }
@@ -334,57 +396,58 @@ static void output_statistics()
 static int calculate_background(AFFY_CHIP *chip)
 {
   double        b, n, I_prime;
-  int           x, y, pinterval, progress;
+  int           x, y;
+  size_t        i;
+  affy_uint32   m = 0, nummasks;
   AFFY_CELFILE *cf = chip->cel;
 
   assert(cf != NULL);
 
-  pinterval = progress = cf->numrows / 10;
+  nummasks = cf->mask ? cf->nummasks : 0;
 
-  for (y = 0; y < cf->numrows; y++)
+  /* x outer, y inner: cells, masks and cell types are all x-major */
+  for (x = 0, i = 0; x < cf->numcols; x++)
   {
-    if (y == progress)
-      progress += pinterval;
+    const double *dx = dx2 + (size_t)x * K;
 
-    for (x = 0; x < cf->numcols; x++)
+    for (y = 0; y < cf->numrows; y++, i++)
     {
-      /* Skip over masked cells and undefined cells and QC cells */
-      if (affy_ismasked(chip, x, y) 
-          || affy_isundefined(chip, x, y) 
-          || affy_isqc(chip, x, y))
+      /* the mask list is sorted, so the next masked cell is cf->mask[m] */
+      if (m < nummasks && cf->mask[m] == i)
+      {
+        m++;
+        continue;
+      }
+
+      /* Skip over undefined cells and QC cells */
+      if (affy_isundefined(chip, x, y) || affy_isqc(chip, x, y))
         continue;
 
       /* Calculate both the b and n values */
-      background(x, y, &b, &n);
+      background(dx, dy2 + (size_t)y * K, &b, &n);
 
-      I_prime = max_macro(cf->data[x][y].value, 0.5);
-      cf->data[x][y].value = max_macro(I_prime - b, NoiseFrac * n);
+      I_prime = max_macro(affy_cel_value_at(cf, i), 0.5);
+      affy_cel_set_value_at(cf, i, max_macro(I_prime - b, NoiseFrac * n));
     }
   }
 
   return (0);
 }
 
-/* This is the b(x,y) calculation */
-static int background(int x, int y, double *b, double *n)
+/*
+ * This is the b(x,y) calculation, given the rows of the distance tables
+ * for x and y.  The zone weights are w_k(x,y) = 1 / (d^2 + smooth).
+ */
+static void background(const double *dx, const double *dy,
+                       double *b, double *n)
 {
   double denom = 0, n_n = 0, b_n = 0;
   double cur_weight;
   int    k;
 
-  /* 
-   * Although C operates on 0-based indexing, both Bioconductor and
-   *  MAS5.0 assume that the grid is 1-based indexing. We increment
-   *  both x and y coordinates before calculating background. Note
-   *  this does not address the intensity at (x,y) from the cel file,
-   *  which is 0-based indexing.
-   */
-  x++;
-  y++;
-
   for (k = 0; k < K; k++)
   {
-    cur_weight = w_k(x, y, k);
+    cur_weight = 1.0 / (dx[k] + dy[k] + smooth);
 
     denom += cur_weight;
     b_n   += cur_weight * bZ[k];
@@ -393,31 +456,4 @@ static int background(int x, int y, double *b, double *n)
 
   *b = b_n / denom;
   *n = n_n / denom;
-
-  return (0);
-}
-
-/* This is the w_k(row,col) calculation */
-static double w_k(int x, int y, int k)
-{
-  double d;
-
-  /* 
-   * From my understanding of the Bioconductor code, an additional 0.5 
-   * is added to the computation of the centers, which since they use 
-   * floating point won't be truncated. Here, we (optionally) add that
-   *  additional value back in, since our centers are integers.
-   */
-  if (bioconductor_compatability) 
-  {
-    d = ((x - center[k].x - 0.5) * (x - center[k].x - 0.5)) 
-        + ((y - center[k].y - 0.5) * (y - center[k].y - 0.5));
-  }
-  else 
-  {
-    d = ((x - center[k].x) * (x - center[k].x)) 
-        + ((y - center[k].y) * (y - center[k].y));
-  }
-
-  return (1.0 / (d + smooth));
 }
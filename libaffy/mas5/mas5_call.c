@@ -17,6 +17,9 @@
  * 10/22/10: Use new AFFY_COMBINED_FLAGS instead of AFFY_MAS5_FLAGS
  * 06/09/11: modified algorithm to be closer to Affymetrix whitepaper
  * 03/06/14: Do not make calls if chip is missing MM probes (EAW)
+ * 10/16/26: access cells through affy_cel_value() (EAW)
+ * 10/16/26: work arrays come from a per-run scratch arena, no longer
+ *           leaked on the early returns (EAW)
  *
  **************************************************************************/
 
@@ -30,46 +33,34 @@ static const double ALPHA1 = 0.04, ALPHA2 = 0.06;
 /* Private routines */
 static double calculate_probeset_call(AFFY_CHIP *c, 
                                       int probeset_num, 
+                                      harena_t *scratch,
                                       AFFY_ERROR *err);
 
 static double calculate_probeset_call(AFFY_CHIP *c, 
                                       int probeset_num, 
+                                      harena_t *scratch,
                                       AFFY_ERROR *err)
 {
   AFFY_PROBESET *p;
-  AFFY_CELL    **data;
+  AFFY_CELFILE  *cel;
   double        *pm, *mm, *r, pvalue;
-  int            n, i, j, x, y, *mempool;
+  int            n, i, j, x, y;
   int            non_masked_count = 0, saturated_count = 0;
+  harena_mark_t  mark;
 
   /* Some shortcuts */
   p    = &(c->cdf->probeset[probeset_num]);
   n    = p->numprobes;
-  data = c->cel->data;
-
-  mempool = h_malloc(sizeof(int));
-  if (mempool == NULL)
-    AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, -DBL_MIN);
+  cel  = c->cel;
 
   /* Assign pm/mm values for this chip (based on existing layout) */
-  pm = h_subcalloc(mempool, n, sizeof(double));
-  if (pm == NULL)
-  {
-    h_free(mempool);
-    AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, -DBL_MIN);
-  }
-
-  mm = h_subcalloc(mempool, n, sizeof(double));
-  if (mm == NULL)
-  {
-    h_free(mempool);
-    AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, -DBL_MIN);
-  }
-
-  r = h_subcalloc(mempool, n, sizeof(double));
-  if (r == NULL)
+  mark = h_arena_mark(scratch);
+  pm   = h_arena_calloc(scratch, n, sizeof(double));
+  mm   = h_arena_calloc(scratch, n, sizeof(double));
+  r    = h_arena_calloc(scratch, n, sizeof(double));
+  if (pm == NULL || mm == NULL || r == NULL)
   {
-    h_free(mempool);
+    h_arena_reset(scratch, mark);
     AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, -DBL_MIN);
   }
 
@@ -85,13 +76,13 @@ static double calculate_probeset_call(AFFY_CHIP *c,
     y = p->probe[i].pm.y;
     if (affy_ismasked(c, x, y))
       continue;
-    pm_i = data[x][y].value;
+    pm_i = affy_cel_value(cel, x, y);
 
     x = p->probe[i].mm.x;
     y = p->probe[i].mm.y;
     if (affy_ismasked(c, x, y))
       continue;
-    mm_i = data[x][y].value;
+    mm_i = affy_cel_value(cel, x, y);
     
     non_masked_count++;
     
@@ -119,12 +110,16 @@ static double calculate_probeset_call(AFFY_CHIP *c,
   /* assign completely saturated probesets as present (0.0) */
   if (saturated_count == non_masked_count)
   {
+    h_arena_reset(scratch, mark);
     return 0.0;
   }
 
   /* if no probes left, call 'A' (0.5) */
   if (j == 0)
+  {
+    h_arena_reset(scratch, mark);
     return 0.5;
+  }
 
   
   /* In case the total number of probes is less than n */
@@ -136,9 +131,9 @@ static double calculate_probeset_call(AFFY_CHIP *c,
     n = j;
   }
 
-  pvalue = affy_mas5_calculate_call_pvalue(r, n, TAU, err);
+  pvalue = affy_mas5_calculate_call_pvalue_scratch(r, n, TAU, scratch, err);
 
-  h_free(mempool);
+  h_arena_reset(scratch, mark);
 
   AFFY_CHECK_ERROR(err, -DBL_MIN);
 
@@ -161,6 +156,7 @@ char affy_mas5_pvalue_call(double pvalue)
 int affy_mas5_call(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err)
 {
   int               i, n, num_probesets;
+  harena_t         *scratch;
   LIBUTILS_PB_STATE pbs;
 
   assert(c            != NULL);
@@ -177,6 +173,11 @@ int affy_mas5_call(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err)
   }
 
   num_probesets = c->cdf->numprobesets;
+
+  scratch = h_arena_create(NULL, 0);
+  if (scratch == NULL)
+    AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, -1);
+
   pb_init(&pbs);
 
   for (n = 0; n < c->num_chips; n++)
@@ -195,16 +196,19 @@ int affy_mas5_call(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err)
     {
       pb_tick(&pbs, 1, "");
       c->chip[n]->probe_set_call_pvalue[i] = 
-        calculate_probeset_call(c->chip[n], i, err);
+        calculate_probeset_call(c->chip[n], i, scratch, err);
     }
 
     pb_finish(&pbs, "Finished present/absent calls");
   }
 
   pb_cleanup(&pbs);
+  h_free(scratch);
 
   return (0);
 
 err:
+  h_free(scratch);
+
   return (-1);
 }
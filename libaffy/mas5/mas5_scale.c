@@ -20,6 +20,7 @@
  * 10/22/10: Use new AFFY_COMBINED_FLAGS instead of AFFY_MAS5_FLAGS
  * 01/06/12: Added global scaling for quantile pre-normalized probesets
  * 03/06/14: Only include points >= 0 in the averages
+ * 10/16/26: trimmed_mean() only sorts the values it keeps (EAW)
  *
  **************************************************************************/
 
@@ -200,7 +201,7 @@ int affy_mas5_scale_iron(AFFY_CHIPSET *c, AFFY_CHIPSET *model_chipset,
 static double trimmed_mean(double *values, int n, double lo, double hi)
 {
   double sum = 0;
-  int    min_value, max_value, i;
+  int    min_value, max_value, i, k[2];
 
   assert(values != NULL);
 
@@ -208,8 +209,16 @@ static double trimmed_mean(double *values, int n, double lo, double hi)
   min_value = (int)(n * lo);
   max_value = (int)(n * hi);
 
-  /* Sort values */
-  qsort(values, n, sizeof(double), dcompare);
+  /* Trim the tails, then sort (and so sum) the rest in order */
+  if (max_value < n)
+  {
+    k[0] = min_value;
+    k[1] = max_value;
+    dselect_multi(values, n, k, 2);
+    dsort(values + min_value, max_value - min_value + 1);
+  }
+  else
+    dsort(values, n);
 
   /* Accumulate sums */
   for (i = min_value; i <= max_value; i++)
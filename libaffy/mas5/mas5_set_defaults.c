@@ -32,6 +32,11 @@
  *           probe norm (EAW)
  * 09/13/23: added iron_check_saturated flag (EAW)
  * 09/13/23: added iron_ignore_low flag (EAW)
+ * 10/16/26: added num_threads (EAW)
+ * 10/16/26: added use_cdf_cache (off by default, the apps turn it on),
+ *           cdf_cache_directory (EAW)
+ * 10/16/26: added use_compact_cel (EAW)
+ * 10/16/26: added memory_budget_mb, spill_directory (EAW)
  *
  **************************************************************************/
 
@@ -50,6 +55,11 @@ void affy_mas5_set_defaults(AFFY_COMBINED_FLAGS *f)
   f->scale_tau = 10;
   f->cdf_directory = ".";
   f->cdf_filename = "";
+  f->use_cdf_cache = false;
+  f->cdf_cache_directory = NULL;
+  f->use_compact_cel = false;
+  f->memory_budget_mb = 0;
+  f->spill_directory = NULL;
   f->probe_filename = "probe-values.txt";
   f->dump_probe_values = false;
   f->output_present_absent = false;
@@ -84,6 +94,7 @@ void affy_mas5_set_defaults(AFFY_COMBINED_FLAGS *f)
   f->iron_ignore_low = true;
   f->iron_ignore_noise = false;
   f->salvage_corrupt = false;
+  f->num_threads = 1;
   f->use_exclusions = false;
   f->exclusions_filename = NULL;
   f->use_spikeins = false;
@@ -22,6 +22,12 @@
  * 10/22/10: Use new AFFY_COMBINED_FLAGS instead of AFFY_MAS5_FLAGS
  * 09/19/12: Handle some rare special Tukey's Biweight cases (EAW)
  * 03/06/14: Skip MM subtraction when chip is missing MM probes (EAW)
+ * 10/16/26: access cells through affy_cel_value() and friends (EAW)
+ * 10/16/26: gather probeset PM/MM values through the flat CDF probe
+ *           tables (EAW)
+ * 10/16/26: per-probeset work arrays come from a scratch arena (EAW)
+ * 10/16/26: per-chip arrays go through the chipset's backing store (EAW)
+ * 10/16/26: median() selects instead of sorting (EAW)
  *
  **************************************************************************/
 
@@ -34,16 +40,19 @@ static const double epsilon = 0.0001;
 
 /* Private routines */
 
-static int    double_sort_compare(const void *p1, const void *p2);
-static double median(double *x, int n, double *range_ptr, AFFY_ERROR *err);
-static double tukey_biweight(double *x, int n, AFFY_ERROR *err);
+static double median(double *x, int n, double *range_ptr, harena_t *scratch,
+                     AFFY_ERROR *err);
+static double tukey_biweight(double *x, int n, harena_t *scratch,
+                             AFFY_ERROR *err);
 static double calculate_specific_background(double *pm, 
                                             double *mm, 
                                             int n, 
+                                            harena_t *scratch,
                                             AFFY_ERROR *err);
 static double calculate_probeset_signal(AFFY_CHIP *c, 
                                         int probeset_num,
 					AFFY_COMBINED_FLAGS *f,
+                                        harena_t *scratch,
                                         AFFY_ERROR *err);
 
 
@@ -53,36 +62,29 @@ static double calculate_probeset_signal(AFFY_CHIP *c,
 static double calculate_probeset_signal_iron(AFFY_CHIP *c, 
                                              int probeset_num,
 					     AFFY_COMBINED_FLAGS *f,
+                                             harena_t *scratch,
                                              AFFY_ERROR *err)
 {
   AFFY_PROBESET *p;
-  AFFY_CELL    **data;
+  AFFY_CELFILE  *cel;
   double        *pm, *mm;
   double         signal, signal_log_value_pm, signal_log_value_mm;
-  int            n, i, j, x, y, *mempool;
+  int            n, i, j, x, y;
   double         r;
+  harena_mark_t  mark;
   
   /* Some shortcuts */
   p    = &(c->cdf->probeset[probeset_num]);
   n    = p->numprobes;
-  data = c->cel->data;
-
-  mempool = h_malloc(sizeof(int));
-  if (mempool == NULL)
-    AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, 0.0);
+  cel  = c->cel;
 
   /* Assign pm/mm values for this chip (based on existing layout) */
-  pm = h_subcalloc(mempool, n, sizeof(double));
-  if (pm == NULL)
-  {
-    h_free(mempool);
-    AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, 0.0);
-  }
-
-  mm = h_subcalloc(mempool, n, sizeof(double));
-  if (mm == NULL)
+  mark = h_arena_mark(scratch);
+  pm   = h_arena_calloc(scratch, n, sizeof(double));
+  mm   = h_arena_calloc(scratch, n, sizeof(double));
+  if (pm == NULL || mm == NULL)
   {
-    h_free(mempool);
+    h_arena_reset(scratch, mark);
     AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, 0.0);
   }
   
@@ -97,13 +99,13 @@ static double calculate_probeset_signal_iron(AFFY_CHIP *c,
     y = p->probe[i].pm.y;
     if (affy_ismasked(c, x, y))
       continue;
-    pm[j] = log(max_macro(data[x][y].value, f->delta)) / LOG2;
+    pm[j] = log(max_macro(affy_cel_value(cel, x, y), f->delta)) / LOG2;
 
     x = p->probe[i].mm.x;
     y = p->probe[i].mm.y;
     if (affy_ismasked(c, x, y))
       continue;
-    mm[j] = log(max_macro(data[x][y].value, f->delta)) / LOG2;
+    mm[j] = log(max_macro(affy_cel_value(cel, x, y), f->delta)) / LOG2;
     j++;
   }
 
@@ -114,7 +116,7 @@ static double calculate_probeset_signal_iron(AFFY_CHIP *c,
     {
       x = p->probe[i].pm.x;
       y = p->probe[i].pm.y;
-      pm[j++] = log(max_macro(data[x][y].value, f->delta)) / LOG2;;
+      pm[j++] = log(max_macro(affy_cel_value(cel, x, y), f->delta)) / LOG2;;
     }
   }
 
@@ -128,8 +130,8 @@ static double calculate_probeset_signal_iron(AFFY_CHIP *c,
   /* FIXME -- cases where #mm == 0 are not handled properly */
 
   /* Tukey's Biweight signals (in log2 space) */
-  signal_log_value_pm = tukey_biweight(pm, n, err);
-  signal_log_value_mm = tukey_biweight(mm, n, err);
+  signal_log_value_pm = tukey_biweight(pm, n, scratch, err);
+  signal_log_value_mm = tukey_biweight(mm, n, scratch, err);
   
   /* correlate PM/MM vectors */
   r = calculate_pearson_r_double(pm, mm, n);
@@ -141,7 +143,7 @@ static double calculate_probeset_signal_iron(AFFY_CHIP *c,
 
   signal = max_macro(signal, f->delta);
 
-  h_free(mempool);
+  h_arena_reset(scratch, mark);
 
   AFFY_CHECK_ERROR(err, 0.0);
 
@@ -152,35 +154,31 @@ static double calculate_probeset_signal_iron(AFFY_CHIP *c,
 static double calculate_probeset_signal(AFFY_CHIP *c, 
                                         int probeset_num,
 					AFFY_COMBINED_FLAGS *f,
+                                        harena_t *scratch,
                                         AFFY_ERROR *err)
 {
   AFFY_PROBESET *p;
-  AFFY_CELL    **data;
+  AFFY_CELFILE  *cel;
+  affy_uint32   *pm_cell;
   double        *pm, *pv;
   double         signal, signal_log_value;
-  int            n, i, j, x, y, *mempool;
+  int            n, i, j;
+  harena_mark_t  mark;
   
   /* Some shortcuts */
-  p    = &(c->cdf->probeset[probeset_num]);
-  n    = p->numprobes;
-  data = c->cel->data;
-
-  mempool = h_malloc(sizeof(int));
-  if (mempool == NULL)
-    AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, 0.0);
+  p       = &(c->cdf->probeset[probeset_num]);
+  pm_cell = c->cdf->pm_cell + c->cdf->ps_offset[probeset_num];
+  n       = c->cdf->ps_offset[probeset_num + 1] -
+            c->cdf->ps_offset[probeset_num];
+  cel     = c->cel;
 
   /* Assign pm values for this chip (based on existing layout) */
-  pm = h_subcalloc(mempool, n, sizeof(double));
-  if (pm == NULL)
+  mark = h_arena_mark(scratch);
+  pm   = h_arena_calloc(scratch, n, sizeof(double));
+  pv   = h_arena_calloc(scratch, n, sizeof(double));
+  if (pm == NULL || pv == NULL)
   {
-    h_free(mempool);
-    AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, 0.0);
-  }
-
-  pv = h_subcalloc(mempool, n, sizeof(double));
-  if (pv == NULL)
-  {
-    h_free(mempool);
+    h_arena_reset(scratch, mark);
     AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, 0.0);
   }
 
@@ -191,22 +189,16 @@ static double calculate_probeset_signal(AFFY_CHIP *c,
    */
   for (i = 0, j = 0; i < n; i++)
   {
-    x = p->probe[i].pm.x;
-    y = p->probe[i].pm.y;
-    if (affy_ismasked(c, x, y))
+    if (affy_cel_ismasked_at(cel, pm_cell[i]))
       continue;
-    pm[j++] = data[x][y].value;
+    pm[j++] = affy_cel_value_at(cel, pm_cell[i]);
   }
   
   /* Uh oh, all probes are masked.  We'll have to use all probes instead... */
   if (j == 0)
   {
     for (i = 0, j = 0; i < n; i++)
-    {
-      x = p->probe[i].pm.x;
-      y = p->probe[i].pm.y;
-      pm[j++] = data[x][y].value;
-    }
+      pm[j++] = affy_cel_value_at(cel, pm_cell[i]);
   }
 
   /* In case the total number of probes is less than n */
@@ -221,9 +213,9 @@ static double calculate_probeset_signal(AFFY_CHIP *c,
     pv[j] = log(max_macro(pm[j], f->delta)) / LOG2;
 
   /* Signal log value is here */
-  signal_log_value = tukey_biweight(pv, n, err);
+  signal_log_value = tukey_biweight(pv, n, scratch, err);
 
-  h_free(mempool);
+  h_arena_reset(scratch, mark);
 
   AFFY_CHECK_ERROR(err, 0.0);
 
@@ -239,13 +231,16 @@ static double calculate_probeset_signal(AFFY_CHIP *c,
 static double calculate_specific_background(double *pm, 
                                             double *mm, 
                                             int n, 
+                                            harena_t *scratch,
                                             AFFY_ERROR *err)
 {
-  double *d;
-  double  r;
-  int     j;
+  double        *d;
+  double         r;
+  int            j;
+  harena_mark_t  mark;
 
-  d = h_malloc(n * sizeof(double));
+  mark = h_arena_mark(scratch);
+  d    = h_arena_alloc(scratch, n * sizeof(double));
   if (d == NULL)
     AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, 0.0);
 
@@ -254,9 +249,9 @@ static double calculate_specific_background(double *pm,
     d[j] = (log(pm[j]) / LOG2 - log(mm[j]) / LOG2);
 
   /* Compute this biweight */
-  r = tukey_biweight(d, n, err);
+  r = tukey_biweight(d, n, scratch, err);
 
-  h_free(d);
+  h_arena_reset(scratch, mark);
 
   AFFY_CHECK_ERROR(err, 0.0);
 
@@ -266,14 +261,16 @@ static double calculate_specific_background(double *pm,
 /*--------------------------------------------------------------------
   Calculate Tukey's Biweighted Average, per the Affy docs.
   --------------------------------------------------------------------*/
-static double tukey_biweight(double *x, int n, AFFY_ERROR *err)
+static double tukey_biweight(double *x, int n, harena_t *scratch,
+                             AFFY_ERROR *err)
 {
-  double *u;
-  int     i, *mempool;
-  double  M, S;
-  double  Tbi_num = 0, Tbi_denom = 0;
-  double *diffs;
-  double  range;
+  double        *u;
+  int            i;
+  double         M, S;
+  double         Tbi_num = 0, Tbi_denom = 0;
+  double        *diffs;
+  double         range;
+  harena_mark_t  mark;
   
   /* special case for n == 1, to avoid any potential issues */
   if (n == 1)
@@ -287,48 +284,46 @@ static double tukey_biweight(double *x, int n, AFFY_ERROR *err)
     return (0.5 * (x[0] + x[1]));
   }
 
-  mempool = h_malloc(sizeof(int));
-  if (mempool == NULL)
-    AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, 0.0);
+  mark = h_arena_mark(scratch);
 
-  u = h_suballoc(mempool, n * sizeof(double));
+  u = h_arena_alloc(scratch, n * sizeof(double));
   if (u == NULL)
   {
-    h_free(mempool);
+    h_arena_reset(scratch, mark);
     AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, 0.0);
   }
 
   /* Calculate median */
-  M = median(x, n, &range, err);
+  M = median(x, n, &range, scratch, err);
   if (err->type != AFFY_ERROR_NONE)
   {
-    h_free(mempool);
+    h_arena_reset(scratch, mark);
     return (0.0);
   }
   
   /* zero variance, return first value */
   if (range <= DBL_EPSILON)
   {
-    h_free(mempool);
+    h_arena_reset(scratch, mark);
     return x[0];
   }
 
   /* Calculate S, median of absolute differences from M */
-  diffs = h_suballoc(mempool, n * sizeof(double));
+  diffs = h_arena_alloc(scratch, n * sizeof(double));
   if (diffs == NULL)
   {
-    h_free(mempool);
+    h_arena_reset(scratch, mark);
     AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, 0.0);
   }
 
   for (i = 0; i < n; i++)
     diffs[i] = fabs(x[i] - M);
 
-  S = median(diffs, n, &range, err);
+  S = median(diffs, n, &range, scratch, err);
 
   if (err->type != AFFY_ERROR_NONE)
   {
-    h_free(mempool);
+    h_arena_reset(scratch, mark);
 
     return (0.0);
   }
@@ -362,7 +357,7 @@ static double tukey_biweight(double *x, int n, AFFY_ERROR *err)
       Tbi_num += x[i];
   }
 
-  h_free(mempool);
+  h_arena_reset(scratch, mark);
 
   return (Tbi_num / Tbi_denom);
 }
@@ -371,55 +366,47 @@ static double tukey_biweight(double *x, int n, AFFY_ERROR *err)
  * Calculate the median of n numbers (x[0]..x[n-1]) without touching
  *  the x array.
  */
-static double median(double *x, int n, double *range_ptr, AFFY_ERROR *err)
+static double median(double *x, int n, double *range_ptr, harena_t *scratch,
+                     AFFY_ERROR *err)
 {
-  double *d;
-  int     i;
-  double  M;
+  double        *d;
+  int            i;
+  double         M, lo, hi;
+  harena_mark_t  mark;
 
   /* Copy the array */
-  d = h_malloc(n * sizeof(double));
+  mark = h_arena_mark(scratch);
+  d    = h_arena_alloc(scratch, n * sizeof(double));
   if (d == NULL)
     AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, 0.0);
 
+  lo = hi = x[0];
   for (i = 0; i < n; i++)
+  {
     d[i] = x[i];
 
-  /* Sort in increasing order */
-  qsort(d, n, sizeof(double), double_sort_compare);
+    if (d[i] < lo)
+      lo = d[i];
+    if (d[i] > hi)
+      hi = d[i];
+  }
 
   /* Median is middle value, or mean of two middle values */
-  if (n % 2 == 1)
-    M = d[n / 2];
-  else
-    M = (d[(n / 2) - 1] + d[n / 2]) / 2.0;
+  M = dmedian(d, n);
 
-  *range_ptr = d[n-1] - d[0];
+  *range_ptr = hi - lo;
 
-  h_free(d);
+  h_arena_reset(scratch, mark);
 
   return (M);
 }
 
-static int double_sort_compare(const void *p1, const void *p2)
-{
-  double d1 = *((double *)p1);
-  double d2 = *((double *)p2);
-
-  if (d1 < d2)
-    return (-1);
-  if (d1 > d2)
-    return (1);
-  if (d1 == d2)
-    return (0);
-
-  return (-1);
-}
 
 int affy_mas5_signal(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err)
 {
   int               i, n;
   int               num_probesets;
+  harena_t         *scratch;
   LIBUTILS_PB_STATE pbs;
 
   assert(c      != NULL);
@@ -429,6 +416,10 @@ int affy_mas5_signal(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err)
   if (c->num_chips == 0)
     return (-1);
 
+  scratch = h_arena_create(NULL, 0);
+  if (scratch == NULL)
+    AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, -1);
+
   pb_init(&pbs);
 
   num_probesets = c->cdf->numprobesets;
@@ -438,9 +429,10 @@ int affy_mas5_signal(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err)
            "Calculating signal for probesets using Tukey's biweight method");
   for (n = 0; n < c->num_chips; n++)
   {
-    c->chip[n]->probe_set = h_subcalloc(c->chip[n], 
-                                        num_probesets, 
-                                        sizeof(double));
+    c->chip[n]->probe_set = affy_backing_store_calloc(c->chip[n]->store,
+                                                      c->chip[n],
+                                                      num_probesets,
+                                                      sizeof(double));
     if (c->chip[n]->probe_set == NULL)
       AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, err);
 
@@ -452,16 +444,20 @@ int affy_mas5_signal(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err)
       c->chip[n]->probe_set[i] = calculate_probeset_signal(c->chip[n], 
                                                            i, 
                                                            f, 
+                                                           scratch,
                                                            err);
       AFFY_CHECK_ERROR_GOTO(err, err);
     }
   }
 
   pb_finish(&pbs, "Finished Tukey's Biweight probeset summarization");
+  h_free(scratch);
 
   return (0);
 
 err:
+  h_free(scratch);
+
   return (-1);
 }
 
@@ -470,6 +466,7 @@ int affy_iron_signal(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err)
 {
   int               i, n;
   int               num_probesets;
+  harena_t         *scratch;
   LIBUTILS_PB_STATE pbs;
 
   assert(c      != NULL);
@@ -479,6 +476,10 @@ int affy_iron_signal(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err)
   if (c->num_chips == 0)
     return (-1);
 
+  scratch = h_arena_create(NULL, 0);
+  if (scratch == NULL)
+    AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, -1);
+
   pb_init(&pbs);
 
   num_probesets = c->cdf->numprobesets;
@@ -488,9 +489,10 @@ int affy_iron_signal(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err)
            "Calculating signal for chip using IRON method");
   for (n = 0; n < c->num_chips; n++)
   {
-    c->chip[n]->probe_set = h_subcalloc(c->chip[n], 
-                                        num_probesets, 
-                                        sizeof(double));
+    c->chip[n]->probe_set = affy_backing_store_calloc(c->chip[n]->store,
+                                                      c->chip[n],
+                                                      num_probesets,
+                                                      sizeof(double));
     if (c->chip[n]->probe_set == NULL)
       AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, err);
 
@@ -502,16 +504,20 @@ int affy_iron_signal(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err)
       c->chip[n]->probe_set[i] = calculate_probeset_signal_iron(c->chip[n], 
                                                            i, 
                                                            f, 
+                                                           scratch,
                                                            err);
       AFFY_CHECK_ERROR_GOTO(err, err);
     }
   }
 
   pb_finish(&pbs, "Finished IRON probeset summarization");
+  h_free(scratch);
 
   return (0);
 
 err:
+  h_free(scratch);
+
   return (-1);
 }
 
@@ -520,38 +526,49 @@ int affy_mas5_subtract_mm_signal_probe(AFFY_CHIP *c,
                                        AFFY_COMBINED_FLAGS *f,
                                        AFFY_ERROR *err)
 {
-  AFFY_PROBESET *p;
-  AFFY_CELL    **data;
+  AFFY_CELFILE  *cel;
+  affy_uint32   *pm_cell, *mm_cell;
   double        *pm = NULL, *mm = NULL;
-  int            probeset_num, n, i, x, y;
+  int            probeset_num, n, i;
   int            numprobesets;
   double         SB, im;
+  harena_t      *scratch;
   LIBUTILS_PB_STATE pbs;
   
   /* chip is missing MM probes, abort */
   if (c->cdf->no_mm_flag == 1)
     return 1;
   
+  scratch = h_arena_create(NULL, 0);
+  if (scratch == NULL)
+    AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, 0);
+
   pb_init(&pbs);
-  data = c->cel->data;
+  cel  = c->cel;
   numprobesets = c->cdf->numprobesets;
 
   pb_begin(&pbs, 2, "MM Probe subtraction");
 
   for (probeset_num = 0; probeset_num < numprobesets; probeset_num++)
   {
-    p    = &(c->cdf->probeset[probeset_num]);
-    n    = p->numprobes;
+    pm_cell = c->cdf->pm_cell + c->cdf->ps_offset[probeset_num];
+    mm_cell = c->cdf->mm_cell + c->cdf->ps_offset[probeset_num];
+    n       = c->cdf->ps_offset[probeset_num + 1] -
+              c->cdf->ps_offset[probeset_num];
 
     /* Assign pm/mm values for this chip (based on existing layout) */
     pm = realloc(pm, n * sizeof(double));
     if (pm == NULL)
+    {
+      h_free(scratch);
       AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, 0);
+    }
 
     mm = realloc(mm, n * sizeof(double));
     if (mm == NULL)
     {
-      free(mm);
+      free(pm);
+      h_free(scratch);
       AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, 0);
     }
 
@@ -560,33 +577,27 @@ int affy_mas5_subtract_mm_signal_probe(AFFY_CHIP *c,
      */
     for (i = 0; i < n; i++)
     {
-      x = p->probe[i].pm.x;
-      y = p->probe[i].pm.y;
-      pm[i] = data[x][y].value;
+      pm[i] = affy_cel_value_at(cel, pm_cell[i]);
 
       /* hack for missing MM probes, where MM coords == PM coords
        */
-      if (p->probe[i].pm.x == p->probe[i].mm.x &&
-          p->probe[i].pm.y == p->probe[i].mm.y)
+      if (mm_cell[i] == pm_cell[i])
       {
-        if (affy_ismasked(c, x, y))
+        if (affy_cel_ismasked_at(cel, pm_cell[i]))
           continue;
         mm[i] = 0;
       }
       else
-      {
-        x = p->probe[i].mm.x;
-        y = p->probe[i].mm.y;
-        mm[i] = data[x][y].value;
-      }
+        mm[i] = affy_cel_value_at(cel, mm_cell[i]);
     }
 
-    SB = calculate_specific_background(pm, mm, n, err);
+    SB = calculate_specific_background(pm, mm, n, scratch, err);
 
     if (err->type != AFFY_ERROR_NONE)
     {
       free(pm);
       free(mm);
+      h_free(scratch);
 
       return (0);
     }
@@ -614,21 +625,15 @@ int affy_mas5_subtract_mm_signal_probe(AFFY_CHIP *c,
       /* hack for missing MM probes, where MM coords == PM coords
        * leave background unchanged
        */
-      if (p->probe[i].pm.x == p->probe[i].mm.x &&
-          p->probe[i].pm.y == p->probe[i].mm.y)
+      if (mm_cell[i] == pm_cell[i])
       {
         continue;
       }
       /* handle MM as usual */
       else
       {
-        x = p->probe[i].pm.x;
-        y = p->probe[i].pm.y;
-        data[x][y].value = pm[i] - im;
-        
-        x = p->probe[i].mm.x;
-        y = p->probe[i].mm.y;
-        data[x][y].value = 0;
+        affy_cel_set_value_at(cel, pm_cell[i], pm[i] - im);
+        affy_cel_set_value_at(cel, mm_cell[i], 0);
       }
     }
   }
@@ -637,6 +642,7 @@ int affy_mas5_subtract_mm_signal_probe(AFFY_CHIP *c,
   
   free(pm);
   free(mm);
+  h_free(scratch);
 
   AFFY_CHECK_ERROR(err, 0);
   
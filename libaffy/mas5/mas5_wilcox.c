@@ -15,6 +15,8 @@
  * 09/16/10: initial version (EAW)
  * 09/20/10: Pooled memory allocator (AMH)
  * 12/22/11: replaced Abramowitz (1964) pnorm approximation with Hart (1968)
+ * 10/16/26: work arrays come from a caller supplied scratch arena (EAW)
+ * 10/16/26: old affy_mas5_calculate_call_pvalue() signature back (EAW)
  *
  **************************************************************************/
 
@@ -186,7 +188,8 @@ static void rank(double *x, int nx, double *r)
 
 /* a straight translation of relevant bits of the wilcox.test method
    in the R base library */
-static double wilcox_approx(double *x, int n, double mu, AFFY_ERROR *err)
+static double wilcox_approx(double *x, int n, double mu, harena_t *scratch,
+                            AFFY_ERROR *err)
 {
   int     i = 0, j = 0;
   double *r        = 0;
@@ -200,11 +203,9 @@ static double wilcox_approx(double *x, int n, double mu, AFFY_ERROR *err)
   double SIGMA     = 0;
   double PVAL      = 0;
   double nx        = n;
-  int   *mempool;
+  harena_mark_t mark;
 
-  mempool = h_malloc(sizeof(int));
-  if (mempool == NULL)
-    AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, -DBL_MIN);
+  mark = h_arena_mark(scratch);
 
   for (i = 0; i < nx; i++)
   {
@@ -214,24 +215,24 @@ static double wilcox_approx(double *x, int n, double mu, AFFY_ERROR *err)
   }
 
   nx = j;
-  r  = (double *)h_subcalloc(mempool, nx, sizeof(double));
+  r  = (double *)h_arena_calloc(scratch, nx, sizeof(double));
   if (r == NULL)
   {
-    h_free(mempool);
+    h_arena_reset(scratch, mark);
     AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, -DBL_MIN);
   }
 
-  absx = (double *)h_subcalloc(mempool, nx, sizeof(double));
+  absx = (double *)h_arena_calloc(scratch, nx, sizeof(double));
   if (absx == NULL)
   {
-    h_free(mempool);
+    h_arena_reset(scratch, mark);
     AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, -DBL_MIN);
   }
 
-  xidx = (int *)h_subcalloc(mempool, nx, sizeof(int));
+  xidx = (int *)h_arena_calloc(scratch, nx, sizeof(int));
   if (xidx == NULL)
   {
-    h_free(mempool);
+    h_arena_reset(scratch, mark);
     AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, -DBL_MIN);
   }
 
@@ -276,7 +277,7 @@ static double wilcox_approx(double *x, int n, double mu, AFFY_ERROR *err)
   PVAL    = pnorm(z / SIGMA);
   PVAL    = 1 - PVAL;
 
-  h_free(mempool);
+  h_arena_reset(scratch, mark);
 
   return (PVAL);
 }
@@ -388,11 +389,34 @@ double affy_mas5_calculate_call_pvalue(double *values,
                                        int n,
                                        double tau,
                                        AFFY_ERROR *err)
+{
+  harena_t *scratch;
+  double    pvalue;
+
+  scratch = h_arena_create(NULL, 0);
+  if (scratch == NULL)
+    AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, -DBL_MIN);
+
+  pvalue = affy_mas5_calculate_call_pvalue_scratch(values, n, tau,
+                                                   scratch, err);
+
+  h_free(scratch);
+
+  return (pvalue);
+}
+
+/* Same as affy_mas5_calculate_call_pvalue(), work arrays from scratch */
+double affy_mas5_calculate_call_pvalue_scratch(double *values,
+                                               int n,
+                                               double tau,
+                                               harena_t *scratch,
+                                               AFFY_ERROR *err)
 {
   struct affy_wilcox  *rset      = NULL;
   struct affy_wilcox **rset_sort = NULL;
-  int                  i, *mempool;
+  int                  i;
   double               pvalue;
+  harena_mark_t        mark;
 
   if (n == 0)
     return (1.0);
@@ -400,27 +424,25 @@ double affy_mas5_calculate_call_pvalue(double *values,
   /* Should be at least >= 20, set it as high as is feasible */
   /* HG-U133plus2 chip has one AFFX probeset with 69, 2nd biggest are 20 */
   if (n >= 21)
-    return (wilcox_approx(values, n, tau, err));
+    return (wilcox_approx(values, n, tau, scratch, err));
 
-  mempool = h_malloc(sizeof(int));
-  if (mempool == NULL)
-    AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, -DBL_MIN);
+  mark = h_arena_mark(scratch);
 
-  rset = (struct affy_wilcox *)h_subcalloc(mempool,
-                                           n,
-                                           sizeof(struct affy_wilcox));
+  rset = (struct affy_wilcox *)h_arena_calloc(scratch,
+                                              n,
+                                              sizeof(struct affy_wilcox));
   if (rset == NULL)
   {
-    h_free(mempool);
+    h_arena_reset(scratch, mark);
     AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, -DBL_MIN);
   }
 
-  rset_sort = (struct affy_wilcox **)h_subcalloc(mempool,
-                                                 n,
-                                                 sizeof(struct affy_wilcox *));
+  rset_sort = (struct affy_wilcox **)h_arena_calloc(scratch,
+                                                    n,
+                                                    sizeof(struct affy_wilcox *));
   if (rset_sort == NULL)
   {
-    h_free(mempool);
+    h_arena_reset(scratch, mark);
     AFFY_HANDLE_ERROR("calloc failed", AFFY_ERROR_OUTOFMEM, err, -DBL_MIN);
   }
 
@@ -439,7 +461,7 @@ double affy_mas5_calculate_call_pvalue(double *values,
 
   pvalue = affy_mas5_calculate_wilcox_pvalue(rset, n);
 
-  h_free(mempool);
+  h_arena_reset(scratch, mark);
 
   return (pvalue);
 }
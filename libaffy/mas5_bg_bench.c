@@ -0,0 +1,264 @@
+/*
+ * Microbenchmark for MAS5 background correction
+ * (mas5/mas5_background_correction.c): synthetic chipsets at a few
+ * common array sizes, with a QC border, scattered undefined and masked
+ * cells, in both CEL storage layouts (see affy_alloc_cel_data()).
+ * Every result is also checked: cells that must be skipped are left
+ * alone, the rest are positive, and the compact layout gives the same
+ * values as the AFFY_CELL one, rounded to float.
+ *
+ *   scons mas5_bg_bench && ./libaffy/mas5_bg_bench 2>/dev/null
+ */
+
+#include <time.h>
+
+#include <affy_mas5.h>
+
+/* chips per chipset */
+#define BENCH_CHIPS  4
+
+/* total cells corrected per case, so each line takes similar time */
+#define BENCH_CELLS  20000000
+
+/* every BENCH_UNDEFINED'th cell is undefined, every BENCH_MASKED'th masked */
+#define BENCH_UNDEFINED 97
+#define BENCH_MASKED    1009
+
+/* results are accumulated here so the work can't be optimized away */
+static volatile double sink;
+
+static unsigned long long rng_state = 88172645463325252ULL;
+
+/* xorshift64, so runs are repeatable */
+static double next_random(void)
+{
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+
+  return ((rng_state >> 11) * (1.0 / 9007199254740992.0));
+}
+
+static void out_of_memory(void)
+{
+  printf("out of memory\n");
+  exit(EXIT_FAILURE);
+}
+
+/*
+ * A square n x n chipset of BENCH_CHIPS chips sharing one CDF, with
+ * everything allocated under the chipset.
+ */
+static AFFY_CHIPSET *make_chipset(int n, int storage, AFFY_ERROR *err)
+{
+  AFFY_CHIPSET *cs;
+  AFFY_CDFFILE *cdf;
+  AFFY_CELFILE *cf;
+  size_t        i, numcells = (size_t)n * n;
+  affy_uint32   m;
+  int           x, y, c;
+
+  cs = h_calloc(1, sizeof(AFFY_CHIPSET));
+  if (cs == NULL)
+    out_of_memory();
+
+  cs->max_chips = cs->num_chips = BENCH_CHIPS;
+  cs->numrows   = cs->numcols   = n;
+  cs->cel_storage = storage;
+
+  cdf = cs->cdf = h_subcalloc(cs, 1, sizeof(AFFY_CDFFILE));
+  cs->chip = h_subcalloc(cs, BENCH_CHIPS, sizeof(AFFY_CHIP *));
+  if (cdf == NULL || cs->chip == NULL)
+    out_of_memory();
+
+  cdf->numrows   = cdf->numcols = n;
+  cdf->cell_type = h_subcalloc(cdf, n, sizeof(affy_uint8 *));
+  if (cdf->cell_type == NULL)
+    out_of_memory();
+
+  cdf->cell_type[0] = h_subcalloc(cdf->cell_type, numcells,
+                                  sizeof(affy_uint8));
+  if (cdf->cell_type[0] == NULL)
+    out_of_memory();
+
+  for (x = 0, i = 0; x < n; x++)
+  {
+    cdf->cell_type[x] = cdf->cell_type[0] + (size_t)x * n;
+
+    for (y = 0; y < n; y++, i++)
+    {
+      if (x == 0 || y == 0 || x == n - 1 || y == n - 1)
+        cdf->cell_type[x][y] = AFFY_QC_LOCATION;
+      else if (i % BENCH_UNDEFINED == 0)
+        cdf->cell_type[x][y] = AFFY_UNDEFINED_LOCATION;
+      else
+        cdf->cell_type[x][y] = AFFY_NORMAL_LOCATION;
+    }
+  }
+
+  for (c = 0; c < BENCH_CHIPS; c++)
+  {
+    cs->chip[c] = h_subcalloc(cs->chip, 1, sizeof(AFFY_CHIP));
+    if (cs->chip[c] == NULL)
+      out_of_memory();
+
+    cs->chip[c]->cdf = cdf;
+
+    cf = h_subcalloc(cs->chip[c], 1, sizeof(AFFY_CELFILE));
+    if (cf == NULL)
+      out_of_memory();
+
+    cs->chip[c]->cel = cf;
+    cf->numrows      = cf->numcols = n;
+    affy_alloc_cel_data(cf, storage, err);
+
+    /* offset per chip, so the masks don't all fall on the same cells */
+    cf->nummasks = (affy_uint32)((numcells - 1 - c) / BENCH_MASKED) + 1;
+    cf->mask     = h_subcalloc(cf, cf->nummasks, sizeof(affy_uint32));
+    if (cf->mask == NULL)
+      out_of_memory();
+
+    for (m = 0; m < cf->nummasks; m++)
+      cf->mask[m] = m * BENCH_MASKED + c;
+  }
+
+  return (cs);
+}
+
+static void load_values(AFFY_CHIPSET *cs, const double *values)
+{
+  size_t i, numcells = (size_t)cs->numrows * cs->numcols;
+  int    c;
+
+  for (c = 0; c < cs->num_chips; c++)
+    for (i = 0; i < numcells; i++)
+      affy_cel_set_value_at(cs->chip[c]->cel, i, values[c * numcells + i]);
+}
+
+/*
+ * Time BENCH_CELLS worth of corrections, reloading the raw values
+ * (untimed) before each one; the corrected values are left in cs.
+ */
+static double time_correction(AFFY_CHIPSET *cs,
+                              const double *values,
+                              int reps,
+                              AFFY_COMBINED_FLAGS *f,
+                              AFFY_ERROR *err)
+{
+  clock_t total = 0, start;
+  int     r;
+
+  for (r = 0; r < reps; r++)
+  {
+    load_values(cs, values);
+
+    start = clock();
+    affy_mas5_background_correction(cs, f, err);
+    total += clock() - start;
+
+    sink += affy_cel_value_at(cs->chip[0]->cel, cs->numrows + 1);
+  }
+
+  return ((double)total / CLOCKS_PER_SEC);
+}
+
+static int check(AFFY_CHIPSET *cells,
+                 AFFY_CHIPSET *compact,
+                 const double *values)
+{
+  size_t        i, numcells = (size_t)cells->numrows * cells->numcols;
+  double        v;
+  int           c;
+  AFFY_CELFILE *cf;
+
+  for (c = 0; c < cells->num_chips; c++)
+  {
+    cf = cells->chip[c]->cel;
+
+    for (i = 0; i < numcells; i++)
+    {
+      v = affy_cel_value_at(cf, i);
+
+      if (cells->cdf->cell_type[0][i] != AFFY_NORMAL_LOCATION ||
+          affy_cel_ismasked_at(cf, i))
+      {
+        if (v != values[c * numcells + i])
+          return (1);
+      }
+      else if (!(v > 0 && v < HUGE_VAL))
+        return (1);
+
+      if ((float)v != affy_cel_value_at(compact->chip[c]->cel, i))
+        return (1);
+    }
+  }
+
+  return (0);
+}
+
+static int bench(int n, AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err)
+{
+  AFFY_CHIPSET *cells, *compact;
+  double       *values, t_cells, t_compact;
+  size_t        i, total = (size_t)BENCH_CHIPS * n * n;
+  int           reps, failed;
+
+  reps = BENCH_CELLS / total;
+  if (reps < 1)
+    reps = 1;
+
+  values = malloc(total * sizeof(double));
+  if (values == NULL)
+    out_of_memory();
+
+  /*
+   * Log-scale intensities, 2^6 .. 2^14 in sixteenths, which are exact
+   * in a float so both layouts start from the same values.
+   */
+  for (i = 0; i < total; i++)
+    values[i] = floor(pow(2.0, 6.0 + 8.0 * next_random()) * 16.0) / 16.0;
+
+  cells   = make_chipset(n, AFFY_CEL_STORAGE_CELLS, err);
+  compact = make_chipset(n, AFFY_CEL_STORAGE_COMPACT, err);
+
+  t_cells   = time_correction(cells, values, reps, f, err);
+  t_compact = time_correction(compact, values, reps, f, err);
+  failed    = check(cells, compact, values);
+
+  /* milliseconds per chip */
+  printf("%5dx%-5d %6d %9.2f %9.2f  %s\n",
+         n, n, reps,
+         1000.0 * t_cells / (reps * BENCH_CHIPS),
+         1000.0 * t_compact / (reps * BENCH_CHIPS),
+         failed ? "MISMATCH" : "ok");
+
+  h_free(cells);
+  h_free(compact);
+  free(values);
+
+  return (failed);
+}
+
+int main(int argc, char **argv)
+{
+  /* HG-U95 class, HG-U133A, HG-U133 Plus 2.0, Human Exon 1.0 ST */
+  static const int    sizes[] = { 640, 712, 1164, 2560 };
+  AFFY_COMBINED_FLAGS f;
+  AFFY_ERROR         *err;
+  int                 i, failed = 0;
+
+  err = affy_get_default_error();
+  if (err == NULL)
+    out_of_memory();
+
+  affy_mas5_set_defaults(&f);
+
+  printf("%-11s %6s %9s %9s\n", "chip", "reps", "cells", "compact");
+
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    failed |= bench(sizes[i], &f, err);
+
+  free(err);
+
+  exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -16,6 +16,12 @@
  * 06/05/08: New error handling scheme (AMH)
  * 09/20/10: Pooled memory allocator (AMH)
  * 11/19/10: Pass flags to affy_median_polish() (EAW)
+ * 10/16/26: work vectors come from a caller supplied scratch arena (EAW)
+ * 10/16/26: polish a contiguous row-major block, medians by selection
+ *           instead of qsort(), single chip fast path (EAW)
+ * 10/16/26: medians from the libutils selection routines (EAW)
+ * 10/16/26: block kernel is affy_rma_median_polish_block(), the old
+ *           row pointer entry point packs into it (EAW)
  *
  **************************************************************************/
 
@@ -54,192 +60,196 @@ static INLINE void vector_add(double *x, double *xdelta, unsigned int n)
     x[i] += xdelta[i];
 }
 
-static INLINE double sum_abs(double **z, 
-                             int startingrow, 
-                             int startingcol, 
-			     int numrows, 
-                             int numcols)
+/* Sum of |z|, row by row (the order matters for exact results) */
+static INLINE double sum_abs(const double *z, 
+                             int numrows, 
+                             int numcols,
+                             int stride)
 {
   int    i, j;
-  int    rowsleft, colsleft;
   double sum = 0.0;
 
   assert(z != NULL);
 
-  for (i = startingrow, rowsleft = numrows; rowsleft > 0; i++, rowsleft--)
-    for (j = startingcol, colsleft = numcols; colsleft > 0; j++, colsleft--)
-      sum += fabs(z[i][j]);
+  for (i = 0; i < numrows; i++, z += stride)
+    for (j = 0; j < numcols; j++)
+      sum += fabs(z[j]);
 
   return (sum);
+}
 
-/*   int i, j; */
-/*   double sum = 0.0; */
-
-/*   for (i = 0; i < numrows; i++) */
-/*     for (j = 0; j < numcols; j++) */
-/*       sum += fabs(z[i][j]); */
+static INLINE void subtract_by_row(double *z, 
+                                   const double *rdelta, 
+                                   int numrows, 
+                                   int numcols,
+                                   int stride)
+{
+  int i, j;
 
-/*   return sum; */
+  assert(z      != NULL);
+  assert(rdelta != NULL);
 
+  for (i = 0; i < numrows; i++, z += stride)
+    for (j = 0; j < numcols; j++)
+      z[j] -= rdelta[i];
 }
 
-static INLINE void subtract_by_row(double **z, 
-                                   double *rdelta, 
-				   int startingrow, 
-                                   int startingcol, 
-				   int numrows, 
-                                   int numcols)
+static INLINE void subtract_by_col(double *z, 
+                                   const double *cdelta, 
+                                   int numrows, 
+                                   int numcols,
+                                   int stride)
 {
-  int i, j, rowsleft, colsleft;
+  int i, j;
 
-  assert(z != NULL);
+  assert(z      != NULL);
+  assert(cdelta != NULL);
 
-  for (i = startingrow, rowsleft = numrows; rowsleft > 0; i++, rowsleft--)
-    for (j = startingcol, colsleft = numcols; colsleft > 0; j++, colsleft--)
-      z[i][j] -= rdelta[numrows-rowsleft];
+  for (i = 0; i < numrows; i++, z += stride)
+    for (j = 0; j < numcols; j++)
+      z[j] -= cdelta[j];
+}
 
-/*   int i, j; */
+/* Median of n values spaced stride apart, using buffer as work space */
+static INLINE double strided_median(const double *x, int n, int stride,
+                                    double *buffer)
+{
+  int i;
 
-/*   for (i = 0; i < numrows; i++) */
-/*     for (j = 0; j < numcols; j++) */
-/*       z[i][j] -= rdelta[i]; */
-/*   return; */
+  for (i = 0; i < n; i++, x += stride)
+    buffer[i] = *x;
 
+  return (dmedian(buffer, n));
 }
 
-static INLINE void subtract_by_col(double **z, 
-                                   double *cdelta, 
-				   int startingrow, 
-                                   int startingcol, 
-				   int numrows, 
-                                   int numcols)
+/*
+ * A single chip (column) converges in one pass: each row median is the
+ * row itself, leaving all-zero residuals, and t is the median of the
+ * column.  The arithmetic below is the same as the first iteration of
+ * the full polish, so the results are identical.  Only valid when every
+ * value is finite; returns -1 otherwise.
+ */
+static int polish_single_column(double *z,
+                                int numprobes,
+                                int stride,
+                                double *r,
+                                double *buffer,
+                                double *results,
+                                double *affinities,
+                                double *t_val)
 {
-  int i, j, rowsleft, colsleft;
+  double t, c, m, *zp;
+  int    i;
 
-  assert(z      != NULL);
-  assert(cdelta != NULL);
+  for (i = 0, zp = z; i < numprobes; i++, zp += stride)
+  {
+    if (isinf(*zp) || isnan(*zp))
+      return (-1);
+  }
+
+  for (i = 0, zp = z; i < numprobes; i++, zp += stride)
+  {
+    r[i]      = 0.0 + *zp;
+    buffer[i] = r[i];
+    *zp       = 0.0;
+  }
 
-/*   fprintf(stderr, "startingrow = %d, startingcol = %d, numrows = %d, " */
-/* 	  "numcols = %d\n", startingrow, startingcol, numrows, numcols); */
-/*   fflush(stderr); */
+  /* c starts at 0, its median and the all-zero column median are 0 */
+  c = 0.0;
+  t = 0.0 + 0.0;
+  m = dmedian(buffer, numprobes);
+  t += m;
 
-  for (j = startingcol, colsleft = numcols; colsleft > 0; j++, colsleft--)
+  if (results != NULL)
+    results[0] = t + c;
+
+  if (affinities != NULL)
   {
-/*     fprintf(stderr, "colsleft = %d, j = %d\n", colsleft, j); */
-/*     fflush(stderr); */
-    for (i = startingrow, rowsleft = numrows; rowsleft > 0; i++, rowsleft--)
-    {
-/*       fprintf(stderr, "rowsleft = %d, i = %d\n", rowsleft, i); */
-/*       fprintf(stderr, "z[%d][%d]  cdelta[%d]\n", i, j, numcols-colsleft); */
-/*       fflush(stderr); */
-      z[i][j] -= cdelta[numcols-colsleft];
-    }
+    for (i = 0; i < numprobes; i++)
+      affinities[i] = t + (r[i] - m);
   }
 
-/*   int i, j; */
-
-/*   for (j = 0; j < numcols; j++) */
-/*   { */
-/*     for (i = 0; i < numrows; i++) */
-/*     { */
-/*       fprintf(stderr, "z[%d][%d]  cdelta[%d]\n", i, j, j); */
-     
-/*  z[i][j] -= cdelta[j]; */
-/*     } */
-/*   } */
+  if (t_val != NULL)
+    *t_val = t;
+
+  return (0);
 }
 
 /*
-  Do a median polish on the chipset c, using probe set # ps. The results
-  are stored in the corresponding probe_set array for each chip.
+  Median polish the numprobes x numchips matrix z, stored row-major with
+  row i starting at z[i * stride] (stride >= numchips, so one column of
+  a larger matrix can be polished in place).  z is overwritten with the
+  residuals.  Expressions go to results[numchips], probe affinities to
+  affinities[numprobes] and the overall effect to *t_val, any of which
+  may be NULL.  Work space comes from scratch, and is given back.
 */
-void affy_rma_median_polish(double **z, 
-                            int startingprobe, 
-                            int startingchip, 
-			    int numprobes, 
-                            int numchips, 
-                            double *results, 
-			    double *affinities,
-                            double *t_val,
-                            AFFY_COMBINED_FLAGS *f,
-                            AFFY_ERROR *err)
+void affy_rma_median_polish_block(double *z, 
+                                  int numprobes, 
+                                  int numchips, 
+                                  int stride,
+                                  double *results, 
+                                  double *affinities,
+                                  double *t_val,
+                                  AFFY_COMBINED_FLAGS *f,
+                                  harena_t *scratch,
+                                  AFFY_ERROR *err)
 {
-  double *rdelta = NULL, *r = NULL, *cdelta = NULL, *c = NULL;
+  double *work, *rdelta, *r, *cdelta, *c, *buffer;
   double eps = 0.01;
   double oldsum = 0.0, newsum = 0.0;
   double t = 0.0;
   double delta;
-  int    i, j, it, *mempool;
-
-  assert(z    != NULL);
-  assert(z[0] != NULL);
+  int    i, j, it;
+  harena_mark_t mark;
 
-  mempool = h_malloc(sizeof(int));
-  if (mempool == NULL)
-    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+  assert(z      != NULL);
+  assert(stride >= numchips);
 
-  rdelta = h_subcalloc(mempool, numprobes, sizeof(double));
-  if (rdelta == NULL)
-    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+  /* everything in one block, handed back to scratch on the way out */
+  mark = h_arena_mark(scratch);
 
-  cdelta = h_subcalloc(mempool, numchips, sizeof(double));
-  if (rdelta == NULL)
+  work = h_arena_calloc(scratch,
+                        2 * numprobes + 2 * numchips +
+                        (numprobes > numchips ? numprobes : numchips),
+                        sizeof(double));
+  if (work == NULL)
     AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
 
-  r = h_subcalloc(mempool, numprobes, sizeof(double));
-  if (rdelta == NULL)
-    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+  rdelta = work;
+  r      = rdelta + numprobes;
+  cdelta = r      + numprobes;
+  c      = cdelta + numchips;
+  buffer = c      + numchips;
 
-  c = h_subcalloc(mempool, numchips, sizeof(double));
-  if (rdelta == NULL)
-    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+  if (numchips == 1 &&
+      polish_single_column(z, numprobes, stride, r, buffer,
+                           results, affinities, t_val) == 0)
+    goto cleanup;
 
   /* Do the actual median polish */
   for (it = 0; it < max_iterations; it++)
   {
     /* Rows first */
-    affy_get_row_median(z, 
-                        rdelta, 
-                        startingprobe, 
-                        startingchip, 
-                        numprobes, 
-			numchips,
-			f,
-                        err);
-    AFFY_CHECK_ERROR_GOTO(err, cleanup);
-
-    subtract_by_row(z, 
-                    rdelta, 
-                    startingprobe, 
-                    startingchip, 
-                    numprobes, 
-		    numchips);
+    for (i = 0; i < numprobes; i++)
+      rdelta[i] = strided_median(z + i * stride, numchips, 1, buffer);
+
+    subtract_by_row(z, rdelta, numprobes, numchips, stride);
     vector_add(r, rdelta, numprobes);
 
-    delta = affy_median_save(c, numchips, f, err);
-    AFFY_CHECK_ERROR_GOTO(err, cleanup);
+    delta = strided_median(c, numchips, 1, buffer);
 
     for (j = 0; j < numchips; j++)
       c[j] -= delta;
     t += delta;
 
     /* Then columns */
-    affy_get_column_median(z, 
-                           cdelta, 
-                           startingprobe, 
-                           startingchip, 
-                           numprobes, 
-			   numchips,
-			   f,
-                           err);
-    AFFY_CHECK_ERROR_GOTO(err, cleanup);
-
-    subtract_by_col(z, cdelta, startingprobe, startingchip, numprobes, 
-		    numchips);
+    for (j = 0; j < numchips; j++)
+      cdelta[j] = strided_median(z + j, numprobes, stride, buffer);
+
+    subtract_by_col(z, cdelta, numprobes, numchips, stride);
     vector_add(c, cdelta, numchips);
 
-    delta = affy_median_save(r, numprobes, f, err);
-    AFFY_CHECK_ERROR_GOTO(err, cleanup);
+    delta = strided_median(r, numprobes, 1, buffer);
 
     for (i = 0; i < numprobes; i++)
       r[i] -= delta;
@@ -247,7 +257,7 @@ void affy_rma_median_polish(double **z,
     t += delta;
 
     /* If changes are small, then quit */
-    newsum = sum_abs(z, startingprobe, startingchip, numprobes, numchips);
+    newsum = sum_abs(z, numprobes, numchips, stride);
 
     if ((newsum == 0.0) || (fabs(1.0 - oldsum / newsum) < eps))
       break;
@@ -272,5 +282,54 @@ void affy_rma_median_polish(double **z,
     *t_val = t;
 
 cleanup:
-  h_free(mempool);
+  h_arena_reset(scratch, mark);
+}
+
+/*
+  Median polish the numprobes x numchips submatrix of z starting at
+  z[startingprobe][startingchip], leaving the residuals in z.  The
+  submatrix is copied into one block for affy_rma_median_polish_block()
+  and the residuals copied back.
+*/
+void affy_rma_median_polish(double **z, 
+                            int startingprobe, 
+                            int startingchip, 
+                            int numprobes, 
+                            int numchips, 
+                            double *results, 
+                            double *affinities,
+                            double *t_val,
+                            AFFY_COMBINED_FLAGS *f,
+                            AFFY_ERROR *err)
+{
+  harena_t *scratch;
+  double   *block;
+  int       i, j;
+
+  assert(z    != NULL);
+  assert(z[0] != NULL);
+
+  scratch = h_arena_create(NULL, 0);
+  if (scratch == NULL)
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+
+  block = h_arena_calloc(scratch, (size_t)numprobes * numchips,
+                         sizeof(double));
+  if (block == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+  for (i = 0; i < numprobes; i++)
+    for (j = 0; j < numchips; j++)
+      block[i * numchips + j] = z[startingprobe + i][startingchip + j];
+
+  affy_rma_median_polish_block(block, numprobes, numchips, numchips,
+                               results, affinities, t_val, f, scratch, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+  for (i = 0; i < numprobes; i++)
+    for (j = 0; j < numchips; j++)
+      z[startingprobe + i][startingchip + j] = block[i * numchips + j];
+
+cleanup:
+  h_free(scratch);
 }
@@ -30,6 +30,18 @@
  * 08/12/20: pass flags to affy_create_chipset() (EAW)
  * 09/05/23: change utils_getline() to fgets_strip_realloc() (EAW)
  * 01/10/24: pass flags to affy_mean_normalization() (EAW)
+ * 10/16/26: load CEL files through the threaded prefetch loader (EAW)
+ * 10/16/26: read saved means with LINE_READER (EAW)
+ * 10/16/26: write saved means through an OUTPUT_BUFFER (EAW)
+ * 10/16/26: access cells through affy_cel_value() and friends (EAW)
+ * 10/16/26: gather PM probes through cdf->pm_cell[] (EAW)
+ * 10/16/26: per-chip arrays go through the chipset's backing store (EAW)
+ * 10/16/26: write frozen models; affy_rma_frozen() processes chips one at
+ *           a time against one (EAW)
+ * 10/16/26: rank the chips for quantile normalization after loading, in
+ *           parallel (EAW)
+ * 10/16/26: scan the CEL headers once up front, load from the index (EAW)
+ * 10/16/26: affy_rma_frozen() no longer changes the caller's flags (EAW)
  *
  **************************************************************************/
 
@@ -47,24 +59,19 @@ static void load_pm(AFFY_CHIP *cp, AFFY_ERROR *err)
   assert(cp            != NULL);
   assert(cp->cdf       != NULL);
   assert(cp->cel       != NULL);
-  assert(cp->cel->data != NULL);
+  assert(affy_cel_has_data(cp->cel));
 
   numprobes = cp->cdf->numprobes;
 
-  cp->pm = h_subcalloc(cp, numprobes, sizeof(double));
+  cp->pm = affy_backing_store_calloc(cp->store, cp, numprobes,
+                                     sizeof(double));
   if (cp->pm == NULL)
     AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
   
   for (k = 0; k < numprobes; k++)
-  {
-    int x = cp->cdf->probe[k]->pm.x;
-    int y = cp->cdf->probe[k]->pm.y;
-    
-    cp->pm[k] = cp->cel->data[x][y].value;
-  }
+    cp->pm[k] = affy_cel_value_at(cp->cel, cp->cdf->pm_cell[k]);
   
-  h_free(cp->cel->data);
-  cp->cel->data = NULL;
+  affy_free_cel_data(cp->cel);
 }
 
 AFFY_CHIPSET *affy_rma(char **filelist, AFFY_COMBINED_FLAGS *f,
@@ -72,6 +79,8 @@ AFFY_CHIPSET *affy_rma(char **filelist, AFFY_COMBINED_FLAGS *f,
 {
   AFFY_CHIPSET         *result = NULL, *model_chipset = NULL, *temp = NULL;
   AFFY_CHIP            *model_chip = NULL;
+  AFFY_CEL_PREFETCH    *pf = NULL;
+  AFFY_CEL_INDEX       *idx = NULL;
   AFFY_COMBINED_FLAGS  default_flags;
   int                  i;
   char                 *chip_type, **p;
@@ -88,6 +97,9 @@ AFFY_CHIPSET *affy_rma(char **filelist, AFFY_COMBINED_FLAGS *f,
     affy_rma_set_defaults(&default_flags);
     f = &default_flags;
   }
+
+  if (f->use_frozen_model)
+    return (affy_rma_frozen(filelist, f, err));
   
   /* sanity check, can not mix-and-match quantile with post-norm non-rma bg */
   if (f->use_background_correction && f->normalize_before_bg &&
@@ -109,13 +121,16 @@ AFFY_CHIPSET *affy_rma(char **filelist, AFFY_COMBINED_FLAGS *f,
   if (mempool == NULL)
     AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, NULL);
 
-  /* Get the array type. */
-  chip_type = affy_get_cdf_name_from_cel(filelist[0], err);
+  /* Scan every CEL header once; the array type is the first file's */
+  idx = affy_scan_cel_headers(filelist, f->num_threads, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+  hattach(idx, mempool);
+
+  chip_type = affy_cel_index_array_type(idx, err);
   if (chip_type == NULL)
     AFFY_CHECK_ERROR_GOTO(err, cleanup);
 
-  hattach(chip_type, mempool);
-
   /* Count up chips */
   for (p = filelist, max_chips = 0; *p != NULL; p++)
     max_chips++;
@@ -129,7 +144,7 @@ AFFY_CHIPSET *affy_rma(char **filelist, AFFY_COMBINED_FLAGS *f,
 
   /* abort if any MM probes are missing */
   if (result->cdf->dupe_probes_flag)
-    AFFY_HANDLE_ERROR("multiple probesets share same probe, use 'iron --norm-quantile --median-polish' instead", AFFY_ERROR_NOTSUPP, err, NULL);
+    AFFY_HANDLE_ERROR_GOTO("multiple probesets share same probe, use 'iron --norm-quantile --median-polish' instead", AFFY_ERROR_NOTSUPP, err, cleanup);
 
   numprobes = result->cdf->numprobes;
   
@@ -138,6 +153,28 @@ AFFY_CHIPSET *affy_rma(char **filelist, AFFY_COMBINED_FLAGS *f,
     f->reuse_affinities = false;
   if (f->use_saved_affinities)
     f->reuse_affinities = false;
+
+  /* a frozen model is the quantile target plus the affinities of this run */
+  if (f->dump_frozen_model)
+  {
+    if (!f->use_normalization || f->use_mean_normalization ||
+        f->use_pairwise_normalization || f->use_rma_probeset_singletons ||
+        f->use_saved_affinities)
+      AFFY_HANDLE_ERROR_GOTO("frozen models require quantile normalization "
+                             "and affinities estimated from all chips",
+                             AFFY_ERROR_NOTSUPP,
+                             err,
+                             cleanup);
+
+    if (f->use_background_correction && (!f->bg_rma || f->normalize_before_bg))
+      AFFY_HANDLE_ERROR_GOTO("frozen models require RMA background "
+                             "correction (or none)",
+                             AFFY_ERROR_NOTSUPP,
+                             err,
+                             cleanup);
+
+    f->reuse_affinities = true;
+  }
   
   if (f->use_pairwise_normalization)
   {
@@ -199,14 +236,18 @@ AFFY_CHIPSET *affy_rma(char **filelist, AFFY_COMBINED_FLAGS *f,
     info("Pairwise reference sample loaded");
   }
 
+  /* Start loading CEL files in the background */
+  pf = affy_cel_prefetch_start(filelist, idx, f->num_threads, 0,
+                               result->cel_storage, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
   /* Load each chip */
   for (i = 0; i < max_chips; i++)
   {
     int cur_chip;
 
     /* Load chip */
-    affy_load_chipset_single(result, filelist[i],
-                             f->ignore_chip_mismatch, err);
+    affy_load_chipset_next(result, pf, f->ignore_chip_mismatch, err);
     if (err->type != AFFY_ERROR_NONE)
       continue;
 
@@ -256,27 +297,25 @@ AFFY_CHIPSET *affy_rma(char **filelist, AFFY_COMBINED_FLAGS *f,
       load_pm(result->chip[cur_chip], err);
       AFFY_CHECK_ERROR_GOTO(err, cleanup);
     }
+  }
 
-    /* Normalize (partially) */
-    if (f->use_normalization)
-    {
-      if (!f->use_mean_normalization && !f->use_pairwise_normalization)
-      {
-        /* Default is quantile normalization */
-        if (mean == NULL)
-        {
-          mean = h_subcalloc(mempool, numprobes, sizeof(double));
-          if (mean == NULL)
-            AFFY_HANDLE_ERROR_GOTO("calloc failed",
-                                   AFFY_ERROR_OUTOFMEM,
-                                   err,
-                                   cleanup);
-        }
+  affy_cel_prefetch_free(pf);
+  pf = NULL;
 
-        affy_rma_quantile_normalization_chip(result, cur_chip, mean, f, err);
-        AFFY_CHECK_ERROR_GOTO(err, cleanup);
-      }
-    }
+  /* Normalize (partially): rank every chip, the chips in parallel */
+  if (f->use_normalization &&
+      !f->use_mean_normalization && !f->use_pairwise_normalization)
+  {
+    /* Default is quantile normalization */
+    mean = h_subcalloc(mempool, numprobes, sizeof(double));
+    if (mean == NULL)
+      AFFY_HANDLE_ERROR_GOTO("calloc failed",
+                             AFFY_ERROR_OUTOFMEM,
+                             err,
+                             cleanup);
+
+    affy_rma_quantile_normalization_chips(result, mean, f, err);
+    AFFY_CHECK_ERROR_GOTO(err, cleanup);
   }
 
   /* Option to use mean normalization */
@@ -294,13 +333,10 @@ AFFY_CHIPSET *affy_rma(char **filelist, AFFY_COMBINED_FLAGS *f,
   {
     if (f->use_saved_means)
     {
-      FILE *fp;
-      char *nl, *err_str;
-      int   i = 0;
-      int   max_string_len;
-      
-      nl             = NULL;
-      max_string_len = 0;
+      FILE        *fp;
+      LINE_READER *lr;
+      char        *nl, *err_str;
+      int          i = 0;
 
       fp = fopen(f->means_filename, "rb");
       if (fp == NULL)
@@ -309,15 +345,25 @@ AFFY_CHIPSET *affy_rma(char **filelist, AFFY_COMBINED_FLAGS *f,
                                err,
                                cleanup);
 
-      /* while ((nl = utils_getline(fp)) != NULL) */
-      while (fgets_strip_realloc(&nl, &max_string_len, fp) != NULL)
+      lr = line_reader_init(fp);
+      if (lr == NULL)
+      {
+        fclose(fp);
+        AFFY_HANDLE_ERROR_GOTO("malloc failed",
+                               AFFY_ERROR_OUTOFMEM,
+                               err,
+                               cleanup);
+      }
+
+      while ((nl = line_reader_next(lr, NULL)) != NULL)
       {
 	mean[i] = strtod(nl, &err_str);
 	
 	if ((nl == err_str) && (mean[i] == 0))
         {
-          if (nl) free(nl);
-        
+          line_reader_free(lr);
+          fclose(fp);
+
 	  warn("error parsing mean value from %s, line %d\n", 
                f->means_filename, 
                i);
@@ -330,8 +376,7 @@ AFFY_CHIPSET *affy_rma(char **filelist, AFFY_COMBINED_FLAGS *f,
 	i++;
       }
       fclose(fp);
-
-      if (nl) free(nl);
+      line_reader_free(lr);
 
       if (i != numprobes)
       {
@@ -352,9 +397,10 @@ AFFY_CHIPSET *affy_rma(char **filelist, AFFY_COMBINED_FLAGS *f,
   /* Save the means if such was requested. */
   if (f->dump_expression_means)
   {
-    FILE *fp;
-    int   i;
-    char *mf_name = f->means_filename;
+    FILE          *fp;
+    OUTPUT_BUFFER *ob;
+    int            i;
+    char          *mf_name = f->means_filename;
     
     assert(mean != NULL);
     
@@ -365,9 +411,23 @@ AFFY_CHIPSET *affy_rma(char **filelist, AFFY_COMBINED_FLAGS *f,
                              err,
                              cleanup);
     
+    ob = output_buffer_init(fp);
+    if (ob == NULL)
+    {
+      fclose(fp);
+      AFFY_HANDLE_ERROR_GOTO("malloc failed",
+                             AFFY_ERROR_OUTOFMEM,
+                             err,
+                             cleanup);
+    }
+
     for (i = 0; i < numprobes; i++)
-      fprintf(fp, "%.15e\n", mean[i]);
+    {
+      output_buffer_exp(ob, mean[i], 15);
+      output_buffer_putc(ob, '\n');
+    }
     
+    output_buffer_free(ob);
     fclose(fp);
   }
 
@@ -479,6 +539,13 @@ AFFY_CHIPSET *affy_rma(char **filelist, AFFY_COMBINED_FLAGS *f,
     AFFY_CHECK_ERROR_GOTO(err, cleanup);
     
     safe_to_write_affinities_flag = 0;
+
+    if (f->dump_frozen_model)
+    {
+      affy_rma_write_frozen_model(result, mean, f, f->frozen_model_filename,
+                                  err);
+      AFFY_CHECK_ERROR_GOTO(err, cleanup);
+    }
   }
 
   if (f->use_normalization && f->use_pairwise_normalization &&
@@ -532,6 +599,168 @@ AFFY_CHIPSET *affy_rma(char **filelist, AFFY_COMBINED_FLAGS *f,
   return (result);
 
 cleanup:
+  affy_cel_prefetch_free(pf);
+  h_free(temp);
+  h_free(mempool);
+  affy_free_chipset(result);
+
+  return (NULL);
+}
+
+/*
+ * affy_rma_frozen(): RMA of each chip on its own against the frozen model
+ * in f->frozen_model_filename (see rma_frozen_model.c).  Each chip is
+ * background corrected, mapped onto the model's quantile target and
+ * median polished with the model's affinities, giving the values it would
+ * have had with --read-means/--read-affinities from the same reference
+ * run.  Only one chip's probe values are held at a time; what is kept
+ * per chip is its probeset expressions.
+ */
+AFFY_CHIPSET *affy_rma_frozen(char **filelist, AFFY_COMBINED_FLAGS *f,
+                              AFFY_ERROR *err)
+{
+  AFFY_CHIPSET          *result = NULL, *temp = NULL;
+  AFFY_CEL_PREFETCH     *pf = NULL;
+  AFFY_CEL_INDEX        *idx = NULL;
+  AFFY_RMA_FROZEN_MODEL *model = NULL;
+  AFFY_COMBINED_FLAGS    model_f;
+  AFFY_CHIP             *cp;
+  char                  *chip_type, **p;
+  int                    i, max_chips, *mempool = NULL;
+
+  assert(filelist != NULL);
+  assert(f        != NULL);
+
+  if (!f->use_normalization || f->use_mean_normalization ||
+      f->use_pairwise_normalization || f->use_rma_probeset_singletons ||
+      f->use_saved_means || f->use_saved_affinities)
+    AFFY_HANDLE_ERROR("frozen models only support quantile normalization "
+                      "and median polish with the model's affinities",
+                      AFFY_ERROR_NOTSUPP, err, NULL);
+
+  if (f->use_background_correction && (!f->bg_rma || f->normalize_before_bg))
+    AFFY_HANDLE_ERROR("frozen models require RMA background correction "
+                      "(or none)",
+                      AFFY_ERROR_NOTSUPP, err, NULL);
+
+  mempool = h_malloc(sizeof(int));
+  if (mempool == NULL)
+    AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, NULL);
+
+  /* Scan every CEL header once; the array type is the first file's */
+  idx = affy_scan_cel_headers(filelist, f->num_threads, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+  hattach(idx, mempool);
+
+  chip_type = affy_cel_index_array_type(idx, err);
+  if (chip_type == NULL)
+    AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+  /* Count up chips */
+  for (p = filelist, max_chips = 0; *p != NULL; p++)
+    max_chips++;
+
+  /* Create structure */
+  result = affy_create_chipset(max_chips, chip_type, f->cdf_directory, f, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+  if (result->cdf->dupe_probes_flag)
+    AFFY_HANDLE_ERROR_GOTO("multiple probesets share same probe, use 'iron --norm-quantile --median-polish' instead", AFFY_ERROR_NOTSUPP, err, cleanup);
+
+  model = affy_rma_load_frozen_model(f->frozen_model_filename, result->cdf,
+                                     f, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+  hattach(model, mempool);
+
+  /*
+   * Each chip is summarized through a one chip view of the result,
+   * holding the model's affinities as already estimated ones.  The
+   * model's means are the saved quantile target, never accumulated into.
+   */
+  temp = affy_clone_chipset(result, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+  temp->affinities        = model->affinities;
+  temp->t_values          = model->t_values;
+  temp->mp_allocated_flag = 1;
+  temp->mp_populated_flag = 1;
+
+  /* the caller's flags, with the model standing in for saved values */
+  model_f                  = *f;
+  model_f.use_saved_means  = true;
+  model_f.reuse_affinities = true;
+
+  /* Start loading CEL files in the background */
+  pf = affy_cel_prefetch_start(filelist, idx, f->num_threads, 0,
+                               result->cel_storage, err);
+  AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+  for (i = 0; i < max_chips; i++)
+  {
+    int cur_chip;
+
+    affy_load_chipset_next(result, pf, f->ignore_chip_mismatch, err);
+    AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+    cur_chip = result->num_chips - 1;
+    cp       = result->chip[cur_chip];
+
+    /* abort on corrupt CEL files, unless --salvage is used */
+    if (cp->cel->corrupt_flag && f->salvage_corrupt == false)
+      AFFY_HANDLE_ERROR_GOTO("corrupt CEL file",
+                             AFFY_ERROR_BADFORMAT,
+                             err,
+                             cleanup);
+
+    /* Load PM data, then free all data */
+    load_pm(cp, err);
+    AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+    if (f->use_background_correction)
+    {
+      affy_rma_background_correct(result, cur_chip, err);
+      AFFY_CHECK_ERROR_GOTO(err, cleanup);
+    }
+
+    /* rank, then map the ranks onto the model's quantile target */
+    affy_rma_quantile_normalization_chip(result, cur_chip, model->mean,
+                                         &model_f, err);
+    AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+    temp->chip[0]   = cp;
+    temp->num_chips = 1;
+
+    affy_rma_quantile_normalization_chipset(temp, model->mean, &model_f);
+
+    affy_rma_signal(temp, &model_f, 0, err);
+    AFFY_CHECK_ERROR_GOTO(err, cleanup);
+
+    /* only the expressions are kept */
+    affy_backing_store_free_array(cp->store, cp->pm, cp->cdf->numprobes,
+                                  sizeof(double));
+    cp->pm = NULL;
+
+    affy_mostly_free_cel_file(cp->cel);
+  }
+
+  affy_cel_prefetch_free(pf);
+  pf = NULL;
+
+  /* floor to signal intensity of 1 (0 in log2 space) */
+  if (!f->bioconductor_compatability)
+    affy_floor_probeset(result, 0.0, err);
+
+  info("Frozen RMA finished on %u samples", result->num_chips);
+
+  h_free(temp);
+  h_free(mempool);
+
+  return (result);
+
+cleanup:
+  affy_cel_prefetch_free(pf);
   h_free(temp);
   h_free(mempool);
   affy_free_chipset(result);
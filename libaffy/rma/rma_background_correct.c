@@ -569,7 +569,7 @@ void affy_rma_background_correct_pm_mm_together(AFFY_CHIPSET *c,
   assert(c->chip                     != NULL);
   assert(c->chip[chipnum]            != NULL);
   assert(c->chip[chipnum]->cel       != NULL);
-  assert(c->chip[chipnum]->cel->data != NULL);
+  assert(affy_cel_has_data(c->chip[chipnum]->cel));
 
   cdf = c->cdf;
   cel = c->chip[chipnum]->cel;
@@ -595,7 +595,7 @@ void affy_rma_background_correct_pm_mm_together(AFFY_CHIPSET *c,
     y = cdf->probe[p]->pm.y;
 
     if (cdf->seen_xy[x][y] == 0)
-      mmpm[j++] = cel->data[x][y].value;
+      mmpm[j++] = affy_cel_value(cel, x, y);
     cdf->seen_xy[x][y] = 1;
     
     if (pm_only)
@@ -614,7 +614,7 @@ void affy_rma_background_correct_pm_mm_together(AFFY_CHIPSET *c,
       y = cdf->probe[p]->mm.y;
 
       if (cdf->seen_xy[x][y] == 0)
-        mmpm[j++] = cel->data[x][y].value;
+        mmpm[j++] = affy_cel_value(cel, x, y);
       cdf->seen_xy[x][y] = 1;
     }
   }
@@ -655,7 +655,7 @@ void affy_rma_background_correct_pm_mm_together(AFFY_CHIPSET *c,
     y = cdf->probe[p]->pm.y;
 
     if (cdf->seen_xy[x][y] == 0)
-      cel->data[x][y].value = mmpm[j++];
+      affy_cel_set_value(cel, x, y, mmpm[j++]);
     cdf->seen_xy[x][y] = 1;
 
     if (pm_only)
@@ -674,7 +674,7 @@ void affy_rma_background_correct_pm_mm_together(AFFY_CHIPSET *c,
       y = cdf->probe[p]->mm.y;
       
       if (cdf->seen_xy[x][y] == 0)
-        cel->data[x][y].value = mmpm[j++];
+        affy_cel_set_value(cel, x, y, mmpm[j++]);
       cdf->seen_xy[x][y] = 1;
     }
   }
@@ -710,7 +710,7 @@ void affy_global_background_correct(AFFY_CHIPSET *c,
   assert(c->chip                     != NULL);
   assert(c->chip[chipnum]            != NULL);
   assert(c->chip[chipnum]->cel       != NULL);
-  assert(c->chip[chipnum]->cel->data != NULL);
+  assert(affy_cel_has_data(c->chip[chipnum]->cel));
 
   cdf     = c->cdf;
   cel     = c->chip[chipnum]->cel;
@@ -734,7 +734,7 @@ void affy_global_background_correct(AFFY_CHIPSET *c,
     y = cdf->probe[p]->mm.y;
 
     if (cdf->seen_xy[x][y] == 0)
-      mmpm[j++] = cel->data[x][y].value;
+      mmpm[j++] = affy_cel_value(cel, x, y);
     cdf->seen_xy[x][y] = 1;
   }
   n2 = j;
@@ -760,11 +760,12 @@ void affy_global_background_correct(AFFY_CHIPSET *c,
 
     if (cdf->seen_xy[x][y] == 0)
     {
-      if (cel->data[x][y].value >= TINY_VALUE)
-        cel->data[x][y].value -= b;
+      if (affy_cel_value(cel, x, y) >= TINY_VALUE)
+        affy_cel_set_value(cel, x, y,
+                           affy_cel_value(cel, x, y) - b);
     
-      if (cel->data[x][y].value < TINY_VALUE)
-        cel->data[x][y].value = 0;
+      if (affy_cel_value(cel, x, y) < TINY_VALUE)
+        affy_cel_set_value(cel, x, y, 0);
     }
     cdf->seen_xy[x][y] = 1;
 
@@ -785,11 +786,12 @@ void affy_global_background_correct(AFFY_CHIPSET *c,
       
       if (cdf->seen_xy[x][y] == 0)
       {
-        if (cel->data[x][y].value >= TINY_VALUE)
-          cel->data[x][y].value -= b;
+        if (affy_cel_value(cel, x, y) >= TINY_VALUE)
+          affy_cel_set_value(cel, x, y,
+                             affy_cel_value(cel, x, y) - b);
     
-        if (cel->data[x][y].value < TINY_VALUE)
-          cel->data[x][y].value = 0;
+        if (affy_cel_value(cel, x, y) < TINY_VALUE)
+          affy_cel_set_value(cel, x, y, 0);
       }
       cdf->seen_xy[x][y] = 1;
     }
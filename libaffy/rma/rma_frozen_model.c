@@ -0,0 +1,356 @@
+/**************************************************************************
+ *
+ * Filename:  rma_frozen_model.c
+ *
+ * Purpose:   Read/write frozen RMA models: the quantile normalization
+ *            target and median polish probe affinities of a reference
+ *            run, for processing further samples one at a time.
+ *
+ * Creation:  October 16th, 2026
+ *
+ * Author:    Eric A. Welsh
+ *
+ * Copyright: Copyright (C) 2026, Moffitt Cancer Center.
+ *            All rights reserved.
+ *
+ * Update History
+ * --------------
+ * 10/16/26: Creation (EAW)
+ *
+ **************************************************************************/
+
+#include <affy_rma.h>
+
+#ifdef AFFY_POSIX_ENV
+#include <unistd.h>
+#endif
+
+/*
+ * A frozen model is a flat, native-endian file: a header, the CDF array
+ * type name, then the quantile target (numprobes doubles), the per
+ * probeset t values (numprobesets doubles) and the probe affinities
+ * (numprobes doubles, in cdf->ps_offset[] order).  It is everything
+ * --read-means plus --read-affinities would supply, without any text to
+ * parse, so loading one is three bulk fread()s.
+ *
+ * The header fingerprints the CDF the model was built with (dimensions,
+ * counts, and a hash of the probeset names and PM probe layout) and the
+ * preprocessing options that shaped the model, and a model is refused
+ * unless both match the current run.
+ *
+ * Every section starts on an 8 byte boundary.  The file is written to a
+ * temporary file and rename()d into place.
+ */
+
+#define RMA_FROZEN_MAGIC      "AFFYRMAF"
+#define RMA_FROZEN_VERSION    1
+#define RMA_FROZEN_BYTE_ORDER 0x01020304
+#define RMA_FROZEN_ALIGN      8
+
+#define RMA_FROZEN_PAD(x) \
+  (((x) + RMA_FROZEN_ALIGN - 1) & ~((size_t)RMA_FROZEN_ALIGN - 1))
+
+typedef struct
+{
+  char        magic[8];
+  affy_uint32 version;
+  affy_uint32 byte_order;
+  affy_uint32 header_size;
+  affy_uint32 type_len;        /* includes the terminating NUL          */
+  affy_uint32 numrows;
+  affy_uint32 numcols;
+  affy_int32  numprobes;
+  affy_int32  numprobesets;
+  affy_uint32 cdf_hash;        /* see cdf_fingerprint()                 */
+  affy_uint32 options;         /* AFFY_RMA_FROZEN_* bits                */
+  affy_uint32 num_chips;       /* chips the model was built from        */
+  affy_uint32 pad;
+} RMA_FROZEN_HEADER;
+
+/*
+ * FNV-1a hash over what ties the model's arrays to the CDF: each
+ * probeset's name and probe count, and each probe's PM cell.
+ */
+static affy_uint32 cdf_fingerprint(AFFY_CDFFILE *cdf)
+{
+  unsigned long  h = FNV1A_INIT;
+  affy_int32     ps, k;
+  const char    *name;
+
+  for (ps = 0; ps < cdf->numprobesets; ps++)
+  {
+    h    = fnv1a_hash_uint32(h, cdf->ps_offset[ps + 1] - cdf->ps_offset[ps]);
+    name = cdf->probeset[ps].name;
+    if (name == NULL)
+      name = "";
+    h = fnv1a_hash(h, name, strlen(name) + 1);
+  }
+
+  for (k = 0; k < cdf->numprobes; k++)
+    h = fnv1a_hash_uint32(h, cdf->pm_cell[k]);
+
+  return ((affy_uint32)h);
+}
+
+/* AFFY_RMA_FROZEN_* bits for the preprocessing selected in f */
+static affy_uint32 frozen_options(AFFY_COMBINED_FLAGS *f)
+{
+  affy_uint32 options = 0;
+
+  if (f->use_background_correction && f->bg_rma)
+    options |= AFFY_RMA_FROZEN_BG_RMA;
+  if (f->normalize_affx_probes)
+    options |= AFFY_RMA_FROZEN_AFFX;
+
+  return (options);
+}
+
+/* Write zero padding so the next section starts aligned. */
+static int write_padded(FILE *fp, const void *buf, size_t len)
+{
+  static const char zeroes[RMA_FROZEN_ALIGN] = { 0 };
+  size_t            pad = RMA_FROZEN_PAD(len) - len;
+
+  if (len && fwrite(buf, 1, len, fp) != len)
+    return (-1);
+  if (pad && fwrite(zeroes, 1, pad, fp) != pad)
+    return (-1);
+
+  return (0);
+}
+
+/* Read len bytes plus the padding after them, returns -1 if short. */
+static int read_padded(FILE *fp, void *buf, size_t len)
+{
+  char   zeroes[RMA_FROZEN_ALIGN];
+  size_t pad = RMA_FROZEN_PAD(len) - len;
+
+  if (len && fread(buf, 1, len, fp) != len)
+    return (-1);
+  if (pad && fread(zeroes, 1, pad, fp) != pad)
+    return (-1);
+
+  return (0);
+}
+
+/*
+ * affy_rma_write_frozen_model(): write the model of a finished RMA run on
+ *   c to filename: mean[] is the quantile target, and the chipset must
+ *   hold its median polish affinities (see f->reuse_affinities).
+ */
+void affy_rma_write_frozen_model(AFFY_CHIPSET *c,
+                                 double *mean,
+                                 AFFY_COMBINED_FLAGS *f,
+                                 const char *filename,
+                                 AFFY_ERROR *err)
+{
+  RMA_FROZEN_HEADER  hdr;
+  AFFY_CDFFILE      *cdf;
+  FILE              *fp;
+  char              *tmp_filename;
+  int                write_failed;
+
+  assert(c           != NULL);
+  assert(c->cdf      != NULL);
+  assert(mean        != NULL);
+  assert(f           != NULL);
+  assert(filename    != NULL);
+
+  cdf = c->cdf;
+
+  if (!c->mp_populated_flag || c->affinities == NULL || c->t_values == NULL)
+    AFFY_HANDLE_ERROR_VOID("no probe affinities to write a frozen model from",
+                           AFFY_ERROR_NOTREADY,
+                           err);
+
+  memset(&hdr, 0, sizeof(RMA_FROZEN_HEADER));
+  memcpy(hdr.magic, RMA_FROZEN_MAGIC, 8);
+  hdr.version      = RMA_FROZEN_VERSION;
+  hdr.byte_order   = RMA_FROZEN_BYTE_ORDER;
+  hdr.header_size  = sizeof(RMA_FROZEN_HEADER);
+  hdr.type_len     = strlen(cdf->array_type) + 1;
+  hdr.numrows      = cdf->numrows;
+  hdr.numcols      = cdf->numcols;
+  hdr.numprobes    = cdf->numprobes;
+  hdr.numprobesets = cdf->numprobesets;
+  hdr.cdf_hash     = cdf_fingerprint(cdf);
+  hdr.options      = frozen_options(f);
+  hdr.num_chips    = c->num_chips;
+
+  tmp_filename = h_malloc(strlen(filename) + 32);
+  if (tmp_filename == NULL)
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+#ifdef AFFY_POSIX_ENV
+  sprintf(tmp_filename, "%s.%ld.tmp", filename, (long)getpid());
+#else
+  sprintf(tmp_filename, "%s.%ld.tmp", filename, (long)time(NULL));
+#endif
+
+  fp = fopen(tmp_filename, "wb");
+  if (fp == NULL)
+  {
+    h_free(tmp_filename);
+    AFFY_HANDLE_ERROR_VOID("couldn't open frozen model file for writing",
+                           AFFY_ERROR_IO,
+                           err);
+  }
+
+  write_failed = write_padded(fp, &hdr, sizeof(RMA_FROZEN_HEADER))      ||
+                 write_padded(fp, cdf->array_type, hdr.type_len)        ||
+                 write_padded(fp, mean, cdf->numprobes * sizeof(double)) ||
+                 write_padded(fp, c->t_values,
+                              cdf->numprobesets * sizeof(double))       ||
+                 write_padded(fp, c->affinities[0],
+                              cdf->numprobes * sizeof(double));
+  if (fclose(fp) != 0)
+    write_failed = 1;
+
+  if (write_failed)
+  {
+    remove(tmp_filename);
+    h_free(tmp_filename);
+    AFFY_HANDLE_ERROR_VOID("error writing frozen model file",
+                           AFFY_ERROR_IO,
+                           err);
+  }
+
+#ifdef AFFY_WIN32_ENV
+  /* rename() won't replace an existing file on win32 */
+  remove(filename);
+#endif
+
+  if (rename(tmp_filename, filename) != 0)
+  {
+    remove(tmp_filename);
+    h_free(tmp_filename);
+    AFFY_HANDLE_ERROR_VOID("couldn't rename frozen model file",
+                           AFFY_ERROR_IO,
+                           err);
+  }
+
+  h_free(tmp_filename);
+
+  info("Wrote frozen RMA model of %u samples to %s", c->num_chips, filename);
+}
+
+/*
+ * affy_rma_load_frozen_model(): load the frozen model in filename, which
+ *   must have been built for cdf with the preprocessing selected in f.
+ *   Free the result with h_free().
+ */
+AFFY_RMA_FROZEN_MODEL *affy_rma_load_frozen_model(const char *filename,
+                                                  AFFY_CDFFILE *cdf,
+                                                  AFFY_COMBINED_FLAGS *f,
+                                                  AFFY_ERROR *err)
+{
+  RMA_FROZEN_HEADER      hdr;
+  AFFY_RMA_FROZEN_MODEL *model = NULL;
+  FILE                  *fp;
+  affy_int32             ps;
+
+  assert(filename != NULL);
+  assert(cdf      != NULL);
+  assert(f        != NULL);
+
+  fp = fopen(filename, "rb");
+  if (fp == NULL)
+    AFFY_HANDLE_ERROR("couldn't open frozen model file",
+                      AFFY_ERROR_NOTFOUND,
+                      err,
+                      NULL);
+
+  if (read_padded(fp, &hdr, sizeof(RMA_FROZEN_HEADER))    ||
+      memcmp(hdr.magic, RMA_FROZEN_MAGIC, 8) != 0          ||
+      hdr.version      != RMA_FROZEN_VERSION               ||
+      hdr.byte_order   != RMA_FROZEN_BYTE_ORDER            ||
+      hdr.header_size  != sizeof(RMA_FROZEN_HEADER)        ||
+      hdr.type_len     == 0)
+    AFFY_HANDLE_ERROR_GOTO("not a frozen RMA model file (or wrong version)",
+                           AFFY_ERROR_BADFORMAT,
+                           err,
+                           cleanup);
+
+  model = h_calloc(1, sizeof(AFFY_RMA_FROZEN_MODEL));
+  if (model == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+  model->chip_type = h_subcalloc(model, RMA_FROZEN_PAD(hdr.type_len), 1);
+  if (model->chip_type == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+  if (read_padded(fp, model->chip_type, hdr.type_len) ||
+      model->chip_type[hdr.type_len - 1] != '\0')
+    AFFY_HANDLE_ERROR_GOTO("truncated frozen model file",
+                           AFFY_ERROR_BADFORMAT,
+                           err,
+                           cleanup);
+
+  /* the model only applies to the exact CDF it was built with */
+  if (strcmp(model->chip_type, cdf->array_type) != 0 ||
+      hdr.numrows      != cdf->numrows                ||
+      hdr.numcols      != cdf->numcols                ||
+      hdr.numprobes    != cdf->numprobes              ||
+      hdr.numprobesets != cdf->numprobesets           ||
+      hdr.cdf_hash     != cdf_fingerprint(cdf))
+  {
+    warn("frozen model %s was built for %s, not %s",
+         filename, model->chip_type, cdf->array_type);
+    AFFY_HANDLE_ERROR_GOTO("frozen model does not match the CDF",
+                           AFFY_ERROR_WRONGTYPE,
+                           err,
+                           cleanup);
+  }
+
+  if (hdr.options != frozen_options(f))
+    AFFY_HANDLE_ERROR_GOTO("frozen model was built with different "
+                           "background correction/normalization options",
+                           AFFY_ERROR_BADPARAM,
+                           err,
+                           cleanup);
+
+  model->numprobes    = hdr.numprobes;
+  model->numprobesets = hdr.numprobesets;
+  model->options      = hdr.options;
+  model->num_chips    = hdr.num_chips;
+
+  model->mean          = h_subcalloc(model, hdr.numprobes + 1,
+                                     sizeof(double));
+  model->t_values      = h_subcalloc(model, hdr.numprobesets + 1,
+                                     sizeof(double));
+  model->affinities    = h_subcalloc(model, hdr.numprobesets + 1,
+                                     sizeof(double *));
+  if (model->mean == NULL || model->t_values == NULL ||
+      model->affinities == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+  /* one block for all probesets, like the reuse affinities of a chipset */
+  model->affinities[0] = h_subcalloc(model->affinities, hdr.numprobes + 1,
+                                     sizeof(double));
+  if (model->affinities[0] == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+  if (read_padded(fp, model->mean, hdr.numprobes * sizeof(double))        ||
+      read_padded(fp, model->t_values,
+                  hdr.numprobesets * sizeof(double))                      ||
+      read_padded(fp, model->affinities[0], hdr.numprobes * sizeof(double)))
+    AFFY_HANDLE_ERROR_GOTO("truncated frozen model file",
+                           AFFY_ERROR_BADFORMAT,
+                           err,
+                           cleanup);
+
+  for (ps = 1; ps < cdf->numprobesets; ps++)
+    model->affinities[ps] = model->affinities[0] + cdf->ps_offset[ps];
+
+  fclose(fp);
+
+  info("Loaded frozen RMA model of %u samples from %s",
+       model->num_chips, filename);
+
+  return (model);
+
+cleanup:
+  fclose(fp);
+  h_free(model);
+
+  return (NULL);
+}
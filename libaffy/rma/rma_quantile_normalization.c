@@ -32,73 +32,120 @@
  **                called "robust" method
  **
  ** 10/22/10: Use new AFFY_COMBINED_FLAGS instead of AFFY_RMA_FLAGS
+ ** 10/16/26: test AFFY_PS_CONTROL in cdf->ps_flags[] instead of the names;
+ **           only write back the ranks of the probes that were ranked (EAW)
+ ** 10/16/26: rank by radix sort (dsort_index()) instead of qsort(); ranks
+ **           go in chip->qnorm_rank[] instead of over the pm values;
+ **           affy_rma_quantile_normalization_chips() ranks a whole
+ **           chipset on f->num_threads threads (EAW)
  **
  ***********************************************************/
 
 #include <affy_rma.h>
 
+#ifdef AFFY_HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+/*
+ * Ranking a chip: the pm values to normalize are gathered into vals[]
+ * (with their probe indices in probe[]), and dsort_index() puts their
+ * indices in sorted order in order[].  Ties get the floor of their
+ * average rank, counting from 0, same as R's rank() that this code
+ * originally followed.  The sorted values are summed into the means in
+ * position order; the values at each position are the same whatever
+ * order ties come out in, so the means are too.
+ */
 typedef struct
 {
-  double data;
-  int index;
-} dataitem;
-
-int qnorm_compare(const void *p1, const void *p2)
+  double *vals;
+  int    *probe;
+  int    *order;
+  int     np;
+} QNORM_SCRATCH;
+
+/* Scratch for ranking chips of numprobes probes, children of parent */
+static int alloc_scratch(QNORM_SCRATCH *s, void *parent, int numprobes)
 {
-  double x;
-  double y;
-
-  assert(p1 != NULL);
-  assert(p2 != NULL);
-
-  x = ((dataitem *) p1)->data;
-  y = ((dataitem *) p2)->data;
+  s->vals  = h_subcalloc(parent, numprobes + 1, sizeof(double));
+  s->probe = h_subcalloc(parent, numprobes + 1, sizeof(int));
+  s->order = h_subcalloc(parent, numprobes + 1, sizeof(int));
+  s->np    = 0;
 
-  if (x < y)
+  if (s->vals == NULL || s->probe == NULL || s->order == NULL)
     return (-1);
-  if (x > y)
-    return (1);
 
   return (0);
 }
 
-/************************************************************
- **
- ** double *rank_order()
- **
- ** get ranks in the same manner as R does. Assume that *x is
- ** already sorted
- ** NB: Can this be in-place now?
- *************************************************************/
-void rank_order(double *rank, dataitem *x, unsigned int n)
+/*
+ * Rank the pm values of chip cp into cp->qnorm_rank[], leaving them and
+ * their sorted order in s.  Control probes are left out unless
+ * f->normalize_affx_probes.  Returns -1 if out of memory.
+ */
+static int rank_chip(AFFY_CHIP *cp, AFFY_COMBINED_FLAGS *f, QNORM_SCRATCH *s)
 {
-  int i, j, k;
+  AFFY_CDFFILE *cdf = cp->cdf;
+  affy_int32   *rank = cp->qnorm_rank;
+  int           i, j, k, np;
+  double        v;
 
-  assert(rank != NULL);
-  assert(x    != NULL);
+  assert(cp->pm != NULL);
+  assert(rank   != NULL);
 
-  i = 0;
+  /* Load in pm for each probe */
+  np = 0;
 
-  while (i < n)
+  for (i = 0; i < cdf->numprobes; i++)
   {
-    j = i;
-
-    while ((j < n - 1) && (x[j].data == x[j + 1].data))
-      j++;
-
-    if (i != j)
-    {
-      for (k = i; k <= j; k++)
-        rank[k] = (i + j + 2) / 2.0;
-    }
-    else
+    if ((f->normalize_affx_probes) 
+	|| !(affy_probe_flags(cdf, i) & AFFY_PS_CONTROL))
     {
-      rank[i] = i + 1;
+      s->vals[np]  = cp->pm[i];
+      s->probe[np] = i;
+      np++;
     }
+  }
+
+  s->np = np;
+
+  if (dsort_index(s->vals, np, s->order) != 0)
+    return (-1);
+
+  /* only the np probes loaded above are ranked */
+  for (i = 0; i < np; i = j + 1)
+  {
+    v = s->vals[s->order[i]];
 
-    i = j + 1;
+    for (j = i; j < np - 1 && s->vals[s->order[j + 1]] == v; j++)
+      ;
+
+    /* floor((i + j + 2) / 2.0) - 1 */
+    for (k = i; k <= j; k++)
+      rank[s->probe[s->order[k]]] = (i + j) / 2;
   }
-  /*return rank; */
+
+  return (0);
+}
+
+/* Accumulate the sorted values of a ranked chip into the means */
+static void accumulate_means(double *mean, const QNORM_SCRATCH *s)
+{
+  int i;
+
+  for (i = 0; i < s->np; i++)
+    mean[i] += s->vals[s->order[i]];
+}
+
+/* Rank storage for chip cp, NULL if out of memory */
+static affy_int32 *alloc_rank(AFFY_CHIP *cp)
+{
+  if (cp->qnorm_rank == NULL)
+    cp->qnorm_rank = affy_backing_store_calloc(cp->store, cp,
+                                               cp->cdf->numprobes,
+                                               sizeof(affy_int32));
+
+  return (cp->qnorm_rank);
 }
 
 void affy_rma_quantile_normalization_chip(AFFY_CHIPSET *c, 
@@ -107,12 +154,10 @@ void affy_rma_quantile_normalization_chip(AFFY_CHIPSET *c,
 					  AFFY_COMBINED_FLAGS *f,
                                           AFFY_ERROR *err)
 {
-  int               i, np, *mempool;
-  double           *rank = NULL;
-  dataitem         *vals = NULL;
-  int               num_probes;
-  AFFY_PROBE      **probe_arr;
-  LIBUTILS_PB_STATE pbs;
+  int               *mempool;
+  QNORM_SCRATCH      s;
+  AFFY_CHIP         *cp;
+  LIBUTILS_PB_STATE  pbs;
 
   assert(c             != NULL);
   assert(f             != NULL);
@@ -120,8 +165,7 @@ void affy_rma_quantile_normalization_chip(AFFY_CHIPSET *c,
   assert(c->cdf        != NULL);
   assert(c->cdf->probe != NULL);
 
-  num_probes = c->cdf->numprobes;
-  probe_arr = c->cdf->probe;
+  cp = c->chip[chipnum];
 
   pb_init(&pbs);
   pb_begin(&pbs, 2, "Quantile Normalization");
@@ -131,53 +175,254 @@ void affy_rma_quantile_normalization_chip(AFFY_CHIPSET *c,
   if (mempool == NULL)
     AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
 
-  vals = h_subcalloc(mempool, num_probes, sizeof(dataitem));
-  if (vals == NULL)
+  if (alloc_scratch(&s, mempool, c->cdf->numprobes) != 0 ||
+      alloc_rank(cp) == NULL)
     AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
 
-  /* Load in pm for each probe */
-  np = 0;
+  pb_tick(&pbs,1,"Rank ordering");
+  if (rank_chip(cp, f, &s) != 0)
+    AFFY_HANDLE_ERROR_GOTO("malloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+
+  /* Step two: accumulate mean value at a given rank */
+  pb_tick(&pbs,1,"Accumulating means");
+  if (!(f->use_saved_means))
+    accumulate_means(mean, &s);
+
+  pb_finish(&pbs,"Finished quantile normalization");
+
+cleanup:
+  h_free(mempool);
+}
+
+/*
+ * Ranking a whole chipset runs on f->num_threads workers, each taking
+ * the next unranked chip.  Each chip's sorted values are added into the
+ * means in chip order, as in the one-chip-at-a-time version: a worker
+ * that has ranked chip k waits for chip k - 1 to be added first.  Chips
+ * are handed out in order, so the chip being waited on is always being
+ * ranked by some other worker.
+ */
+typedef struct
+{
+  AFFY_CHIPSET        *c;
+  AFFY_COMBINED_FLAGS *f;
+  double              *mean;
+  int                  num_threads;
+  unsigned int         next;             /* next chip to rank              */
+  unsigned int         next_sum;         /* next chip to add to mean[]     */
+  bool                 failed;           /* a worker hit an error, stop    */
+  LIBUTILS_PB_STATE   *pbs;
+#ifdef AFFY_HAVE_PTHREADS
+  pthread_mutex_t      lock;
+  pthread_cond_t       turn;             /* next_sum moved, or failed      */
+#endif
+} QNORM_STATE;
+
+typedef struct
+{
+  QNORM_STATE  *st;
+  QNORM_SCRATCH s;
+  AFFY_ERROR    err;
+} QNORM_WORKER;
+
+static void qnorm_lock(QNORM_STATE *st)
+{
+#ifdef AFFY_HAVE_PTHREADS
+  if (st->num_threads > 1)
+    pthread_mutex_lock(&st->lock);
+#endif
+}
 
-  for (i = 0; i < num_probes; i++)
+static void qnorm_unlock(QNORM_STATE *st)
+{
+#ifdef AFFY_HAVE_PTHREADS
+  if (st->num_threads > 1)
+    pthread_mutex_unlock(&st->lock);
+#endif
+}
+
+static void *qnorm_worker(void *arg)
+{
+  QNORM_WORKER *w  = arg;
+  QNORM_STATE  *st = w->st;
+  unsigned int  k;
+  bool          failed;
+
+  for (;;)
   {
-    if ((f->normalize_affx_probes) 
-	|| !(affy_is_control_probe(probe_arr[i])))
+    qnorm_lock(st);
+    if (st->failed || st->next >= st->c->num_chips)
     {
-      assert(c->chip[chipnum]->pm != NULL);
-      vals[np].data  = c->chip[chipnum]->pm[i];
-      vals[np].index = i;
-      np++;
+      qnorm_unlock(st);
+      break;
     }
+    k = st->next++;
+    qnorm_unlock(st);
+
+    if (rank_chip(st->c->chip[k], st->f, &w->s) != 0)
+    {
+      w->err.type = AFFY_ERROR_OUTOFMEM;
+
+      qnorm_lock(st);
+      st->failed = true;
+#ifdef AFFY_HAVE_PTHREADS
+      if (st->num_threads > 1)
+        pthread_cond_broadcast(&st->turn);
+#endif
+      qnorm_unlock(st);
+      break;
+    }
+
+    /* wait for our turn to add into the means */
+    qnorm_lock(st);
+#ifdef AFFY_HAVE_PTHREADS
+    if (st->num_threads > 1)
+      while (st->next_sum != k && !st->failed)
+        pthread_cond_wait(&st->turn, &st->lock);
+#endif
+    failed = st->failed;
+    qnorm_unlock(st);
+
+    if (failed)
+      break;
+
+    if (!(st->f->use_saved_means))
+      accumulate_means(st->mean, &w->s);
+
+    qnorm_lock(st);
+    st->next_sum++;
+    pb_tick(st->pbs, 1, "Ranked chip %u", k + 1);
+#ifdef AFFY_HAVE_PTHREADS
+    if (st->num_threads > 1)
+      pthread_cond_broadcast(&st->turn);
+#endif
+    qnorm_unlock(st);
   }
 
-  pb_tick(&pbs,1,"Accumulating means");
-  qsort(vals, np, sizeof(dataitem), qnorm_compare);
+  return (NULL);
+}
 
-  /* Step two: accumulate mean value at a given rank */
-  if (!(f->use_saved_means))
+/**
+ * Rank every chip of c and accumulate the means, as
+ * affy_rma_quantile_normalization_chip() does for each chip in turn,
+ * using f->num_threads threads.
+ */
+void affy_rma_quantile_normalization_chips(AFFY_CHIPSET *c,
+                                           double *mean,
+                                           AFFY_COMBINED_FLAGS *f,
+                                           AFFY_ERROR *err)
+{
+  int               i, *mempool, num_threads, num_started = 0;
+  QNORM_STATE       st;
+  QNORM_WORKER     *workers;
+  LIBUTILS_PB_STATE pbs;
+
+  assert(c             != NULL);
+  assert(f             != NULL);
+  assert(mean          != NULL);
+  assert(c->cdf        != NULL);
+  assert(c->cdf->probe != NULL);
+
+  if (c->num_chips == 0)
+    return;
+
+  num_threads = f->num_threads;
+  if (num_threads > (int)c->num_chips)
+    num_threads = c->num_chips;
+  if (num_threads < 1)
+    num_threads = 1;
+
+  mempool = h_malloc(sizeof(int));
+  if (mempool == NULL)
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+
+  /* rank arrays come from the (shared) backing store, so not in workers */
+  for (i = 0; i < c->num_chips; i++)
   {
-    for (i = 0; i < np; i++)
-      mean[i] += vals[i].data;
+    if (alloc_rank(c->chip[i]) == NULL)
+      AFFY_HANDLE_ERROR_GOTO("calloc failed",
+                             AFFY_ERROR_OUTOFMEM,
+                             err,
+                             cleanup);
   }
 
-  pb_tick(&pbs,1,"Rank ordering");
-  rank = h_subcalloc(mempool, np, sizeof(double));
-  if (rank == NULL)
+  workers = h_subcalloc(mempool, num_threads, sizeof(QNORM_WORKER));
+  if (workers == NULL)
     AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
 
-  /* Rank order the intensities on this chip */
-  rank_order(rank, vals, np);
+  for (i = 0; i < num_threads; i++)
+  {
+    workers[i].st          = &st;
+    workers[i].err.type    = AFFY_ERROR_NONE;
+    workers[i].err.handler = NULL;
+
+    if (alloc_scratch(&workers[i].s, mempool, c->cdf->numprobes) != 0)
+      AFFY_HANDLE_ERROR_GOTO("calloc failed",
+                             AFFY_ERROR_OUTOFMEM,
+                             err,
+                             cleanup);
+  }
+
+  pb_init(&pbs);
+  pb_begin(&pbs, c->num_chips, "Quantile Normalization");
+
+  st.c           = c;
+  st.f           = f;
+  st.mean        = mean;
+  st.num_threads = num_threads;
+  st.next        = 0;
+  st.next_sum    = 0;
+  st.failed      = false;
+  st.pbs         = &pbs;
+
+#ifdef AFFY_HAVE_PTHREADS
+  if (num_threads > 1)
+  {
+    pthread_t *threads;
+
+    threads = h_subcalloc(mempool, num_threads, sizeof(pthread_t));
+    if (threads == NULL)
+      AFFY_HANDLE_ERROR_GOTO("calloc failed",
+                             AFFY_ERROR_OUTOFMEM,
+                             err,
+                             cleanup);
+
+    pthread_mutex_init(&st.lock, NULL);
+    pthread_cond_init(&st.turn, NULL);
+
+    for (i = 0; i < num_threads; i++)
+    {
+      if (pthread_create(&threads[i], NULL, qnorm_worker, &workers[i]) != 0)
+        break;
+
+      num_started++;
+    }
+
+    for (i = 0; i < num_started; i++)
+      pthread_join(threads[i], NULL);
 
-  for (i = 0; i < num_probes; i++)
+    pthread_cond_destroy(&st.turn);
+    pthread_mutex_destroy(&st.lock);
+  }
+#endif
+
+  /* single threaded, or no threads could be started */
+  if (num_started == 0)
   {
-    int r = vals[i].index;
+    st.num_threads = 1;
+    qnorm_worker(&workers[0]);
+  }
 
-   if ((f->normalize_affx_probes) 
-       || !(affy_is_control_probe(probe_arr[i])))
-     c->chip[chipnum]->pm[r] = floor(rank[i]) - 1;
+  for (i = 0; i < num_threads; i++)
+  {
+    if (workers[i].err.type != AFFY_ERROR_NONE)
+      AFFY_HANDLE_ERROR_GOTO("malloc failed",
+                             AFFY_ERROR_OUTOFMEM,
+                             err,
+                             cleanup);
   }
 
-  pb_finish(&pbs,"Finished quantile normalization");
+  pb_finish(&pbs, "Finished quantile normalization");
 
 cleanup:
   h_free(mempool);
@@ -191,9 +436,10 @@ void affy_rma_quantile_normalization_chipset(AFFY_CHIPSET *c,
 					     double *mean,
 					     AFFY_COMBINED_FLAGS *f)
 {
-  int          i, j;
-  int          numprobes;
-  AFFY_PROBE **probe_arr;
+  int           i, j;
+  int           numprobes;
+  AFFY_CDFFILE *cdf;
+  AFFY_CHIP    *cp;
 
   assert(c             != NULL);
   assert(mean          != NULL);
@@ -202,22 +448,28 @@ void affy_rma_quantile_normalization_chipset(AFFY_CHIPSET *c,
   assert(c->cdf        != NULL);
   assert(c->cdf->probe != NULL);
 
-  numprobes = c->cdf->numprobes;
-  probe_arr = c->cdf->probe;
+  cdf       = c->cdf;
+  numprobes = cdf->numprobes;
 
   for (i = 0; i < c->num_chips; i++)
   {
-    /* The rank is stored in the pm array */
+    cp = c->chip[i];
+
+    assert(cp->pm         != NULL);
+    assert(cp->qnorm_rank != NULL);
+
     for (j = 0; j < numprobes; j++)
     {
       if ((f->normalize_affx_probes) 
-	  || !(affy_is_control_probe(probe_arr[j])))
+	  || !(affy_probe_flags(cdf, j) & AFFY_PS_CONTROL))
       {
-        assert(c->chip[i]->pm != NULL);
-
-	c->chip[i]->pm[j] = mean[(int)c->chip[i]->pm[j]];
+	cp->pm[j] = mean[cp->qnorm_rank[j]];
       }
     }
+
+    /* the ranks are used up */
+    affy_backing_store_free_array(cp->store, cp->qnorm_rank, numprobes,
+                                  sizeof(affy_int32));
+    cp->qnorm_rank = NULL;
   }
 }
-
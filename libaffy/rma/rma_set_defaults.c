@@ -30,6 +30,13 @@
  *           probe norm (EAW)
  * 09/13/23: added iron_check_saturated flag (EAW)
  * 09/13/23: added iron_ignore_low flag (EAW)
+ * 10/16/26: added num_threads (EAW)
+ * 10/16/26: added use_cdf_cache (off by default, the apps turn it on),
+ *           cdf_cache_directory (EAW)
+ * 10/16/26: added use_compact_cel (EAW)
+ * 10/16/26: added memory_budget_mb, spill_directory (EAW)
+ * 10/16/26: added dump_frozen_model, use_frozen_model,
+ *           frozen_model_filename (EAW)
  *
  **************************************************************************/
 
@@ -50,9 +57,17 @@ void affy_rma_set_defaults(AFFY_COMBINED_FLAGS *f)
   f->use_saved_means                   = false;
   f->affinities_filename               = "affinities.txt";
   f->means_filename                    = "mean-values.txt";
+  f->dump_frozen_model                 = false;
+  f->use_frozen_model                  = false;
+  f->frozen_model_filename             = "rma-model.bin";
   f->probe_filename                    = "probe-values.txt";
   f->cdf_directory                     = ".";
   f->cdf_filename                      = "";
+  f->use_cdf_cache                     = false;
+  f->cdf_cache_directory               = NULL;
+  f->use_compact_cel                   = false;
+  f->memory_budget_mb                  = 0;
+  f->spill_directory                   = NULL;
   f->bg_mas5                           = false;
   f->bg_rma                            = true;
   f->bg_rma_both                       = false;
@@ -76,6 +91,7 @@ void affy_rma_set_defaults(AFFY_COMBINED_FLAGS *f)
   f->iron_ignore_low                   = true;
   f->iron_ignore_noise                 = false;
   f->salvage_corrupt                   = false;
+  f->num_threads                       = 1;
   f->floor_to_min_non_zero             = false;
   f->floor_non_zero_to_one             = false;
 
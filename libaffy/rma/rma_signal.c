@@ -20,86 +20,381 @@
  * 11/16/10: Added ability to reuse calculated median polish affinities
  * 11/19/10: Pass flags for bioconductor compatability (EAW)
  * 09/05/23: change utils_getline() to fgets_strip_realloc() (EAW)
+ * 10/16/26: read affinities with LINE_READER, fixes reuse of freed line (EAW)
+ * 10/16/26: write affinities through an OUTPUT_BUFFER (EAW)
+ * 10/16/26: gather probes through the flat CDF probe tables (EAW)
+ * 10/16/26: read saved affinities up front, matched to probesets by name
+ *           rather than by position (EAW)
+ * 10/16/26: per-probeset z matrix and affinities come from a scratch
+ *           arena instead of create_matrix()/halloc() (EAW)
+ * 10/16/26: per-chip arrays go through the chipset's backing store (EAW)
+ * 10/16/26: summarize probesets on f->num_threads worker threads; reuse
+ *           affinities are kept in one flat per-probe array (EAW)
+ * 10/16/26: z is a single row-major block, no row pointers (EAW)
+ * 10/16/26: each worker allocates its scratch from a halloc pool of its
+ *           own, freed by the main thread after the join (EAW)
  *
  **************************************************************************/
 
 #include <affy_rma.h>
 
-/* XXX remove strtok! */
-static void read_affinities(FILE *infile, 
-                            double *affinities, 
-                            double *t,
-			    unsigned int numprobes,
+#ifdef AFFY_HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+/*
+ * Read a whole saved affinities file: for each probeset, a "name t" line
+ * followed by a "name x y affinity" line per probe.  Probesets are matched
+ * to the CDF by name, so the file doesn't have to list them in CDF order;
+ * probesets the CDF doesn't have are skipped.  t_values[] is per probeset,
+ * affinities[] per probe (in cdf->ps_offset[] order), count[] is scratch.
+ */
+static void read_affinities(LINE_READER *lr,
+                            AFFY_CDFFILE *cdf,
+                            double *t_values,
+                            double *affinities,
+                            int *count,
                             AFFY_ERROR *err)
 {
-  char *line = NULL, *val  = NULL;
-  int   i;
-  int   max_string_len = 0;
+  char      *line, *kv[5];
+  int        n;
+  affy_int32 ps = -1, numprobes;
 
-  assert(infile     != NULL);
+  assert(lr         != NULL);
+  assert(cdf        != NULL);
+  assert(t_values   != NULL);
   assert(affinities != NULL);
-  assert(t          != NULL);
-
-  /* Get the t-value. */
-  /* if ((line = utils_getline(infile)) == NULL) */
-  if (fgets_strip_realloc(&line, &max_string_len, infile) == NULL)
-    AFFY_HANDLE_ERROR_GOTO("failed to parse affinity value from file",
-                           AFFY_ERROR_BADFORMAT,
-                           err,
-                           cleanup);
-
-  if (   ((val = strtok(line, " ")) == NULL)
-      || ((val = strtok(NULL, " ")) == NULL))
-    AFFY_HANDLE_ERROR_GOTO("failed to parse affinity value from file",
-                           AFFY_ERROR_BADFORMAT,
-                           err,
-                           cleanup);
-
-  if (parsefloat(val, t) == -1)
-    AFFY_HANDLE_ERROR_GOTO("failed to parse affinity value from file",
-                           AFFY_ERROR_BADFORMAT,
-                           err,
-                           cleanup);
-
-  free(line);
-
-  /* Now read an affinity for each probe. */
-  for (i = 0; i < numprobes; i++)
+  assert(count      != NULL);
+
+  /* -1: no t-value yet */
+  for (ps = 0; ps < cdf->numprobesets; ps++)
+    count[ps] = -1;
+  ps = -1;
+
+  while ((line = line_reader_next(lr, NULL)) != NULL)
   {
-    int j;
-    
-    /* if ((line = utils_getline(infile)) == NULL) */
-    if (fgets_strip_realloc(&line, &max_string_len, infile) == NULL)
-      AFFY_HANDLE_ERROR_GOTO("failed to parse affinity value from file",
-                             AFFY_ERROR_BADFORMAT,
-                             err,
-                             cleanup);
-    
-    /* Skip irrelevant stuff. */
-    for (j = 0, val = strtok(line, " "); 
-	 val && (j < 3); 
-	 j++, val = strtok(NULL, " "))
-      ;
-
-    if ((j != 3) || (!val))
-      AFFY_HANDLE_ERROR_GOTO("failed to parse affinity value from file",
+    if (*line == '\0')
+      continue;
+
+    n = split(line, kv, ' ', 5);
+
+    /* t-value and probeset name start each probeset */
+    if (n == 2)
+    {
+      ps = affy_cdf_find_probeset(cdf, kv[0]);
+
+      /* first probeset of that name that hasn't been read yet */
+      while (ps >= 0 && count[ps] >= 0)
+        ps = cdf->name_next[ps];
+
+      if (ps < 0)
+        continue;
+
+      if (parsefloat(kv[1], &t_values[ps]) == -1)
+        AFFY_HANDLE_ERROR_VOID("failed to parse affinity value from file",
+                               AFFY_ERROR_BADFORMAT,
+                               err);
+      count[ps] = 0;
+    }
+    /* then an affinity for each probe */
+    else if (n == 4)
+    {
+      if (ps < 0)
+        continue;
+
+      numprobes = cdf->ps_offset[ps + 1] - cdf->ps_offset[ps];
+      if (count[ps] >= numprobes)
+        AFFY_HANDLE_ERROR_VOID("too many affinities for probeset in file",
+                               AFFY_ERROR_BADFORMAT,
+                               err);
+
+      if (parsefloat(kv[3], &affinities[cdf->ps_offset[ps] + count[ps]])
+          == -1)
+        AFFY_HANDLE_ERROR_VOID("failed to parse affinity value from file",
+                               AFFY_ERROR_BADFORMAT,
+                               err);
+      count[ps]++;
+    }
+    else
+      AFFY_HANDLE_ERROR_VOID("failed to parse affinity value from file",
                              AFFY_ERROR_BADFORMAT,
-                             err,
-                             cleanup);
+                             err);
+  }
 
-    if (parsefloat(val, affinities+i) == -1)
-      AFFY_HANDLE_ERROR_GOTO("failed to parse affinity value from file",
+  for (ps = 0; ps < cdf->numprobesets; ps++)
+  {
+    numprobes = cdf->ps_offset[ps + 1] - cdf->ps_offset[ps];
+
+    if (count[ps] != numprobes)
+      AFFY_HANDLE_ERROR_VOID("affinities file does not match CDF",
                              AFFY_ERROR_BADFORMAT,
-                             err,
-                             cleanup);
-    
-    free(line);
+                             err);
   }
+}
 
-  return;
+/*
+ * Summarization.  Probesets are independent of each other, so they are
+ * handed out to f->num_threads workers a chunk at a time, under a lock;
+ * chunks start large and shrink towards the end so the workers finish
+ * together.  Each worker creates a halloc pool (see hpool.c) when it
+ * starts and keeps its scratch arena there, for the z matrix and the
+ * affinities of the probeset it is working on; nothing in the pool ever
+ * moves into a shared tree, and the main thread frees the pools after
+ * the join.  Each worker writes its results straight into chip->probe_set[ps],
+ * which no other worker touches.
+ *
+ * Affinities and t-values that have to outlive the probeset (for reuse
+ * on a later chipset, or for the affinities file) go into flat arrays
+ * indexed like cdf->ps_offset[], also disjoint between probesets.  The
+ * affinities file is written from those after all workers are done, in
+ * CDF order, so it is the same however many threads were used.
+ */
+#define SIGNAL_MIN_CHUNK  16
+#define SIGNAL_MAX_CHUNK  1024
 
-cleanup:
-  if (line) free(line);
+typedef struct
+{
+  AFFY_CHIPSET        *c;
+  AFFY_COMBINED_FLAGS *f;
+  const double        *saved_t;          /* --read-affinities, or NULL     */
+  const double        *saved_affinities;
+  double              *out_t;            /* kept t-values, or NULL         */
+  double              *out_affinities;   /* kept affinities, or NULL       */
+  int                  num_threads;
+  int                  next;             /* next probeset to hand out      */
+  bool                 failed;           /* a worker hit an error, stop    */
+  LIBUTILS_PB_STATE   *pbs;
+#ifdef AFFY_HAVE_PTHREADS
+  pthread_mutex_t      lock;
+#endif
+} SIGNAL_STATE;
+
+typedef struct
+{
+  SIGNAL_STATE *st;
+  hpool_t      *pool;                    /* owns scratch                   */
+  harena_t     *scratch;
+  double       *results;                 /* one per chip                   */
+  AFFY_ERROR    err;
+} SIGNAL_WORKER;
+
+/* Median polish probeset ps, storing its expression on every chip */
+static void signal_probeset(SIGNAL_STATE *st,
+                            int ps,
+                            double *results,
+                            harena_t *scratch,
+                            AFFY_ERROR *err)
+{
+  AFFY_CHIPSET        *c   = st->c;
+  AFFY_COMBINED_FLAGS *f   = st->f;
+  AFFY_CDFFILE        *cdf = c->cdf;
+  unsigned int         numchips = c->num_chips;
+  int                  i, j, numprobes, first;
+  double              *z, *affinities, t, value;
+  double               LOG2 = log(2.0);
+  harena_mark_t        mark;
+
+  first     = cdf->ps_offset[ps];
+  numprobes = cdf->ps_offset[ps + 1] - first;
+
+  /* z matrix (for polishing), one row of numchips per probe */
+  mark       = h_arena_mark(scratch);
+  z          = h_arena_alloc(scratch, numprobes * numchips * sizeof(double));
+  affinities = h_arena_alloc(scratch, numprobes * sizeof(double));
+  if (z == NULL || affinities == NULL)
+    AFFY_HANDLE_ERROR_GOTO("malloc failed", AFFY_ERROR_OUTOFMEM, err, done);
+
+  /* Load logged data for this probe set */
+  for (i = 0; i < numchips; i++)
+  {
+    /* Load probes from pm array or actual cel data */
+    for (j = 0; j < numprobes; j++)
+    {
+      /* look out, CEL file can contain intensities <= 0 now !!
+       *  HACK -- use the delta from the mas5 settings
+       */
+      value = c->chip[i]->pm[first + j];
+      if (value < f->delta)
+      {
+        value = f->delta;
+      }
+
+      z[j * numchips + i] = log(value) / LOG2;
+    }
+  }
+
+  if (st->saved_t || (f->reuse_affinities && c->mp_populated_flag))
+  {
+    double        t_p, t_g;
+    const double *affinities_ptr;
+
+    if (st->saved_t)
+    {
+      t_g            = st->saved_t[ps];
+      affinities_ptr = st->saved_affinities + first;
+    }
+    else
+    {
+      t_g            = c->t_values[ps];
+      affinities_ptr = c->affinities[ps];
+    }
+
+    /* At this point the affinity values have been successfully
+       loaded from disk, now we simply calculate the expression
+       value for this probeset on each chip. */
+    for (i = 0; i < numchips; i++)
+    {
+      /* First adjust the bg-corrected probe values for the affinity. */
+      for (j = 0; j < numprobes; j++)
+        z[j * numchips + i] -= affinities_ptr[j];
+
+      /* Next, median polish the corrected probe values (column i). */
+      affy_rma_median_polish_block(z + i, numprobes, 1, numchips, NULL, NULL,
+                                   &t_p, f, scratch, err);
+      AFFY_CHECK_ERROR_GOTO(err, done);
+
+      /* Calculate and store probeset expression. */
+      results[i] = t_p + t_g;
+    }
+
+    t = t_g;
+    memcpy(affinities, affinities_ptr, numprobes * sizeof(double));
+  }
+  else
+  {
+    affy_rma_median_polish_block(z, numprobes, numchips, numchips, results,
+                                 affinities, &t, f, scratch, err);
+    AFFY_CHECK_ERROR_GOTO(err, done);
+  }
+
+  /* keep affinities for median polish reuse and/or the affinities file */
+  if (st->out_t)
+  {
+    st->out_t[ps] = t;
+    memcpy(st->out_affinities + first, affinities,
+           numprobes * sizeof(double));
+  }
+
+  /* Store results */
+  for (i = 0; i < numchips; i++)
+    c->chip[i]->probe_set[ps] = results[i];
+
+done:
+  h_arena_reset(scratch, mark);
+}
+
+/* Hand out the next chunk of probesets, returns its size (0 when done) */
+static int next_chunk(SIGNAL_STATE *st, int *start)
+{
+  int remaining, n;
+
+  remaining = st->c->cdf->numprobesets - st->next;
+  if (remaining <= 0 || st->failed)
+    return (0);
+
+  n = remaining / (4 * st->num_threads);
+  if (n < SIGNAL_MIN_CHUNK)
+    n = SIGNAL_MIN_CHUNK;
+  if (n > SIGNAL_MAX_CHUNK)
+    n = SIGNAL_MAX_CHUNK;
+  if (n > remaining)
+    n = remaining;
+
+  *start    = st->next;
+  st->next += n;
+
+  pb_tick(st->pbs, n, "Calculating signal for probe %d", *start + n);
+
+  return (n);
+}
+
+static void *signal_worker(void *arg)
+{
+  SIGNAL_WORKER *w   = arg;
+  SIGNAL_STATE  *st  = w->st;
+  AFFY_ERROR    *err = &w->err;
+  int            start, n, ps;
+
+  /* on failure, the first pass through the loop stops everybody */
+  w->pool = h_pool_create();
+  if (w->pool == NULL)
+    AFFY_HANDLE_ERROR_GOTO("malloc failed", AFFY_ERROR_OUTOFMEM, err, work);
+
+  w->scratch = h_arena_create(w->pool, 0);
+  if (w->scratch == NULL)
+    AFFY_HANDLE_ERROR_GOTO("malloc failed", AFFY_ERROR_OUTOFMEM, err, work);
+
+  w->results = h_arena_calloc(w->scratch, st->c->num_chips + 1,
+                              sizeof(double));
+  if (w->results == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, work);
+
+work:
+  for (;;)
+  {
+#ifdef AFFY_HAVE_PTHREADS
+    if (st->num_threads > 1)
+      pthread_mutex_lock(&st->lock);
+#endif
+    if (w->err.type != AFFY_ERROR_NONE)
+      st->failed = true;
+
+    n = next_chunk(st, &start);
+#ifdef AFFY_HAVE_PTHREADS
+    if (st->num_threads > 1)
+      pthread_mutex_unlock(&st->lock);
+#endif
+
+    if (n == 0)
+      break;
+
+    for (ps = start; ps < start + n; ps++)
+    {
+      signal_probeset(st, ps, w->results, w->scratch, &w->err);
+      if (w->err.type != AFFY_ERROR_NONE)
+        break;
+    }
+  }
+
+  return (NULL);
+}
+
+/* Write the kept affinities to the affinities file, in CDF order */
+static void write_affinities(OUTPUT_BUFFER *ob,
+                             AFFY_CDFFILE *cdf,
+                             const double *t_values,
+                             const double *affinities)
+{
+  int ps, i, first, numprobes;
+
+  for (ps = 0; ps < cdf->numprobesets; ps++)
+  {
+    char *name = cdf->probeset[ps].name;
+
+    first     = cdf->ps_offset[ps];
+    numprobes = cdf->ps_offset[ps + 1] - first;
+
+    /* T-value and probeset name come first, on their own line. */
+    output_buffer_puts(ob, name);
+    output_buffer_putc(ob, ' ');
+    output_buffer_exp(ob, t_values[ps], 15);
+    output_buffer_putc(ob, '\n');
+
+    /* Then each probe and its location, one per line. */
+    for (i = 0; i < numprobes; i++)
+    {
+      AFFY_POINT pt = cdf->probe[first + i]->pm;
+
+      output_buffer_puts(ob, name);
+      output_buffer_putc(ob, ' ');
+      output_buffer_int(ob, pt.x);
+      output_buffer_putc(ob, ' ');
+      output_buffer_int(ob, pt.y);
+      output_buffer_putc(ob, ' ');
+      output_buffer_exp(ob, affinities[first + i], 15);
+      output_buffer_putc(ob, '\n');
+    }
+  }
 }
 
 /*
@@ -109,13 +404,18 @@ cleanup:
 void affy_rma_signal(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f,
                      int safe_to_write_affinities_flag, AFFY_ERROR *err)
 {
-  int               i, j, ps, *mempool, affinity_size = 0;
+  int               i, ps, *mempool, num_threads, num_started = 0;
   unsigned int      numchips;
-  double           *results = NULL, *affinities = NULL, t, **z = NULL;
-  double            LOG2 = log(2.0);
+  double           *saved_t = NULL, *saved_affinities = NULL;
+  int              *saved_count;
+  bool              dump_affinities, keep_affinities;
   AFFY_CDFFILE     *cdf;
   FILE             *aff_file = NULL;
+  LINE_READER      *aff_lr = NULL;
+  OUTPUT_BUFFER    *aff_ob = NULL;
   LIBUTILS_PB_STATE pbs;
+  SIGNAL_STATE      st;
+  SIGNAL_WORKER    *workers = NULL;
 
   /* Preconditions: The CHIPSET and the CDF exist */
   assert(c      != NULL);
@@ -126,6 +426,17 @@ void affy_rma_signal(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f,
   cdf      = c->cdf;
   numchips = c->num_chips;
 
+  dump_affinities = f->dump_probe_affinities && safe_to_write_affinities_flag;
+  keep_affinities = f->reuse_affinities &&
+                    !f->use_saved_affinities &&
+                    !c->mp_populated_flag;
+
+  num_threads = f->num_threads;
+  if (num_threads > cdf->numprobesets)
+    num_threads = cdf->numprobesets;
+  if (num_threads < 1)
+    num_threads = 1;
+
   pb_init(&pbs);
   pb_begin(&pbs, cdf->numprobesets, "Calculating expressions");
 
@@ -136,9 +447,10 @@ void affy_rma_signal(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f,
 
   for (i = 0; i < numchips; i++)
   {
-    c->chip[i]->probe_set = h_subcalloc(c->chip[i], 
-                                        cdf->numprobesets, 
-                                        sizeof(double));
+    c->chip[i]->probe_set = affy_backing_store_calloc(c->chip[i]->store,
+                                                      c->chip[i],
+                                                      cdf->numprobesets,
+                                                      sizeof(double));
     if (c->chip[i]->probe_set == NULL)
       AFFY_HANDLE_ERROR_GOTO("calloc failed", 
                              AFFY_ERROR_OUTOFMEM, 
@@ -148,26 +460,42 @@ void affy_rma_signal(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f,
     c->chip[i]->numprobesets = cdf->numprobesets;
   }
   
-  /* allocate arrays for reuse of median polish affinities */
+  /*
+   * allocate arrays for reuse of median polish affinities; the
+   * affinities of all probesets share one block, c->affinities[0]
+   */
   if (f->reuse_affinities &&
       !f->use_saved_affinities &&
       !c->mp_allocated_flag)
   {
     c->affinities = h_subcalloc(c,
-                                cdf->numprobesets,
+                                cdf->numprobesets + 1,
                                 sizeof(double *));
     c->t_values   = h_subcalloc(c,
-                                cdf->numprobesets,
-                                sizeof(double *));
-  }
+                                cdf->numprobesets + 1,
+                                sizeof(double));
+    if (c->affinities == NULL || c->t_values == NULL)
+      AFFY_HANDLE_ERROR_GOTO("calloc failed",
+                             AFFY_ERROR_OUTOFMEM,
+                             err,
+                             cleanup);
 
-  results = h_subcalloc(mempool, numchips, sizeof(double));
-  if (results == NULL)
-    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
+    c->affinities[0] = h_subcalloc(c->affinities,
+                                   cdf->numprobes + 1,
+                                   sizeof(double));
+    if (c->affinities[0] == NULL)
+      AFFY_HANDLE_ERROR_GOTO("calloc failed",
+                             AFFY_ERROR_OUTOFMEM,
+                             err,
+                             cleanup);
+
+    for (ps = 1; ps < cdf->numprobesets; ps++)
+      c->affinities[ps] = c->affinities[0] + cdf->ps_offset[ps];
+  }
 
   /* If we're using saved affinity values or dumping calculated ones,
      get the file opened first. */
-  if (f->dump_probe_affinities && safe_to_write_affinities_flag)
+  if (dump_affinities)
   {
     aff_file = fopen(f->affinities_filename, "w");
     if (aff_file == NULL)
@@ -175,6 +503,13 @@ void affy_rma_signal(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f,
                              AFFY_ERROR_IO,
                              err,
                              cleanup);
+
+    aff_ob = output_buffer_init(aff_file);
+    if (aff_ob == NULL)
+      AFFY_HANDLE_ERROR_GOTO("malloc failed",
+                             AFFY_ERROR_OUTOFMEM,
+                             err,
+                             cleanup);
   }
   else if (f->use_saved_affinities)
   {
@@ -184,156 +519,126 @@ void affy_rma_signal(AFFY_CHIPSET *c, AFFY_COMBINED_FLAGS *f,
                              AFFY_ERROR_NOTFOUND,
                              err,
                              cleanup);
-  }
 
-  /* ----------- XXX */
+    aff_lr = line_reader_init(aff_file);
+    if (aff_lr == NULL)
+      AFFY_HANDLE_ERROR_GOTO("malloc failed",
+                             AFFY_ERROR_OUTOFMEM,
+                             err,
+                             cleanup);
 
-  /* Median polish each probeset. The results are stored in probeset */
-  for (ps = 0; ps < cdf->numprobesets; ps++)
+    saved_t          = h_subcalloc(mempool, cdf->numprobesets + 1,
+                                   sizeof(double));
+    saved_affinities = h_subcalloc(mempool, cdf->numprobes + 1,
+                                   sizeof(double));
+    saved_count      = h_subcalloc(mempool, cdf->numprobesets + 1,
+                                   sizeof(int));
+    if (saved_t == NULL || saved_affinities == NULL || saved_count == NULL)
+      AFFY_HANDLE_ERROR_GOTO("calloc failed",
+                             AFFY_ERROR_OUTOFMEM,
+                             err,
+                             cleanup);
+
+    read_affinities(aff_lr, cdf, saved_t, saved_affinities, saved_count,
+                    err);
+    AFFY_CHECK_ERROR_GOTO(err, cleanup);
+  }
+
+  st.c                = c;
+  st.f                = f;
+  st.saved_t          = f->use_saved_affinities ? saved_t : NULL;
+  st.saved_affinities = saved_affinities;
+  st.out_t            = NULL;
+  st.out_affinities   = NULL;
+  st.num_threads      = num_threads;
+  st.next             = 0;
+  st.failed           = false;
+  st.pbs              = &pbs;
+
+  /* where to keep the affinities; the file is written from these */
+  if (keep_affinities)
+  {
+    st.out_t          = c->t_values;
+    st.out_affinities = c->affinities[0];
+  }
+  else if (dump_affinities)
   {
-    AFFY_PROBESET  *p;
-    int             numprobes;
-    double          value;
+    st.out_t          = h_subcalloc(mempool, cdf->numprobesets + 1,
+                                    sizeof(double));
+    st.out_affinities = h_subcalloc(mempool, cdf->numprobes + 1,
+                                    sizeof(double));
+    if (st.out_t == NULL || st.out_affinities == NULL)
+      AFFY_HANDLE_ERROR_GOTO("calloc failed",
+                             AFFY_ERROR_OUTOFMEM,
+                             err,
+                             cleanup);
+  }
 
-    pb_tick(&pbs, 1, "Calculating signal for probe %d",ps+1);
-    p = &(cdf->probeset[ps]);
-    assert(p != NULL);
+  /* the workers set up their own scratch */
+  workers = h_subcalloc(mempool, num_threads, sizeof(SIGNAL_WORKER));
+  if (workers == NULL)
+    AFFY_HANDLE_ERROR_GOTO("calloc failed", AFFY_ERROR_OUTOFMEM, err, cleanup);
 
-    numprobes = p->numprobes;
+  for (i = 0; i < num_threads; i++)
+  {
+    workers[i].st          = &st;
+    workers[i].err.type    = AFFY_ERROR_NONE;
+    workers[i].err.handler = NULL;
+  }
 
-    z = NULL; /* for safety in case code gets reordered in here */
+  /* Median polish each probeset. The results are stored in probeset */
+#ifdef AFFY_HAVE_PTHREADS
+  if (num_threads > 1)
+  {
+    pthread_t *threads;
 
-    /* Allocate storage for z matrix (for polishing) */
-    z = create_matrix(numprobes, numchips);
-    if (z == NULL)
-      AFFY_HANDLE_ERROR_GOTO("create_matrix() out of memory",
+    threads = h_subcalloc(mempool, num_threads, sizeof(pthread_t));
+    if (threads == NULL)
+      AFFY_HANDLE_ERROR_GOTO("calloc failed",
                              AFFY_ERROR_OUTOFMEM,
                              err,
                              cleanup);
 
-    /* Load logged data for this probe set */
-    for (i = 0; i < numchips; i++)
-    {
-      /* Load probes from pm array or actual cel data */
-      for (j = 0; j < numprobes; j++)
-      {
-        /* look out, CEL file can contain intensities <= 0 now !!
-         *  HACK -- use the delta from the mas5 settings
-         */
-        value = c->chip[i]->pm[p->probe[j].index];
-        if (value < f->delta)
-        {
-          value = f->delta;
-        }
-        
-        z[j][i] = log(value) / LOG2;
-      }
-    }
-
-    /* Even if affinities aren't stored, the median polish will record them */
-    if (affinity_size < numprobes)
-    {
-      affinities = halloc(affinities, numprobes * sizeof(double));
-      if (affinities == NULL)
-        AFFY_HANDLE_ERROR_GOTO("realloc failed",
-                               AFFY_ERROR_OUTOFMEM,
-                               err,
-                               cleanup);
-      else
-        /* XXX double check this is ok */
-        hattach(affinities, mempool);
-
-      affinity_size = numprobes;
-    }
+    pthread_mutex_init(&st.lock, NULL);
 
-    if (f->use_saved_affinities ||
-        (f->reuse_affinities && c->mp_populated_flag))
+    for (i = 0; i < num_threads; i++)
     {
-      double t_p, t_g;
-      double *affinities_ptr;
+      if (pthread_create(&threads[i], NULL, signal_worker, &workers[i]) != 0)
+        break;
 
-      if (f->use_saved_affinities)
-      {
-        read_affinities(aff_file, affinities, &t_g, numprobes, err);
-        AFFY_CHECK_ERROR_GOTO(err, cleanup);
-        
-        affinities_ptr = affinities;
-      }
-      else
-      {
-        t_g = c->t_values[ps];
-        affinities_ptr = c->affinities[ps];
-      }
-
-      /* At this point the affinity values have been successfully
-	 loaded from disk, now we simply calculate the expression
-	 value for this probeset on each chip. */
-      for (i = 0; i < numchips; i++)
-      {
-	int probe_idx;
-
-	/* First adjust the bg-corrected probe values for the affinity. */
-	for (probe_idx = 0; probe_idx < numprobes; probe_idx++)
-	  z[probe_idx][i] -= affinities_ptr[probe_idx];
-	
-	/* Next, median polish the corrected probe values. */
-	affy_rma_median_polish(z, 0, i, numprobes, 1, NULL, NULL, &t_p, f,
-	                       err);
-        AFFY_CHECK_ERROR_GOTO(err, cleanup);
-
-	/* Calculate and store probeset expression. */
-	results[i] = t_p + t_g;
-      }
-    }
-    else
-    {
-      affy_rma_median_polish(z, 0, 0, numprobes, numchips, results, 
-			     affinities, &t, f, err);
-      AFFY_CHECK_ERROR_GOTO(err, cleanup);
+      num_started++;
     }
 
-    /* store affinities for median polish reuse */
-    if (f->reuse_affinities &&
-        !f->use_saved_affinities &&
-        !c->mp_populated_flag)
-    {
-      double *dptr;
-    
-      dptr = c->affinities[ps] = h_subcalloc(c->affinities,
-                                             numprobes,
-                                             sizeof(double *));
-
-      c->t_values[ps] = t;
-      for (i = 0; i < numprobes; i++)
-        dptr[i] = affinities[i];
-    }
+    for (i = 0; i < num_started; i++)
+      pthread_join(threads[i], NULL);
 
-    /* Store results */
-    for (i = 0; i < numchips; i++)
-    {
-      c->chip[i]->probe_set[ps] = results[i];
-    }
+    pthread_mutex_destroy(&st.lock);
+  }
+#endif
 
-    /* If desired, dump the probe affinities */
-    if (f->dump_probe_affinities && safe_to_write_affinities_flag)
+  /* single threaded, or no threads could be started */
+  if (num_started == 0)
+  {
+    st.num_threads = 1;
+    signal_worker(&workers[0]);
+  }
+
+  for (i = 0; i < num_threads; i++)
+  {
+    if (workers[i].err.type != AFFY_ERROR_NONE)
     {
-      /* T-value and probeset name come first, on their own line. */
-      fprintf(aff_file, "%s %.15e\n", p->name, t);
+      affy_clone_error(err, &workers[i].err);
+      if (err->handler != NULL)
+        (err->handler)(err);
 
-      /* Then each probe and its location, one per line. */
-      for (i = 0; i < numprobes; i++)
-      {
-	AFFY_POINT pt = p->probe[i].pm;
-	
-	fprintf(aff_file, "%s %" AFFY_PRNd32 " %" AFFY_PRNd32 " %.15e\n",
-		p->name, pt.x, pt.y, affinities[i]);
-      }
+      goto cleanup;
     }
-
-    free_matrix(z);
-    z = NULL;
   }
 
+  /* If desired, dump the probe affinities */
+  if (dump_affinities)
+    write_affinities(aff_ob, cdf, st.out_t, st.out_affinities);
+
   pb_finish(&pbs, "Finished median polish probeset summarization");
 
 cleanup:
@@ -341,11 +646,21 @@ cleanup:
   c->mp_allocated_flag = 1;
   c->mp_populated_flag = 1;
 
+  /* worker pools aren't part of mempool; all workers have exited */
+  if (workers)
+  {
+    for (i = 0; i < num_threads; i++)
+      h_free(workers[i].pool);
+  }
+
   /* Free up results storage */
   h_free(mempool);
-  free_matrix(z);
 
   /* Close affinity file if it was opened. */
+  if (aff_lr)
+    line_reader_free(aff_lr);
+  if (aff_ob)
+    output_buffer_free(aff_ob);
   if (aff_file)
     fclose(aff_file);
 }
@@ -18,6 +18,7 @@
  * 03/07/08: New error handling scheme (AMH)
  * 09/20/10: Pooled memory allocator (AMH)
  * 03/11/14: Added unweighted_massdist() function (EAW)
+ * 10/16/26: range and IQR by selection instead of sorting (EAW)
  *
  **************************************************************************/
 
@@ -123,7 +124,7 @@ void affy_kernel_density(double *x, int nx, double *weights, double *dy,
 			 double *dx, int N, AFFY_ERROR *err)
 {
 
-  int    i;
+  int    i, k[4];
   double low, high, iqr, bw, from, to;
   double *kords;
   double *buffer;
@@ -156,10 +157,18 @@ void affy_kernel_density(double *x, int nx, double *weights, double *dy,
     buffer[i] = x[i];
   }
 
-  qsort(buffer, nx, sizeof(double), dcompare);
-  low  = buffer[0];
-  high = buffer[nx - 1];
-  iqr  = buffer[(int)(0.75 * nx + 0.5)] - buffer[(int)(0.25 * nx + 0.5)];
+  /* min, quartiles, max; the upper quartile index is nx for nx <= 2 */
+  k[0] = 0;
+  k[1] = (int)(0.25 * nx + 0.5);
+  k[2] = (int)(0.75 * nx + 0.5);
+  k[3] = nx - 1;
+  if (k[2] > k[3])
+    k[2] = k[3];
+  dselect_multi(buffer, nx, k, 4);
+
+  low  = buffer[k[0]];
+  high = buffer[k[3]];
+  iqr  = buffer[k[2]] - buffer[k[1]];
   bw   = bandwidth(x, nx, iqr);
   low  = low - 7 * bw;
   high = high + 7 * bw;
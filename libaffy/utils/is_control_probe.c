@@ -17,6 +17,8 @@
  * 2005-04-14: Imported/repaired from old libaffy (AMH)
  * 2019-03-15: Added probeset and string functions, more control strings (EAW)
  * 2019-08-13: removed "unsigned" from affy_is_control_string() chars (EAW)
+ * 2026-10-16: affy_is_control_string() no longer mallocs a lowercase copy;
+ *             added affy_training_mask_flags() (EAW)
  *
  **************************************************************************/
 
@@ -24,74 +26,64 @@
 #include <affy.h>
 
 
+/* case-insensitive strstr(), needle must be lowercase */
+static char *find_lower(char *string, const char *needle)
+{
+  size_t i;
+
+  for (; *string != '\0'; string++)
+  {
+    for (i = 0; needle[i] != '\0'; i++)
+      if (tolower((unsigned char)string[i]) != needle[i])
+        break;
+
+    if (needle[i] == '\0')
+      return (string);
+  }
+
+  return (NULL);
+}
+
+/* case-insensitive strncmp() == 0, prefix must be lowercase */
+static bool starts_lower(const char *string, const char *prefix)
+{
+  for (; *prefix != '\0'; string++, prefix++)
+    if (tolower((unsigned char)*string) != *prefix)
+      return (false);
+
+  return (true);
+}
+
 bool affy_is_control_string(char *string)
 {
-  char *str_lower = NULL;
-  char *sptr, *sptr2;
-  unsigned int length;
+  char *sptr;
 
   assert(string != NULL);
-  
-  length = strlen(string);
 
   /* strcasestr() and strcasecmp() are non-standard BSD/POSIX extensions,
-   * so the simplest solution is to make a lowercase copy ahead of time
+   * so compare against lowercase patterns in place, rather than making a
+   * lowercase copy of the string on every call
    */
 
-  /* allocate lowercase string */
-  if (length)
-  {
-    str_lower = (char *) malloc((length+1) * sizeof(char));
-
-    /* this should never happen, we must have run out of memory */
-    if (!str_lower)
-      return false;
-    
-    str_lower[length] = '\0';
-  }
-  else
-    return(false);
-  
-  /* lowercase the string */
-  sptr  = str_lower;
-  sptr2 = string;
-
-  while (*sptr2 != '\0')
-    *sptr++ = tolower(*sptr2++);
-
   /* AFFX */
   if (strncmp(string, "AFFX", 4) == 0)
-  {
-    if (str_lower)
-      free(str_lower);
     return (true);
-  }
 
   /* spike in */
-  if ((sptr = strstr(str_lower, "spike")))
+  if ((sptr = find_lower(string, "spike")))
   {
     sptr += 5;
-    if (strncmp(sptr, "in",  2) == 0 ||
-        strncmp(sptr, "-in", 3) == 0 ||
-        strncmp(sptr, "_in", 3) == 0 ||
-        strncmp(sptr, " in", 3) == 0)
-    {
-      if (str_lower)
-        free(str_lower);
+    if (starts_lower(sptr, "in")  ||
+        starts_lower(sptr, "-in") ||
+        starts_lower(sptr, "_in") ||
+        starts_lower(sptr, " in"))
       return (true);
-    }
   }
+
   /* control */
-  if (strstr(str_lower, "control"))
-  {
-    if (str_lower)
-      free(str_lower);
+  if (find_lower(string, "control"))
     return (true);
-  }
 
-  if (str_lower)
-    free(str_lower);
-  
   return (false);
 }
 
@@ -126,3 +118,23 @@ bool affy_is_control_probeset(AFFY_PROBESET *ps)
   else
     return (false);
 }
+
+
+/*
+ * AFFY_PS_* bits of the probesets to leave out of normalization training:
+ * always controls, plus exclusions and spike-ins if they are in use.
+ * Test against affy_probe_flags() or cdf->ps_flags[].
+ */
+affy_uint8 affy_training_mask_flags(AFFY_COMBINED_FLAGS *f)
+{
+  affy_uint8 flags = AFFY_PS_CONTROL;
+
+  assert(f != NULL);
+
+  if (f->use_exclusions)
+    flags |= AFFY_PS_EXCLUDED;
+  if (f->use_spikeins)
+    flags |= AFFY_PS_SPIKEIN;
+
+  return (flags);
+}
@@ -15,6 +15,7 @@
  * Update History
  * --------------
  * 4/14/05: Imported/repaired from old libaffy (AMH)
+ * 10/16/26: look the cell up in the sparse outlier list (EAW)
  *
  **************************************************************************/
 
@@ -31,7 +32,7 @@ bool affy_isoutlier(AFFY_CHIP *chip, int x, int y)
   assert(x >= 0);
   assert(y >= 0);
 
-  if (bit_test(chip->cel->outlier[x], y))
+  if (affy_cel_isoutlier_at(chip->cel, (size_t)x * chip->cel->numrows + y))
     return (true);
   else
     return (false);
@@ -0,0 +1,45 @@
+/**************************************************************************
+ *
+ * Filename:  mark_probe_cells.c
+ *
+ * Purpose:   Flag every cell used by a PM or MM probe in cdf->seen_xy.
+ *
+ * Creation:  October 16th, 2026
+ *
+ * Author:    Eric A. Welsh
+ *
+ * Copyright: Copyright (C) 2026, Moffitt Cancer Center.
+ *            All rights reserved.
+ *
+ * Update History
+ * --------------
+ * 10/16/26: Creation (EAW)
+ *
+ **************************************************************************/
+
+#include <utils.h>
+#include <affy.h>
+
+/*
+ * Clear cdf->seen_xy, then set it to 1 for each cell that holds a PM or
+ * MM probe.  Passes that touch each probe cell once (scaling, flooring)
+ * can then walk the whole chip in storage order, testing
+ * seen_xy[0][i] against affy_cel_value_at(cf, i), instead of jumping
+ * around the chip in probe order.
+ */
+void affy_mark_probe_cells(AFFY_CDFFILE *cdf)
+{
+  int p;
+
+  assert(cdf          != NULL);
+  assert(cdf->seen_xy != NULL);
+
+  memset(cdf->seen_xy[0], 0, cdf->numrows*cdf->numcols*sizeof(affy_uint8));
+
+  for (p = 0; p < cdf->numprobes; p++)
+  {
+    /* missing MM probes have MM coords == PM coords, marked twice */
+    cdf->seen_xy[cdf->probe[p]->pm.x][cdf->probe[p]->pm.y] = 1;
+    cdf->seen_xy[cdf->probe[p]->mm.x][cdf->probe[p]->mm.y] = 1;
+  }
+}
@@ -25,6 +25,12 @@
  * 10/29/18: handle 1:many probe:probeset (EAW)
  *  1/10/24: use geometric mean instead of arithmetic mean (EAW)
  *  4/25/24: add affy_median_normalization() function (EAW)
+ * 10/16/26: access cells through affy_cel_value() and friends (EAW)
+ * 10/16/26: scale the chip in storage order, see affy_mark_probe_cells()
+ *           (EAW)
+ * 10/16/26: is_masked_probe() tests cdf->ps_flags[] instead of the names
+ *           (EAW)
+ * 10/16/26: look cells up in the sparse mask list (EAW)
  *
  **************************************************************************/
 
@@ -37,32 +43,13 @@ char is_masked_probe(AFFY_CDFFILE *cdf, AFFY_CELFILE *cf,
 {
   char mask_char;
 
-  mask_char = (bit_test(cf->mask[x], y)) ||
+  mask_char = affy_cel_ismasked(cf, x, y) ||
     (cdf->cell_type[x][y] == AFFY_UNDEFINED_LOCATION) ||
     (cdf->cell_type[x][y] == AFFY_QC_LOCATION);
 
-  /* skip AFFX/control probesets */
-  if (affy_is_control_string(cdf->probe[p]->ps->name))
+  /* skip AFFX/control probesets, exclusions and spikeins */
+  if (affy_probe_flags(cdf, p) & affy_training_mask_flags(f))
     mask_char = 1;
-
-  /* mask probesets that we want to exclude from training */
-  if (f->use_exclusions && cdf->exclusions)
-  {
-    if (bsearch(&cdf->probe[p]->ps->name, &cdf->exclusions[0],
-        cdf->numexclusions, sizeof(char *), compare_string))
-    {
-      mask_char = 1;
-    }
-  }
-  /* we also want to exclude spikins */
-  if (f->use_spikeins && cdf->spikeins)
-  {
-    if (bsearch(&cdf->probe[p]->ps->name, &cdf->spikeins[0],
-        cdf->numspikeins, sizeof(char *), compare_string))
-    {
-      mask_char = 1;
-    }
-  }
   
   return mask_char;
 }
@@ -82,6 +69,7 @@ void affy_mean_normalization(AFFY_CHIPSET *d, double target_mean,
   double        mean, value, min;
   int           number_of_probes;
   int           i, j, x, y, n;
+  size_t        k;
   char          mask_char;
 
   assert(d   != NULL); 
@@ -104,7 +92,7 @@ void affy_mean_normalization(AFFY_CHIPSET *d, double target_mean,
     min = 9.99E99;
 
     /* both PM and MM */
-    if (cf->data)
+    if (affy_cel_has_data(cf))
     {
       for (j = 0; j < number_of_probes; j++)
       {
@@ -121,7 +109,7 @@ void affy_mean_normalization(AFFY_CHIPSET *d, double target_mean,
         mask_char = is_masked_probe(cdf, cf, x, y, j, f);
 
         /* don't skip < 0 in the min value calculation */
-        value = cf->data[x][y].value;
+        value = affy_cel_value(cf, x, y);
         if (mask_char == 0 && value < min)
           min = value;
 
@@ -144,7 +132,7 @@ void affy_mean_normalization(AFFY_CHIPSET *d, double target_mean,
         mask_char = is_masked_probe(cdf, cf, x, y, j, f);
 
         /* don't skip < 0 in the min value calculation */
-        value = cf->data[x][y].value;
+        value = affy_cel_value(cf, x, y);
         if (mask_char == 0 && value < min)
           min = value;
       }
@@ -178,7 +166,7 @@ void affy_mean_normalization(AFFY_CHIPSET *d, double target_mean,
     
     /* both PM and MM */
     n = 0;
-    if (cf->data)
+    if (affy_cel_has_data(cf))
     {
       memset(cdf->seen_xy[0], 0, cdf->numrows*cdf->numcols*sizeof(affy_uint8));
       for (j = 0; j < number_of_probes; j++)
@@ -202,7 +190,7 @@ void affy_mean_normalization(AFFY_CHIPSET *d, double target_mean,
         {
           mask_char = is_masked_probe(cdf, cf, x, y, j, f);
 
-          value = cf->data[x][y].value;
+          value = affy_cel_value(cf, x, y);
           if (mask_char == 0 && value > 0 &&
               (value > min || f->m_include_min))
           {
@@ -232,7 +220,7 @@ void affy_mean_normalization(AFFY_CHIPSET *d, double target_mean,
         {
           mask_char = is_masked_probe(cdf, cf, x, y, j, f);
 
-          value = cf->data[x][y].value;
+          value = affy_cel_value(cf, x, y);
           if (mask_char == 0 && value > 0 &&
               (value > min || f->m_include_min))
           {
@@ -326,33 +314,20 @@ void affy_mean_normalization(AFFY_CHIPSET *d, double target_mean,
     mean = exp(mean_array[i]);
     
     /* both PM and MM */
-    if (cf->data)
+    if (affy_cel_has_data(cf))
     {
-      /* Now shift all values by the same factor */
-      memset(cdf->seen_xy[0], 0, cdf->numrows*cdf->numcols*sizeof(affy_uint8));
-      for (j = 0; j < number_of_probes; j++)
+      assert(cf->numrows == cdf->numrows && cf->numcols == cdf->numcols);
+
+      /*
+       * Now shift all values by the same factor, each PM and MM cell
+       * once, walking the chip in storage order
+       */
+      affy_mark_probe_cells(cdf);
+      for (k = 0; k < affy_cel_num_cells(cf); k++)
       {
-        x = cdf->probe[j]->pm.x;
-        y = cdf->probe[j]->pm.y;
-
-        if (cdf->seen_xy[x][y] == 0)
-          cf->data[x][y].value *= target_mean / mean;
-        cdf->seen_xy[x][y] = 1;
-
-        /* hack for missing MM probes, where MM coords == PM coords
-         */
-        if (cdf->probe[j]->pm.x == cdf->probe[j]->mm.x &&
-            cdf->probe[j]->pm.y == cdf->probe[j]->mm.y)
-        {
-          continue;
-        }
-
-        x = cdf->probe[j]->mm.x;
-        y = cdf->probe[j]->mm.y;
-
-        if (cdf->seen_xy[x][y] == 0)
-          cf->data[x][y].value *= target_mean / mean;
-        cdf->seen_xy[x][y] = 1;
+        if (cdf->seen_xy[0][k])
+          affy_cel_set_value_at(cf, k, affy_cel_value_at(cf, k) *
+                                       (target_mean / mean));
       }
     }
     /* only PM */
@@ -407,6 +382,7 @@ void affy_median_normalization(AFFY_CHIPSET *d, double target_median,
   double        median, value, min, min_higher;
   int           number_of_probes;
   int           i, j, x, y, n;
+  size_t        k;
   char          mask_char;
 
   assert(d   != NULL); 
@@ -431,7 +407,7 @@ void affy_median_normalization(AFFY_CHIPSET *d, double target_median,
     min_higher = 9.99E99;
 
     /* both PM and MM */
-    if (cf->data)
+    if (affy_cel_has_data(cf))
     {
       for (j = 0; j < number_of_probes; j++)
       {
@@ -448,7 +424,7 @@ void affy_median_normalization(AFFY_CHIPSET *d, double target_median,
         mask_char = is_masked_probe(cdf, cf, x, y, j, f);
 
         /* don't skip < 0 in the min value calculation */
-        value = cf->data[x][y].value;
+        value = affy_cel_value(cf, x, y);
         if (mask_char == 0 && value < min)
           min = value;
 
@@ -471,7 +447,7 @@ void affy_median_normalization(AFFY_CHIPSET *d, double target_median,
         mask_char = is_masked_probe(cdf, cf, x, y, j, f);
 
         /* don't skip < 0 in the min value calculation */
-        value = cf->data[x][y].value;
+        value = affy_cel_value(cf, x, y);
         if (mask_char == 0 && value < min)
           min = value;
       }
@@ -505,7 +481,7 @@ void affy_median_normalization(AFFY_CHIPSET *d, double target_median,
     
     /* both PM and MM */
     n = 0;
-    if (cf->data)
+    if (affy_cel_has_data(cf))
     {
       memset(cdf->seen_xy[0], 0, cdf->numrows*cdf->numcols*sizeof(affy_uint8));
       for (j = 0; j < number_of_probes; j++)
@@ -529,7 +505,7 @@ void affy_median_normalization(AFFY_CHIPSET *d, double target_median,
         {
           mask_char = is_masked_probe(cdf, cf, x, y, j, f);
 
-          value = cf->data[x][y].value;
+          value = affy_cel_value(cf, x, y);
           if (mask_char == 0 && value > 0 &&
               (value > min || f->m_include_min))
           {
@@ -561,7 +537,7 @@ void affy_median_normalization(AFFY_CHIPSET *d, double target_median,
         {
           mask_char = is_masked_probe(cdf, cf, x, y, j, f);
 
-          value = cf->data[x][y].value;
+          value = affy_cel_value(cf, x, y);
           if (mask_char == 0 && value > 0 &&
               (value > min || f->m_include_min))
           {
@@ -673,33 +649,21 @@ void affy_median_normalization(AFFY_CHIPSET *d, double target_median,
     median = median_array[i];
     
     /* both PM and MM */
-    if (cf->data)
+    if (affy_cel_has_data(cf))
     {
-      /* Now shift all values by the same factor */
-      memset(cdf->seen_xy[0], 0, cdf->numrows*cdf->numcols*sizeof(affy_uint8));
-      for (j = 0; j < number_of_probes; j++)
+      assert(cf->numrows == cdf->numrows && cf->numcols == cdf->numcols);
+
+      /*
+       * Now shift all values by the same factor, each PM and MM cell
+       * once, walking the chip in storage order
+       */
+      affy_mark_probe_cells(cdf);
+      for (k = 0; k < affy_cel_num_cells(cf); k++)
       {
-        x = cdf->probe[j]->pm.x;
-        y = cdf->probe[j]->pm.y;
-
-        if (cdf->seen_xy[x][y] == 0)
-          cf->data[x][y].value *= target_median / median;
-        cdf->seen_xy[x][y] = 1;
-
-        /* hack for missing MM probes, where MM coords == PM coords
-         */
-        if (cdf->probe[j]->pm.x == cdf->probe[j]->mm.x &&
-            cdf->probe[j]->pm.y == cdf->probe[j]->mm.y)
-        {
-          continue;
-        }
-
-        x = cdf->probe[j]->mm.x;
-        y = cdf->probe[j]->mm.y;
-
-        if (cdf->seen_xy[x][y] == 0)
-          cf->data[x][y].value *= target_median / median;
-        cdf->seen_xy[x][y] = 1;
+        if (cdf->seen_xy[0][k])
+          affy_cel_set_value_at(cf, k,
+                                (target_median / median) *
+                                affy_cel_value_at(cf, k));
       }
     }
     /* only PM */
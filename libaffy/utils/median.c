@@ -21,6 +21,9 @@
  * 11/19/10: Fixed median calculations, added bioconductor compatability (EAW)
  * 08/12/20: removed bioconductor compatiblity, both gave same results (EAW)
  * 05/16/24: optimized median math (EAW)
+ * 10/16/26: scratch buffers come from a caller supplied arena (EAW)
+ * 10/16/26: affy_median() selects instead of sorting (EAW)
+ * 10/16/26: old signatures back, arena versions are the *_scratch() ones (EAW)
  *
  **************************************************************************/
 
@@ -45,11 +48,35 @@
 double affy_median_save(double *x, int length, AFFY_COMBINED_FLAGS *f,
                         AFFY_ERROR *err)
 {
-  int     i;
-  double *buffer;
-  double  result;
+  harena_t *scratch;
+  double    result;
 
-  buffer = h_malloc(length * sizeof(double));
+  scratch = h_arena_create(NULL, length * sizeof(double));
+  if (scratch == NULL)
+    AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, 0.0);
+
+  result = affy_median_save_scratch(x, length, f, scratch, err);
+
+  h_free(scratch);
+
+  return (result);
+}
+
+/*
+ * Same as affy_median_save(), with the copy taken from scratch and given
+ * back before returning.
+ */
+double affy_median_save_scratch(double *x, int length,
+                                AFFY_COMBINED_FLAGS *f,
+                                harena_t *scratch, AFFY_ERROR *err)
+{
+  int            i;
+  double        *buffer;
+  double         result;
+  harena_mark_t  mark;
+
+  mark   = h_arena_mark(scratch);
+  buffer = h_arena_alloc(scratch, length * sizeof(double));
   if (buffer == NULL)
     AFFY_HANDLE_ERROR("malloc failed", AFFY_ERROR_OUTOFMEM, err, 0.0);
 
@@ -58,41 +85,28 @@ double affy_median_save(double *x, int length, AFFY_COMBINED_FLAGS *f,
 
   result = affy_median(buffer, length, f);
 
-  h_free(buffer);
+  h_arena_reset(scratch, mark);
 
   return (result);
 }
 
 /* 
- *  This function will sort x and find the median. Note this is 
+ *  This function will reorder x to find the median. Note this is 
  *  destructive, therefore you should call affy_median_save() if you 
  *  care about this.
  */
 double affy_median(double *x, int length, AFFY_COMBINED_FLAGS *f)
 {
-  int    half;
-  double med;
-
   assert(x != NULL);
 
-  qsort(x, length, sizeof(double), affy_median_sort);
-
-
-  half = length >> 1;
-
-  if (length % 2)
-    med = x[half];
-  else
-    med = 0.5 * (x[half - 1] + x[half]);
-
-  return (med);
+  return (dmedian(x, length));
 }
 
 /*****************************************************************************
  **
  ** void affy_get_row_median(double *z, double *rdelta, int startrow,
  **                          int startcol, int rows, int cols,
- **                          AFFY_COMBINED_FLAGS *f)
+ **                          AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err)
  **
  ** double *z - matrix of dimension  rows*cols
  ** double *rdelta - on output will contain row medians (vector of length rows)
@@ -111,14 +125,39 @@ void affy_get_row_median(double **z,
                          AFFY_COMBINED_FLAGS *f,
                          AFFY_ERROR *err)
 {
-  int     i, j;
-  int     rowsleft, colsleft;
-  double *buffer;
+  harena_t *scratch;
+
+  scratch = h_arena_create(NULL, numcolumns * sizeof(double));
+  if (scratch == NULL)
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+
+  affy_get_row_median_scratch(z, rdelta, startrow, startcol, numrows,
+                              numcolumns, f, scratch, err);
+
+  h_free(scratch);
+}
+
+/* Same as affy_get_row_median(), with the buffer taken from scratch */
+void affy_get_row_median_scratch(double **z, 
+                                 double *rdelta, 
+                                 int startrow, 
+                                 int startcol, 
+                                 int numrows, 
+                                 int numcolumns,
+                                 AFFY_COMBINED_FLAGS *f,
+                                 harena_t *scratch,
+                                 AFFY_ERROR *err)
+{
+  int            i, j;
+  int            rowsleft, colsleft;
+  double        *buffer;
+  harena_mark_t  mark;
 
   assert(z      != NULL);
   assert(rdelta != NULL);
 
-  buffer = h_malloc(numcolumns * sizeof(double));
+  mark   = h_arena_mark(scratch);
+  buffer = h_arena_alloc(scratch, numcolumns * sizeof(double));
   if (buffer == NULL)
     AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
 
@@ -130,14 +169,14 @@ void affy_get_row_median(double **z,
     rdelta[numrows-rowsleft] = affy_median(buffer, numcolumns, f);
   }
 
-  h_free(buffer);
+  h_arena_reset(scratch, mark);
 }
 
 /*****************************************************************************
  **
  ** void affy_get_col_median(double *z, double *cdelta, int startrow, 
  **                          int startcol, int rows, int cols,
- **                          AFFY_COMBINED_FLAGS *f)
+ **                          AFFY_COMBINED_FLAGS *f, AFFY_ERROR *err)
  **
  ** double *z - matrix of dimension  rows*cols
  ** double *cdelta - on output will contain col medians (vector of length cols)
@@ -156,14 +195,39 @@ void affy_get_column_median(double **z,
                             AFFY_COMBINED_FLAGS *f,
                             AFFY_ERROR *err)
 {
-  int     i, j;
-  int     rowsleft, colsleft;
-  double *buffer;
+  harena_t *scratch;
+
+  scratch = h_arena_create(NULL, numrows * sizeof(double));
+  if (scratch == NULL)
+    AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
+
+  affy_get_column_median_scratch(z, cdelta, startrow, startcol, numrows,
+                                 numcolumns, f, scratch, err);
+
+  h_free(scratch);
+}
+
+/* Same as affy_get_column_median(), with the buffer taken from scratch */
+void affy_get_column_median_scratch(double **z, 
+                                    double *cdelta, 
+                                    int startrow, 
+                                    int startcol, 
+                                    int numrows, 
+                                    int numcolumns,
+                                    AFFY_COMBINED_FLAGS *f,
+                                    harena_t *scratch,
+                                    AFFY_ERROR *err)
+{
+  int            i, j;
+  int            rowsleft, colsleft;
+  double        *buffer;
+  harena_mark_t  mark;
 
   assert(z      != NULL);
   assert(cdelta != NULL);
 
-  buffer = h_malloc(numrows * sizeof(double));
+  mark   = h_arena_mark(scratch);
+  buffer = h_arena_alloc(scratch, numrows * sizeof(double));
   if (buffer == NULL)
     AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
 
@@ -175,7 +239,7 @@ void affy_get_column_median(double **z,
     cdelta[numcolumns-colsleft] = affy_median(buffer, numrows, f);
   }
 
-  h_free(buffer);
+  h_arena_reset(scratch, mark);
 }
 
 /* 
@@ -18,6 +18,7 @@
  * 03/07/08: New error handling scheme (AMH)
  * 09/20/10: Misc updates (AMH)
  * 03/10/14: #ifdef out CEL qc fields to save memory (EAW)
+ * 10/16/26: no caching with compact cell storage (EAW)
  *
  **************************************************************************/
 
@@ -34,7 +35,8 @@
  *
  * Outputs: Pointer to an AFFY_PIXREGION or NULL on error.
  *
- * Side effects: The AFFY_CELL structure is updated to cache the result.
+ * Side effects: The AFFY_CELL structure is updated to cache the result
+ *               (there is nowhere to cache it with compact cell storage).
  *
  * TODO: Boundary conditions.
  *
@@ -88,7 +90,7 @@ AFFY_PIXREGION *affy_pixels_from_cell(AFFY_CHIP *cp,
   for (i = 0; i < px_result->numrows; i++) 
     px_result->data[i] = &(cp->dat->pixels.data[px.y+i][px.x]);
   
-  if (cp->cel != NULL)
+  if (cp->cel != NULL && cp->cel->data != NULL)
     cp->cel->data[x][y].pixels = px_result;
 
   return (px_result);
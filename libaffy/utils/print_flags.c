@@ -26,6 +26,11 @@
  * 09/13/23: added support for iron_ignore_low (EAW)
  * 04/26/25: added support for median normalization (EAW)
  * 04/12/17: added support for normalization before bg-sub (EAW)
+ * 10/16/26: added num_threads (EAW)
+ * 10/16/26: added compiled CDF cache flags (EAW)
+ * 10/16/26: added use_compact_cel (EAW)
+ * 10/16/26: added out-of-core memory budget (EAW)
+ * 10/16/26: added frozen RMA model flags (EAW)
  *
  **************************************************************************/
 
@@ -43,6 +48,17 @@ void print_flags(AFFY_COMBINED_FLAGS *f, char *output_file_name)
   printf("General flags for this run:\n");
   printf("======================================\n");
   printf("CDF Directory:                       %s\n", f->cdf_directory);
+  printf("Use compiled CDF cache:              %s\n",
+         boolstr(f->use_cdf_cache));
+  if (f->use_cdf_cache && f->cdf_cache_directory)
+    printf("Compiled CDF cache directory:        %s\n",
+           f->cdf_cache_directory);
+  printf("Compact CEL storage:                 %s\n",
+         boolstr(f->use_compact_cel));
+  if (f->memory_budget_mb > 0)
+    printf("Memory budget for chip data:         %ld MB (spill to %s)\n",
+           f->memory_budget_mb,
+           f->spill_directory ? f->spill_directory : "$TMPDIR");
   printf("Output filename:                     %s\n", output_file_name);
 
   printf("BG Correction (global override):     %s\n", 
@@ -113,6 +129,8 @@ void print_flags(AFFY_COMBINED_FLAGS *f, char *output_file_name)
          boolstr(f->output_present_absent));
   printf("Salvage corrupt CEL files:           %s\n",
          boolstr(f->output_present_absent));
+  printf("CEL loading threads:                 %d\n",
+         f->num_threads);
 
 
   printf("\n");
@@ -175,6 +193,20 @@ void print_flags(AFFY_COMBINED_FLAGS *f, char *output_file_name)
   else
     printf("\n");
 
+  printf("Dump frozen model:                   %s ",
+         boolstr(f->dump_frozen_model));
+  if (f->dump_frozen_model)
+    printf("(filename: %s)\n", f->frozen_model_filename);
+  else
+    printf("\n");
+
+  printf("Use frozen model:                    %s ",
+         boolstr(f->use_frozen_model));
+  if (f->use_frozen_model)
+    printf("(filename: %s)\n", f->frozen_model_filename);
+  else
+    printf("\n");
+
   printf("\n");
   printf("IRON specific flags for this run:\n");
   printf("======================================\n");
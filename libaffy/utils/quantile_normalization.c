@@ -20,6 +20,11 @@
  * 09/20/10: Pooled memory allocator (AMH)
  * 03/12/13: added affy_quantile_normalize_probeset()
  * 03/14/14: fixed to work with exons arrays (EAW)
+ * 10/16/26: normalize copies of the cell values and store them back, so
+ *           that either cell storage layout works (EAW)
+ * 10/16/26: fixed mean[] overflow when normalizing PM and MM probes (EAW)
+ * 10/16/26: rank by radix sort (dsort_index()) instead of qsort() of
+ *           pointers (EAW)
  *
  **************************************************************************/
 
@@ -62,6 +67,30 @@
  ***********************************************************/
 
 
+/*
+ * Replace each x[] by the mean at its rank.  order[] is x's indices in
+ * sorted order (from dsort_index()); tied values share the floor of
+ * their average rank, as affy_rank_order() gives.
+ */
+static void assign_rank_means(double *x, const int *order, int n,
+                              const double *mean)
+{
+  int    j, k, m;
+  double v;
+
+  for (j = 0; j < n; j = k + 1)
+  {
+    v = x[order[j]];
+
+    for (k = j; k < n - 1 && x[order[k + 1]] == v; k++)
+      ;
+
+    /* floor((j + k + 2) / 2.0) - 1 */
+    for (m = j; m <= k; m++)
+      x[order[m]] = mean[(j + k) / 2];
+  }
+}
+
 /*
  * This normalizes both PM and MM values, which is different from the RMA
  * version, which only normalizes the PM values.
@@ -72,9 +101,11 @@ void affy_quantile_normalization(AFFY_CHIPSET *d, affy_uint8 pm_only,
   int           p, i, j, x, y, number_of_probes;
   int           num_seen_probes = 0;
   double        sum;
-  double       *rank, *mean;
+  double       *mean;
   AFFY_CELFILE *cf;
-  double     ***all_vals;
+  AFFY_POINT   *loc;
+  double      **values;
+  int         **order;
   int          *qnorm_pool;
 
   if (pm_only)
@@ -89,73 +120,99 @@ void affy_quantile_normalization(AFFY_CHIPSET *d, affy_uint8 pm_only,
   if (qnorm_pool == NULL)
     AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
 
-  mean = (double *)h_subcalloc(qnorm_pool, number_of_probes, sizeof(double));
-  if (mean == NULL)
+  order    = (int **)h_subcalloc(qnorm_pool, 
+                                 d->num_chips, 
+                                 sizeof(int *));
+  values   = (double **)h_subcalloc(qnorm_pool, 
+                                    d->num_chips, 
+                                    sizeof(double *));
+  loc      = (AFFY_POINT *)h_subcalloc(qnorm_pool,
+                                       2 * number_of_probes,
+                                       sizeof(AFFY_POINT));
+  if (order == NULL || values == NULL || loc == NULL)
   {
     h_free(qnorm_pool);
     AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
   }
 
-  all_vals = (double ***)h_subcalloc(qnorm_pool, 
-                                     d->num_chips, 
-                                     sizeof(double **));
-  if (all_vals == NULL)
+  /* The cells to normalize, each one once, are the same for every chip */
+  memset(d->cdf->seen_xy[0], 0,
+         d->cdf->numrows * d->cdf->numcols * sizeof(affy_uint8));
+  for (p = 0, j = 0; p < number_of_probes; p++)
+  {
+    x = d->cdf->probe[p]->pm.x;
+    y = d->cdf->probe[p]->pm.y;
+      
+    if (d->cdf->seen_xy[x][y] == 0)
+    {
+      loc[j].x = x;
+      loc[j].y = y;
+      j++;
+    }
+    d->cdf->seen_xy[x][y] = 1;
+      
+    if (pm_only)
+      continue;
+
+    /* hack for missing MM probes, where MM coords == PM coords
+     */
+    if (d->cdf->probe[p]->pm.x == d->cdf->probe[p]->mm.x &&
+        d->cdf->probe[p]->pm.y == d->cdf->probe[p]->mm.y)
+    {
+      continue;
+    }
+    else
+    {
+      x = d->cdf->probe[p]->mm.x;
+      y = d->cdf->probe[p]->mm.y;
+      
+      if (d->cdf->seen_xy[x][y] == 0)
+      {
+        loc[j].x = x;
+        loc[j].y = y;
+        j++;
+      }
+      d->cdf->seen_xy[x][y] = 1;
+    }
+  }
+  num_seen_probes = j;
+
+  /* one mean per cell, PM and MM cells both count if !pm_only */
+  mean = (double *)h_subcalloc(qnorm_pool, num_seen_probes + 1, sizeof(double));
+  if (mean == NULL)
   {
     h_free(qnorm_pool);
     AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
   }
 
-  /* We start by creating a matrix of double pointers to data */
+  /*
+   * We start by copying the data, and sorting the copies' indices
+   */
   for (i = 0; i < d->num_chips; i++)
   {
     cf = d->chip[i]->cel;
-    j = 0;
 
     /* Allocate storage for this chip */
-    all_vals[i] = (double **)h_subcalloc(qnorm_pool, 
-                                         number_of_probes, 
-                                         sizeof(double *));
-    if (all_vals[i] == NULL)
+    values[i] = (double *)h_subcalloc(qnorm_pool, 
+                                      num_seen_probes + 1, 
+                                      sizeof(double));
+    order[i]  = (int *)h_subcalloc(qnorm_pool, 
+                                   num_seen_probes + 1, 
+                                   sizeof(int));
+    if (values[i] == NULL || order[i] == NULL)
     {
       h_free(qnorm_pool);
       AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
     }
 
-    /* Load in the pm for each probe */
-    memset(d->cdf->seen_xy[0], 0,
-           d->cdf->numrows * d->cdf->numcols * sizeof(affy_uint8));
-    for (p = 0, j = num_seen_probes = 0; p < number_of_probes; p++)
-    {
-      x = d->cdf->probe[p]->pm.x;
-      y = d->cdf->probe[p]->pm.y;
-      
-      if (d->cdf->seen_xy[x][y] == 0)
-        all_vals[i][j++] = &(cf->data[x][y].value);
-      d->cdf->seen_xy[x][y] = 1;
-      
-      if (pm_only)
-        continue;
+    for (j = 0; j < num_seen_probes; j++)
+      values[i][j] = affy_cel_value(cf, loc[j].x, loc[j].y);
 
-      /* hack for missing MM probes, where MM coords == PM coords
-       */
-      if (d->cdf->probe[p]->pm.x == d->cdf->probe[p]->mm.x &&
-          d->cdf->probe[p]->pm.y == d->cdf->probe[p]->mm.y)
-      {
-        continue;
-      }
-      else
-      {
-        x = d->cdf->probe[p]->mm.x;
-        y = d->cdf->probe[p]->mm.y;
-      
-        if (d->cdf->seen_xy[x][y] == 0)
-          all_vals[i][j++] = &(cf->data[x][y].value);
-        d->cdf->seen_xy[x][y] = 1;
-      }
+    if (dsort_index(values[i], num_seen_probes, order[i]) != 0)
+    {
+      h_free(qnorm_pool);
+      AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
     }
-    num_seen_probes = j;
-
-    qsort(all_vals[i], num_seen_probes, sizeof(double *), affy_qnorm_compare);
   }
 
   /* Step two: calculate mean value at a given rank */
@@ -164,27 +221,20 @@ void affy_quantile_normalization(AFFY_CHIPSET *d, affy_uint8 pm_only,
     sum = 0;
     /* Calculate mean */
     for (i = 0; i < d->num_chips; i++)
-      sum += *(all_vals[i][j]) / (double)d->num_chips;
+      sum += values[i][order[i][j]] / (double)d->num_chips;
 
     mean[j] = sum;
   }
 
-  rank = (double *)h_subcalloc(qnorm_pool, num_seen_probes, sizeof(double));
-  if (rank == NULL)
-  {
-    h_free(qnorm_pool);
-    AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
-  }
-
   /* Step 3: Redistribute mean value to all chips */
   for (i = 0; i < d->num_chips; i++)
   {
-    /* Rank order the intensities on this chip */
-    affy_rank_order(rank, all_vals[i], num_seen_probes);
+    assign_rank_means(values[i], order[i], num_seen_probes, mean);
+
+    /* store the normalized values back into the chip */
+    cf = d->chip[i]->cel;
     for (j = 0; j < num_seen_probes; j++)
-    {
-      *(all_vals[i][j]) = mean[(int)floor(rank[j]) - 1];
-    }
+      affy_cel_set_value(cf, loc[j].x, loc[j].y, values[i][j]);
   }
 
   h_free(qnorm_pool);
@@ -200,9 +250,9 @@ void affy_quantile_normalization_probeset(AFFY_CHIPSET *d, AFFY_ERROR *err)
 {
   int           i, j, x, y, number_of_probesets;
   double        sum;
-  double       *rank, *mean;
+  double       *mean;
   AFFY_CDFFILE *cdf;
-  double     ***all_vals;
+  int         **order;
   int          *qnorm_pool;
   
   assert(d->cdf != NULL);
@@ -224,35 +274,32 @@ void affy_quantile_normalization_probeset(AFFY_CHIPSET *d, AFFY_ERROR *err)
     AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
   }
 
-  all_vals = (double ***)h_subcalloc(qnorm_pool, 
-                                     d->num_chips, 
-                                     sizeof(double **));
-  if (all_vals == NULL)
+  order = (int **)h_subcalloc(qnorm_pool, d->num_chips, sizeof(int *));
+  if (order == NULL)
   {
     h_free(qnorm_pool);
     AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
   }
 
-  /* We start by creating a matrix of double pointers to data */
+  /* We start by sorting the indices of each chip's probesets */
   for (i = 0; i < d->num_chips; i++)
   {
     /* Allocate storage for this chip */
-    all_vals[i] = (double **)h_subcalloc(qnorm_pool, 
-                                         number_of_probesets,
-                                         sizeof(double *));
-    if (all_vals[i] == NULL)
+    order[i] = (int *)h_subcalloc(qnorm_pool,
+                                  number_of_probesets + 1,
+                                  sizeof(int));
+    if (order[i] == NULL)
     {
       h_free(qnorm_pool);
       AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
     }
 
-    /* store pointers to each probeset value */
-    for (j = 0; j < number_of_probesets; j++)
+    if (dsort_index(d->chip[i]->probe_set, number_of_probesets,
+                    order[i]) != 0)
     {
-      all_vals[i][j] = &(d->chip[i]->probe_set[j]);
+      h_free(qnorm_pool);
+      AFFY_HANDLE_ERROR_VOID("malloc failed", AFFY_ERROR_OUTOFMEM, err);
     }
-
-    qsort(all_vals[i], number_of_probesets, sizeof(double *), affy_qnorm_compare);
   }
 
   /* Step two: calculate mean value at a given rank */
@@ -261,28 +308,15 @@ void affy_quantile_normalization_probeset(AFFY_CHIPSET *d, AFFY_ERROR *err)
     sum = 0;
     /* Calculate mean */
     for (i = 0; i < d->num_chips; i++)
-      sum += *(all_vals[i][j]) / (double)d->num_chips;
+      sum += d->chip[i]->probe_set[order[i][j]] / (double)d->num_chips;
 
     mean[j] = sum;
   }
 
-  rank = (double *)h_subcalloc(qnorm_pool, number_of_probesets, sizeof(double));
-  if (rank == NULL)
-  {
-    h_free(qnorm_pool);
-    AFFY_HANDLE_ERROR_VOID("calloc failed", AFFY_ERROR_OUTOFMEM, err);
-  }
-
   /* Step 3: Redistribute mean value to all chips */
   for (i = 0; i < d->num_chips; i++)
-  {
-    /* Rank order the intensities on this chip */
-    affy_rank_order(rank, all_vals[i], number_of_probesets);
-    for (j = 0; j < number_of_probesets; j++)
-    {
-      *(all_vals[i][j]) = mean[(int)floor(rank[j]) - 1];
-    }
-  }
+    assign_rank_means(d->chip[i]->probe_set, order[i], number_of_probesets,
+                      mean);
 
   h_free(qnorm_pool);
 
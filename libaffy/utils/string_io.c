@@ -4,8 +4,91 @@
 #include <ctype.h>
 #include <math.h>
 
+#include "string_io.h"
+
 #define MEM_OVERHEAD 1.01    /* speed hack -- overallocate to avoid reallocs */
 
+/* initial size of each line reader buffer, doubled for longer lines */
+#define LINE_READER_BUFFER_SIZE (256 * 1024)
+
+
+/* Powers of ten that are exactly representable as doubles */
+static const double exact_pow10[] =
+{
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define IS_BLANK(c)  ((c) == ' ' || (c) == '\t' || (c) == '\v' || (c) == '\f')
+
+/*
+ * Drop-in replacement for strtod(), for the numbers found in CEL files
+ * and spreadsheets.
+ *
+ * Plain decimals with at most 15 significant digits and 22 fractional
+ * digits are converted directly: both the digits and the power of ten
+ * are exact doubles, so a single division gives the same correctly
+ * rounded result as strtod().  Anything else (exponents, inf/nan, hex,
+ * long mantissas, ...) is handed to strtod().
+ */
+double strtod_fast(const char *string, char **endptr)
+{
+    const char *s = string, *p, *digits;
+    double mantissa = 0.0;
+    int numdigits = 0, numint, numfrac = 0;
+    int neg = 0;
+
+    while (IS_BLANK(*s))
+        s++;
+
+    p = s;
+    if (*p == '-')
+    {
+        neg = 1;
+        p++;
+    }
+    else if (*p == '+')
+        p++;
+
+    for (digits = p; *p >= '0' && *p <= '9'; p++)
+    {
+        if (numdigits || *p != '0')
+        {
+            mantissa = 10.0 * mantissa + (*p - '0');
+            numdigits++;
+        }
+    }
+    numint = p - digits;
+
+    if (*p == '.')
+    {
+        for (p++; *p >= '0' && *p <= '9'; p++, numfrac++)
+        {
+            if (numdigits || *p != '0')
+            {
+                mantissa = 10.0 * mantissa + (*p - '0');
+                numdigits++;
+            }
+        }
+    }
+
+    /* at least one digit: ".", "-." and "+." are not numbers */
+    if (numint + numfrac > 0 &&
+        numdigits <= 15 && numfrac <= 22 &&
+        !isalnum((unsigned char)*p) && *p != '.')
+    {
+        if (numfrac)
+            mantissa /= exact_pow10[numfrac];
+
+        if (endptr)
+            *endptr = (char *)p;
+
+        return (neg ? -mantissa : mantissa);
+    }
+
+    return (strtod(string, endptr));
+}
+
 
 /* we can't just pass strcmp to qsort, it needs a wrapper */
 int compare_string(const void *f1, const void *f2)
@@ -143,3 +226,187 @@ int split_tabs(char *string, char ***fields, int *return_max_field)
     
     return count;
 }
+
+
+/* allocate a line reader for infile, returns NULL if out of memory */
+LINE_READER * line_reader_init(FILE *infile)
+{
+    LINE_READER *lr;
+    
+    lr = (LINE_READER *) calloc(1, sizeof(LINE_READER));
+    if (lr == NULL)
+    	return NULL;
+
+    lr->buf = (char *) malloc(LINE_READER_BUFFER_SIZE + 1);
+    if (lr->buf == NULL)
+    {
+    	free(lr);
+    	return NULL;
+    }
+    
+    lr->fp         = infile;
+    lr->buf_offset = ftell(infile);
+    lr->buf_size   = LINE_READER_BUFFER_SIZE;
+    lr->buf[0]   = '\0';
+    
+    return lr;
+}
+
+
+/* does not close the stream */
+void line_reader_free(LINE_READER *lr)
+{
+    if (lr == NULL)
+    	return;
+
+    if (lr->buf)
+    	free(lr->buf);
+    free(lr);
+}
+
+
+/* move any partial line to the front of the buffer, then read more */
+static void line_reader_fill(LINE_READER *lr)
+{
+    size_t n;
+
+    if (lr->pos)
+    {
+    	memmove(lr->buf, lr->buf + lr->pos, lr->len - lr->pos);
+    	lr->len -= lr->pos;
+    	if (lr->buf_offset >= 0)
+    	    lr->buf_offset += lr->pos;
+    	lr->pos  = 0;
+    }
+    lr->nl_valid = 0;
+    
+    /* a single line longer than the whole buffer */
+    if (lr->len == lr->buf_size)
+    {
+    	char *new_buf;
+
+    	new_buf = (char *) realloc(lr->buf, 2 * lr->buf_size + 1);
+    	if (new_buf == NULL)
+    	{
+    	    /* return what we have as the last line */
+    	    lr->eof_flag = 1;
+    	    return;
+    	}
+    	
+    	lr->buf       = new_buf;
+    	lr->buf_size *= 2;
+    }
+
+    n = fread(lr->buf + lr->len, 1, lr->buf_size - lr->len, lr->fp);
+    if (n == 0)
+    	lr->eof_flag = 1;
+    
+    lr->len += n;
+    lr->buf[lr->len] = '\0';
+}
+
+
+/* return the next line with the EOL stripped, NULL at EOF */
+/* length of the line is stored in *return_length, if not NULL */
+char * line_reader_next(LINE_READER *lr, size_t *return_length)
+{
+    char *line, *eol, *end;
+
+    if (lr->unget_flag)
+    {
+    	lr->unget_flag = 0;
+
+    	if (lr->line && return_length)
+    	    *return_length = lr->line_len;
+
+    	return lr->line;
+    }
+
+    while (1)
+    {
+    	line = lr->buf + lr->pos;
+    	end  = lr->buf + lr->len;
+    	
+    	/* the next \n is remembered, in case this is a \r-only file */
+    	if (!lr->nl_valid || lr->nl_pos < lr->pos)
+    	{
+    	    eol = memchr(line, '\n', end - line);
+
+    	    lr->nl_pos   = eol ? (size_t)(eol - lr->buf) : lr->len;
+    	    lr->nl_valid = 1;
+    	}
+    	
+    	/* a \r before it ends the line first */
+    	eol = memchr(line, '\r', lr->nl_pos - lr->pos);
+    	if (eol == NULL)
+    	    eol = lr->buf + lr->nl_pos;
+    	
+    	/* need the character after a \r to know if it is \r\n */
+    	if (eol < end &&
+    	    (*eol == '\n' || eol + 1 < end || lr->eof_flag))
+    	{
+    	    lr->pos = (eol - lr->buf) + 1;
+    	    if (*eol == '\r' && eol + 1 < end && eol[1] == '\n')
+    	    	lr->pos++;
+
+    	    break;
+    	}
+    	
+    	if (lr->eof_flag)
+    	{
+    	    /* no more data */
+    	    if (line == end)
+    	    {
+    	    	lr->line     = NULL;
+    	    	lr->line_len = 0;
+
+    	    	return NULL;
+    	    }
+
+    	    /* last line, without an EOL */
+    	    lr->pos = lr->len;
+
+    	    break;
+    	}
+    	
+    	line_reader_fill(lr);
+    }
+
+    *eol = '\0';
+
+    lr->line     = line;
+    lr->line_len = eol - line;
+
+    if (return_length)
+    	*return_length = lr->line_len;
+    
+    return line;
+}
+
+
+/* return the same line again on the next call to line_reader_next() */
+void line_reader_unget(LINE_READER *lr)
+{
+    lr->unget_flag = 1;
+}
+
+
+/* cancel a pending line_reader_unget(), if any */
+void line_reader_reset_unget(LINE_READER *lr)
+{
+    lr->unget_flag = 0;
+}
+
+
+/* stream offset of the next line line_reader_next() will return */
+/* (just past the last line and its EOL), -1 if it can't be told */
+long line_reader_offset(LINE_READER *lr)
+{
+    if (lr->buf_offset < 0)
+    	return -1;
+
+    if (lr->unget_flag && lr->line)
+    	return lr->buf_offset + (lr->line - lr->buf);
+
+    return lr->buf_offset + (long)lr->pos;
+}
@@ -0,0 +1,45 @@
+#include "utils.h"
+
+/*
+ * 32 bit FNV-1a hashing (Fowler/Noll/Vo).  Each byte is xor'ed into the
+ * hash, which is then multiplied by the FNV prime.  Start from
+ * FNV1A_INIT, or from the result of an earlier call to carry on hashing
+ * more data.
+ *
+ * unsigned long may be wider than 32 bits, so the hash is cut back to 32
+ * bits after every byte; the values are the same on every platform.
+ */
+
+#define FNV1A_PRIME 16777619UL
+#define FNV1A_MASK  0xffffffffUL
+
+/* hash len bytes at buf */
+unsigned long fnv1a_hash(unsigned long h, const void *buf, size_t len)
+{
+  const unsigned char *p = (const unsigned char *)buf;
+
+  for (; len > 0; len--, p++)
+    h = ((h ^ *p) * FNV1A_PRIME) & FNV1A_MASK;
+
+  return (h);
+}
+
+/* hash the characters of s, not including the terminating '\0' */
+unsigned long fnv1a_hash_string(unsigned long h, const char *s)
+{
+  for (; *s != '\0'; s++)
+    h = ((h ^ (unsigned char)*s) * FNV1A_PRIME) & FNV1A_MASK;
+
+  return (h);
+}
+
+/* hash the low 32 bits of w, least significant byte first */
+unsigned long fnv1a_hash_uint32(unsigned long h, unsigned long w)
+{
+  int i;
+
+  for (i = 0; i < 4; i++, w >>= 8)
+    h = ((h ^ (w & 0xff)) * FNV1A_PRIME) & FNV1A_MASK;
+
+  return (h);
+}
@@ -0,0 +1,154 @@
+/*
+ * Microbenchmarks for the selection routines (selection/select.c):
+ * medians, quartiles and full sorts against qsort() with dcompare(),
+ * over the probeset-sized arrays that dominate and a few large ones,
+ * plus the radix index sort (selection/radix_sort.c) used for ranking.
+ * Every result is also checked against the qsort() answer.
+ *
+ *   make select_bench && ./select_bench
+ */
+
+#include <time.h>
+
+#include "utils.h"
+
+/* total values processed per case, so each line takes similar time */
+#define BENCH_VALUES 20000000
+
+/* results are accumulated here so the work can't be optimized away */
+static volatile double sink;
+
+static unsigned long long rng_state = 88172645463325252ULL;
+
+/* xorshift64, so runs are repeatable */
+static double next_random(void)
+{
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+
+  return ((rng_state >> 11) * (1.0 / 9007199254740992.0));
+}
+
+static double seconds(clock_t start)
+{
+  return ((double)(clock() - start) / CLOCKS_PER_SEC);
+}
+
+static double sorted_median(const double *x, int n)
+{
+  return ((n & 1) ? x[n / 2] : 0.5 * (x[n / 2 - 1] + x[n / 2]));
+}
+
+static int bench(int n)
+{
+  double  *data, *work, *check;
+  double   t_qsort, t_median, t_quart, t_sort, t_index;
+  int     *order;
+  int      reps, r, i, k[3], failed = 0;
+  clock_t  start;
+
+  reps  = BENCH_VALUES / n;
+  data  = malloc(n * sizeof(double));
+  work  = malloc(n * sizeof(double));
+  check = malloc(n * sizeof(double));
+  order = malloc(n * sizeof(int));
+  if (data == NULL || work == NULL || check == NULL || order == NULL)
+  {
+    printf("out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* log-scale intensities with some ties, like probe values */
+  for (i = 0; i < n; i++)
+    data[i] = (double)(int)(next_random() * 4096.0) / 256.0;
+
+  memcpy(check, data, n * sizeof(double));
+  qsort(check, n, sizeof(double), dcompare);
+
+  k[0] = n / 4;
+  k[1] = n / 2;
+  k[2] = (3 * n) / 4;
+
+  start = clock();
+  for (r = 0; r < reps; r++)
+  {
+    memcpy(work, data, n * sizeof(double));
+    qsort(work, n, sizeof(double), dcompare);
+    sink += sorted_median(work, n);
+  }
+  t_qsort = seconds(start);
+
+  start = clock();
+  for (r = 0; r < reps; r++)
+  {
+    memcpy(work, data, n * sizeof(double));
+    sink += dmedian(work, n);
+  }
+  t_median = seconds(start);
+  if (dmedian(memcpy(work, data, n * sizeof(double)), n) !=
+      sorted_median(check, n))
+    failed = 1;
+
+  start = clock();
+  for (r = 0; r < reps; r++)
+  {
+    memcpy(work, data, n * sizeof(double));
+    dselect_multi(work, n, k, 3);
+    sink += work[k[2]] - work[k[0]];
+  }
+  t_quart = seconds(start);
+  for (i = 0; i < 3; i++)
+    if (work[k[i]] != check[k[i]])
+      failed = 1;
+
+  start = clock();
+  for (r = 0; r < reps; r++)
+  {
+    memcpy(work, data, n * sizeof(double));
+    dsort(work, n);
+    sink += work[0];
+  }
+  t_sort = seconds(start);
+  if (memcmp(work, check, n * sizeof(double)) != 0)
+    failed = 1;
+
+  start = clock();
+  for (r = 0; r < reps; r++)
+  {
+    dsort_index(data, n, order);
+    sink += data[order[0]];
+  }
+  t_index = seconds(start);
+  for (i = 0; i < n; i++)
+    if (data[order[i]] != check[i] ||
+        (i > 0 && data[order[i]] == data[order[i - 1]] &&
+         order[i] < order[i - 1]))
+      failed = 1;
+
+  printf("%8d %10d %9.3f %9.3f %9.3f %9.3f %9.3f  %s\n",
+         n, reps, t_qsort, t_median, t_quart, t_sort, t_index,
+         failed ? "MISMATCH" : "ok");
+
+  free(data);
+  free(work);
+  free(check);
+  free(order);
+
+  return (failed);
+}
+
+int main(int argc, char **argv)
+{
+  static const int sizes[] = { 3, 4, 8, 11, 16, 20, 25, 32, 64,
+                               1000, 100000, 1000000 };
+  int i, failed = 0;
+
+  printf("%8s %10s %9s %9s %9s %9s %9s\n",
+         "n", "reps", "qsort", "dmedian", "quartiles", "dsort", "index");
+
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    failed |= bench(sizes[i]);
+
+  exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
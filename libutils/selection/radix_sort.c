@@ -0,0 +1,160 @@
+#include "utils.h"
+
+/*
+ * Ranking sort of double arrays, by LSD radix sort.
+ *
+ * dsort_index() sorts the indices of an array rather than the values:
+ * each value is turned into a 64 bit key that orders like the double
+ * (sign bit flipped for positives, all bits flipped for negatives), and
+ * the (key, index) pairs are distributed RADIX_BITS bits at a time, least
+ * significant digit first.  Every pass is stable, so equal values come
+ * out in index order.  All the digit histograms are counted in one pass
+ * up front, and a digit that is the same for every key (typically the
+ * high exponent bits) costs nothing.
+ *
+ * That makes ranking a chip's worth of probes linear time, with no
+ * comparator calls, instead of an O(n log n) qsort().
+ */
+
+#define RADIX_BITS   11
+#define RADIX_SIZE   (1 << RADIX_BITS)
+#define RADIX_MASK   (RADIX_SIZE - 1)
+#define RADIX_PASSES ((64 + RADIX_BITS - 1) / RADIX_BITS)
+
+/* below this many values, an insertion sort is quicker */
+#define RADIX_MIN    64
+
+/*
+ * Sortable key of x: unsigned order of keys is the numeric order of
+ * values.  -0.0 is keyed as 0.0, so the two stay equal as they do for
+ * comparisons; NaNs go to the ends.
+ */
+static unsigned long long double_key(double x)
+{
+  unsigned long long u;
+
+  x += 0.0;
+  memcpy(&u, &x, sizeof(double));
+
+  return ((u >> 63) ? ~u : u | (1ULL << 63));
+}
+
+/* Stable insertion sort of idx[0..n-1] by key[] */
+static void insertion_sort(unsigned long long *key, int *idx, int n)
+{
+  unsigned long long k;
+  int                i, j, t;
+
+  for (i = 1; i < n; i++)
+  {
+    k = key[i];
+    t = idx[i];
+
+    for (j = i; j > 0 && key[j - 1] > k; j--)
+    {
+      key[j] = key[j - 1];
+      idx[j] = idx[j - 1];
+    }
+
+    key[j] = k;
+    idx[j] = t;
+  }
+}
+
+/*
+ * dsort_index(): order[0..n-1] = the indices of x[0..n-1] in ascending
+ * order of their values, equal values in index order.  x is not
+ * modified.  Returns 0, or -1 if out of memory.
+ */
+int dsort_index(const double *x, int n, int *order)
+{
+  unsigned long long *key, *key_tmp, *src_key, *dst_key, *p_key;
+  int                *idx_tmp, *src_idx, *dst_idx, *p_idx;
+  int                *count, *c;
+  char               *block;
+  int                 i, pass, shift, sum, tmp;
+
+  assert(x != NULL || n == 0);
+  assert(order != NULL || n == 0);
+
+  if (n <= 0)
+    return (0);
+
+  block = malloc(2 * (size_t)n * sizeof(unsigned long long)
+                 + (size_t)n * sizeof(int)
+                 + RADIX_PASSES * RADIX_SIZE * sizeof(int));
+  if (block == NULL)
+    return (-1);
+
+  key     = (unsigned long long *)block;
+  key_tmp = key + n;
+  idx_tmp = (int *)(key_tmp + n);
+  count   = idx_tmp + n;
+
+  for (i = 0; i < n; i++)
+  {
+    key[i]   = double_key(x[i]);
+    order[i] = i;
+  }
+
+  if (n <= RADIX_MIN)
+  {
+    insertion_sort(key, order, n);
+    free(block);
+
+    return (0);
+  }
+
+  /* every digit's histogram, in one pass over the keys */
+  memset(count, 0, RADIX_PASSES * RADIX_SIZE * sizeof(int));
+  for (i = 0; i < n; i++)
+    for (pass = 0; pass < RADIX_PASSES; pass++)
+      count[pass * RADIX_SIZE
+            + ((key[i] >> (pass * RADIX_BITS)) & RADIX_MASK)]++;
+
+  src_key = key;
+  src_idx = order;
+  dst_key = key_tmp;
+  dst_idx = idx_tmp;
+
+  for (pass = 0; pass < RADIX_PASSES; pass++)
+  {
+    shift = pass * RADIX_BITS;
+    c     = count + pass * RADIX_SIZE;
+
+    /* all keys share this digit, nothing to move */
+    if (c[(src_key[0] >> shift) & RADIX_MASK] == n)
+      continue;
+
+    /* counts --> starting positions */
+    for (i = 0, sum = 0; i < RADIX_SIZE; i++)
+    {
+      tmp  = c[i];
+      c[i] = sum;
+      sum += tmp;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+      int pos = c[(src_key[i] >> shift) & RADIX_MASK]++;
+
+      dst_key[pos] = src_key[i];
+      dst_idx[pos] = src_idx[i];
+    }
+
+    p_key   = src_key;
+    src_key = dst_key;
+    dst_key = p_key;
+
+    p_idx   = src_idx;
+    src_idx = dst_idx;
+    dst_idx = p_idx;
+  }
+
+  if (src_idx != order)
+    memcpy(order, src_idx, n * sizeof(int));
+
+  free(block);
+
+  return (0);
+}
@@ -0,0 +1,291 @@
+#include "utils.h"
+
+/*
+ * Order statistics of double arrays without sorting them.
+ *
+ * dselect() and friends find the k-th smallest value(s) by quickselect,
+ * partitioning around a median of three, and finish short ranges with a
+ * sorting network.  A range that keeps partitioning badly falls back to
+ * heapsort after about 2*log2(n) rounds (introselect), so the worst case
+ * stays O(n log n).  The arrays are reordered in place.
+ *
+ * The values found are the ones a full sort would put in the same
+ * positions, so dmedian() gives exactly the sorted-middle median.
+ *
+ * Ranges of up to SELECT_NETWORK_MAX values (which covers nearly every
+ * probeset) are sorted with Batcher's odd-even merge network, from the
+ * tables in select_networks.h.  Which pairs are compared depends only on
+ * n, never on the data, and each compare-exchange is branch free, so
+ * there are no mispredicted branches to pay for.
+ */
+
+#define SELECT_NETWORK_MAX 32
+
+#include "select_networks.h"
+
+/*
+ * compare-exchange, leaves the smaller value in a.  The min is a single
+ * minsd-style select; the max is whichever of a, b the min wasn't, by
+ * bits, so equal but distinct values (-0.0/0.0, NaNs) are never lost.
+ */
+#define CSWAP(a, b)                                     \
+  {                                                     \
+    double             a_ = (a), b_ = (b), lo_, hi_;    \
+    unsigned long long ua_, ub_, ulo_;                  \
+                                                        \
+    lo_ = (a_ < b_) ? a_ : b_;                          \
+    memcpy(&ua_,  &a_,  sizeof(double));                \
+    memcpy(&ub_,  &b_,  sizeof(double));                \
+    memcpy(&ulo_, &lo_, sizeof(double));                \
+    ua_ ^= ub_ ^ ulo_;                                  \
+    memcpy(&hi_,  &ua_, sizeof(double));                \
+    (a) = lo_;                                          \
+    (b) = hi_;                                          \
+  }
+
+/* Sort x[0..n-1] (n <= SELECT_NETWORK_MAX) with a sorting network */
+static void sort_network(double *x, int n)
+{
+  const unsigned char *p   = network_pairs + 2 * network_start[n];
+  const unsigned char *end = network_pairs + 2 * network_start[n + 1];
+
+  assert(n <= SELECT_NETWORK_MAX);
+
+  for (; p < end; p += 2)
+    CSWAP(x[p[0]], x[p[1]]);
+}
+
+static void sift_down(double *x, int root, int n)
+{
+  int    child;
+  double tmp;
+
+  while ((child = 2 * root + 1) < n)
+  {
+    if (child + 1 < n && x[child] < x[child + 1])
+      child++;
+    if (!(x[root] < x[child]))
+      return;
+
+    tmp      = x[root];
+    x[root]  = x[child];
+    x[child] = tmp;
+    root     = child;
+  }
+}
+
+/* Fallback for badly partitioning ranges */
+static void heap_sort(double *x, int n)
+{
+  int    i;
+  double tmp;
+
+  for (i = n / 2 - 1; i >= 0; i--)
+    sift_down(x, i, n);
+
+  for (i = n - 1; i > 0; i--)
+  {
+    tmp  = x[0];
+    x[0] = x[i];
+    x[i] = tmp;
+    sift_down(x, 0, i);
+  }
+}
+
+/*
+ * Hoare partition of x[lo..hi] around a median of three.  On return
+ * x[lo..*j] <= pivot <= x[*i..hi], and anything in between equals the
+ * pivot (so is already in its sorted position).
+ */
+static void partition(double *x, int lo, int hi, int *i_ptr, int *j_ptr)
+{
+  int    i, j, mid = lo + ((hi - lo) >> 1);
+  double pivot, tmp;
+
+  CSWAP(x[lo], x[mid]);
+  CSWAP(x[lo], x[hi]);
+  CSWAP(x[mid], x[hi]);
+  pivot = x[mid];
+
+  i = lo;
+  j = hi;
+  while (i <= j)
+  {
+    while (x[i] < pivot)
+      i++;
+    while (pivot < x[j])
+      j--;
+    if (i <= j)
+    {
+      tmp  = x[i];
+      x[i] = x[j];
+      x[j] = tmp;
+      i++;
+      j--;
+    }
+  }
+
+  *i_ptr = i;
+  *j_ptr = j;
+}
+
+/* 2 * floor(log2(n)), the partitioning rounds allowed before heapsort */
+static int depth_limit(int n)
+{
+  int depth = 0;
+
+  for (; n > 1; n >>= 1)
+    depth += 2;
+
+  return (depth);
+}
+
+/*
+ * Place the sorted-order values for positions k[0..nk-1] (ascending) of
+ * x[lo..hi] at those positions.
+ */
+static void select_multi(double *x, int lo, int hi, const int *k, int nk,
+                         int depth)
+{
+  int i, j, left, right;
+
+  while (nk > 0 && hi - lo + 1 > SELECT_NETWORK_MAX)
+  {
+    if (depth-- == 0)
+    {
+      heap_sort(x + lo, hi - lo + 1);
+      return;
+    }
+
+    partition(x, lo, hi, &i, &j);
+
+    /* positions left of j, right of i; those between are placed */
+    for (left = 0; left < nk && k[left] <= j; left++)
+      ;
+    for (right = left; right < nk && k[right] < i; right++)
+      ;
+
+    /* recurse into the smaller side, loop on the other */
+    if (left < nk - right)
+    {
+      select_multi(x, lo, j, k, left, depth);
+      lo  = i;
+      k  += right;
+      nk -= right;
+    }
+    else
+    {
+      select_multi(x, i, hi, k + right, nk - right, depth);
+      hi = j;
+      nk = left;
+    }
+  }
+
+  if (nk > 0 && hi > lo)
+    sort_network(x + lo, hi - lo + 1);
+}
+
+/*
+ * dselect(): the k-th smallest (from 0) of x[0..n-1].  Reorders x so
+ * that x[k] holds it, with nothing larger before it and nothing smaller
+ * after it.
+ */
+double dselect(double *x, int n, int k)
+{
+  assert(x != NULL);
+  assert(k >= 0 && k < n);
+
+  select_multi(x, 0, n - 1, &k, 1, depth_limit(n));
+
+  return (x[k]);
+}
+
+/*
+ * dselect_multi(): several order statistics in one pass.  k[0..nk-1]
+ * must be ascending (repeats are fine); afterwards each x[k[i]] holds
+ * the value a full sort would put there.
+ */
+void dselect_multi(double *x, int n, const int *k, int nk)
+{
+  int i;
+
+  assert(x != NULL);
+  assert(k != NULL || nk == 0);
+
+  for (i = 0; i < nk; i++)
+  {
+    assert(k[i] >= 0 && k[i] < n);
+    assert(i == 0 || k[i - 1] <= k[i]);
+  }
+
+  select_multi(x, 0, n - 1, k, nk, depth_limit(n));
+}
+
+/*
+ * dmedian(): median of x[0..n-1], the middle value or the mean of the
+ * two middle values.  Reorders x.
+ */
+double dmedian(double *x, int n)
+{
+  int    i, half = n >> 1;
+  double below;
+
+  assert(x != NULL);
+  assert(n >  0);
+
+  dselect(x, n, half);
+
+  if (n & 1)
+    return (x[half]);
+
+  /* the lower middle is the largest of everything before half */
+  below = x[0];
+  for (i = 1; i < half; i++)
+    if (x[i] > below)
+      below = x[i];
+
+  return (0.5 * (below + x[half]));
+}
+
+static void sort_range(double *x, int lo, int hi, int depth)
+{
+  int i, j;
+
+  while (hi - lo + 1 > SELECT_NETWORK_MAX)
+  {
+    if (depth-- == 0)
+    {
+      heap_sort(x + lo, hi - lo + 1);
+      return;
+    }
+
+    partition(x, lo, hi, &i, &j);
+
+    /* recurse into the smaller side, loop on the larger */
+    if (j - lo < hi - i)
+    {
+      sort_range(x, lo, j, depth);
+      lo = i;
+    }
+    else
+    {
+      sort_range(x, i, hi, depth);
+      hi = j;
+    }
+  }
+
+  if (hi > lo)
+    sort_network(x + lo, hi - lo + 1);
+}
+
+/*
+ * dsort(): sort x[0..n-1] ascending, same order as qsort() with
+ * dcompare() but without the comparator calls.
+ */
+void dsort(double *x, int n)
+{
+  assert(x != NULL || n == 0);
+
+  if (n > 1)
+    sort_range(x, 0, n - 1, depth_limit(n));
+}
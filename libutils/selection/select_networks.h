@@ -0,0 +1,288 @@
+/*
+ * Comparator tables for select.c: Batcher's odd-even merge sorting
+ * network for each n from 2 to SELECT_NETWORK_MAX (32), as pairs of
+ * positions to compare-exchange in order.  The pairs for n are
+ * network_pairs[2 * network_start[n]] up to [2 * network_start[n + 1]].
+ *
+ * Generated from the usual loop (p, k, j, i), which is too slow to
+ * run per sort:
+ *
+ *   for (p = 1; p < n; p *= 2)
+ *     for (k = p; k >= 1; k /= 2)
+ *       for (j = k % p; j + k < n; j += 2 * k)
+ *         for (i = 0; i < k && i + j + k < n; i++)
+ *           if ((i + j) / (2 * p) == (i + j + k) / (2 * p))
+ *             pair (i + j, i + j + k)
+ */
+
+static const unsigned short network_start[SELECT_NETWORK_MAX + 2] =
+{
+  0, 0, 0, 1, 4, 9, 18, 30, 46, 65, 93, 125, 163, 205, 253, 306, 365, 428,
+  513, 603, 701, 804, 916, 1035, 1162, 1294, 1434, 1581, 1737, 1899, 2070,
+  2248, 2434, 2625
+};
+
+static const unsigned char network_pairs[] =
+{
+  /* n = 2 */
+  0,1,
+  /* n = 3 */
+  0,1, 0,2, 1,2,
+  /* n = 4 */
+  0,1, 2,3, 0,2, 1,3, 1,2,
+  /* n = 5 */
+  0,1, 2,3, 0,2, 1,3, 1,2, 0,4, 2,4, 1,2, 3,4,
+  /* n = 6 */
+  0,1, 2,3, 4,5, 0,2, 1,3, 1,2, 0,4, 1,5, 2,4, 3,5, 1,2, 3,4,
+  /* n = 7 */
+  0,1, 2,3, 4,5, 0,2, 1,3, 4,6, 1,2, 5,6, 0,4, 1,5, 2,6, 2,4, 3,5, 1,2, 3,4,
+  5,6,
+  /* n = 8 */
+  0,1, 2,3, 4,5, 6,7, 0,2, 1,3, 4,6, 5,7, 1,2, 5,6, 0,4, 1,5, 2,6, 3,7, 2,4,
+  3,5, 1,2, 3,4, 5,6,
+  /* n = 9 */
+  0,1, 2,3, 4,5, 6,7, 0,2, 1,3, 4,6, 5,7, 1,2, 5,6, 0,4, 1,5, 2,6, 3,7, 2,4,
+  3,5, 1,2, 3,4, 5,6, 0,8, 4,8, 2,4, 3,5, 6,8, 1,2, 3,4, 5,6, 7,8,
+  /* n = 10 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 0,2, 1,3, 4,6, 5,7, 1,2, 5,6, 0,4, 1,5, 2,6, 3,7,
+  2,4, 3,5, 1,2, 3,4, 5,6, 0,8, 1,9, 4,8, 5,9, 2,4, 3,5, 6,8, 7,9, 1,2, 3,4,
+  5,6, 7,8,
+  /* n = 11 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 0,2, 1,3, 4,6, 5,7, 8,10, 1,2, 5,6, 9,10, 0,4,
+  1,5, 2,6, 3,7, 2,4, 3,5, 1,2, 3,4, 5,6, 9,10, 0,8, 1,9, 2,10, 4,8, 5,9,
+  6,10, 2,4, 3,5, 6,8, 7,9, 1,2, 3,4, 5,6, 7,8, 9,10,
+  /* n = 12 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 0,2, 1,3, 4,6, 5,7, 8,10, 9,11, 1,2, 5,6,
+  9,10, 0,4, 1,5, 2,6, 3,7, 2,4, 3,5, 1,2, 3,4, 5,6, 9,10, 0,8, 1,9, 2,10,
+  3,11, 4,8, 5,9, 6,10, 7,11, 2,4, 3,5, 6,8, 7,9, 1,2, 3,4, 5,6, 7,8, 9,10,
+  /* n = 13 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 0,2, 1,3, 4,6, 5,7, 8,10, 9,11, 1,2, 5,6,
+  9,10, 0,4, 1,5, 2,6, 3,7, 8,12, 2,4, 3,5, 10,12, 1,2, 3,4, 5,6, 9,10,
+  11,12, 0,8, 1,9, 2,10, 3,11, 4,12, 4,8, 5,9, 6,10, 7,11, 2,4, 3,5, 6,8,
+  7,9, 10,12, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12,
+  /* n = 14 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 0,2, 1,3, 4,6, 5,7, 8,10, 9,11, 1,2,
+  5,6, 9,10, 0,4, 1,5, 2,6, 3,7, 8,12, 9,13, 2,4, 3,5, 10,12, 11,13, 1,2,
+  3,4, 5,6, 9,10, 11,12, 0,8, 1,9, 2,10, 3,11, 4,12, 5,13, 4,8, 5,9, 6,10,
+  7,11, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12,
+  /* n = 15 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 0,2, 1,3, 4,6, 5,7, 8,10, 9,11,
+  12,14, 1,2, 5,6, 9,10, 13,14, 0,4, 1,5, 2,6, 3,7, 8,12, 9,13, 10,14, 2,4,
+  3,5, 10,12, 11,13, 1,2, 3,4, 5,6, 9,10, 11,12, 13,14, 0,8, 1,9, 2,10, 3,11,
+  4,12, 5,13, 6,14, 4,8, 5,9, 6,10, 7,11, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13,
+  1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14,
+  /* n = 16 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 0,2, 1,3, 4,6, 5,7, 8,10,
+  9,11, 12,14, 13,15, 1,2, 5,6, 9,10, 13,14, 0,4, 1,5, 2,6, 3,7, 8,12, 9,13,
+  10,14, 11,15, 2,4, 3,5, 10,12, 11,13, 1,2, 3,4, 5,6, 9,10, 11,12, 13,14,
+  0,8, 1,9, 2,10, 3,11, 4,12, 5,13, 6,14, 7,15, 4,8, 5,9, 6,10, 7,11, 2,4,
+  3,5, 6,8, 7,9, 10,12, 11,13, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14,
+  /* n = 17 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 0,2, 1,3, 4,6, 5,7, 8,10,
+  9,11, 12,14, 13,15, 1,2, 5,6, 9,10, 13,14, 0,4, 1,5, 2,6, 3,7, 8,12, 9,13,
+  10,14, 11,15, 2,4, 3,5, 10,12, 11,13, 1,2, 3,4, 5,6, 9,10, 11,12, 13,14,
+  0,8, 1,9, 2,10, 3,11, 4,12, 5,13, 6,14, 7,15, 4,8, 5,9, 6,10, 7,11, 2,4,
+  3,5, 6,8, 7,9, 10,12, 11,13, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 0,16,
+  8,16, 4,8, 5,9, 6,10, 7,11, 12,16, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 14,16,
+  1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 15,16,
+  /* n = 18 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 16,17, 0,2, 1,3, 4,6, 5,7,
+  8,10, 9,11, 12,14, 13,15, 1,2, 5,6, 9,10, 13,14, 0,4, 1,5, 2,6, 3,7, 8,12,
+  9,13, 10,14, 11,15, 2,4, 3,5, 10,12, 11,13, 1,2, 3,4, 5,6, 9,10, 11,12,
+  13,14, 0,8, 1,9, 2,10, 3,11, 4,12, 5,13, 6,14, 7,15, 4,8, 5,9, 6,10, 7,11,
+  2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14,
+  0,16, 1,17, 8,16, 9,17, 4,8, 5,9, 6,10, 7,11, 12,16, 13,17, 2,4, 3,5, 6,8,
+  7,9, 10,12, 11,13, 14,16, 15,17, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14,
+  15,16,
+  /* n = 19 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 16,17, 0,2, 1,3, 4,6, 5,7,
+  8,10, 9,11, 12,14, 13,15, 16,18, 1,2, 5,6, 9,10, 13,14, 17,18, 0,4, 1,5,
+  2,6, 3,7, 8,12, 9,13, 10,14, 11,15, 2,4, 3,5, 10,12, 11,13, 1,2, 3,4, 5,6,
+  9,10, 11,12, 13,14, 17,18, 0,8, 1,9, 2,10, 3,11, 4,12, 5,13, 6,14, 7,15,
+  4,8, 5,9, 6,10, 7,11, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 1,2, 3,4, 5,6, 7,8,
+  9,10, 11,12, 13,14, 17,18, 0,16, 1,17, 2,18, 8,16, 9,17, 10,18, 4,8, 5,9,
+  6,10, 7,11, 12,16, 13,17, 14,18, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 14,16,
+  15,17, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 15,16, 17,18,
+  /* n = 20 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 16,17, 18,19, 0,2, 1,3, 4,6,
+  5,7, 8,10, 9,11, 12,14, 13,15, 16,18, 17,19, 1,2, 5,6, 9,10, 13,14, 17,18,
+  0,4, 1,5, 2,6, 3,7, 8,12, 9,13, 10,14, 11,15, 2,4, 3,5, 10,12, 11,13, 1,2,
+  3,4, 5,6, 9,10, 11,12, 13,14, 17,18, 0,8, 1,9, 2,10, 3,11, 4,12, 5,13,
+  6,14, 7,15, 4,8, 5,9, 6,10, 7,11, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 1,2,
+  3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 17,18, 0,16, 1,17, 2,18, 3,19, 8,16,
+  9,17, 10,18, 11,19, 4,8, 5,9, 6,10, 7,11, 12,16, 13,17, 14,18, 15,19, 2,4,
+  3,5, 6,8, 7,9, 10,12, 11,13, 14,16, 15,17, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12,
+  13,14, 15,16, 17,18,
+  /* n = 21 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 16,17, 18,19, 0,2, 1,3, 4,6,
+  5,7, 8,10, 9,11, 12,14, 13,15, 16,18, 17,19, 1,2, 5,6, 9,10, 13,14, 17,18,
+  0,4, 1,5, 2,6, 3,7, 8,12, 9,13, 10,14, 11,15, 16,20, 2,4, 3,5, 10,12,
+  11,13, 18,20, 1,2, 3,4, 5,6, 9,10, 11,12, 13,14, 17,18, 19,20, 0,8, 1,9,
+  2,10, 3,11, 4,12, 5,13, 6,14, 7,15, 4,8, 5,9, 6,10, 7,11, 2,4, 3,5, 6,8,
+  7,9, 10,12, 11,13, 18,20, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 17,18,
+  19,20, 0,16, 1,17, 2,18, 3,19, 4,20, 8,16, 9,17, 10,18, 11,19, 12,20, 4,8,
+  5,9, 6,10, 7,11, 12,16, 13,17, 14,18, 15,19, 2,4, 3,5, 6,8, 7,9, 10,12,
+  11,13, 14,16, 15,17, 18,20, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 15,16,
+  17,18, 19,20,
+  /* n = 22 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 16,17, 18,19, 20,21, 0,2,
+  1,3, 4,6, 5,7, 8,10, 9,11, 12,14, 13,15, 16,18, 17,19, 1,2, 5,6, 9,10,
+  13,14, 17,18, 0,4, 1,5, 2,6, 3,7, 8,12, 9,13, 10,14, 11,15, 16,20, 17,21,
+  2,4, 3,5, 10,12, 11,13, 18,20, 19,21, 1,2, 3,4, 5,6, 9,10, 11,12, 13,14,
+  17,18, 19,20, 0,8, 1,9, 2,10, 3,11, 4,12, 5,13, 6,14, 7,15, 4,8, 5,9, 6,10,
+  7,11, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 18,20, 19,21, 1,2, 3,4, 5,6, 7,8,
+  9,10, 11,12, 13,14, 17,18, 19,20, 0,16, 1,17, 2,18, 3,19, 4,20, 5,21, 8,16,
+  9,17, 10,18, 11,19, 12,20, 13,21, 4,8, 5,9, 6,10, 7,11, 12,16, 13,17,
+  14,18, 15,19, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 14,16, 15,17, 18,20, 19,21,
+  1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 15,16, 17,18, 19,20,
+  /* n = 23 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 16,17, 18,19, 20,21, 0,2,
+  1,3, 4,6, 5,7, 8,10, 9,11, 12,14, 13,15, 16,18, 17,19, 20,22, 1,2, 5,6,
+  9,10, 13,14, 17,18, 21,22, 0,4, 1,5, 2,6, 3,7, 8,12, 9,13, 10,14, 11,15,
+  16,20, 17,21, 18,22, 2,4, 3,5, 10,12, 11,13, 18,20, 19,21, 1,2, 3,4, 5,6,
+  9,10, 11,12, 13,14, 17,18, 19,20, 21,22, 0,8, 1,9, 2,10, 3,11, 4,12, 5,13,
+  6,14, 7,15, 4,8, 5,9, 6,10, 7,11, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 18,20,
+  19,21, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 17,18, 19,20, 21,22, 0,16,
+  1,17, 2,18, 3,19, 4,20, 5,21, 6,22, 8,16, 9,17, 10,18, 11,19, 12,20, 13,21,
+  14,22, 4,8, 5,9, 6,10, 7,11, 12,16, 13,17, 14,18, 15,19, 2,4, 3,5, 6,8,
+  7,9, 10,12, 11,13, 14,16, 15,17, 18,20, 19,21, 1,2, 3,4, 5,6, 7,8, 9,10,
+  11,12, 13,14, 15,16, 17,18, 19,20, 21,22,
+  /* n = 24 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 16,17, 18,19, 20,21, 22,23,
+  0,2, 1,3, 4,6, 5,7, 8,10, 9,11, 12,14, 13,15, 16,18, 17,19, 20,22, 21,23,
+  1,2, 5,6, 9,10, 13,14, 17,18, 21,22, 0,4, 1,5, 2,6, 3,7, 8,12, 9,13, 10,14,
+  11,15, 16,20, 17,21, 18,22, 19,23, 2,4, 3,5, 10,12, 11,13, 18,20, 19,21,
+  1,2, 3,4, 5,6, 9,10, 11,12, 13,14, 17,18, 19,20, 21,22, 0,8, 1,9, 2,10,
+  3,11, 4,12, 5,13, 6,14, 7,15, 4,8, 5,9, 6,10, 7,11, 2,4, 3,5, 6,8, 7,9,
+  10,12, 11,13, 18,20, 19,21, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 17,18,
+  19,20, 21,22, 0,16, 1,17, 2,18, 3,19, 4,20, 5,21, 6,22, 7,23, 8,16, 9,17,
+  10,18, 11,19, 12,20, 13,21, 14,22, 15,23, 4,8, 5,9, 6,10, 7,11, 12,16,
+  13,17, 14,18, 15,19, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 14,16, 15,17, 18,20,
+  19,21, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 15,16, 17,18, 19,20, 21,22,
+  /* n = 25 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 16,17, 18,19, 20,21, 22,23,
+  0,2, 1,3, 4,6, 5,7, 8,10, 9,11, 12,14, 13,15, 16,18, 17,19, 20,22, 21,23,
+  1,2, 5,6, 9,10, 13,14, 17,18, 21,22, 0,4, 1,5, 2,6, 3,7, 8,12, 9,13, 10,14,
+  11,15, 16,20, 17,21, 18,22, 19,23, 2,4, 3,5, 10,12, 11,13, 18,20, 19,21,
+  1,2, 3,4, 5,6, 9,10, 11,12, 13,14, 17,18, 19,20, 21,22, 0,8, 1,9, 2,10,
+  3,11, 4,12, 5,13, 6,14, 7,15, 16,24, 4,8, 5,9, 6,10, 7,11, 20,24, 2,4, 3,5,
+  6,8, 7,9, 10,12, 11,13, 18,20, 19,21, 22,24, 1,2, 3,4, 5,6, 7,8, 9,10,
+  11,12, 13,14, 17,18, 19,20, 21,22, 23,24, 0,16, 1,17, 2,18, 3,19, 4,20,
+  5,21, 6,22, 7,23, 8,24, 8,16, 9,17, 10,18, 11,19, 12,20, 13,21, 14,22,
+  15,23, 4,8, 5,9, 6,10, 7,11, 12,16, 13,17, 14,18, 15,19, 20,24, 2,4, 3,5,
+  6,8, 7,9, 10,12, 11,13, 14,16, 15,17, 18,20, 19,21, 22,24, 1,2, 3,4, 5,6,
+  7,8, 9,10, 11,12, 13,14, 15,16, 17,18, 19,20, 21,22, 23,24,
+  /* n = 26 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 16,17, 18,19, 20,21, 22,23,
+  24,25, 0,2, 1,3, 4,6, 5,7, 8,10, 9,11, 12,14, 13,15, 16,18, 17,19, 20,22,
+  21,23, 1,2, 5,6, 9,10, 13,14, 17,18, 21,22, 0,4, 1,5, 2,6, 3,7, 8,12, 9,13,
+  10,14, 11,15, 16,20, 17,21, 18,22, 19,23, 2,4, 3,5, 10,12, 11,13, 18,20,
+  19,21, 1,2, 3,4, 5,6, 9,10, 11,12, 13,14, 17,18, 19,20, 21,22, 0,8, 1,9,
+  2,10, 3,11, 4,12, 5,13, 6,14, 7,15, 16,24, 17,25, 4,8, 5,9, 6,10, 7,11,
+  20,24, 21,25, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 18,20, 19,21, 22,24, 23,25,
+  1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 17,18, 19,20, 21,22, 23,24, 0,16,
+  1,17, 2,18, 3,19, 4,20, 5,21, 6,22, 7,23, 8,24, 9,25, 8,16, 9,17, 10,18,
+  11,19, 12,20, 13,21, 14,22, 15,23, 4,8, 5,9, 6,10, 7,11, 12,16, 13,17,
+  14,18, 15,19, 20,24, 21,25, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 14,16, 15,17,
+  18,20, 19,21, 22,24, 23,25, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 15,16,
+  17,18, 19,20, 21,22, 23,24,
+  /* n = 27 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 16,17, 18,19, 20,21, 22,23,
+  24,25, 0,2, 1,3, 4,6, 5,7, 8,10, 9,11, 12,14, 13,15, 16,18, 17,19, 20,22,
+  21,23, 24,26, 1,2, 5,6, 9,10, 13,14, 17,18, 21,22, 25,26, 0,4, 1,5, 2,6,
+  3,7, 8,12, 9,13, 10,14, 11,15, 16,20, 17,21, 18,22, 19,23, 2,4, 3,5, 10,12,
+  11,13, 18,20, 19,21, 1,2, 3,4, 5,6, 9,10, 11,12, 13,14, 17,18, 19,20,
+  21,22, 25,26, 0,8, 1,9, 2,10, 3,11, 4,12, 5,13, 6,14, 7,15, 16,24, 17,25,
+  18,26, 4,8, 5,9, 6,10, 7,11, 20,24, 21,25, 22,26, 2,4, 3,5, 6,8, 7,9,
+  10,12, 11,13, 18,20, 19,21, 22,24, 23,25, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12,
+  13,14, 17,18, 19,20, 21,22, 23,24, 25,26, 0,16, 1,17, 2,18, 3,19, 4,20,
+  5,21, 6,22, 7,23, 8,24, 9,25, 10,26, 8,16, 9,17, 10,18, 11,19, 12,20,
+  13,21, 14,22, 15,23, 4,8, 5,9, 6,10, 7,11, 12,16, 13,17, 14,18, 15,19,
+  20,24, 21,25, 22,26, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 14,16, 15,17, 18,20,
+  19,21, 22,24, 23,25, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 15,16, 17,18,
+  19,20, 21,22, 23,24, 25,26,
+  /* n = 28 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 16,17, 18,19, 20,21, 22,23,
+  24,25, 26,27, 0,2, 1,3, 4,6, 5,7, 8,10, 9,11, 12,14, 13,15, 16,18, 17,19,
+  20,22, 21,23, 24,26, 25,27, 1,2, 5,6, 9,10, 13,14, 17,18, 21,22, 25,26,
+  0,4, 1,5, 2,6, 3,7, 8,12, 9,13, 10,14, 11,15, 16,20, 17,21, 18,22, 19,23,
+  2,4, 3,5, 10,12, 11,13, 18,20, 19,21, 1,2, 3,4, 5,6, 9,10, 11,12, 13,14,
+  17,18, 19,20, 21,22, 25,26, 0,8, 1,9, 2,10, 3,11, 4,12, 5,13, 6,14, 7,15,
+  16,24, 17,25, 18,26, 19,27, 4,8, 5,9, 6,10, 7,11, 20,24, 21,25, 22,26,
+  23,27, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 18,20, 19,21, 22,24, 23,25, 1,2,
+  3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 17,18, 19,20, 21,22, 23,24, 25,26, 0,16,
+  1,17, 2,18, 3,19, 4,20, 5,21, 6,22, 7,23, 8,24, 9,25, 10,26, 11,27, 8,16,
+  9,17, 10,18, 11,19, 12,20, 13,21, 14,22, 15,23, 4,8, 5,9, 6,10, 7,11,
+  12,16, 13,17, 14,18, 15,19, 20,24, 21,25, 22,26, 23,27, 2,4, 3,5, 6,8, 7,9,
+  10,12, 11,13, 14,16, 15,17, 18,20, 19,21, 22,24, 23,25, 1,2, 3,4, 5,6, 7,8,
+  9,10, 11,12, 13,14, 15,16, 17,18, 19,20, 21,22, 23,24, 25,26,
+  /* n = 29 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 16,17, 18,19, 20,21, 22,23,
+  24,25, 26,27, 0,2, 1,3, 4,6, 5,7, 8,10, 9,11, 12,14, 13,15, 16,18, 17,19,
+  20,22, 21,23, 24,26, 25,27, 1,2, 5,6, 9,10, 13,14, 17,18, 21,22, 25,26,
+  0,4, 1,5, 2,6, 3,7, 8,12, 9,13, 10,14, 11,15, 16,20, 17,21, 18,22, 19,23,
+  24,28, 2,4, 3,5, 10,12, 11,13, 18,20, 19,21, 26,28, 1,2, 3,4, 5,6, 9,10,
+  11,12, 13,14, 17,18, 19,20, 21,22, 25,26, 27,28, 0,8, 1,9, 2,10, 3,11,
+  4,12, 5,13, 6,14, 7,15, 16,24, 17,25, 18,26, 19,27, 20,28, 4,8, 5,9, 6,10,
+  7,11, 20,24, 21,25, 22,26, 23,27, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 18,20,
+  19,21, 22,24, 23,25, 26,28, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 17,18,
+  19,20, 21,22, 23,24, 25,26, 27,28, 0,16, 1,17, 2,18, 3,19, 4,20, 5,21,
+  6,22, 7,23, 8,24, 9,25, 10,26, 11,27, 12,28, 8,16, 9,17, 10,18, 11,19,
+  12,20, 13,21, 14,22, 15,23, 4,8, 5,9, 6,10, 7,11, 12,16, 13,17, 14,18,
+  15,19, 20,24, 21,25, 22,26, 23,27, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 14,16,
+  15,17, 18,20, 19,21, 22,24, 23,25, 26,28, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12,
+  13,14, 15,16, 17,18, 19,20, 21,22, 23,24, 25,26, 27,28,
+  /* n = 30 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 16,17, 18,19, 20,21, 22,23,
+  24,25, 26,27, 28,29, 0,2, 1,3, 4,6, 5,7, 8,10, 9,11, 12,14, 13,15, 16,18,
+  17,19, 20,22, 21,23, 24,26, 25,27, 1,2, 5,6, 9,10, 13,14, 17,18, 21,22,
+  25,26, 0,4, 1,5, 2,6, 3,7, 8,12, 9,13, 10,14, 11,15, 16,20, 17,21, 18,22,
+  19,23, 24,28, 25,29, 2,4, 3,5, 10,12, 11,13, 18,20, 19,21, 26,28, 27,29,
+  1,2, 3,4, 5,6, 9,10, 11,12, 13,14, 17,18, 19,20, 21,22, 25,26, 27,28, 0,8,
+  1,9, 2,10, 3,11, 4,12, 5,13, 6,14, 7,15, 16,24, 17,25, 18,26, 19,27, 20,28,
+  21,29, 4,8, 5,9, 6,10, 7,11, 20,24, 21,25, 22,26, 23,27, 2,4, 3,5, 6,8,
+  7,9, 10,12, 11,13, 18,20, 19,21, 22,24, 23,25, 26,28, 27,29, 1,2, 3,4, 5,6,
+  7,8, 9,10, 11,12, 13,14, 17,18, 19,20, 21,22, 23,24, 25,26, 27,28, 0,16,
+  1,17, 2,18, 3,19, 4,20, 5,21, 6,22, 7,23, 8,24, 9,25, 10,26, 11,27, 12,28,
+  13,29, 8,16, 9,17, 10,18, 11,19, 12,20, 13,21, 14,22, 15,23, 4,8, 5,9,
+  6,10, 7,11, 12,16, 13,17, 14,18, 15,19, 20,24, 21,25, 22,26, 23,27, 2,4,
+  3,5, 6,8, 7,9, 10,12, 11,13, 14,16, 15,17, 18,20, 19,21, 22,24, 23,25,
+  26,28, 27,29, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 15,16, 17,18, 19,20,
+  21,22, 23,24, 25,26, 27,28,
+  /* n = 31 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 16,17, 18,19, 20,21, 22,23,
+  24,25, 26,27, 28,29, 0,2, 1,3, 4,6, 5,7, 8,10, 9,11, 12,14, 13,15, 16,18,
+  17,19, 20,22, 21,23, 24,26, 25,27, 28,30, 1,2, 5,6, 9,10, 13,14, 17,18,
+  21,22, 25,26, 29,30, 0,4, 1,5, 2,6, 3,7, 8,12, 9,13, 10,14, 11,15, 16,20,
+  17,21, 18,22, 19,23, 24,28, 25,29, 26,30, 2,4, 3,5, 10,12, 11,13, 18,20,
+  19,21, 26,28, 27,29, 1,2, 3,4, 5,6, 9,10, 11,12, 13,14, 17,18, 19,20,
+  21,22, 25,26, 27,28, 29,30, 0,8, 1,9, 2,10, 3,11, 4,12, 5,13, 6,14, 7,15,
+  16,24, 17,25, 18,26, 19,27, 20,28, 21,29, 22,30, 4,8, 5,9, 6,10, 7,11,
+  20,24, 21,25, 22,26, 23,27, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 18,20, 19,21,
+  22,24, 23,25, 26,28, 27,29, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 17,18,
+  19,20, 21,22, 23,24, 25,26, 27,28, 29,30, 0,16, 1,17, 2,18, 3,19, 4,20,
+  5,21, 6,22, 7,23, 8,24, 9,25, 10,26, 11,27, 12,28, 13,29, 14,30, 8,16,
+  9,17, 10,18, 11,19, 12,20, 13,21, 14,22, 15,23, 4,8, 5,9, 6,10, 7,11,
+  12,16, 13,17, 14,18, 15,19, 20,24, 21,25, 22,26, 23,27, 2,4, 3,5, 6,8, 7,9,
+  10,12, 11,13, 14,16, 15,17, 18,20, 19,21, 22,24, 23,25, 26,28, 27,29, 1,2,
+  3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 15,16, 17,18, 19,20, 21,22, 23,24,
+  25,26, 27,28, 29,30,
+  /* n = 32 */
+  0,1, 2,3, 4,5, 6,7, 8,9, 10,11, 12,13, 14,15, 16,17, 18,19, 20,21, 22,23,
+  24,25, 26,27, 28,29, 30,31, 0,2, 1,3, 4,6, 5,7, 8,10, 9,11, 12,14, 13,15,
+  16,18, 17,19, 20,22, 21,23, 24,26, 25,27, 28,30, 29,31, 1,2, 5,6, 9,10,
+  13,14, 17,18, 21,22, 25,26, 29,30, 0,4, 1,5, 2,6, 3,7, 8,12, 9,13, 10,14,
+  11,15, 16,20, 17,21, 18,22, 19,23, 24,28, 25,29, 26,30, 27,31, 2,4, 3,5,
+  10,12, 11,13, 18,20, 19,21, 26,28, 27,29, 1,2, 3,4, 5,6, 9,10, 11,12,
+  13,14, 17,18, 19,20, 21,22, 25,26, 27,28, 29,30, 0,8, 1,9, 2,10, 3,11,
+  4,12, 5,13, 6,14, 7,15, 16,24, 17,25, 18,26, 19,27, 20,28, 21,29, 22,30,
+  23,31, 4,8, 5,9, 6,10, 7,11, 20,24, 21,25, 22,26, 23,27, 2,4, 3,5, 6,8,
+  7,9, 10,12, 11,13, 18,20, 19,21, 22,24, 23,25, 26,28, 27,29, 1,2, 3,4, 5,6,
+  7,8, 9,10, 11,12, 13,14, 17,18, 19,20, 21,22, 23,24, 25,26, 27,28, 29,30,
+  0,16, 1,17, 2,18, 3,19, 4,20, 5,21, 6,22, 7,23, 8,24, 9,25, 10,26, 11,27,
+  12,28, 13,29, 14,30, 15,31, 8,16, 9,17, 10,18, 11,19, 12,20, 13,21, 14,22,
+  15,23, 4,8, 5,9, 6,10, 7,11, 12,16, 13,17, 14,18, 15,19, 20,24, 21,25,
+  22,26, 23,27, 2,4, 3,5, 6,8, 7,9, 10,12, 11,13, 14,16, 15,17, 18,20, 19,21,
+  22,24, 23,25, 26,28, 27,29, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 15,16,
+  17,18, 19,20, 21,22, 23,24, 25,26, 27,28, 29,30
+};
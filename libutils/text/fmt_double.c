@@ -0,0 +1,307 @@
+#include <math.h>
+
+#include "utils.h"
+
+/*
+ * Fast, exact double --> text conversion.
+ *
+ * fmt_fixed() and fmt_exp() produce exactly the same text as printf()'s
+ * "%.*f" and "%.*e" (round half to even on the exact binary value).
+ *
+ * The value is scaled by a single exact power of ten.  fma() recovers
+ * the rounding error of that multiply (or the remainder of the divide)
+ * exactly, which is all that is needed to round the scaled value
+ * correctly.  Anything outside of the fast path (inf/nan, huge or tiny
+ * exponents, too many digits) is handed to snprintf().
+ */
+
+/* Powers of ten that are exactly representable as doubles */
+static const double fmt_pow10[] =
+{
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define FMT_POW10_MAX   22
+#define FMT_MAX_PREC    15           /* fast path limit, %.15e and %.15f  */
+#define FMT_TWO_52      4503599627370496.0
+#define FMT_TWO_63      9223372036854775808.0
+
+typedef unsigned long long fmt_uint64;
+
+/*
+ * Round a * 10^k (a >= 0) to the nearest integer, ties to even.  Returns
+ * -1 if this can't be done exactly here.
+ */
+static int round_scaled(double a, int k, fmt_uint64 *result)
+{
+  double     y, err, d, t;
+  fmt_uint64 digits;
+  int        dir;
+
+  if (k > FMT_POW10_MAX || k < -FMT_POW10_MAX)
+    return (-1);
+
+  if (k >= 0)
+  {
+    /* a * p == y + err, exactly */
+    y   = a * fmt_pow10[k];
+    err = fma(a, fmt_pow10[k], -y);
+
+    if (y >= FMT_TWO_63)
+      return (-1);
+
+    /* y is an integer, the fraction is all in err */
+    if (y >= FMT_TWO_52)
+    {
+      d      = floor(err);
+      t      = err - d;
+      digits = (fmt_uint64)y;
+      digits = (d < 0) ? digits - 1 : digits + (fmt_uint64)d;
+
+      if (t > 0.5 || (t == 0.5 && (digits & 1)))
+        digits++;
+
+      *result = digits;
+
+      return (0);
+    }
+  }
+  else
+  {
+    /* a == y * p + err, exactly; err has the sign of the lost fraction */
+    y   = a / fmt_pow10[-k];
+    err = fma(-y, fmt_pow10[-k], a);
+
+    if (y >= FMT_TWO_52)
+      return (-1);
+  }
+
+  /*
+   * y - d is exact, and so is subtracting 0.5 from it (y < 2^52, so 0.5
+   * is a multiple of its ulp).  Unless t is 0, it is at least an ulp of
+   * y away from 0, so the lost fraction (at most half an ulp) can't
+   * change its sign.
+   */
+  d = floor(y);
+  t = (y - d) - 0.5;
+
+  if (t > 0)
+    dir = 1;
+  else if (t < 0)
+    dir = -1;
+  else
+    dir = (err > 0) ? 1 : ((err < 0) ? -1 : 0);
+
+  digits = (fmt_uint64)d;
+
+  if (dir > 0 || (dir == 0 && (digits & 1)))
+    digits++;
+
+  *result = digits;
+
+  return (0);
+}
+
+/* write exactly n digits of v, zero padded, returns n */
+static int put_digits(char *s, fmt_uint64 v, int n)
+{
+  int i;
+
+  for (i = n - 1; i >= 0; i--)
+  {
+    s[i] = '0' + (char)(v % 10);
+    v   /= 10;
+  }
+
+  return (n);
+}
+
+/* write all digits of v, returns the number written */
+static int put_uint(char *s, fmt_uint64 v)
+{
+  char tmp[24];
+  int  n = 0, i;
+
+  do
+  {
+    tmp[n++] = '0' + (char)(v % 10);
+    v       /= 10;
+  } while (v);
+
+  for (i = 0; i < n; i++)
+    s[i] = tmp[n - 1 - i];
+
+  return (n);
+}
+
+/* "e+XX", at least 2 exponent digits */
+static int put_exponent(char *s, int e10)
+{
+  int n = 0;
+
+  s[n++] = 'e';
+  if (e10 < 0)
+  {
+    s[n++] = '-';
+    e10    = -e10;
+  }
+  else
+    s[n++] = '+';
+
+  if (e10 < 10)
+    s[n++] = '0';
+
+  n += put_uint(s + n, (fmt_uint64)e10);
+
+  return (n);
+}
+
+/*
+ * Same as sprintf(s, "%.*f", prec, x).  s must have room for
+ * FMT_DOUBLE_BUFSIZE characters.  Returns the length of the text.
+ */
+int fmt_fixed(char *s, double x, int prec)
+{
+  fmt_uint64 ip, frac, scale;
+  double     a, ipart;
+  int        n = 0;
+
+  a = fabs(x);
+
+  if (!isfinite(x) || prec < 0 || prec > FMT_MAX_PREC || a >= FMT_TWO_52)
+    return (snprintf(s, FMT_DOUBLE_BUFSIZE, "%.*f", prec, x));
+
+  /* ties go to the even integer, not the even (empty) fraction */
+  if (prec == 0)
+  {
+    if (round_scaled(a, 0, &ip) != 0)
+      return (snprintf(s, FMT_DOUBLE_BUFSIZE, "%.*f", prec, x));
+
+    frac = 0;
+  }
+  else
+  {
+    ipart = floor(a);
+    if (round_scaled(a - ipart, prec, &frac) != 0)
+      return (snprintf(s, FMT_DOUBLE_BUFSIZE, "%.*f", prec, x));
+
+    ip = (fmt_uint64)ipart;
+  }
+
+  scale = (fmt_uint64)fmt_pow10[prec];
+
+  /* fraction rounded up to a whole unit */
+  if (frac >= scale)
+  {
+    frac -= scale;
+    ip++;
+  }
+
+  if (signbit(x))
+    s[n++] = '-';
+
+  n += put_uint(s + n, ip);
+
+  if (prec)
+  {
+    s[n++] = '.';
+    n     += put_digits(s + n, frac, prec);
+  }
+
+  s[n] = '\0';
+
+  return (n);
+}
+
+/*
+ * Significant digits of a (> 0): round a to prec + 1 significant digits,
+ * store them in *digits and the decimal exponent of the first digit in
+ * *e10.  Returns -1 if it can't be done exactly here.
+ */
+static int scale_digits(double a, int prec, fmt_uint64 *digits, int *e10)
+{
+  fmt_uint64 lo, hi, below;
+  int        e, tries;
+
+  lo = (fmt_uint64)fmt_pow10[prec];
+  hi = (fmt_uint64)fmt_pow10[prec + 1];
+
+  /* the estimate can be off by one near powers of ten */
+  e = (int)floor(log10(a));
+
+  for (tries = 0; tries < 4; tries++)
+  {
+    if (round_scaled(a, prec - e, digits) != 0)
+      return (-1);
+
+    if (*digits >= hi)
+      e++;
+    else if (*digits < lo)
+      e--;
+    else
+      break;
+  }
+
+  if (tries == 4)
+    return (-1);
+
+  /*
+   * Exactly lo may have been rounded up from below 10^e, in which case
+   * the exponent is e - 1 unless that rounds up to hi.
+   */
+  if (*digits == lo)
+  {
+    if (round_scaled(a, prec - e + 1, &below) != 0)
+      return (-1);
+
+    if (below < hi)
+    {
+      *digits = below;
+      e--;
+    }
+  }
+
+  *e10 = e;
+
+  return (0);
+}
+
+/*
+ * Same as sprintf(s, "%.*e", prec, x).  s must have room for
+ * FMT_DOUBLE_BUFSIZE characters.  Returns the length of the text.
+ */
+int fmt_exp(char *s, double x, int prec)
+{
+  fmt_uint64 digits = 0;
+  double     a;
+  int        e10 = 0, n = 0;
+
+  a = fabs(x);
+
+  if (!isfinite(x) || prec < 0 || prec > FMT_MAX_PREC ||
+      (a != 0 && (a < 1e-280 || a > 1e280)))
+    return (snprintf(s, FMT_DOUBLE_BUFSIZE, "%.*e", prec, x));
+
+  if (a != 0 && scale_digits(a, prec, &digits, &e10) != 0)
+    return (snprintf(s, FMT_DOUBLE_BUFSIZE, "%.*e", prec, x));
+
+  if (signbit(x))
+    s[n++] = '-';
+
+  /* leading digit, then the rest after the decimal point */
+  put_digits(s + n, digits, prec + 1);
+  if (prec)
+  {
+    memmove(s + n + 2, s + n + 1, prec);
+    s[n + 1] = '.';
+    n       += prec + 2;
+  }
+  else
+    n++;
+
+  n   += put_exponent(s + n, e10);
+  s[n] = '\0';
+
+  return (n);
+}
@@ -0,0 +1,180 @@
+#include "utils.h"
+
+/* size of each output buffer, written out with a single fwrite() */
+#define OUTPUT_BUFFER_SIZE (1024 * 1024)
+
+/*
+ * Buffered text output.  Text and formatted numbers are assembled in a
+ * large block and written out with one fwrite() per block, rather than
+ * one fprintf() per value.  Write errors are sticky: check
+ * output_buffer_error() (or the return of output_buffer_free()) once at
+ * the end, or once per row.
+ */
+
+/* allocate an output buffer for outfile, returns NULL if out of memory */
+OUTPUT_BUFFER *output_buffer_init(FILE *outfile)
+{
+  OUTPUT_BUFFER *ob;
+
+  ob = (OUTPUT_BUFFER *)calloc(1, sizeof(OUTPUT_BUFFER));
+  if (ob == NULL)
+    return (NULL);
+
+  ob->buf = (char *)malloc(OUTPUT_BUFFER_SIZE);
+  if (ob->buf == NULL)
+  {
+    free(ob);
+    return (NULL);
+  }
+
+  ob->fp   = outfile;
+  ob->size = OUTPUT_BUFFER_SIZE;
+
+  return (ob);
+}
+
+/* write out everything buffered so far, returns -1 on write error */
+int output_buffer_flush(OUTPUT_BUFFER *ob)
+{
+  if (ob->len && !ob->error)
+  {
+    if (fwrite(ob->buf, 1, ob->len, ob->fp) != ob->len)
+      ob->error = 1;
+  }
+
+  ob->len = 0;
+
+  return (ob->error ? -1 : 0);
+}
+
+/* flush and free, does not close the stream; returns -1 on write error */
+int output_buffer_free(OUTPUT_BUFFER *ob)
+{
+  int status;
+
+  if (ob == NULL)
+    return (0);
+
+  status = output_buffer_flush(ob);
+
+  free(ob->buf);
+  free(ob);
+
+  return (status);
+}
+
+int output_buffer_error(OUTPUT_BUFFER *ob)
+{
+  return (ob->error);
+}
+
+/* make sure there is room for len more characters */
+static INLINE void output_buffer_reserve(OUTPUT_BUFFER *ob, size_t len)
+{
+  if (ob->len + len > ob->size)
+    output_buffer_flush(ob);
+}
+
+void output_buffer_write(OUTPUT_BUFFER *ob, const char *s, size_t len)
+{
+  /* too large to be worth copying */
+  if (len > ob->size / 2)
+  {
+    output_buffer_flush(ob);
+
+    if (!ob->error && fwrite(s, 1, len, ob->fp) != len)
+      ob->error = 1;
+
+    return;
+  }
+
+  output_buffer_reserve(ob, len);
+
+  memcpy(ob->buf + ob->len, s, len);
+  ob->len += len;
+}
+
+void output_buffer_puts(OUTPUT_BUFFER *ob, const char *s)
+{
+  output_buffer_write(ob, s, strlen(s));
+}
+
+void output_buffer_putc(OUTPUT_BUFFER *ob, char c)
+{
+  output_buffer_reserve(ob, 1);
+
+  ob->buf[ob->len++] = c;
+}
+
+/* same as fprintf(fp, "%.*f", prec, x) */
+void output_buffer_fixed(OUTPUT_BUFFER *ob, double x, int prec)
+{
+  output_buffer_reserve(ob, FMT_DOUBLE_BUFSIZE);
+
+  ob->len += fmt_fixed(ob->buf + ob->len, x, prec);
+}
+
+/* same as fprintf(fp, "%.*e", prec, x) */
+void output_buffer_exp(OUTPUT_BUFFER *ob, double x, int prec)
+{
+  output_buffer_reserve(ob, FMT_DOUBLE_BUFSIZE);
+
+  ob->len += fmt_exp(ob->buf + ob->len, x, prec);
+}
+
+/* same as fprintf(fp, "%ld", v) */
+void output_buffer_int(OUTPUT_BUFFER *ob, long v)
+{
+  char          tmp[24];
+  unsigned long u;
+  int           n = 0;
+
+  output_buffer_reserve(ob, sizeof(tmp));
+
+  u = (v < 0) ? 0UL - (unsigned long)v : (unsigned long)v;
+  do
+  {
+    tmp[n++] = '0' + (char)(u % 10);
+    u       /= 10;
+  } while (u);
+
+  if (v < 0)
+    ob->buf[ob->len++] = '-';
+
+  while (n)
+    ob->buf[ob->len++] = tmp[--n];
+}
+
+/* anything else, for headers and the like */
+void output_buffer_printf(OUTPUT_BUFFER *ob, const char *fmt, ...)
+{
+  va_list ap;
+  int     len;
+
+  output_buffer_reserve(ob, FMT_DOUBLE_BUFSIZE);
+
+  va_start(ap, fmt);
+  len = vsnprintf(ob->buf + ob->len, ob->size - ob->len, fmt, ap);
+  va_end(ap);
+
+  if (len < 0)
+  {
+    ob->error = 1;
+    return;
+  }
+
+  /* didn't fit, write it out directly */
+  if ((size_t)len >= ob->size - ob->len)
+  {
+    output_buffer_flush(ob);
+
+    va_start(ap, fmt);
+    if (!ob->error && vfprintf(ob->fp, fmt, ap) < 0)
+      ob->error = 1;
+    va_end(ap);
+
+    return;
+  }
+
+  ob->len += len;
+}
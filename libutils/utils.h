@@ -19,6 +19,11 @@
  *              stem_from_filename(), since sample names in spreadsheets
  *              can have .A01, etc. extensions as part of the true sample
  *              name, and thus should not be removed. (EAW)
+ *  10/16/26 -- stem_from_filename_safer() also strips a trailing .gz, so
+ *              that foo.CEL.gz --> foo (EAW)
+ *  10/16/26 -- added fast exact double formatting (fmt_fixed(), fmt_exp())
+ *              and buffered OUTPUT_BUFFER text output (EAW)
+ *  10/16/26 -- added FNV-1a hashing, fnv1a_hash() and friends (EAW)
  *
  */
 
@@ -103,6 +108,25 @@
 extern const int  libutils_big_endian;
 extern const char libutils_version[];
 
+/* Starting value for fnv1a_hash() and friends */
+#define FNV1A_INIT 2166136261UL
+
+/* Room needed for any one number formatted by fmt_fixed() and friends */
+#define FMT_DOUBLE_BUFSIZE 384
+
+/*
+ * Buffered text output, see text/output_buffer.c.  Users should not
+ * rely on the contents of this structure.
+ */
+typedef struct output_buffer_s
+{
+  FILE   *fp;
+  char   *buf;
+  size_t  size;
+  size_t  len;
+  int     error;
+} OUTPUT_BUFFER;
+
 /********************************************************
  * Function prototypes.
  * 
@@ -121,11 +145,43 @@ extern "C"
   /* Simple interface for parsing floats. */
   int parsefloat(char *p_str, double *p_dest);
 
+  /* Exact double --> text, same output as "%.*f" "%.*e" */
+  int fmt_fixed(char *s, double x, int prec);
+  int fmt_exp(char *s, double x, int prec);
+
+  /* Buffered text output, one fwrite() per buffer */
+  OUTPUT_BUFFER *output_buffer_init(FILE *outfile);
+  int            output_buffer_flush(OUTPUT_BUFFER *ob);
+  int            output_buffer_free(OUTPUT_BUFFER *ob);
+  int            output_buffer_error(OUTPUT_BUFFER *ob);
+  void           output_buffer_write(OUTPUT_BUFFER *ob, const char *s,
+                                     size_t len);
+  void           output_buffer_puts(OUTPUT_BUFFER *ob, const char *s);
+  void           output_buffer_putc(OUTPUT_BUFFER *ob, char c);
+  void           output_buffer_fixed(OUTPUT_BUFFER *ob, double x, int prec);
+  void           output_buffer_exp(OUTPUT_BUFFER *ob, double x, int prec);
+  void           output_buffer_int(OUTPUT_BUFFER *ob, long v);
+  void           output_buffer_printf(OUTPUT_BUFFER *ob, const char *fmt, ...);
+
   /* Compare two doubles (for sorting) */
   int dcompare(const void *p1, const void *p2);
   int icompare(const void *p1, const void *p2);
   int fcompare(const void *p1, const void *p2);
 
+  /* Order statistics by selection (reorder x) */
+  double dselect(double *x, int n, int k);
+  void   dselect_multi(double *x, int n, const int *k, int nk);
+  double dmedian(double *x, int n);
+  void   dsort(double *x, int n);
+
+  /* Sorted order of x's indices, by radix sort (x is left alone) */
+  int    dsort_index(const double *x, int n, int *order);
+
+  /* 32 bit FNV-1a hashes, continuing from h (FNV1A_INIT to start) */
+  unsigned long fnv1a_hash(unsigned long h, const void *buf, size_t len);
+  unsigned long fnv1a_hash_string(unsigned long h, const char *s);
+  unsigned long fnv1a_hash_uint32(unsigned long h, unsigned long w);
+
   /* Matrix allocation */
   double **create_matrix(unsigned int rows, unsigned int columns);
   void     free_matrix(double **m);
@@ -356,7 +412,7 @@ static INLINE char *stem_from_filename(const char *p)
  *
  * *ONLY* removes .CEL and .TXT/.TEXT file extensions at the end, since
  *  some samplenames have .A01, etc. at the end when reading from
- *  spreadsheets
+ *  spreadsheets.  A trailing .gz is removed before checking.
  *
  * Example: /a/b/c/foo.txt  -->  foo
  *
@@ -384,6 +440,14 @@ static INLINE char *stem_from_filename_safer(const char *p)
   result = (char *)MALLOC(strlen(q) + 1);
   strcpy(result, q);
 
+  /* Strip .gz compression extension first, if present */
+  r = strrchr(result, '.');
+  if (r != NULL && r != result &&
+      tolower(r[1]) == 'g' && tolower(r[2]) == 'z' && r[3] == '\0')
+  {
+    *r = '\0';
+  }
+
   /* Find file extension */
   r = strrchr(result, '.');
 